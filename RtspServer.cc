@@ -4,6 +4,14 @@
 #include "reactor/cpp11_compat.h"
 #include "reactor/Logger.h"
 #include "media/MonitorServer.h"
+#include "media/Mp4Recorder.h"
+#include "media/ClipRecorder.h"
+#include "media/HlsServer.h"
+#include "media/RtpJitterBuffer.h"
+#include "media/PacketPool.h"
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 std::unique_ptr<MultiThreadEventLoop> g_server;
 // std::atomic_bool g_stopFlag{false};
@@ -12,17 +20,62 @@ void signalHandler(int sig) {
  
     if (g_server) g_server->stop();
 }
-int main() {
+// 用法：rtsp_server [-r 录像目录] [-s 单个录像文件秒数] [-e 事件片段目录] [-p 预录秒数] [-P 事后秒数] [-H HLS端口] [-j RTP/UDP推流重排等待毫秒]
+int main(int argc, char *argv[]) {
+    int opt;
+    unsigned short hlsPort = 0;
+    while ((opt = getopt(argc, argv, "r:s:e:p:P:H:j:")) != -1) {
+        if (opt == 'r') {
+            Mp4Recorder::options().dir = optarg;
+        } else if (opt == 's') {
+            Mp4Recorder::options().segmentSeconds = static_cast<uint32_t>(atoi(optarg));
+        } else if (opt == 'e') {
+            ClipRecorder::options().dir = optarg;
+        } else if (opt == 'p') {
+            ClipRecorder::options().preSeconds = static_cast<uint32_t>(atoi(optarg));
+        } else if (opt == 'P') {
+            ClipRecorder::options().postSeconds = static_cast<uint32_t>(atoi(optarg));
+        } else if (opt == 'H') {
+            hlsPort = static_cast<unsigned short>(atoi(optarg));
+            HlsSegmenter::options().enabled = hlsPort != 0;
+        } else if (opt == 'j') {
+            RtpJitterBuffer::options().depthMs = static_cast<uint32_t>(atoi(optarg));
+        } else {
+            std::cerr << "usage: " << argv[0] << " [-r record_dir] [-s segment_seconds]"
+                      << " [-e clip_dir] [-p pre_seconds] [-P post_seconds] [-H hls_port] [-j jitter_ms]" << std::endl;
+            return 1;
+        }
+    }
+    if (!Mp4Recorder::options().dir.empty()) {
+        ::mkdir(Mp4Recorder::options().dir.c_str(), 0755);
+        LOG_INFO("Recording pushed streams to %s", Mp4Recorder::options().dir.c_str());
+    }
+    if (!ClipRecorder::options().dir.empty()) {
+        ::mkdir(ClipRecorder::options().dir.c_str(), 0755);
+        LOG_INFO("Event clips to %s, %us before and %us after each trigger",
+                 ClipRecorder::options().dir.c_str(), ClipRecorder::options().preSeconds,
+                 ClipRecorder::options().postSeconds);
+    }
+
+    // KCP 分片从报文池里分，要在任何会话创建 ikcpcb 之前装上
+    PacketPool::installKcpAllocator();
 
     signal(SIGINT,  signalHandler);
     signal(SIGTERM, signalHandler);
+    // 观看端（尤其是放弃阻塞播放列表请求的 HLS 播放器）断开后再 writev 会收到 SIGPIPE，忽略它，按 EPIPE 关连接
+    signal(SIGPIPE, SIG_IGN);
 
     LOG_INFO("Starting Multi-Thread RTSP Server...");
-    g_server = std::make_unique<MultiThreadEventLoop>("0.0.0.0", 8554, 4);
+    // 每个子loop各自监听8554（SO_REUSEPORT），摄像头集中重连时由内核分散到各线程accept
+    g_server = std::make_unique<MultiThreadEventLoop>("0.0.0.0", 8554, 4, true);
 
-    // 启动监控 TCP 服务（独立线程），供 Qt 客户端连接
+    // 监控服务挂在各子loop上，供 Qt 客户端连接
     // 这里固定监听 9000 端口，Qt 端用 server_ip:9000 连接
-    MonitorServer::instance().start("0.0.0.0", 9000);
+    MonitorServer::instance().start(g_server->getSubLoops(), "0.0.0.0", 9000);
+    if (hlsPort != 0) {
+        // 浏览器用 http://server_ip:port/<流名称>/index.m3u8 观看，摄像头的检测结果在 /<流名称>/detections.json
+        HlsServer::instance().start(g_server->getSubLoops(), "0.0.0.0", hlsPort);
+    }
 
     try {
         // 启动（内部会主 loop 阻塞）
@@ -0,0 +1,337 @@
+// 丢包链路上的推流传输对比：KCP 重传（摄像头/服务器的实际参数）与 FEC（固定组大小、按丢包自适应），
+// 以及不加保护的普通 RTP。不收发真实报文：模拟时钟按 1ms 推进，链路是固定单向时延加
+// Gilbert-Elliott 丢包（平均丢包率、平均突发长度），两个方向独立。
+// 视频按 30fps、每 30 帧一个关键帧生成 RTP 包，统计：
+//   送达率、包时延（发出到接收端可用，KCP 是按序交付）、帧完整率和帧时延、
+//   线路字节数（含 28 字节 IP/UDP 头、KCP 的 ACK）与送达的 RTP 字节之比。
+// 丢包高时 KCP 拥塞窗口收缩，发送积压，跑完后仍未送达的包按丢失计。用法：
+//   fec_loss_bench [丢包率%列表=0,1,5,10,20] [单向时延ms=20] [平均突发长度=1] [秒数=30]
+#include "Fec.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+extern "C" {
+#include "ikcp.h"
+}
+
+static const int kFps = 30;
+static const int kGop = 30;
+static const size_t kKeyFrameBytes = 40000;
+static const size_t kFrameBytes = 5000;
+static const size_t kMaxPayload = 1384;      // 摄像头 RTP 包不超过 MTU-4 = 1396 字节
+static const size_t kWireHeader = 28;        // IPv4 + UDP
+static const uint32_t kFecMaxDelayMs = 40;   // 与 camera/fec.h 的 FEC_MAX_DELAY_MS 相同
+static const uint32_t kReportMs = 1000;      // 自适应 FEC 的丢包反馈间隔（RTCP RR）
+
+// Gilbert-Elliott：坏状态全丢，平均丢包率 loss，坏状态平均持续 burst 个包
+class LossModel {
+public:
+    LossModel(double loss, double burst, uint32_t seed) : _rng(seed), _bad(false) {
+        _toGood = 1.0 / burst;
+        _toBad = loss >= 1.0 ? 1.0 : loss * _toGood / (1.0 - loss);
+    }
+    bool drop() {
+        _bad = _bad ? (_u(_rng) >= _toGood) : (_u(_rng) < _toBad);
+        return _bad;
+    }
+private:
+    std::mt19937 _rng;
+    std::uniform_real_distribution<double> _u{0.0, 1.0};
+    double _toBad, _toGood;
+    bool _bad;
+};
+
+struct Datagram {
+    uint32_t arrival;
+    std::string data;
+};
+
+// 单向链路：固定时延，先进先出
+class Link {
+public:
+    Link(double loss, double burst, uint32_t delay, uint32_t seed) : _loss(loss, burst, seed), _delay(delay) {}
+    void send(uint32_t now, const char *data, size_t len) {
+        _wireBytes += len + kWireHeader;
+        ++_datagrams;
+        if (!_loss.drop()) {
+            _queue.push_back(Datagram{now + _delay, std::string(data, len)});
+        }
+    }
+    bool ready(uint32_t now) const { return !_queue.empty() && _queue.front().arrival <= now; }
+    std::string pop() {
+        std::string d = std::move(_queue.front().data);
+        _queue.pop_front();
+        return d;
+    }
+    uint64_t wireBytes() const { return _wireBytes; }
+private:
+    LossModel _loss;
+    uint32_t _delay;
+    std::deque<Datagram> _queue;
+    uint64_t _wireBytes = 0;
+    uint64_t _datagrams = 0;
+};
+
+struct Packet {
+    std::string rtp;
+    uint32_t frame;
+};
+
+struct Result {
+    const char *name;
+    size_t packets = 0, delivered = 0;
+    std::vector<uint32_t> latency;          // 每个送达的包
+    std::vector<uint32_t> frameLatency;     // 每个完整的帧：首包发出到最后一个包可用
+    size_t frames = 0;
+    uint64_t deliveredBytes = 0, wireBytes = 0;
+};
+
+static std::vector<Packet> makeStream(int seconds, std::vector<uint32_t> &frameSendMs) {
+    std::vector<Packet> pkts;
+    uint16_t seq = 0;
+    for (int f = 0; f < seconds * kFps; ++f) {
+        frameSendMs.push_back(f * 1000 / kFps);
+        size_t bytes = f % kGop == 0 ? kKeyFrameBytes : kFrameBytes;
+        uint32_t ts = f * (90000 / kFps);
+        while (bytes > 0) {
+            size_t n = std::min(bytes, kMaxPayload);
+            bytes -= n;
+            std::string rtp(12 + n, '\x5a');
+            rtp[0] = (char)0x80;
+            rtp[1] = (char)(96 | (bytes == 0 ? 0x80 : 0));
+            rtp[2] = (char)(seq >> 8);
+            rtp[3] = (char)seq;
+            for (int i = 0; i < 4; ++i) rtp[4 + i] = (char)(ts >> (24 - 8 * i));
+            rtp[8] = 0x12; rtp[9] = 0x34; rtp[10] = 0x56; rtp[11] = 0x78;
+            pkts.push_back(Packet{std::move(rtp), (uint32_t)f});
+            ++seq;
+        }
+    }
+    return pkts;
+}
+
+static uint16_t seqOf(const char *rtp) {
+    return (uint16_t)(((uint8_t)rtp[2] << 8) | (uint8_t)rtp[3]);
+}
+
+// 按包序号记录可用时间，最后汇总成包时延和帧时延
+class Tracker {
+public:
+    Tracker(const std::vector<Packet> &pkts, const std::vector<uint32_t> &frameSendMs)
+        : _pkts(pkts), _frameSendMs(frameSendMs), _arrival(pkts.size(), UINT32_MAX) {}
+    void deliver(uint16_t seq, uint32_t now) {
+        // 16 位序号回绕：取离最近送达位置最近的那一轮
+        size_t idx = (_hint & ~size_t(0xFFFF)) | seq;
+        if (idx + 0x8000 < _hint) idx += 0x10000;
+        else if (idx > _hint + 0x8000 && idx >= 0x10000) idx -= 0x10000;
+        if (idx >= _arrival.size() || _arrival[idx] != UINT32_MAX) return;
+        _arrival[idx] = now;
+        _hint = idx;
+    }
+    void finish(Result &r) const {
+        r.packets = _pkts.size();
+        r.frames = _frameSendMs.size();
+        std::vector<uint32_t> frameDone(_frameSendMs.size(), 0);
+        std::vector<bool> frameOk(_frameSendMs.size(), true);
+        for (size_t i = 0; i < _pkts.size(); ++i) {
+            uint32_t f = _pkts[i].frame;
+            if (_arrival[i] == UINT32_MAX) {
+                frameOk[f] = false;
+                continue;
+            }
+            ++r.delivered;
+            r.deliveredBytes += _pkts[i].rtp.size();
+            r.latency.push_back(_arrival[i] - _frameSendMs[f]);
+            frameDone[f] = std::max(frameDone[f], _arrival[i]);
+        }
+        for (size_t f = 0; f < frameOk.size(); ++f) {
+            if (frameOk[f]) r.frameLatency.push_back(frameDone[f] - _frameSendMs[f]);
+        }
+    }
+private:
+    const std::vector<Packet> &_pkts;
+    const std::vector<uint32_t> &_frameSendMs;
+    std::vector<uint32_t> _arrival;
+    size_t _hint = 0;
+};
+
+struct KcpPeer {
+    Link *link;
+    uint32_t now;
+};
+
+static int kcpOutput(const char *buf, int len, ikcpcb *, void *user) {
+    KcpPeer *peer = static_cast<KcpPeer *>(user);
+    peer->link->send(peer->now, buf, len);
+    return len;
+}
+
+static Result runKcp(const std::vector<Packet> &pkts, const std::vector<uint32_t> &frameSendMs,
+                     double loss, double burst, uint32_t delay, uint32_t endMs) {
+    Result r;
+    r.name = "kcp";
+    Link up(loss, burst, delay, 1), down(loss, burst, delay, 2);
+    KcpPeer camPeer{&up, 0}, srvPeer{&down, 0};
+    // 与 camera/kcp.c、RtspConnect::initCamKcp 相同的参数
+    ikcpcb *cam = ikcp_create(1, &camPeer);
+    ikcp_setoutput(cam, kcpOutput);
+    ikcp_nodelay(cam, 1, 10, 2, 0);
+    ikcp_wndsize(cam, 256, 256);
+    ikcp_setmtu(cam, 1450);
+    ikcpcb *srv = ikcp_create(1, &srvPeer);
+    ikcp_setoutput(srv, kcpOutput);
+    ikcp_nodelay(srv, 1, 10, 2, 0);
+    ikcp_wndsize(srv, 128, 128);
+    ikcp_setmtu(srv, 1450);
+
+    Tracker tracker(pkts, frameSendMs);
+    size_t next = 0;
+    char buf[2048];
+    for (uint32_t now = 0; now < endMs; ++now) {
+        camPeer.now = srvPeer.now = now;
+        while (next < pkts.size() && frameSendMs[pkts[next].frame] <= now) {
+            ikcp_send(cam, pkts[next].rtp.data(), (int)pkts[next].rtp.size());
+            ikcp_flush(cam);//摄像头每包 send 后立即 flush
+            ++next;
+        }
+        while (up.ready(now)) {
+            std::string d = up.pop();
+            ikcp_input(srv, d.data(), (long)d.size());
+            ikcp_flush(srv);//服务器收包后由 KcpScheduler 提前更新回 ACK
+        }
+        int n;
+        while ((n = ikcp_recv(srv, buf, sizeof(buf))) > 0) {
+            tracker.deliver(seqOf(buf), now);
+        }
+        while (down.ready(now)) {
+            std::string d = down.pop();
+            ikcp_input(cam, d.data(), (long)d.size());
+        }
+        ikcp_update(cam, now + 1000);
+        ikcp_update(srv, now + 1000);
+    }
+    ikcp_release(cam);
+    ikcp_release(srv);
+    tracker.finish(r);
+    r.wireBytes = up.wireBytes() + down.wireBytes();
+    return r;
+}
+
+// k=0 表示按接收端反馈的丢包自适应（Fec::paramsForLoss），m=0 表示不加校验（普通 RTP）
+static Result runFec(const char *name, int k, int m, const std::vector<Packet> &pkts,
+                     const std::vector<uint32_t> &frameSendMs, double loss, double burst,
+                     uint32_t delay, uint32_t endMs) {
+    Result r;
+    r.name = name;
+    Link up(loss, burst, delay, 1);
+    Tracker tracker(pkts, frameSendMs);
+    uint32_t now = 0;
+    bool adaptive = k == 0;
+    int k0 = k, m0 = m;
+    if (adaptive) Fec::paramsForLoss(0, k0, m0);
+    FecEncoder enc(k0, m0 > 0 ? m0 : 1);
+    enc.setOutput([&](const uint8_t *data, size_t len) {
+        up.send(now, reinterpret_cast<const char *>(data), len);
+    });
+    FecDecoder dec;
+    // 线路上实际收到的数据包，用来算反馈的丢包比例
+    uint64_t wireReceived = 0, lastReceived = 0;
+    uint16_t maxSeq = 0, lastMaxSeq = 0;
+    bool started = false;
+    dec.setPacketCallback([&](const char *data, size_t, bool recovered) {
+        tracker.deliver(seqOf(data), now);
+        if (!recovered) {
+            ++wireReceived;
+            uint16_t seq = seqOf(data);
+            if (!started || (int16_t)(seq - maxSeq) > 0) maxSeq = seq;
+            started = true;
+        }
+    });
+    std::deque<std::pair<uint32_t, uint8_t>> feedback;//到达发送端的时间、fraction lost
+    uint32_t groupStart = 0;
+    size_t next = 0;
+    for (; now < endMs; ++now) {
+        bool sent = false;
+        while (next < pkts.size() && frameSendMs[pkts[next].frame] <= now) {
+            const std::string &rtp = pkts[next].rtp;
+            if (enc.pending() == 0) groupStart = now;
+            up.send(now, rtp.data(), rtp.size());
+            if (m0 > 0) enc.add(reinterpret_cast<const uint8_t *>(rtp.data()), rtp.size());
+            ++next;
+            sent = true;
+        }
+        // 与摄像头一样：每帧发完后检查组首包等了多久
+        if (sent && enc.pending() > 0 && now - groupStart >= kFecMaxDelayMs) enc.flush();
+        while (up.ready(now)) {
+            std::string d = up.pop();
+            dec.input(d.data(), d.size());
+        }
+        if (adaptive && now > 0 && now % kReportMs == 0 && started) {
+            uint32_t expected = (uint16_t)(maxSeq - lastMaxSeq);
+            uint64_t got = wireReceived - lastReceived;
+            lastMaxSeq = maxSeq;
+            lastReceived = wireReceived;
+            uint8_t fraction = (expected == 0 || got >= expected) ? 0 : (uint8_t)(((expected - got) << 8) / expected);
+            feedback.push_back(std::make_pair(now + delay, fraction));//反馈也要走一个单向时延
+        }
+        while (!feedback.empty() && feedback.front().first <= now) {
+            int nk, nm;
+            Fec::paramsForLoss(feedback.front().second, nk, nm);
+            enc.setParams(nk, nm);
+            feedback.pop_front();
+        }
+    }
+    if (enc.pending() > 0) enc.flush();
+    tracker.finish(r);
+    r.wireBytes = up.wireBytes();
+    return r;
+}
+
+static uint32_t percentile(std::vector<uint32_t> v, double p) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    return v[std::min(v.size() - 1, (size_t)(p * v.size()))];
+}
+
+static void report(const Result &r) {
+    printf("  %-10s delivered=%6.2f%% pkt p50/p99/max=%3u/%4u/%4ums frames=%6.2f%% frame p50/p99=%3u/%4ums wire/goodput=%.2f\n",
+           r.name, 100.0 * r.delivered / r.packets,
+           percentile(r.latency, 0.5), percentile(r.latency, 0.99), percentile(r.latency, 1.0),
+           100.0 * r.frameLatency.size() / r.frames,
+           percentile(r.frameLatency, 0.5), percentile(r.frameLatency, 0.99),
+           r.deliveredBytes ? (double)r.wireBytes / r.deliveredBytes : 0.0);
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<double> losses;
+    std::string list = argc > 1 ? argv[1] : "0,1,5,10,20";
+    for (size_t pos = 0; pos < list.size(); ) {
+        size_t comma = list.find(',', pos);
+        if (comma == std::string::npos) comma = list.size();
+        losses.push_back(atof(list.substr(pos, comma - pos).c_str()) / 100);
+        pos = comma + 1;
+    }
+    uint32_t delay = argc > 2 ? (uint32_t)atoi(argv[2]) : 20;
+    double burst = argc > 3 ? atof(argv[3]) : 1.0;
+    int seconds = argc > 4 ? atoi(argv[4]) : 30;
+    if (burst < 1.0) burst = 1.0;
+
+    std::vector<uint32_t> frameSendMs;
+    std::vector<Packet> pkts = makeStream(seconds, frameSendMs);
+    uint32_t endMs = seconds * 1000 + 5000;//留时间让重传收尾
+    printf("%zu RTP packets, %ds, one-way delay %ums, mean burst %.1f\n", pkts.size(), seconds, delay, burst);
+    for (double loss : losses) {
+        printf("loss %.1f%%\n", loss * 100);
+        report(runFec("rtp", 1, 0, pkts, frameSendMs, loss, burst, delay, endMs));
+        report(runKcp(pkts, frameSendMs, loss, burst, delay, endMs));
+        report(runFec("fec 10+1", 10, 1, pkts, frameSendMs, loss, burst, delay, endMs));
+        report(runFec("fec 10+2", 10, 2, pkts, frameSendMs, loss, burst, delay, endMs));
+        report(runFec("fec adapt", 0, 0, pkts, frameSendMs, loss, burst, delay, endMs));
+    }
+    return 0;
+}
@@ -0,0 +1,192 @@
+// 新观看者首帧时间测试：一个 loop 上按 25fps、GOP=25 帧模拟摄像头的 RTP 流
+// （IDR 前带 SPS/PPS，大帧按 FU-A 分片），观看者在随机时刻挂上 StreamFanout，
+// 经内存中的 KCP 链路收包，统计从挂上到收齐第一个可解码关键帧（SPS+PPS+完整 IDR）的时间。
+// 分别在关闭/打开 GOP 缓存时各测一次。用法：
+//   gop_ttff_bench [观看者数=20] [GOP帧数=25] [帧率=25]
+#include "EventLoop.h"
+#include "Acceptor.h"
+#include "KcpScheduler.h"
+#include "StreamFanout.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static const size_t kMtuPayload = 1400;
+static const size_t kIdrBytes = 40000;
+static const size_t kPBytes = 6000;
+
+struct Viewer {
+    ikcpcb *server = nullptr;   // 服务器侧，挂在 fanout 上
+    ikcpcb *client = nullptr;   // qt 客户端侧
+    StreamFanout *fanout = nullptr;
+    Clock::time_point attached;
+    bool sps = false, pps = false, done = false;
+    double ttffMs = 0;
+};
+
+static int serverOutput(const char *buf, int len, ikcpcb *, void *user) {
+    ikcp_input(static_cast<Viewer *>(user)->client, buf, len);
+    return len;
+}
+
+static int clientOutput(const char *buf, int len, ikcpcb *, void *user) {
+    Viewer *v = static_cast<Viewer *>(user);
+    ikcp_input(v->server, buf, len);
+    KcpScheduler::instance(v->fanout->loop()).touch(v->server);
+    v->fanout->pump(v->server);
+    return len;
+}
+
+static std::string rtpPacket(uint16_t seq, uint32_t ts, bool marker, const std::string &payload) {
+    std::string pkt(12, '\0');
+    pkt[0] = (char)0x80;
+    pkt[1] = (char)(96 | (marker ? 0x80 : 0));
+    pkt[2] = (char)(seq >> 8);
+    pkt[3] = (char)seq;
+    pkt[4] = (char)(ts >> 24);
+    pkt[5] = (char)(ts >> 16);
+    pkt[6] = (char)(ts >> 8);
+    pkt[7] = (char)ts;
+    return pkt + payload;
+}
+
+// 一帧拆成 RTP 报文，与摄像头端 rtp_send_h264 相同的打包方式
+static void packFrame(int nalType, size_t size, uint16_t &seq, uint32_t ts, std::vector<std::string> &out) {
+    if (size + 12 <= kMtuPayload) {
+        out.push_back(rtpPacket(seq++, ts, true, std::string(1, (char)(0x60 | nalType)) + std::string(size - 1, 'x')));
+        return;
+    }
+    size_t left = size - 1;
+    bool first = true;
+    while (left > 0) {
+        size_t n = std::min(left, kMtuPayload - 14);
+        left -= n;
+        std::string fu(2, '\0');
+        fu[0] = (char)(0x60 | 28);
+        fu[1] = (char)((first ? 0x80 : 0) | (left == 0 ? 0x40 : 0) | nalType);
+        out.push_back(rtpPacket(seq++, ts, left == 0, fu + std::string(n, 'x')));
+        first = false;
+    }
+}
+
+static void onClientPacket(Viewer &v, const char *data, int len) {
+    if (v.done || len <= 13) return;
+    int type = data[12] & 0x1F;
+    bool end = true;
+    if (type == 28) {
+        end = (data[13] & 0x40) != 0;
+        type = data[13] & 0x1F;
+    }
+    if (type == 7) v.sps = true;
+    if (type == 8) v.pps = true;
+    if (type == 5 && end && v.sps && v.pps) {
+        v.done = true;
+        v.ttffMs = std::chrono::duration<double, std::milli>(Clock::now() - v.attached).count();
+    }
+}
+
+static void run(bool gopCache, int viewerNum, int gop, int fps) {
+    Acceptor acceptor("127.0.0.1", 0);
+    EventLoop loop(acceptor, false);
+    std::thread loopThread([&loop]() { loop.loop(); });
+
+    StreamFanout fanout(&loop, gopCache);
+    std::vector<std::unique_ptr<Viewer>> viewers;
+    int frameMs = 1000 / fps;
+    std::mt19937 rng(12345);
+    std::uniform_int_distribution<int> attachAt(gop * frameMs, 4 * gop * frameMs);
+    std::vector<int> attachMs;
+    for (int i = 0; i < viewerNum; ++i) attachMs.push_back(attachAt(rng));
+    int runMs = 6 * gop * frameMs;
+
+    loop.runInLoop([&]() {
+        // 摄像头：每帧一次定时器
+        auto frameNo = std::make_shared<int>(0);
+        auto seq = std::make_shared<uint16_t>(0);
+        loop.addPeriodicTimer(0, frameMs, [&, frameNo, seq]() {
+            std::vector<std::string> pkts;
+            uint32_t ts = (uint32_t)(*frameNo) * 90000 / fps;
+            if (*frameNo % gop == 0) {
+                packFrame(7, 20, *seq, ts, pkts);
+                packFrame(8, 6, *seq, ts, pkts);
+                packFrame(5, kIdrBytes, *seq, ts, pkts);
+            } else {
+                packFrame(1, kPBytes, *seq, ts, pkts);
+            }
+            ++*frameNo;
+            for (const std::string &p : pkts) fanout.publish(p.data(), p.size());
+        });
+        // 观看者在各自的时刻挂上来
+        for (int i = 0; i < viewerNum; ++i) {
+            viewers.emplace_back(new Viewer);
+            Viewer *v = viewers.back().get();
+            loop.addOneTimer(attachMs[i], [&loop, &fanout, v, i]() {
+                v->fanout = &fanout;
+                v->server = ikcp_create(1000 + i, v);
+                v->client = ikcp_create(1000 + i, v);
+                ikcp_setoutput(v->server, serverOutput);
+                ikcp_setoutput(v->client, clientOutput);
+                for (ikcpcb *k : {v->server, v->client}) {
+                    ikcp_nodelay(k, 1, 10, 2, 0);
+                    ikcp_wndsize(k, 256, 256);
+                    ikcp_setmtu(k, 1450);
+                }
+                v->attached = Clock::now();
+                KcpScheduler::instance(&loop).add(v->server, [v]() { v->fanout->pump(v->server); });
+                fanout.addSubscriber(v->server);
+            });
+        }
+        // 客户端侧 KCP：10ms 更新一次并收包
+        loop.addPeriodicTimer(10, 10, [&]() {
+            char buf[4096];
+            for (auto &vp : viewers) {
+                Viewer &v = *vp;
+                if (!v.client) continue;
+                ikcp_update(v.client, KcpScheduler::iclock());
+                int n;
+                while ((n = ikcp_recv(v.client, buf, sizeof(buf))) > 0) onClientPacket(v, buf, n);
+            }
+        });
+        loop.addOneTimer(runMs, [&]() {
+            for (auto &vp : viewers) {
+                if (!vp->server) continue;
+                fanout.removeSubscriber(vp->server);
+                KcpScheduler::instance(&loop).remove(vp->server);
+                ikcp_release(vp->server);
+                ikcp_release(vp->client);
+            }
+            loop.unloop();
+        });
+    });
+    loopThread.join();
+
+    std::vector<double> ttff;
+    for (auto &v : viewers) {
+        if (v->done) ttff.push_back(v->ttffMs);
+    }
+    std::sort(ttff.begin(), ttff.end());
+    double sum = 0;
+    for (double t : ttff) sum += t;
+    printf("gopCache=%-3s viewers=%d decoded=%zu ttff avg=%.0fms p50=%.0fms max=%.0fms\n",
+           gopCache ? "on" : "off", viewerNum, ttff.size(),
+           ttff.empty() ? 0 : sum / ttff.size(),
+           ttff.empty() ? 0 : ttff[ttff.size() / 2],
+           ttff.empty() ? 0 : ttff.back());
+}
+
+int main(int argc, char *argv[]) {
+    int viewerNum = argc > 1 ? atoi(argv[1]) : 20;
+    int gop = argc > 2 ? atoi(argv[2]) : 25;
+    int fps = argc > 3 ? atoi(argv[3]) : 25;
+    run(false, viewerNum, gop, fps);
+    run(true, viewerNum, gop, fps);
+    return 0;
+}
@@ -0,0 +1,88 @@
+// EventLoop 分发吞吐测试
+// 在一个子 EventLoop 上挂 N 个 UdpConnection，若干发送线程向这些端口轮流打包，
+// 统计 loop 每秒分发的就绪事件数。用法：
+//   loop_dispatch_bench [连接数=256] [秒数=5] [发送线程数=2] [起始端口=30000]
+#include "EventLoop.h"
+#include "Acceptor.h"
+#include "UdpConnection.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+int main(int argc, char *argv[]) {
+    int connNum = argc > 1 ? atoi(argv[1]) : 256;
+    int seconds = argc > 2 ? atoi(argv[2]) : 5;
+    int senderNum = argc > 3 ? atoi(argv[3]) : 2;
+    int basePort = argc > 4 ? atoi(argv[4]) : 30000;
+
+    Acceptor acceptor("127.0.0.1", 0);  // 子 loop 不监听，只为满足构造参数
+    EventLoop loop(acceptor, false);
+    std::thread loopThread([&loop]() { loop.loop(); });
+
+    std::atomic<uint64_t> events{0};
+    std::atomic<uint64_t> packets{0};
+    std::vector<UdpConnectionPtr> conns;
+    for (int i = 0; i < connNum; ++i) {
+        auto conn = std::make_shared<UdpConnection>("127.0.0.1", basePort + i,
+            InetAddress("127.0.0.1", basePort + i), &loop);
+        conn->setMessageCallback([&events, &packets](const UdpConnectionPtr &c) {
+            char buf[1500];
+            events.fetch_add(1, std::memory_order_relaxed);
+            while (c->recv(buf, sizeof(buf)) > 0) {
+                packets.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+        conns.push_back(conn);
+    }
+    std::atomic<int> added{0};
+    for (auto &conn : conns) {
+        loop.runInLoop([&loop, &added, conn]() {
+            loop.addUdpConnection(conn);
+            added++;
+        });
+    }
+    while (added < connNum) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    std::atomic<bool> sending{true};
+    std::vector<std::thread> senders;
+    for (int t = 0; t < senderNum; ++t) {
+        senders.emplace_back([&, t]() {
+            int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+            char payload[200] = {0};
+            int idx = t;
+            while (sending) {
+                InetAddress dst("127.0.0.1", basePort + idx);
+                ::sendto(fd, payload, sizeof(payload), MSG_DONTWAIT,
+                         (const sockaddr *)dst.getInetAddrPtr(), sizeof(sockaddr_in));
+                idx = (idx + senderNum) % connNum;
+            }
+            ::close(fd);
+        });
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    uint64_t e0 = events, p0 = packets;
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    uint64_t e1 = events, p1 = packets;
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    sending = false;
+    for (auto &s : senders) s.join();
+    loop.runInLoop([&loop, &conns]() {
+        for (auto &conn : conns) loop.removeUdpConnection(conn);
+        loop.unloop();
+    });
+    loopThread.join();
+
+    printf("connections=%d senders=%d seconds=%.2f\n", connNum, senderNum, sec);
+    printf("events=%llu events/sec=%.0f packets/sec=%.0f\n",
+           (unsigned long long)(e1 - e0), (e1 - e0) / sec, (p1 - p0) / sec);
+    return 0;
+}
@@ -0,0 +1,216 @@
+// 录像压测：一个线程（一个核）把 N 路合成的 H.264 RTP 流（25fps，GOP 50，FU-A 分片）
+// 交给 Mp4Recorder，写盘走 AsyncFileWriter 的 I/O 线程。统计录像线程的 CPU 时间，
+// 换算成一个核能持续录多少路实时流，同时给出单帧处理的最长耗时（磁盘卡住时不应变长）。
+// 倍速为 0 时不限速，喂得比磁盘快，多出来的分片会被丢弃（计入 dropped_fragments）。用法：
+//   mp4_record_bench [路数=32] [每路秒数=60] [码率kbps=2048] [倍速=0] [目录=/tmp/mp4_record_bench]
+#include "Mp4Recorder.h"
+#include "AsyncFileWriter.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#include <time.h>
+
+using Clock = std::chrono::steady_clock;
+
+static const int kFps = 25;
+static const int kGop = 50;
+static const size_t kMaxPayload = 1400;
+
+// 指数哥伦布写 1280x720 baseline SPS
+class BitWriter {
+public:
+    void bits(uint32_t v, int n) {
+        while (n-- > 0) {
+            _cur = (_cur << 1) | ((v >> n) & 1);
+            if (++_count == 8) {
+                _out.push_back(static_cast<char>(_cur));
+                _cur = 0;
+                _count = 0;
+            }
+        }
+    }
+    void ue(uint32_t v) {
+        uint32_t x = v + 1;
+        int len = 0;
+        while ((x >> len) > 1) ++len;
+        bits(0, len);
+        bits(x, len + 1);
+    }
+    std::string finish() {
+        bits(1, 1);                                     // rbsp_stop_one_bit
+        while (_count != 0) bits(0, 1);
+        return _out;
+    }
+
+private:
+    std::string _out;
+    uint32_t _cur = 0;
+    int _count = 0;
+};
+
+static std::string makeSps() {
+    BitWriter w;
+    w.bits(0x67, 8);
+    w.bits(66, 8);                                      // baseline
+    w.bits(0xC0, 8);
+    w.bits(31, 8);                                      // level 3.1
+    w.ue(0);                                            // sps id
+    w.ue(0);                                            // log2_max_frame_num_minus4
+    w.ue(2);                                            // poc type
+    w.ue(1);                                            // max_num_ref_frames
+    w.bits(0, 1);
+    w.ue(1280 / 16 - 1);
+    w.ue(720 / 16 - 1);
+    w.bits(1, 1);                                       // frame_mbs_only
+    w.bits(1, 1);                                       // direct_8x8_inference
+    w.bits(0, 1);                                       // cropping
+    w.bits(0, 1);                                       // vui
+    return w.finish();
+}
+
+struct Packet {
+    std::string data;
+    bool lastOfFrame;
+};
+
+static void rtpHeader(std::string &pkt, bool marker) {
+    pkt.assign(12, '\0');
+    pkt[0] = static_cast<char>(0x80);
+    pkt[1] = static_cast<char>(96 | (marker ? 0x80 : 0));
+}
+
+static void packNal(std::vector<Packet> &out, const std::string &nal, bool lastNal) {
+    Packet p;
+    if (nal.size() <= kMaxPayload) {
+        rtpHeader(p.data, lastNal);
+        p.data += nal;
+        p.lastOfFrame = lastNal;
+        out.push_back(p);
+        return;
+    }
+    for (size_t pos = 1; pos < nal.size(); pos += kMaxPayload) {
+        size_t n = std::min(kMaxPayload, nal.size() - pos);
+        bool first = pos == 1, last = pos + n == nal.size();
+        rtpHeader(p.data, last && lastNal);
+        p.data.push_back(static_cast<char>((nal[0] & 0xE0) | 28));
+        p.data.push_back(static_cast<char>((first ? 0x80 : 0) | (last ? 0x40 : 0) | (nal[0] & 0x1F)));
+        p.data.append(nal, pos, n);
+        p.lastOfFrame = last && lastNal;
+        out.push_back(p);
+    }
+}
+
+// 一个 GOP 的报文模板，各路发送时只改序号和时间戳
+static std::vector<Packet> makeGop(size_t kbps) {
+    size_t avg = kbps * 1000 / 8 / kFps;
+    size_t idrSize = avg * 4;
+    size_t pSize = (avg * kGop - idrSize) / (kGop - 1);
+    std::vector<Packet> gop;
+    std::string sps = makeSps();
+    std::string pps("\x68\xCE\x38\x80", 4);
+    packNal(gop, sps, false);
+    packNal(gop, pps, false);
+    unsigned seed = 1;
+    for (int f = 0; f < kGop; ++f) {
+        std::string nal(f == 0 ? idrSize : pSize, '\0');
+        nal[0] = static_cast<char>(f == 0 ? 0x65 : 0x41);
+        for (size_t i = 1; i < nal.size(); ++i) {
+            seed = seed * 1103515245 + 12345;
+            nal[i] = static_cast<char>((seed >> 16) | 1);   // 避开 00 00 0x 起始码
+        }
+        packNal(gop, nal, true);
+    }
+    return gop;
+}
+
+static double threadCpuSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+    int streams = argc > 1 ? atoi(argv[1]) : 32;
+    int seconds = argc > 2 ? atoi(argv[2]) : 60;
+    size_t kbps = argc > 3 ? strtoul(argv[3], nullptr, 10) : 2048;
+    double speed = argc > 4 ? atof(argv[4]) : 0;
+    std::string dir = argc > 5 ? argv[5] : "/tmp/mp4_record_bench";
+    ::mkdir(dir.c_str(), 0755);
+
+    std::vector<Packet> gop = makeGop(kbps);
+    AsyncFileWriter writer;
+    Mp4Recorder::Options options;
+    options.dir = dir;
+    std::vector<std::unique_ptr<Mp4Recorder>> recorders;
+    for (int i = 0; i < streams; ++i) {
+        recorders.emplace_back(new Mp4Recorder("cam" + std::to_string(i), options, writer));
+    }
+
+    std::vector<uint16_t> seqs(streams, 0);
+    std::vector<double> frameCost;
+    frameCost.reserve(static_cast<size_t>(streams) * seconds * kFps);
+    size_t frames = static_cast<size_t>(seconds) * kFps;
+    uint64_t bytesIn = 0;
+    auto wall0 = Clock::now();
+    double cpu0 = threadCpuSeconds();
+    size_t pos = 0;                                     // 当前帧在 GOP 模板里的起点
+    for (size_t f = 0; f < frames; ++f) {
+        size_t begin = (f % kGop == 0) ? 0 : pos;
+        size_t end = begin;
+        while (!gop[end].lastOfFrame) ++end;
+        ++end;
+        uint32_t ts = static_cast<uint32_t>(f * (90000 / kFps));
+        for (int s = 0; s < streams; ++s) {
+            auto t0 = Clock::now();
+            for (size_t i = begin; i < end; ++i) {
+                std::string &pkt = gop[i].data;
+                uint16_t seq = seqs[s]++;
+                pkt[2] = static_cast<char>(seq >> 8);
+                pkt[3] = static_cast<char>(seq);
+                pkt[4] = static_cast<char>(ts >> 24);
+                pkt[5] = static_cast<char>(ts >> 16);
+                pkt[6] = static_cast<char>(ts >> 8);
+                pkt[7] = static_cast<char>(ts);
+                recorders[s]->onRtp(pkt.data(), pkt.size());
+                bytesIn += pkt.size();
+            }
+            frameCost.push_back(std::chrono::duration<double, std::micro>(Clock::now() - t0).count());
+        }
+        pos = (f % kGop == kGop - 1) ? 0 : end;
+        if (speed > 0) {
+            std::this_thread::sleep_until(wall0 + std::chrono::duration<double>((f + 1) / (kFps * speed)));
+        }
+    }
+    Mp4Recorder::Stats total;
+    for (auto &r : recorders) {
+        r->close();
+        total.frames += r->stats().frames;
+        total.fragments += r->stats().fragments;
+        total.segments += r->stats().segments;
+        total.droppedFragments += r->stats().droppedFragments;
+    }
+    double cpu = threadCpuSeconds() - cpu0;
+    double feedWall = std::chrono::duration<double>(Clock::now() - wall0).count();
+    writer.flush();                                     // 等 I/O 线程写完
+    double wall = std::chrono::duration<double>(Clock::now() - wall0).count();
+
+    std::sort(frameCost.begin(), frameCost.end());
+    double mediaSeconds = static_cast<double>(streams) * seconds;
+    printf("streams=%d x %ds @ %zukbps  input=%.1fMB  frames=%lu fragments=%lu files=%lu dropped_fragments=%lu\n",
+           streams, seconds, kbps, bytesIn / 1e6, (unsigned long)total.frames,
+           (unsigned long)total.fragments, (unsigned long)total.segments,
+           (unsigned long)total.droppedFragments);
+    printf("recorder thread: cpu=%.3fs wall=%.3fs  -> %.0f realtime streams per core  (%.0f MB/s)\n",
+           cpu, feedWall, mediaSeconds / cpu, bytesIn / 1e6 / cpu);
+    printf("per-frame cost: p50=%.1fus p99=%.1fus max=%.1fus\n",
+           frameCost[frameCost.size() / 2], frameCost[frameCost.size() * 99 / 100], frameCost.back());
+    printf("disk: %.1fMB in %.3fs including drain (%.0f MB/s)\n",
+           writer.stats().bytesWritten.load() / 1e6, wall, writer.stats().bytesWritten.load() / 1e6 / wall);
+    return 0;
+}
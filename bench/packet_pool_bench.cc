@@ -0,0 +1,208 @@
+// 数据通路内存分配次数测试：在一个线程里用模拟时钟跑 N 路摄像头，每路 25fps（关键帧 40KB，其余 6KB，
+// 按 1400 字节打 RTP 包），一半经 KCP 推流、一半按 TCP interleaved 推流，收到的报文拷成共享数据块，
+// 放进 GOP 缓存，再分给一个 KCP 观看端（qt 客户端）和一个 RTP 观看端（数据块在发送链上挂几毫秒）。
+// 统计每秒的内存分配次数（全局 operator new 和 ikcp 的分配都计入）：
+//   malloc —— 原来的做法：ikcp 用 malloc，数据块 make_shared
+//   pool   —— PacketPool：ikcp_allocator 装上块池，数据块用 makeBuffer
+// 用法：packet_pool_bench [摄像头路数=16] [模拟秒数=20]
+#include "PacketPool.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <new>
+#include <string>
+#include <vector>
+extern "C"{
+#include "ikcp.h"
+}
+
+static std::atomic<uint64_t> g_allocs{0};
+
+// 替换全局 operator new 计数，底下仍是 malloc/free
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void *operator new(size_t size) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    void *p = malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    return malloc(size ? size : 1);
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { free(p); }
+
+static void *countedMalloc(size_t size) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    return malloc(size);
+}
+
+static const int kFps = 25;
+static const int kGop = 25;
+static const size_t kIdrBytes = 40000;
+static const size_t kPBytes = 6000;
+static const size_t kRtpPayload = 1400;
+static const size_t kGopPackets = 256;      // GOP 缓存里留的报文数
+static const uint32_t kSinkHoldMs = 5;      // RTP 观看端发送链上挂的时间
+
+struct Camera {
+    bool kcpIngest = false;
+    ikcpcb *cam = nullptr;          // 摄像头侧
+    ikcpcb *server = nullptr;       // 服务器收流
+    ikcpcb *sub = nullptr;          // 服务器发给 qt 客户端
+    ikcpcb *qt = nullptr;           // qt 客户端
+    uint16_t seq = 0;
+    uint32_t frame = 0;
+    std::deque<BufferPtr> gop;
+    std::deque<BufferPtr> pending;  // qt 客户端的待发队列
+    std::deque<std::pair<uint32_t, BufferPtr>> sinkChain;
+    uint64_t delivered = 0;
+};
+
+static int camOutput(const char *buf, int len, ikcpcb *, void *user) {
+    ikcp_input(static_cast<Camera *>(user)->server, buf, len);
+    return len;
+}
+static int serverOutput(const char *buf, int len, ikcpcb *, void *user) {
+    ikcp_input(static_cast<Camera *>(user)->cam, buf, len);
+    return len;
+}
+static int subOutput(const char *buf, int len, ikcpcb *, void *user) {
+    ikcp_input(static_cast<Camera *>(user)->qt, buf, len);
+    return len;
+}
+static int qtOutput(const char *buf, int len, ikcpcb *, void *user) {
+    ikcp_input(static_cast<Camera *>(user)->sub, buf, len);
+    return len;
+}
+
+static ikcpcb *createKcp(uint32_t conv, Camera *c, int (*output)(const char *, int, ikcpcb *, void *)) {
+    ikcpcb *k = ikcp_create(conv, c);
+    ikcp_setoutput(k, output);
+    ikcp_nodelay(k, 1, 10, 2, 0);
+    ikcp_wndsize(k, 256, 256);
+    ikcp_setmtu(k, 1450);
+    return k;
+}
+
+static BufferPtr copyPacket(bool pool, const char *data, size_t len) {
+    return pool ? PacketPool::makeBuffer(data, len) : std::make_shared<const std::string>(data, len);
+}
+
+// 和 StreamFanout::publish 一样：进 GOP 缓存，交给 RTP 观看端，排进 qt 客户端的待发队列
+static void publish(Camera &c, const BufferPtr &buf, uint32_t now) {
+    c.gop.push_back(buf);
+    if (c.gop.size() > kGopPackets) c.gop.pop_front();
+    c.sinkChain.emplace_back(now, buf);
+    c.pending.push_back(buf);
+    while (!c.pending.empty() && ikcp_waitsnd(c.sub) < (int)c.sub->snd_wnd) {
+        ikcp_send(c.sub, c.pending.front()->data(), (int)c.pending.front()->size());
+        c.pending.pop_front();
+    }
+}
+
+static void sendFrame(Camera &c, bool pool, uint32_t now, char *pkt) {
+    size_t left = (c.frame % kGop == 0) ? kIdrBytes : kPBytes;
+    ++c.frame;
+    while (left > 0) {
+        size_t n = left < kRtpPayload ? left : kRtpPayload;
+        left -= n;
+        size_t len = 12 + n;
+        pkt[0] = (char)0x80;
+        pkt[1] = (char)(96 | (left == 0 ? 0x80 : 0));
+        pkt[2] = (char)(c.seq >> 8);
+        pkt[3] = (char)c.seq;
+        ++c.seq;
+        if (c.kcpIngest) {
+            ikcp_send(c.cam, pkt, (int)len);
+        } else {
+            publish(c, copyPacket(pool, pkt, len), now);//interleaved 帧直接从接收缓冲拷出
+        }
+    }
+}
+
+static void run(bool pool, int cameras, int seconds) {
+    if (pool) {
+        PacketPool::installKcpAllocator();
+    } else {
+        ikcp_allocator(countedMalloc, free);
+    }
+    std::vector<Camera> cams(cameras);
+    for (int i = 0; i < cameras; ++i) {
+        Camera &c = cams[i];
+        c.kcpIngest = i % 2 == 0;
+        if (c.kcpIngest) {
+            c.cam = createKcp(100 + i, &c, camOutput);
+            c.server = createKcp(100 + i, &c, serverOutput);
+        }
+        c.sub = createKcp(1000 + i, &c, subOutput);
+        c.qt = createKcp(1000 + i, &c, qtOutput);
+    }
+
+    char pkt[1500] = {0};
+    char buf[4096];
+    uint64_t startAllocs = g_allocs.load();
+    uint64_t warmAllocs = 0;
+    uint64_t packets = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    uint32_t frameMs = 1000 / kFps;
+    for (uint32_t now = 0; now < (uint32_t)seconds * 1000; ++now) {
+        if (now == 1000) warmAllocs = g_allocs.load();
+        for (int i = 0; i < cameras; ++i) {
+            Camera &c = cams[i];
+            if ((now + i) % frameMs == 0) sendFrame(c, pool, now, pkt);
+            if (c.kcpIngest) {
+                ikcp_update(c.cam, now);
+                ikcp_update(c.server, now);
+                int n;
+                while ((n = ikcp_recv(c.server, buf, sizeof(buf))) > 0) {
+                    publish(c, copyPacket(pool, buf, n), now);
+                }
+            }
+            while (!c.sinkChain.empty() && now - c.sinkChain.front().first >= kSinkHoldMs) {
+                c.sinkChain.pop_front();
+            }
+            ikcp_update(c.sub, now);
+            ikcp_update(c.qt, now);
+            while (ikcp_recv(c.qt, buf, sizeof(buf)) > 0) ++c.delivered;
+            while (!c.pending.empty() && ikcp_waitsnd(c.sub) < (int)c.sub->snd_wnd) {
+                ikcp_send(c.sub, c.pending.front()->data(), (int)c.pending.front()->size());
+                c.pending.pop_front();
+            }
+        }
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    uint64_t endAllocs = g_allocs.load();
+    for (Camera &c : cams) {
+        packets += c.delivered;
+        for (ikcpcb *k : {c.cam, c.server, c.sub, c.qt}) {
+            if (k) ikcp_release(k);
+        }
+    }
+    cams.clear();
+
+    double total = (double)(endAllocs - startAllocs);
+    double steady = (double)(endAllocs - warmAllocs) / (seconds - 1);
+    printf("%-6s cameras=%d delivered=%lu pkts  allocs total=%.0f  per stream-second: avg=%.0f steady=%.0f"
+           "  (%.3f per packet)  wall=%.2fs\n",
+           pool ? "pool" : "malloc", cameras, (unsigned long)packets, total, total / seconds, steady,
+           packets ? (endAllocs - warmAllocs) / ((double)packets * (seconds - 1) / seconds) : 0.0, wall);
+}
+
+int main(int argc, char *argv[]) {
+    int cameras = argc > 1 ? atoi(argv[1]) : 16;
+    int seconds = argc > 2 ? atoi(argv[2]) : 20;
+    if (cameras < 1) cameras = 1;
+    if (seconds < 2) seconds = 2;
+    run(false, cameras, seconds);
+    run(true, cameras, seconds);
+    PacketPool::Stats st = PacketPool::stats();
+    printf("pool slabs: blocks=%lu packets=%lu (%zu each), oversize fallbacks=%lu\n",
+           (unsigned long)st.blockSlabs, (unsigned long)st.packetSlabs, PacketPool::kPerSlab,
+           (unsigned long)st.fallbacks);
+    return 0;
+}
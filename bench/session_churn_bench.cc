@@ -0,0 +1,172 @@
+// SessionManager 并发增删测试：每个线程扮演一个子 loop，反复走一遍会话的生命周期
+// （生成ID、登记、分配端口对、按流名称登记、几次 RTCP 统计读写、按名称查找、释放端口、注销），
+// 每个线程另外常驻一批会话，让表里始终有数据。
+// 对比原来的实现（std::map + 一把锁，按名称查找要遍历，端口只增不减）和分片哈希表 + 位图端口池，
+// 并检查端口池没有把同一对端口同时分给两个会话、结束后全部归还。用法：
+//   session_churn_bench [线程数=CPU核数] [秒数=3] [每线程常驻会话=1000]
+#include "SessionManager.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <time.h>
+
+// 改造前的 SessionManager，会话计数改成原子变量以免基准本身有数据竞争
+class LegacySessionManager {
+public:
+    std::string generateSessionId() {
+        uint32_t counter = ++_sessionCounter;
+        std::ostringstream oss;
+        oss << std::hex << std::time(nullptr) << "-" << counter;
+        return oss.str();
+    }
+    void addSession(RtspSession session) {
+        std::lock_guard<std::mutex> lock(_sessionMutex);
+        _sessions[session.sessionId] = session;
+    }
+    void removeSession(const std::string &sessionId) {
+        std::lock_guard<std::mutex> lock(_sessionMutex);
+        _sessions.erase(sessionId);
+    }
+    void setStreamName(const std::string &sessionId, const std::string &name) {
+        std::lock_guard<std::mutex> lock(_sessionMutex);
+        auto it = _sessions.find(sessionId);
+        if (it != _sessions.end()) it->second.stringName = name;
+    }
+    bool findByStreamName(const std::string &name, SessionInfo &info) {
+        std::lock_guard<std::mutex> lock(_sessionMutex);
+        for (auto &kv : _sessions) {
+            if (kv.second.stringName == name) {
+                info.sessionId = kv.first;
+                info.rtcp = kv.second.rtcp;
+                return true;
+            }
+        }
+        return false;
+    }
+    void updateRtcpStats(const std::string &sessionId, const RtcpStats &stats) {
+        std::lock_guard<std::mutex> lock(_sessionMutex);
+        auto it = _sessions.find(sessionId);
+        if (it != _sessions.end()) {
+            it->second.rtcp = stats;
+            it->second.lastActive = std::chrono::steady_clock::now();
+        }
+    }
+    bool getRtcpStats(const std::string &sessionId, RtcpStats &stats) {
+        std::lock_guard<std::mutex> lock(_sessionMutex);
+        auto it = _sessions.find(sessionId);
+        if (it == _sessions.end()) return false;
+        stats = it->second.rtcp;
+        return true;
+    }
+    uint16_t allocateUdpPorts() {
+        std::lock_guard<std::mutex> lock(_portMutex);
+        return static_cast<uint16_t>(nextUdpPort.fetch_add(2));
+    }
+    void releaseUdpPorts(uint16_t) {}
+    int portsIssued() const { return nextUdpPort.load() - 10000; }
+
+private:
+    std::map<std::string, RtspSession> _sessions;
+    std::mutex _sessionMutex;
+    std::mutex _portMutex;
+    std::atomic<int> nextUdpPort{10000};
+    std::atomic<uint32_t> _sessionCounter{0};
+};
+
+static std::atomic<uint8_t> g_portOwned[65536];
+static std::atomic<uint64_t> g_doubleAllocs{0};
+static std::atomic<uint64_t> g_exhausted{0};
+
+template <typename Manager>
+static uint64_t churn(Manager &mgr, int tid, int resident, std::atomic<bool> &running, bool checkPorts) {
+    std::vector<std::string> live;
+    for (int i = 0; i < resident; ++i) {
+        RtspSession s;
+        s.sessionId = mgr.generateSessionId();
+        mgr.addSession(s);
+        mgr.setStreamName(s.sessionId, "cam" + std::to_string(tid) + "-" + std::to_string(i));
+        live.push_back(s.sessionId);
+    }
+    uint64_t cycles = 0;
+    RtcpStats stats;
+    SessionInfo info;
+    std::string name;
+    while (running.load(std::memory_order_relaxed)) {
+        RtspSession s;
+        s.sessionId = mgr.generateSessionId();
+        s.lastActive = std::chrono::steady_clock::now();
+        mgr.addSession(s);
+        uint16_t port = mgr.allocateUdpPorts();
+        if (port == 0) {
+            g_exhausted.fetch_add(1, std::memory_order_relaxed);
+        } else if (checkPorts && g_portOwned[port].exchange(1) != 0) {
+            g_doubleAllocs.fetch_add(1, std::memory_order_relaxed);
+        }
+        name = "live" + std::to_string(tid) + "-" + std::to_string(cycles % 64);
+        mgr.setStreamName(s.sessionId, name);
+        for (int r = 0; r < 3; ++r) {
+            stats.packets = cycles + r;
+            mgr.updateRtcpStats(s.sessionId, stats);
+        }
+        mgr.getRtcpStats(live[cycles % live.size()], stats);
+        mgr.findByStreamName("cam" + std::to_string(tid) + "-" + std::to_string(cycles % resident), info);
+        if (port != 0) {
+            if (checkPorts) g_portOwned[port].store(0);
+            mgr.releaseUdpPorts(port);
+        }
+        mgr.removeSession(s.sessionId);
+        ++cycles;
+    }
+    for (const std::string &id : live) {
+        mgr.removeSession(id);
+    }
+    return cycles;
+}
+
+template <typename Manager>
+static double run(Manager &mgr, int threads, int seconds, int resident, bool checkPorts) {
+    std::atomic<bool> running{true};
+    std::atomic<uint64_t> total{0};
+    g_exhausted = 0;//原来的实现端口回绕到 0 也记在这里
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            total.fetch_add(churn(mgr, t, resident, running, checkPorts));
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    running = false;
+    for (auto &w : workers) w.join();
+    return (double)total.load() / seconds;
+}
+
+int main(int argc, char *argv[]) {
+    int threads = argc > 1 ? atoi(argv[1]) : (int)std::thread::hardware_concurrency();
+    int seconds = argc > 2 ? atoi(argv[2]) : 3;
+    int resident = argc > 3 ? atoi(argv[3]) : 1000;
+    if (threads < 1) threads = 1;
+    if (resident < 1) resident = 1;
+
+    printf("%d threads, %ds, %d resident sessions per thread\n", threads, seconds, resident);
+    {
+        LegacySessionManager legacy;
+        double rate = run(legacy, threads, seconds, resident, false);
+        int issued = legacy.portsIssued() / 2;
+        printf("legacy  map+mutex:   %10.0f sessions/s, %d port pairs issued, ports past 65535 after %d sessions\n",
+               rate, issued, (65536 - 10000) / 2);
+    }
+    {
+        SessionManager mgr;
+        double rate = run(mgr, threads, seconds, resident, true);
+        printf("sharded hash+bitmap: %10.0f sessions/s, pairs in use after run=%zu, "
+               "double allocations=%lu, exhausted=%lu\n",
+               rate, mgr.udpPortsInUse(), (unsigned long)g_doubleAllocs.load(),
+               (unsigned long)g_exhausted.load());
+    }
+    return 0;
+}
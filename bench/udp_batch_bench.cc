@@ -0,0 +1,119 @@
+// UDP 批量收发测试：本机回环上对比逐包 recvfrom/sendto 与 UdpRecvBatch/UdpSendBatch
+// （recvmmsg/sendmmsg），统计每秒报文数和每秒系统调用次数。
+// 收包每轮先灌满 N 个报文再读空，只计读空的耗时。用法：
+//   udp_batch_bench [报文数=200000] [报文长度=1200] [每轮报文数=1000]
+#include "UdpBatch.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+using Clock = std::chrono::steady_clock;
+
+static int bindUdp(sockaddr_in &addr) {
+    int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+    int size = 8 * 1024 * 1024;
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    addr.sin_family = AF_INET;
+    addr.sin_port = 0;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ::bind(fd, (sockaddr *)&addr, sizeof(addr));
+    socklen_t len = sizeof(addr);
+    ::getsockname(fd, (sockaddr *)&addr, &len);
+    return fd;
+}
+
+static void report(const char *name, size_t packets, uint64_t syscalls, Clock::duration d) {
+    double sec = std::chrono::duration<double>(d).count();
+    printf("%-14s packets=%zu %.0f pkts/sec %.0f syscalls/sec %.2f pkts/syscall\n",
+           name, packets, packets / sec, syscalls / sec, (double)packets / syscalls);
+}
+
+int main(int argc, char *argv[]) {
+    size_t total = argc > 1 ? strtoul(argv[1], nullptr, 10) : 200000;
+    size_t pktLen = argc > 2 ? strtoul(argv[2], nullptr, 10) : 1200;
+    size_t perRound = argc > 3 ? strtoul(argv[3], nullptr, 10) : 1000;
+    sockaddr_in rxAddr{}, txAddr{};
+    int rx = bindUdp(rxAddr);
+    int tx = bindUdp(txAddr);
+    std::vector<char> payload(pktLen, 'k');
+    std::vector<char> buf(2048);
+
+    // 发送：逐包 sendto
+    uint64_t calls = 0;
+    Clock::duration sendOne{0};
+    for (size_t done = 0; done < total; done += perRound) {
+        auto t0 = Clock::now();
+        for (size_t i = 0; i < perRound; ++i, ++calls) {
+            ::sendto(tx, payload.data(), pktLen, 0, (sockaddr *)&rxAddr, sizeof(rxAddr));
+        }
+        sendOne += Clock::now() - t0;
+        while (::recv(rx, buf.data(), buf.size(), MSG_DONTWAIT) > 0) {}
+    }
+    report("sendto", total, calls, sendOne);
+
+    // 发送：UdpSendBatch，攒满 64 个一次 sendmmsg
+    UdpSendBatch sendBatch(tx);
+    calls = 0;
+    Clock::duration sendBatched{0};
+    for (size_t done = 0; done < total; done += perRound) {
+        auto t0 = Clock::now();
+        for (size_t i = 0; i < perRound; ++i) {
+            sendBatch.append(payload.data(), pktLen, rxAddr);
+        }
+        sendBatch.flush();
+        calls += (perRound + UdpSendBatch::kMaxMsgs - 1) / UdpSendBatch::kMaxMsgs;
+        sendBatched += Clock::now() - t0;
+        while (::recv(rx, buf.data(), buf.size(), MSG_DONTWAIT) > 0) {}
+    }
+    report("sendmmsg", total, calls, sendBatched);
+
+    // 收包：逐包 recvfrom
+    size_t received = 0;
+    calls = 0;
+    Clock::duration recvOne{0};
+    for (size_t done = 0; done < total; done += perRound) {
+        for (size_t i = 0; i < perRound; ++i) {
+            ::sendto(tx, payload.data(), pktLen, 0, (sockaddr *)&rxAddr, sizeof(rxAddr));
+        }
+        auto t0 = Clock::now();
+        while (true) {
+            sockaddr_in from;
+            socklen_t len = sizeof(from);
+            ++calls;
+            if (::recvfrom(rx, buf.data(), buf.size(), MSG_DONTWAIT, (sockaddr *)&from, &len) <= 0) break;
+            ++received;
+        }
+        recvOne += Clock::now() - t0;
+    }
+    report("recvfrom", received, calls, recvOne);
+
+    // 收包：UdpRecvBatch，一次 recvmmsg 最多 32 个
+    UdpRecvBatch recvBatch;
+    received = 0;
+    calls = 0;
+    Clock::duration recvBatched{0};
+    for (size_t done = 0; done < total; done += perRound) {
+        for (size_t i = 0; i < perRound; ++i) {
+            ::sendto(tx, payload.data(), pktLen, 0, (sockaddr *)&rxAddr, sizeof(rxAddr));
+        }
+        auto t0 = Clock::now();
+        while (true) {
+            ++calls;
+            int n = recvBatch.recv(rx);
+            received += n > 0 ? n : 0;
+            if (n < UdpRecvBatch::kMaxMsgs) break;
+        }
+        recvBatched += Clock::now() - t0;
+    }
+    report("recvmmsg", received, calls, recvBatched);
+
+    ::close(rx);
+    ::close(tx);
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include "detect.h"
+
+static uint16_t quantize(int v, int size) {
+    if (size <= 0 || v <= 0) {
+        return 0;
+    }
+    if (v >= size) {
+        return DETECT_COORD_MAX;
+    }
+    return (uint16_t)(((int64_t)v * DETECT_COORD_MAX + size / 2) / size);
+}
+
+size_t detect_pack_ext(yolo_detection_t *dets, int n, int width, int height,
+                       uint32_t timestamp, uint8_t *out) {
+    /* 先丢掉低置信度的，再按置信度选出前 DETECT_MAX_BOXES 个 */
+    int kept = 0;
+    for (int i = 0; i < n; i++) {
+        if (dets[i].confidence >= DETECT_MIN_SCORE) {
+            dets[kept++] = dets[i];
+        }
+    }
+    int count = kept < DETECT_MAX_BOXES ? kept : DETECT_MAX_BOXES;
+    for (int i = 0; i < count; i++) {
+        int best = i;
+        for (int j = i + 1; j < kept; j++) {
+            if (dets[j].confidence > dets[best].confidence) {
+                best = j;
+            }
+        }
+        yolo_detection_t tmp = dets[i];
+        dets[i] = dets[best];
+        dets[best] = tmp;
+    }
+
+    size_t len = DETECT_HEADER_SIZE + (size_t)count * DETECT_BOX_SIZE;
+    uint16_t words = (uint16_t)((len - 4) / 4);
+    out[0] = (uint8_t)(DETECT_EXT_PROFILE >> 8);
+    out[1] = (uint8_t)(DETECT_EXT_PROFILE & 0xFF);
+    out[2] = (uint8_t)(words >> 8);
+    out[3] = (uint8_t)(words & 0xFF);
+    out[4] = DETECT_VERSION;
+    out[5] = (uint8_t)count;
+    out[6] = 0;
+    out[7] = 0;
+    out[8] = (uint8_t)(timestamp >> 24);
+    out[9] = (uint8_t)(timestamp >> 16);
+    out[10] = (uint8_t)(timestamp >> 8);
+    out[11] = (uint8_t)timestamp;
+
+    uint8_t *p = out + DETECT_HEADER_SIZE;
+    for (int i = 0; i < count; i++, p += DETECT_BOX_SIZE) {
+        const yolo_detection_t *d = &dets[i];
+        float score = d->confidence < 1.0f ? d->confidence : 1.0f;
+        uint64_t v = ((uint64_t)quantize(d->xmin, width) << 36) |
+                     ((uint64_t)quantize(d->ymin, height) << 24) |
+                     ((uint64_t)quantize(d->xmax, width) << 12) |
+                     (uint64_t)quantize(d->ymax, height);
+        p[0] = (uint8_t)d->class_id;
+        p[1] = (uint8_t)(score * 255.0f + 0.5f);
+        for (int k = 7; k >= 2; k--) {
+            p[k] = (uint8_t)(v & 0xFF);
+            v >>= 8;
+        }
+    }
+    return len;
+}
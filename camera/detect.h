@@ -0,0 +1,34 @@
+#ifndef _DETECT_H_
+#define _DETECT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "yolo_trt.h"
+
+/* 检测结果元数据：推理结果不另开通道，放在该帧第一个 RTP 包的扩展头里（RFC 3550 5.3.1）随视频走，
+ * TCP/KCP/FEC 各种传输方式都一样；服务器取出后按流登记（media/DetectionIndex），
+ * 去掉扩展头再转发，观看端收到的还是普通 RTP。
+ *   扩展头 4 字节：profile 'D''T' | 长度（32 位字数，不含这 4 字节）
+ *   块头   8 字节：版本 | 框数 N | 保留 2 字节 | 推理所用帧的 RTP 时间戳
+ *   每个框 8 字节：类别 | 置信度 x255 | xmin,ymin,xmax,ymax 各 12 位（按宽高归一到 0..4095）
+ * 一帧最多 DETECT_MAX_BOXES 个框，多了按置信度取前面的；没有检测到目标也发（N=0），
+ * 服务器能区分“推理过但没有目标”和“没有推理” */
+#define DETECT_EXT_PROFILE 0x4454
+#define DETECT_VERSION 1
+#define DETECT_MAX_BOXES 32
+#define DETECT_COORD_MAX 4095
+#define DETECT_HEADER_SIZE 12       /* 扩展头 + 块头 */
+#define DETECT_BOX_SIZE 8
+#define DETECT_EXT_MAX (DETECT_HEADER_SIZE + DETECT_MAX_BOXES * DETECT_BOX_SIZE)
+#define DETECT_MIN_SCORE 0.25f      /* 低于这个置信度的框在本地丢弃 */
+/* 最高置信度达到这个值时另外用 SET_PARAMETER 上报检测事件，服务器保存事件前后的视频片段；
+ * 目标停在画面里会每次推理都命中，两次上报至少间隔 DETECT_EVENT_INTERVAL_MS */
+#define DETECT_EVENT_SCORE 0.6f
+#define DETECT_EVENT_INTERVAL_MS 10000
+
+/* 把检测结果打包成扩展头写到 out（至少 DETECT_EXT_MAX 字节），返回字节数；
+ * dets 会按置信度重排 */
+size_t detect_pack_ext(yolo_detection_t *dets, int n, int width, int height,
+                       uint32_t timestamp, uint8_t *out);
+
+#endif
@@ -0,0 +1,137 @@
+#include "fec.h"
+#include "rtcp.h"
+#include <string.h>
+#include <pthread.h>
+
+/* GF(2^8)，本原多项式0x11D */
+static uint8_t gf_exp[512];
+static uint8_t gf_log[256];
+static uint8_t fec_coef[FEC_MAX_PARITY][FEC_MAX_DATA];
+static pthread_once_t gf_once = PTHREAD_ONCE_INIT;
+
+static uint8_t gf_mul(uint8_t a, uint8_t b) {
+    return (a == 0 || b == 0) ? 0 : gf_exp[gf_log[a] + gf_log[b]];
+}
+
+static void gf_init(void) {
+    int x = 1;
+    for (int i = 0; i < 255; ++i) {
+        gf_exp[i] = (uint8_t)x;
+        gf_log[x] = (uint8_t)i;
+        x <<= 1;
+        if (x & 0x100) x ^= 0x11D;
+    }
+    for (int i = 255; i < 512; ++i) gf_exp[i] = gf_exp[i - 255];
+    /* Cauchy矩阵 1/(x_r + y_c)，每列除以第0行使第0行全为1 */
+    for (int r = 0; r < FEC_MAX_PARITY; ++r) {
+        for (int c = 0; c < FEC_MAX_DATA; ++c) {
+            uint8_t x0 = (uint8_t)(FEC_MAX_DATA ^ c);
+            uint8_t xr = (uint8_t)((FEC_MAX_DATA + r) ^ c);
+            fec_coef[r][c] = gf_mul(x0, gf_exp[255 - gf_log[xr]]);
+        }
+    }
+}
+
+/* dst ^= c * src */
+static void gf_mul_add(uint8_t *dst, const uint8_t *src, uint8_t c, int n) {
+    if (c == 1) {
+        for (int i = 0; i < n; ++i) dst[i] ^= src[i];
+        return;
+    }
+    unsigned lc = gf_log[c];
+    for (int i = 0; i < n; ++i) {
+        if (src[i]) dst[i] ^= gf_exp[gf_log[src[i]] + lc];
+    }
+}
+
+static void put16(uint8_t *p, uint16_t v) { p[0] = v >> 8; p[1] = v & 0xFF; }
+
+void fec_encoder_init(fec_encoder_t *enc, udp_socket_t *udp) {
+    pthread_once(&gf_once, gf_init);
+    memset(enc, 0, sizeof(*enc));
+    enc->udp = udp;
+    enc->k = 16;
+    enc->m = 1;
+    atomic_store(&enc->next_k, 16);
+    atomic_store(&enc->next_m, 1);
+}
+
+void fec_encoder_add(fec_encoder_t *enc, const uint8_t *rtp, int len) {
+    if (len < 12 || len + 2 > FEC_MAX_BLOCK) {
+        return;
+    }
+    uint16_t seq = (uint16_t)((rtp[2] << 8) | rtp[3]);
+    if (enc->count > 0 && seq != (uint16_t)(enc->base_seq + enc->count)) {
+        fec_encoder_flush(enc); /* 序号不连续，前一组到此为止 */
+    }
+    if (enc->count == 0) {
+        enc->k = atomic_load(&enc->next_k);
+        enc->m = atomic_load(&enc->next_m);
+        enc->base_seq = seq;
+        enc->block_len = 0;
+        enc->first_ms = rtcp_now_ms();
+    }
+    uint8_t len_bytes[2];
+    put16(len_bytes, (uint16_t)len);
+    for (int r = 0; r < enc->m; ++r) {
+        uint8_t c = fec_coef[r][enc->count];
+        gf_mul_add(enc->parity[r], len_bytes, c, 2);
+        gf_mul_add(enc->parity[r] + 2, rtp, c, len);
+    }
+    if (len + 2 > enc->block_len) enc->block_len = len + 2;
+    enc->timestamp = ((uint32_t)rtp[4] << 24) | ((uint32_t)rtp[5] << 16) | ((uint32_t)rtp[6] << 8) | rtp[7];
+    enc->ssrc = ((uint32_t)rtp[8] << 24) | ((uint32_t)rtp[9] << 16) | ((uint32_t)rtp[10] << 8) | rtp[11];
+    if (++enc->count == enc->k) {
+        fec_encoder_flush(enc);
+    }
+}
+
+void fec_encoder_flush(fec_encoder_t *enc) {
+    if (enc->count == 0) {
+        return;
+    }
+    uint8_t packet[12 + 8 + FEC_MAX_BLOCK];
+    for (int r = 0; r < enc->m; ++r) {
+        packet[0] = 0x80;
+        packet[1] = FEC_PAYLOAD_TYPE;
+        put16(packet + 2, enc->fec_seq++);
+        put16(packet + 4, (uint16_t)(enc->timestamp >> 16));
+        put16(packet + 6, (uint16_t)enc->timestamp);
+        put16(packet + 8, (uint16_t)(enc->ssrc >> 16));
+        put16(packet + 10, (uint16_t)enc->ssrc);
+        put16(packet + 12, enc->base_seq);
+        packet[14] = (uint8_t)enc->count;
+        packet[15] = (uint8_t)enc->m;
+        packet[16] = (uint8_t)r;
+        packet[17] = 0;
+        put16(packet + 18, (uint16_t)enc->block_len);
+        memcpy(packet + 20, enc->parity[r], enc->block_len);
+        udp_send(enc->udp, packet, 20 + enc->block_len);
+        memset(enc->parity[r], 0, enc->block_len);
+    }
+    enc->count = 0;
+}
+
+void fec_encoder_tick(fec_encoder_t *enc, uint64_t now_ms) {
+    if (enc->count > 0 && now_ms - enc->first_ms >= FEC_MAX_DELAY_MS) {
+        fec_encoder_flush(enc);
+    }
+}
+
+void fec_encoder_adapt(fec_encoder_t *enc, uint8_t fraction_lost) {
+    /* 与服务器 Fec::paramsForLoss 相同：丢包越多组越小、校验越多 */
+    int k, m;
+    if (fraction_lost < 2) {
+        k = 16; m = 1;
+    } else if (fraction_lost < 8) {
+        k = 10; m = 1;
+    } else if (fraction_lost < 20) {
+        k = 10; m = 2;
+    } else if (fraction_lost < 40) {
+        k = 8; m = 3;
+    } else {
+        k = 6; m = 4;
+    }
+    atomic_store(&enc->next_k, k);
+    atomic_store(&enc->next_m, m);
+}
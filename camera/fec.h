@@ -0,0 +1,44 @@
+#ifndef _FEC_H_
+#define _FEC_H_
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "udp.h"
+
+/* 前向纠错传输（-t fec）：RTP包原样经UDP发出，每k个包附m个校验包，代替KCP重传。
+ * 系数与包格式和服务器的 media/Fec.h 一致：
+ *   校验包 = RTP头(PT=100) | 组首序号(2) | k(1) | m(1) | 行号(1) | 保留(1) | 块长度(2) | 校验数据
+ *   m=1 时是逐字节XOR，m>1 是 Cauchy 矩阵的 Reed-Solomon
+ * k、m 由主线程按服务器RR里的丢包比例调整，下一组起生效 */
+#define FEC_PAYLOAD_TYPE 100
+#define FEC_MAX_DATA 32
+#define FEC_MAX_PARITY 4
+#define FEC_MAX_BLOCK 1502      /* 2字节长度 + RTP包 */
+#define FEC_MAX_DELAY_MS 40     /* 组首包最多等这么久就发校验，限制恢复延迟 */
+
+typedef struct fec_encoder {
+    udp_socket_t *udp;
+    atomic_int next_k;
+    atomic_int next_m;
+    /* 以下只在视频线程访问 */
+    int k, m;
+    int count;
+    uint16_t base_seq;
+    uint16_t fec_seq;
+    uint32_t ssrc;
+    uint32_t timestamp;
+    int block_len;
+    uint64_t first_ms;
+    uint8_t parity[FEC_MAX_PARITY][FEC_MAX_BLOCK];
+} fec_encoder_t;
+
+void fec_encoder_init(fec_encoder_t *enc, udp_socket_t *udp);
+/* 数据包已经发出，这里计入校验，凑满k个时发出校验包 */
+void fec_encoder_add(fec_encoder_t *enc, const uint8_t *rtp, int len);
+void fec_encoder_flush(fec_encoder_t *enc);
+/* 每帧发完后调用，组首包等太久时不等凑满 */
+void fec_encoder_tick(fec_encoder_t *enc, uint64_t now_ms);
+/* 主线程：按RR的 fraction lost（x256）选组大小和校验个数 */
+void fec_encoder_adapt(fec_encoder_t *enc, uint8_t fraction_lost);
+
+#endif
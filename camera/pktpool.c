@@ -0,0 +1,83 @@
+#include "pktpool.h"
+#include "ikcp.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#define PKTPOOL_HEADER 16           /* 块前面记录来源，释放时据此区分 */
+#define PKTPOOL_FROM_SLAB 0x51ab51abu
+#define PKTPOOL_FROM_HEAP 0x4ea94ea9u
+
+typedef struct pktpool_node {
+    struct pktpool_node *next;      /* 空闲时借用块头的位置 */
+} pktpool_node_t;
+
+static pthread_mutex_t pool_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pktpool_node_t *free_list = NULL;
+static pktpool_stats_t pool_stats;
+
+static int pktpool_grow(void) {
+    size_t stride = PKTPOOL_BLOCK_SIZE + PKTPOOL_HEADER;
+    char *slab = (char *)malloc(stride * PKTPOOL_PER_SLAB);
+    if (!slab) {
+        return -1;
+    }
+    for (int i = PKTPOOL_PER_SLAB - 1; i >= 0; i--) {
+        pktpool_node_t *node = (pktpool_node_t *)(slab + i * stride);
+        node->next = free_list;
+        free_list = node;
+    }
+    pool_stats.slabs++;
+    return 0;
+}
+
+void *pktpool_alloc(size_t size) {
+    char *p;
+    if (size > PKTPOOL_BLOCK_SIZE) {
+        p = (char *)malloc(size + PKTPOOL_HEADER);
+        if (!p) {
+            return NULL;
+        }
+        *(uint32_t *)p = PKTPOOL_FROM_HEAP;
+        pthread_mutex_lock(&pool_mtx);
+        pool_stats.fallbacks++;
+        pthread_mutex_unlock(&pool_mtx);
+        return p + PKTPOOL_HEADER;
+    }
+    pthread_mutex_lock(&pool_mtx);
+    if (!free_list && pktpool_grow() < 0) {
+        pthread_mutex_unlock(&pool_mtx);
+        return NULL;
+    }
+    p = (char *)free_list;
+    free_list = free_list->next;
+    pthread_mutex_unlock(&pool_mtx);
+    *(uint32_t *)p = PKTPOOL_FROM_SLAB;
+    return p + PKTPOOL_HEADER;
+}
+
+void pktpool_free(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    char *p = (char *)ptr - PKTPOOL_HEADER;
+    if (*(uint32_t *)p == PKTPOOL_FROM_HEAP) {
+        free(p);
+        return;
+    }
+    pktpool_node_t *node = (pktpool_node_t *)p;
+    pthread_mutex_lock(&pool_mtx);
+    node->next = free_list;
+    free_list = node;
+    pthread_mutex_unlock(&pool_mtx);
+}
+
+void pktpool_install_kcp(void) {
+    ikcp_allocator(pktpool_alloc, pktpool_free);
+}
+
+void pktpool_get_stats(pktpool_stats_t *st) {
+    pthread_mutex_lock(&pool_mtx);
+    *st = pool_stats;
+    pthread_mutex_unlock(&pool_mtx);
+}
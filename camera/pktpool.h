@@ -0,0 +1,25 @@
+#ifndef _PKTPOOL_H_
+#define _PKTPOOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* MTU 大小报文缓冲的 slab 池：固定 PKTPOOL_BLOCK_SIZE 的块一次申请一片（PKTPOOL_PER_SLAB 块），
+ * 释放后挂回空闲链表重用，不还给系统。和 malloc/free 同语义，装给 ikcp_allocator 后
+ * KCP 分片从这里分，TCP interleaved 发送的拼包缓冲也从这里取；超过块大小的交给 malloc。
+ * 摄像头上只有视频线程和主线程两个使用者，一把锁就够 */
+#define PKTPOOL_BLOCK_SIZE 2048
+#define PKTPOOL_PER_SLAB 64
+
+typedef struct pktpool_stats {
+    uint64_t slabs;         /* 向系统申请过的片数 */
+    uint64_t fallbacks;     /* 超过块大小转给 malloc 的次数 */
+} pktpool_stats_t;
+
+void *pktpool_alloc(size_t size);
+void pktpool_free(void *p);
+/* 把 ikcp 的内存分配换成本池，必须在 ikcp_create 之前调用 */
+void pktpool_install_kcp(void);
+void pktpool_get_stats(pktpool_stats_t *st);
+
+#endif
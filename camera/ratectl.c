@@ -0,0 +1,45 @@
+#include "ratectl.h"
+
+void ratectl_init(ratectl_t *rc, int init_kbps, int min_kbps) {
+    rc->min_kbps = min_kbps;
+    rc->max_kbps = init_kbps;
+    rc->target_kbps = init_kbps;
+    rc->min_rtt_ms = -1;
+    rc->last_decrease_ms = 0;
+}
+
+int ratectl_update(ratectl_t *rc, const ratectl_feedback_t *fb, int queue_bytes, uint64_t now_ms) {
+    int target = rc->target_kbps;
+    /* 字节 * 8 / kbps = 毫秒 */
+    int queue_ms = (int)((int64_t)queue_bytes * 8 / target);
+    int rtt_rise = 0;
+    if (fb->rtt_ms >= 0) {
+        if (rc->min_rtt_ms < 0 || fb->rtt_ms < rc->min_rtt_ms) {
+            rc->min_rtt_ms = fb->rtt_ms;
+        }
+        rtt_rise = fb->rtt_ms - rc->min_rtt_ms;
+    }
+
+    if (queue_ms > RATECTL_QUEUE_HIGH_MS || fb->loss > RATECTL_LOSS_HIGH || rtt_rise > RATECTL_RTT_RISE_MS) {
+        /* 降到 85%，服务器实收更少时按实收的 90%，链路实际只送到这么多 */
+        target = target * 85 / 100;
+        if (fb->ingest_kbps > 0 && fb->ingest_kbps * 9 / 10 < target) {
+            target = fb->ingest_kbps * 9 / 10;
+        }
+        rc->last_decrease_ms = now_ms;
+    } else if (queue_ms < RATECTL_QUEUE_LOW_MS && fb->loss <= RATECTL_LOSS_LOW &&
+               now_ms - rc->last_decrease_ms >= RATECTL_HOLD_MS &&
+               (fb->ingest_kbps < 0 || fb->ingest_kbps * 10 >= target * 7)) {
+        /* 编码器没用满当前码率（画面静止）时上调没有意义，也试探不出链路容量 */
+        int step = target / 20;
+        target += step > 50 ? step : 50;
+    }
+
+    if (target < rc->min_kbps) target = rc->min_kbps;
+    if (target > rc->max_kbps) target = rc->max_kbps;
+    if (target == rc->target_kbps) {
+        return 0;
+    }
+    rc->target_kbps = target;
+    return target;
+}
@@ -0,0 +1,40 @@
+#ifndef _RATECTL_H_
+#define _RATECTL_H_
+
+#include <stdint.h>
+
+/* 编码码率闭环：服务器每秒经RTSP连接发一次反馈（SET_PARAMETER），主线程据此和本端发送队列
+ * 算出新的目标码率，视频线程在下一帧前用 x264_encoder_reconfig 生效。
+ * 拥塞（发送队列积压、丢包高、RTT明显高于最小值）时乘性下降，且不超过服务器实收码率；
+ * 链路空闲且下降后稳定一段时间再小步上调，不超过初始码率 */
+#define RATECTL_MIN_KBPS 300
+#define RATECTL_QUEUE_HIGH_MS 300   /* 发送队列按当前码率折算超过这个时长算拥塞 */
+#define RATECTL_QUEUE_LOW_MS 50
+#define RATECTL_LOSS_HIGH 26        /* x256，约10% */
+#define RATECTL_LOSS_LOW 5          /* 约2% */
+#define RATECTL_RTT_RISE_MS 200     /* 比最小RTT高出这么多认为上行在排队 */
+#define RATECTL_HOLD_MS 5000        /* 下降后这么久内不上调 */
+
+/* 服务器的反馈，没有的项为 -1 */
+typedef struct ratectl_feedback {
+    int ingest_kbps;    /* 服务器上个间隔收到的负载码率 */
+    int loss;           /* 上个间隔丢包比例 x256，KCP 传输时是重传之后的 */
+    int rtt_ms;         /* RTSP 连接的 RTT */
+    int jitter_ms;
+} ratectl_feedback_t;
+
+typedef struct ratectl {
+    int min_kbps;
+    int max_kbps;
+    int target_kbps;
+    int min_rtt_ms;     /* -1 表示还没有 */
+    uint64_t last_decrease_ms;
+} ratectl_t;
+
+void ratectl_init(ratectl_t *rc, int init_kbps, int min_kbps);
+
+/* 每收到一次反馈调用；queue_bytes 是本端积压未确认的字节（KCP的waitsnd、TCP发送队列），
+ * 返回新的目标码率，不变时返回0 */
+int ratectl_update(ratectl_t *rc, const ratectl_feedback_t *fb, int queue_bytes, uint64_t now_ms);
+
+#endif
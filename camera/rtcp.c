@@ -0,0 +1,129 @@
+#include "rtcp.h"
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+
+#define NTP_UNIX_OFFSET 2208988800ULL   /* 1900 到 1970 的秒数 */
+#define RTCP_SR 200
+#define RTCP_RR 201
+#define RTCP_SDES 202
+
+static void put16(uint8_t *p, uint16_t v) { p[0] = v >> 8; p[1] = v & 0xFF; }
+static void put32(uint8_t *p, uint32_t v) { put16(p, v >> 16); put16(p + 2, v & 0xFFFF); }
+static uint16_t get16(const uint8_t *p) { return (uint16_t)((p[0] << 8) | p[1]); }
+static uint32_t get32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/* 当前墙上时间的NTP 64位表示 */
+static uint64_t ntp_now(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    uint64_t sec = (uint64_t)tv.tv_sec + NTP_UNIX_OFFSET;
+    uint64_t frac = ((uint64_t)tv.tv_usec << 32) / 1000000;
+    return (sec << 32) | frac;
+}
+
+uint64_t rtcp_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void rtcp_stats_init(rtcp_stats_t *st) {
+    atomic_store(&st->packets, 0);
+    atomic_store(&st->octets, 0);
+    atomic_store(&st->mapping, 0);
+    st->next_report_ms = rtcp_now_ms() + RTCP_INTERVAL_MS;
+    st->fraction_lost = 0;
+    st->cumulative_lost = 0;
+    st->jitter = 0;
+    st->rtt_ms = -1;
+    st->reports_sent = 0;
+    st->reports_received = 0;
+}
+
+void rtcp_on_rtp_sent(rtcp_stats_t *st, uint32_t timestamp, size_t payload_len) {
+    atomic_fetch_add(&st->octets, payload_len);
+    atomic_store(&st->mapping, ((uint64_t)timestamp << 32) | (uint32_t)rtcp_now_ms());
+    atomic_fetch_add(&st->packets, 1);
+}
+
+int rtcp_build_sr(rtcp_stats_t *st, uint32_t ssrc, const char *cname, uint8_t *buf, int len) {
+    uint32_t packets = (uint32_t)atomic_load(&st->packets);
+    size_t name_len = strlen(cname);
+    if (name_len > 255) name_len = 255;
+    /* SDES 块：SSRC + CNAME项 + 结束项，补零到4字节对齐 */
+    int chunk = (int)((4 + 2 + name_len + 1 + 3) & ~(size_t)3);
+    int total = 28 + 4 + chunk;
+    if (packets == 0 || total > len) {
+        return 0;
+    }
+    /* 最近发出的包的RTP时间戳按90kHz外推到现在，和NTP时间成对 */
+    uint64_t mapping = atomic_load(&st->mapping);
+    uint32_t elapsed = (uint32_t)rtcp_now_ms() - (uint32_t)mapping;
+    uint32_t rtp_ts = (uint32_t)(mapping >> 32) + elapsed * 90;
+    uint64_t ntp = ntp_now();
+
+    uint8_t *p = buf;
+    p[0] = 0x80;                    /* V=2, RC=0 */
+    p[1] = RTCP_SR;
+    put16(p + 2, 28 / 4 - 1);
+    put32(p + 4, ssrc);
+    put32(p + 8, (uint32_t)(ntp >> 32));
+    put32(p + 12, (uint32_t)ntp);
+    put32(p + 16, rtp_ts);
+    put32(p + 20, packets);
+    put32(p + 24, (uint32_t)atomic_load(&st->octets));
+    p += 28;
+
+    memset(p, 0, 4 + chunk);
+    p[0] = 0x81;                    /* V=2, SC=1 */
+    p[1] = RTCP_SDES;
+    put16(p + 2, (uint16_t)((4 + chunk) / 4 - 1));
+    put32(p + 4, ssrc);
+    p[8] = 1;                       /* CNAME */
+    p[9] = (uint8_t)name_len;
+    memcpy(p + 10, cname, name_len);
+    st->reports_sent++;
+    return total;
+}
+
+int rtcp_parse_rr(rtcp_stats_t *st, uint32_t ssrc, const uint8_t *data, int len) {
+    int found = -1;
+    while (len >= 4) {
+        if ((data[0] & 0xC0) != 0x80) return -1;
+        int count = data[0] & 0x1F;
+        int type = data[1];
+        int bytes = (get16(data + 2) + 1) * 4;
+        if (bytes > len) return -1;
+        const uint8_t *blocks = NULL;
+        if (type == RTCP_RR && bytes >= 8 + 24 * count) {
+            blocks = data + 8;
+        } else if (type == RTCP_SR && bytes >= 28 + 24 * count) {
+            blocks = data + 28;
+        }
+        for (int i = 0; blocks && i < count; ++i, blocks += 24) {
+            if (get32(blocks) != ssrc) continue;
+            uint32_t lost = ((uint32_t)blocks[5] << 16) | get16(blocks + 6);
+            if (lost & 0x800000) lost |= 0xFF000000;    /* 24位有符号扩展 */
+            st->fraction_lost = blocks[4];
+            st->cumulative_lost = (int32_t)lost;
+            st->jitter = get32(blocks + 12);
+            uint32_t lsr = get32(blocks + 16);
+            uint32_t dlsr = get32(blocks + 20);
+            if (lsr != 0) {
+                /* RTT = 收到RR的时间 - LSR - DLSR，单位 1/65536 秒 */
+                uint32_t rtt = (uint32_t)(ntp_now() >> 16) - lsr - dlsr;
+                if ((int32_t)rtt >= 0) {
+                    st->rtt_ms = (int32_t)(((uint64_t)rtt * 1000) >> 16);
+                }
+            }
+            st->reports_received++;
+            found = 0;
+        }
+        data += bytes;
+        len -= bytes;
+    }
+    return found;
+}
@@ -0,0 +1,42 @@
+#ifndef _RTCP_H_
+#define _RTCP_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#define RTCP_INTERVAL_MS 5000   /* SR 发送间隔 */
+#define RTCP_BUFFER_SIZE 256
+
+/* 推流端的RTCP统计：
+ * - 视频线程每发一个RTP包累加计数、记下时间戳（原子变量），主线程按间隔生成SR
+ * - 服务器回的RR里带着丢包、抖动和LSR/DLSR，主线程解析后算出RTT */
+typedef struct rtcp_stats {
+    atomic_uint_fast32_t packets;
+    atomic_uint_fast32_t octets;        /* 只算负载 */
+    atomic_uint_fast64_t mapping;       /* 最近一个包的RTP时间戳 << 32 | 发送时的毫秒时钟 */
+    /* 以下只在主线程访问 */
+    uint64_t next_report_ms;
+    uint8_t fraction_lost;              /* 服务器上个报告间隔的丢包比例 x256 */
+    int32_t cumulative_lost;
+    uint32_t jitter;                    /* 90kHz */
+    int32_t rtt_ms;                     /* -1 表示还没有 */
+    uint32_t reports_sent;
+    uint32_t reports_received;
+} rtcp_stats_t;
+
+/* 单调毫秒时钟 */
+uint64_t rtcp_now_ms(void);
+
+void rtcp_stats_init(rtcp_stats_t *st);
+
+/* 视频线程：发出一个RTP包后调用 */
+void rtcp_on_rtp_sent(rtcp_stats_t *st, uint32_t timestamp, size_t payload_len);
+
+/* 生成 SR + SDES(CNAME) 复合包，返回长度；还没发过RTP时返回0 */
+int rtcp_build_sr(rtcp_stats_t *st, uint32_t ssrc, const char *cname, uint8_t *buf, int len);
+
+/* 解析服务器发来的复合包，找到报告本端 ssrc 的报告块时更新统计并返回0，否则返回-1 */
+int rtcp_parse_rr(rtcp_stats_t *st, uint32_t ssrc, const uint8_t *data, int len);
+
+#endif
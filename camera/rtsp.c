@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include "log.h"
+#include "pktpool.h"
 
 /* 初始化RTSP会话 */
 int rtsp_session_init(rtsp_session_t *session) {
@@ -16,6 +17,7 @@ int rtsp_session_init(rtsp_session_t *session) {
     session->rtp_timestamp = 0;
     session->client.fd = -1;
     session->rtp_socket.fd = -1;
+    session->rtcp_socket.fd = -1;
     return 0;
 }
 
@@ -69,7 +71,7 @@ int send_rtp_over_tcp(rtsp_session_t *sess, const uint8_t *rtp_data, size_t rtp_
 
     int ret = 0;
     size_t total_len = 4 + rtp_len;  // header 长度为 4 字节
-    char *buffer = (char *)malloc(total_len);
+    char *buffer = (char *)pktpool_alloc(total_len);//每个RTP包一次，从报文池里取
     if (buffer == NULL) {
         // 处理内存分配失败
         return -1;
@@ -78,15 +80,28 @@ int send_rtp_over_tcp(rtsp_session_t *sess, const uint8_t *rtp_data, size_t rtp_
     memcpy(buffer, header, 4);           // 将 header 复制到 buffer 开头
     memcpy(buffer + 4, rtp_data, rtp_len);  // 将 rtp_data 复制到 buffer 中 header 后面的位置
     // 一次性发送合并后的数据
-    // pthread_mutex_lock(&sess->rtp_send_mtx);
+    pthread_mutex_lock(&sess->rtp_send_mtx);
     ret = tcp_write(&sess->client, buffer, total_len);
     // LOG_DEBUG("send %d seq, %d data",(buffer[6]<<8|buffer[7]),ret);
-    // pthread_mutex_unlock(&sess->rtp_send_mtx);
-    // 发送完成后释放内存
-    free(buffer);
+    pthread_mutex_unlock(&sess->rtp_send_mtx);
+    // 发送完成后还回报文池
+    pktpool_free(buffer);
     return ret;
 }
 
+/* 本帧还有没发出的检测结果时接在 RTP 头后面，置扩展位，返回扩展头长度 */
+static size_t attach_detections(rtsp_session_t *session, uint8_t *packet)
+{
+    size_t len = session->det_ext_len;
+    if (len == 0) {
+        return 0;
+    }
+    packet[0] |= 0x10;
+    memcpy(packet + RTP_HEADER_SIZE, session->det_ext, len);
+    session->det_ext_len = 0;
+    return len;
+}
+
 void rtp_send_h264(rtsp_session_t *session, uint32_t *timestamp,
     const uint8_t *nalu, size_t nalu_size)
 {
@@ -94,7 +109,7 @@ void rtp_send_h264(rtsp_session_t *session, uint32_t *timestamp,
         return;
     }
     uint8_t rtp_header[RTP_HEADER_SIZE];
-    if(4 + nalu_size + RTP_HEADER_SIZE <= MTU){
+    if(4 + nalu_size + RTP_HEADER_SIZE + session->det_ext_len <= MTU){
         uint8_t packet[MTU-4];//rtsp区分留四个字节空位
         uint8_t nal_type = nalu[0] & 0x1F;
         bool marker = true;
@@ -108,17 +123,22 @@ void rtp_send_h264(rtsp_session_t *session, uint32_t *timestamp,
         uint16_t seq = next_seq(session);
         build_rtp_header(rtp_header, seq, *timestamp, session->rtp_ssrc, 96, marker);
         memcpy(packet, rtp_header, RTP_HEADER_SIZE);
-        memcpy(packet + RTP_HEADER_SIZE, nalu, nalu_size);
-        size_t pkt_len = RTP_HEADER_SIZE + nalu_size;
+        size_t ext_len = attach_detections(session, packet);
+        memcpy(packet + RTP_HEADER_SIZE + ext_len, nalu, nalu_size);
+        size_t pkt_len = RTP_HEADER_SIZE + ext_len + nalu_size;
 
         if (strcmp(session->transType, "tcp") == 0)
             send_rtp_over_tcp(session, packet, pkt_len, session->rtpChannel);
-        else{
+        else if (session->fec) {
+            udp_send(&session->rtp_socket, packet, pkt_len);
+            fec_encoder_add(session->fec, packet, pkt_len);
+        } else{
             pthread_mutex_lock(&session->mutex);
             send_rtp_over_kcp(packet,pkt_len,session->kcp);
             ikcp_flush(session->kcp);
             pthread_mutex_unlock(&session->mutex);
         }
+        rtcp_on_rtp_sent(&session->rtcp, *timestamp, nalu_size);
 
     }else{
         // FU-A 分片发送
@@ -131,9 +151,10 @@ void rtp_send_h264(rtsp_session_t *session, uint32_t *timestamp,
         bool isStart = true;
 
         while (pos < payload_size) {
-            //18 = 12(RTP头部) + 4(用于RTSP区分) +2(分片额外负载)
-            size_t len = (payload_size - pos > (MTU - 18))
-                        ? (MTU - 18)
+            //18 = 12(RTP头部) + 4(用于RTSP区分) +2(分片额外负载)，带检测结果的包再让出扩展头的长度
+            size_t room = MTU - 18 - session->det_ext_len;
+            size_t len = (payload_size - pos > room)
+                        ? room
                         : (payload_size - pos);
 
             bool isLast = (pos + len >= payload_size);
@@ -156,7 +177,8 @@ void rtp_send_h264(rtsp_session_t *session, uint32_t *timestamp,
             uint16_t seq = next_seq(session);
             build_rtp_header(rtp_header, seq, *timestamp, session->rtp_ssrc, 96, isLast);
             memcpy(packet + offset, rtp_header, RTP_HEADER_SIZE);
-            offset += RTP_HEADER_SIZE;
+            size_t ext_len = attach_detections(session, packet);
+            offset += RTP_HEADER_SIZE + ext_len;
             packet[offset++] = fu_ind;
             packet[offset++] = fu_hdr;
 
@@ -166,18 +188,41 @@ void rtp_send_h264(rtsp_session_t *session, uint32_t *timestamp,
             // send rtp...
             if (strcmp(session->transType, "tcp") == 0)
                 send_rtp_over_tcp(session, packet, offset, session->rtpChannel);
-            else{
+            else if (session->fec) {
+                udp_send(&session->rtp_socket, packet, offset);
+                fec_encoder_add(session->fec, packet, offset);
+            } else{
                 pthread_mutex_lock(&session->mutex);
                 send_rtp_over_kcp(packet,offset,session->kcp);
                 ikcp_flush(session->kcp);
                 pthread_mutex_unlock(&session->mutex);
             }
+            rtcp_on_rtp_sent(&session->rtcp, *timestamp, offset - RTP_HEADER_SIZE - ext_len);
             pos += len;
             isStart = false;
         }
     }
 }
 
+int rtsp_send_rtcp_sr(rtsp_session_t *session) {
+    if (rtcp_now_ms() < session->rtcp.next_report_ms) {
+        return 0;
+    }
+    session->rtcp.next_report_ms += RTCP_INTERVAL_MS;
+    uint8_t buf[RTCP_BUFFER_SIZE];
+    char cname[64];
+    snprintf(cname, sizeof(cname), "camera-%08x", session->rtp_ssrc);
+    int len = rtcp_build_sr(&session->rtcp, session->rtp_ssrc, cname, buf, sizeof(buf));
+    if (len <= 0) {
+        return 0;
+    }
+    if (strcmp(session->transType, "tcp") == 0)
+        return send_rtp_over_tcp(session, buf, len, session->rtcpChannel);
+    if (session->rtcp_socket.fd >= 0)
+        return udp_send(&session->rtcp_socket, buf, len);
+    return 0;
+}
+
 /* 清理RTSP会话 */
 void rtsp_session_cleanup(rtsp_session_t *session) {
     if (!session) {
@@ -185,6 +230,7 @@ void rtsp_session_cleanup(rtsp_session_t *session) {
     }
     
     udp_close(&session->rtp_socket);
+    udp_close(&session->rtcp_socket);
     tcp_close_client(&session->client);
     session->state = RTSP_STATE_INIT;
 }
@@ -282,18 +328,149 @@ int rtsp_client_announce(rtsp_session_t *session, const char *url, const char *s
 int rtsp_client_record(rtsp_session_t *session, const char *url) {
     char request[512];
     session->cseq++;
+    if (session->fec) {
+        /* FEC传输不用KCP，服务器按Fec头接收校验包 */
+        int len = snprintf(request, sizeof(request),
+            "RECORD %s RTSP/1.0\r\n"
+            "CSeq: %d\r\n"
+            "Session: %s\r\n"
+            "User-Agent: RTSP Client\r\n"
+            "Fec: 1\r\n"
+            "Rate-Feedback: 1\r\n"
+            "\r\n",
+            url, session->cseq, session->session_id);
+        printf("发送RECORD请求:\n%s\n", request);
+        return tcp_write(&session->client, request, len);
+    }
     int len = snprintf(request, sizeof(request),
         "RECORD %s RTSP/1.0\r\n"
         "CSeq: %d\r\n"
         "Session: %s\r\n"
         "User-Agent: RTSP Client\r\n"
         "KcpId: %d\r\n"
+        "Rate-Feedback: 1\r\n"
         "\r\n",
         url, session->cseq, session->session_id,session->kcp->conv);
     printf("发送RECORD请求:\n%s\n", request);
     return tcp_write(&session->client, request, len);
 }
 
+/* 推流中上报检测事件，服务器据此保存事件前后的视频片段 */
+int rtsp_client_event(rtsp_session_t *session, const char *url, const char *event) {
+    char request[512];
+    char body[128];
+    int body_len = snprintf(body, sizeof(body), "event: %s\r\n", event);
+    pthread_mutex_lock(&session->rtp_send_mtx);
+    session->cseq++;
+    int len = snprintf(request, sizeof(request),
+        "SET_PARAMETER %s RTSP/1.0\r\n"
+        "CSeq: %d\r\n"
+        "Session: %s\r\n"
+        "User-Agent: RTSP Client\r\n"
+        "Content-Type: text/parameters\r\n"
+        "Content-Length: %d\r\n"
+        "\r\n"
+        "%s",
+        url, session->cseq, session->session_id, body_len, body);
+    /* 从视频线程调用，tcp 传输时和 interleaved RTP 共用这条连接 */
+    int ret = tcp_write(&session->client, request, len);
+    pthread_mutex_unlock(&session->rtp_send_mtx);
+    return ret;
+}
+
+/* 在 [p, end) 里按行找 "name:"，返回值的起始位置（跳过空格），没有返回NULL */
+static const char *find_field(const char *p, const char *end, const char *name) {
+    size_t name_len = strlen(name);
+    while (p < end) {
+        const char *eol = memchr(p, '\n', end - p);
+        if (!eol) eol = end;
+        if ((size_t)(eol - p) > name_len && strncasecmp(p, name, name_len) == 0 && p[name_len] == ':') {
+            p += name_len + 1;
+            while (p < eol && *p == ' ') p++;
+            return p;
+        }
+        p = eol + 1;
+    }
+    return NULL;
+}
+
+static int field_int(const char *p, const char *end, const char *name, int def) {
+    const char *v = find_field(p, end, name);
+    return v ? (int)strtol(v, NULL, 10) : def;
+}
+
+/* 服务器每秒发一次：
+ *   SET_PARAMETER * RTSP/1.0 ... Content-Type: text/parameters
+ *   ingest_kbps: 1850 / loss: 3 / rtt_ms: 42 / jitter_ms: 2 */
+int rtsp_handle_feedback(rtsp_session_t *session, const char *buf, int len, ratectl_feedback_t *fb) {
+    if (len < 14 || strncmp(buf, "SET_PARAMETER ", 14) != 0) {
+        return 0;
+    }
+    const char *head_end = memmem(buf, len, "\r\n\r\n", 4);
+    if (!head_end) {
+        return 0;
+    }
+    head_end += 4;
+    int body_len = field_int(buf, head_end, "Content-Length", 0);
+    const char *body = head_end;
+    if (body_len < 0 || body + body_len > buf + len) {
+        return 0;
+    }
+    const char *end = body + body_len;
+    fb->ingest_kbps = field_int(body, end, "ingest_kbps", -1);
+    fb->loss = field_int(body, end, "loss", -1);
+    fb->rtt_ms = field_int(body, end, "rtt_ms", -1);
+    fb->jitter_ms = field_int(body, end, "jitter_ms", -1);
+
+    char reply[128];
+    int n = snprintf(reply, sizeof(reply), "RTSP/1.0 200 OK\r\nCSeq: %d\r\nSession: %s\r\n\r\n",
+                     field_int(buf, head_end, "CSeq", 0), session->session_id);
+    pthread_mutex_lock(&session->rtp_send_mtx);
+    tcp_write(&session->client, reply, n);
+    pthread_mutex_unlock(&session->rtp_send_mtx);
+    return (int)(end - buf);
+}
+
+int rtsp_message_length(const char *buf, int len, int max) {
+    if (len <= 0) {
+        return 0;
+    }
+    if (buf[0] == '$') {
+        if (len < 4) {
+            return 0;
+        }
+        int total = 4 + (((uint8_t)buf[2] << 8) | (uint8_t)buf[3]);
+        if (total > max) {
+            return -1;
+        }
+        return total <= len ? total : 0;
+    }
+    if (!isalpha((unsigned char)buf[0])) {
+        return -1;
+    }
+    const char *head_end = memmem(buf, len, "\r\n\r\n", 4);
+    if (!head_end) {
+        return len < max ? 0 : -1;
+    }
+    head_end += 4;
+    const char *v = find_field(buf, head_end, "Content-Length");
+    long body_len = v ? strtol(v, NULL, 10) : 0;
+    if (body_len < 0 || body_len > max - (head_end - buf)) {
+        return -1;
+    }
+    int total = (int)(head_end - buf + body_len);
+    return total <= len ? total : 0;
+}
+
+int rtsp_response_status(const char *buf, int len) {
+    /* "RTSP/1.0 200 OK" */
+    if (len < 12 || strncmp(buf, "RTSP/1.0 ", 9) != 0 ||
+        !isdigit((unsigned char)buf[9]) || !isdigit((unsigned char)buf[10]) || !isdigit((unsigned char)buf[11])) {
+        return 0;
+    }
+    return (buf[9] - '0') * 100 + (buf[10] - '0') * 10 + (buf[11] - '0');
+}
+
 /* 接收RTSP响应 */
 int rtsp_client_read_response(rtsp_session_t *session, char *response, int len) {
     int n = tcp_read(&session->client, response, len);
@@ -8,6 +8,10 @@
 #include <stdatomic.h>
 #include <pthread.h>
 #include "kcp.h"
+#include "rtcp.h"
+#include "fec.h"
+#include "ratectl.h"
+#include "detect.h"
 
 #define RTSP_BUFFER_SIZE 2048
 #define MTU 1400
@@ -35,13 +39,18 @@ typedef struct rtsp_session {
     uint16_t server_rtp_port;
     uint16_t server_rtcp_port;
     udp_socket_t rtp_socket;
+    udp_socket_t rtcp_socket;   /* 发SR、收RR，tcp传输时走interleaved的rtcpChannel */
+    fec_encoder_t *fec;         /* -t fec 时不为空：RTP直接走UDP加校验包，不用KCP */
     //tcp传输
     uint16_t rtpChannel;
     uint16_t rtcpChannel;
     uint32_t rtp_ssrc;
     atomic_uint_fast16_t rtp_seq;
-    // pthread_mutex_t      rtp_send_mtx; // 可选：对 send 整体加锁
+    pthread_mutex_t      rtp_send_mtx; // RTSP连接上整条消息加锁：tcp传输时视频线程发RTP，主线程发SR和应答
     uint32_t rtp_timestamp;
+    rtcp_stats_t rtcp;
+    uint8_t det_ext[DETECT_EXT_MAX]; /* 视频线程写入本帧的检测结果，随本帧第一个RTP包发出后清零 */
+    size_t det_ext_len;
     /* 来自DESCRIBE/SDP解析的信息 */
     char content_base[RTSP_MAX_URL];
     char control_attr[256];
@@ -74,6 +83,9 @@ void send_h264_frame(rtsp_session_t *session, uint32_t *timestamp,
 // void send_h264_frame_udp(rtsp_session_t *session, uint32_t *timestamp,
 //     const uint8_t *nalu, size_t nalu_size);
 
+/* 发送RTCP SR（udp走rtcp_socket，tcp走interleaved），没到间隔或还没发过RTP时不发 */
+int rtsp_send_rtcp_sr(rtsp_session_t *session);
+
 /* 清理RTSP会话 */
 void rtsp_session_cleanup(rtsp_session_t *session);
 
@@ -109,4 +121,19 @@ int rtsp_client_announce(rtsp_session_t *session, const char *url, const char *s
 
 /* 发送RECORD请求 */
 int rtsp_client_record(rtsp_session_t *session, const char *url);
+
+/* 发送SET_PARAMETER请求上报检测事件（RECORD之后），event 会出现在片段文件名里；
+ * 整条消息在 rtp_send_mtx 下写出，可以在视频线程调用 */
+int rtsp_client_event(rtsp_session_t *session, const char *url, const char *event);
+
+/* buf 开头是服务器发来的码率反馈（SET_PARAMETER）时解析到 fb 并回200，返回消费的字节数；
+ * 不是反馈或没收完整时返回0 */
+int rtsp_handle_feedback(rtsp_session_t *session, const char *buf, int len, ratectl_feedback_t *fb);
+
+/* buf 开头一条完整消息的长度：'$' 帧按长度字段，RTSP 请求/响应按头部加 Content-Length。
+ * 还没收全返回0；不像 RTSP 消息（开头既不是 '$' 也不是字母）或超过 max 字节返回-1 */
+int rtsp_message_length(const char *buf, int len, int max);
+
+/* buf 是 RTSP 响应时返回状态码，否则返回0 */
+int rtsp_response_status(const char *buf, int len);
 #endif
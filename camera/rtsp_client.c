@@ -14,8 +14,11 @@
 #include <sys/socket.h>   // 引入 socket 相关的
 #include <fcntl.h>        // 引入 fcntl
 #include <errno.h>        // 引入 errno
+#include <sys/ioctl.h>
+#include <linux/sockios.h> // 引入 SIOCOUTQ
 #include "log.h"
 #include "kcp.h"
+#include "pktpool.h"
 
 #define DEFAULT_WIDTH 800
 #define DEFAULT_HEIGHT 600
@@ -23,9 +26,16 @@
 #define DEFAULT_RTP_PORT 5004
 #define DEFAULT_RTCP_PORT 5005
 #define MAX_BUFFER_SIZE 2048 // UDP/KCP 接收缓冲区大小
+#define SERVER_BUFFER_SIZE 8192 // 推流中RTSP连接上的接收缓冲，跨多次 read 拼出完整消息
+#define YOLO_MAX_DETECTIONS 100 // 单帧推理输出的框数上限（NMS之后），打包时再按置信度取前 DETECT_MAX_BOXES 个
 
 static int frame_counter=0;
 const int infer_interval = 10;//每10帧推理一次 
+static char rtsp_url[256];
+#ifdef HAVE_YOLO
+static trt_context_t yolo_ctx = NULL;//-e 指定了模型才推理
+static uint64_t last_event_ms = 0;//上次上报检测事件的时间
+#endif
 static inline uint64_t get_time_us() {
     struct timeval tv;
     gettimeofday(&tv, NULL);
@@ -50,6 +60,8 @@ static int set_socket_nonblocking(int fd) {
 static int running = 1;
 static h264_encoder_t encoder;
 static rtsp_session_t session;
+static fec_encoder_t fec_encoder;
+static ratectl_t ratectl;
 // FILE *h264_file;
 /* 信号处理 */
 void signal_handler(int sig) {
@@ -88,6 +100,82 @@ static int split_annexb_nalus(const uint8_t *buf, int len, nalu_view_t *out, int
     return cnt;
 }
 
+/* 收到服务器的RR：打印统计，FEC传输时按丢包比例调整组大小 */
+static void on_rtcp_report(rtsp_session_t *sess) {
+    const rtcp_stats_t *st = &sess->rtcp;
+    printf("RTCP RR: 累计丢包 %d, 丢包率 %.1f%%, 抖动 %.2fms, RTT %dms\n",
+           st->cumulative_lost, st->fraction_lost * 100.0 / 256, st->jitter / 90.0, st->rtt_ms);
+    if (sess->fec) {
+        fec_encoder_adapt(sess->fec, st->fraction_lost);
+    }
+}
+
+/* 服务器的码率反馈：加上本端发送队列的积压，算出新码率交给编码线程 */
+static void on_feedback(rtsp_session_t *sess, ratectl_feedback_t *fb) {
+    int queue_bytes = 0;
+    if (strcmp(sess->transType, "tcp") == 0) {
+        ioctl(sess->client.fd, SIOCOUTQ, &queue_bytes);//内核发送队列里还没被确认的字节
+    } else if (!sess->fec) {
+        pthread_mutex_lock(&sess->mutex);
+        queue_bytes = ikcp_waitsnd(sess->kcp) * (int)sess->kcp->mss;
+        pthread_mutex_unlock(&sess->mutex);
+    }
+    if (fb->rtt_ms < 0) {
+        fb->rtt_ms = sess->rtcp.rtt_ms;
+    }
+    int kbps = ratectl_update(&ratectl, fb, queue_bytes, rtcp_now_ms());
+    LOG_DEBUG("反馈: 实收 %dkbps, 丢包 %d/256, RTT %dms, 积压 %d字节", fb->ingest_kbps, fb->loss, fb->rtt_ms, queue_bytes);
+    if (kbps > 0) {
+        h264_encoder_set_bitrate(&encoder, kbps);
+    }
+}
+
+/* 推流中RTSP连接上收到的数据，一次 read 可能只有一条消息的一部分，剩下的留到下次拼上 */
+static char server_buf[SERVER_BUFFER_SIZE];
+static int server_len = 0;
+
+/* 处理 server_buf 里已经收全的消息：tcp传输时的RR（interleaved帧）、码率反馈（SET_PARAMETER）、
+ * 其他请求和应答。服务器要求 TEARDOWN 或应答错误状态时返回-1，其余返回0 */
+static int handle_server_data(rtsp_session_t *sess) {
+    const char *data = server_buf;
+    int len = server_len;
+    int stop = 0;
+    while (len > 0 && !stop) {
+        int used = rtsp_message_length(data, len, sizeof(server_buf) - 1);
+        if (used == 0) {
+            break;//没收全，等下次
+        }
+        if (used < 0) {
+            /* 错位了，丢到下一个 '$' 重新对齐 */
+            const char *next = memchr(data + 1, '$', len - 1);
+            used = next ? (int)(next - data) : len;
+            LOG_WARNING("Dropping %d bytes of unrecognized data from server", used);
+        } else if (data[0] == '$') {
+            if ((uint8_t)data[1] == sess->rtcpChannel &&
+                rtcp_parse_rr(&sess->rtcp, sess->rtp_ssrc, (const uint8_t *)data + 4, used - 4) == 0) {
+                on_rtcp_report(sess);
+            }
+        } else if (strncmp(data, "SET_PARAMETER ", 14) == 0) {
+            ratectl_feedback_t fb;
+            if (rtsp_handle_feedback(sess, data, used, &fb) > 0) {
+                on_feedback(sess, &fb);
+            }
+        } else {
+            int status = rtsp_response_status(data, used);
+            LOG_INFO("Received RTSP control message:\n%.*s", used, data);
+            if (strncmp(data, "TEARDOWN ", 9) == 0 || status >= 400) {
+                LOG_WARNING("Server requested TEARDOWN or returned %d. Stopping.", status);
+                stop = 1;
+            }
+        }
+        data += used;
+        len -= used;
+    }
+    memmove(server_buf, data, len);
+    server_len = len;
+    return stop ? -1 : 0;
+}
+
 /* 视频流发送线程 */
 void *video_stream_thread(void *arg) {
     rtsp_session_t *sess = (rtsp_session_t *)arg;
@@ -126,10 +214,30 @@ void *video_stream_thread(void *arg) {
         if (frame_counter >= infer_interval) {
             frame_counter = 0; // 重置计数器
             
-            // 1. 解码MJPEG为YUV（复用你现有的tjDecompressToYUVPlanes逻辑）
-            // 2. YOLO模型推理（输入YUV数据，输出原始检测框）
-            // 3. （可选）本地轻量化过滤（如低置信度框直接丢弃）
-            // 4. 将原始检测结果通过TCP/UDP发送给服务器（服务器做NMS）
+#ifdef HAVE_YOLO
+            // yolo_infer_frame 里解码MJPEG、推理并做完NMS；低置信度的框在打包时丢弃，
+            // 结果随这一帧的第一个RTP包发给服务器（见 detect.h），时间戳就是这一帧的
+            if (yolo_ctx) {
+                yolo_detection_t dets[YOLO_MAX_DETECTIONS];
+                int n = yolo_infer_frame(yolo_ctx, mjpeg_data, mjpeg_size,
+                                         encoder.width, encoder.height, dets, YOLO_MAX_DETECTIONS);
+                if (n >= 0) {
+                    sess->det_ext_len = detect_pack_ext(dets, n, encoder.width, encoder.height,
+                                                        timestamp, sess->det_ext);
+                    // 打包后 dets[0] 是置信度最高的框（框数在扩展头第 6 字节）
+                    uint64_t now = rtcp_now_ms();
+                    if (sess->det_ext[5] > 0 && dets[0].confidence >= DETECT_EVENT_SCORE &&
+                        (last_event_ms == 0 || now - last_event_ms >= DETECT_EVENT_INTERVAL_MS)) {
+                        char reason[32];
+                        snprintf(reason, sizeof(reason), "class%d", dets[0].class_id);
+                        if (rtsp_client_event(sess, rtsp_url, reason) > 0) {
+                            last_event_ms = now;
+                            LOG_INFO("检测事件 %s，置信度 %.2f", reason, dets[0].confidence);
+                        }
+                    }
+                }
+            }
+#endif
         }
         // ========== 抽帧推理逻辑结束 ==========
         /* 解码MJPEG并编码为H264 */
@@ -152,6 +260,9 @@ void *video_stream_thread(void *arg) {
             }
             // 这一帧的所有 NAL 都发完了，再推进一次时间戳
             timestamp += timestamp_increment;
+            if (sess->fec) {
+                fec_encoder_tick(sess->fec, rtcp_now_ms());
+            }
             t3 = get_time_us();
             uint64_t send_cost_time = t3 - t2;
             printf("发送一帧: %.2f 微秒\n", (float)send_cost_time);
@@ -178,7 +289,8 @@ void print_usage(const char *prog_name) {
     printf("  -w, --width WIDTH       视频宽度 (默认: 1920)\n");
     printf("  -h, --height HEIGHT     视频高度 (默认: 1080)\n");
     printf("  -r, --rtp-port PORT     本地RTP端口 (默认: 5004)\n");
-    printf("  -t, --tcp or udp        默认udp\n");
+    printf("  -t, --tcp, udp or fec   默认udp（KCP重传），fec为UDP加前向纠错\n");
+    printf("  -e, --engine FILE       YOLO 模型（TensorRT .engine），检测结果随视频发给服务器\n");
     printf("  -?, --help              显示帮助信息\n");
 }
 
@@ -188,12 +300,12 @@ int main(int argc, char *argv[]) {
     char transType[8] = "udp";
     int server_port = 8554;
     const char *url = "/stream";
+    const char *engine_path = NULL;
     int width = DEFAULT_WIDTH;
     int height = DEFAULT_HEIGHT;
     uint16_t rtp_port = DEFAULT_RTP_PORT;//默认端口号
     uint16_t rtcp_port = DEFAULT_RTCP_PORT;
     
-    char rtsp_url[256];
     char transport[256];
     char response[RTSP_BUFFER_SIZE];
     char sdp[512];
@@ -208,6 +320,7 @@ int main(int argc, char *argv[]) {
         {"width", required_argument, 0, 'w'},
         {"height", required_argument, 0, 'h'},
         {"rtp-port", required_argument, 0, 'r'},
+        {"engine", required_argument, 0, 'e'},
         {"help", no_argument, 0, '?'},
         {0, 0, 0, 0}
     };
@@ -215,7 +328,7 @@ int main(int argc, char *argv[]) {
     int opt;
     int option_index = 0;
     
-    while ((opt = getopt_long(argc, argv, "d:s:p:u:w:h:r:t:?", long_options, &option_index)) != -1) {
+    while ((opt = getopt_long(argc, argv, "d:s:p:u:w:h:r:t:e:?", long_options, &option_index)) != -1) {
         switch (opt) {
             case 'd':
                 video_device = optarg;
@@ -242,6 +355,9 @@ int main(int argc, char *argv[]) {
             case 't':
                 snprintf(transType, sizeof(transType), "%s", optarg);
                 break;
+            case 'e':
+                engine_path = optarg;
+                break;
             case '?':
                 print_usage(argv[0]);
                 return 0;
@@ -260,13 +376,16 @@ int main(int argc, char *argv[]) {
     /* 注册信号处理 */
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
+    /* KCP 分片从报文池里分，要在 kcp_init 之前装上 */
+    pktpool_install_kcp();
     
     /* 初始化RTSP会话 */
     // rtsp_session_init(&session);
     session.rtp_ssrc = ((uint32_t)rand() << 16) ^ rand();
-    // pthread_mutex_init(&session.rtp_send_mtx, NULL);
+    pthread_mutex_init(&session.rtp_send_mtx, NULL);
     session.rtp_port = rtp_port;
     session.rtcp_port = rtcp_port;
+    session.rtcp_socket.fd = -1;
     
     /* 连接到RTSP服务器 */
     printf("连接到RTSP服务器: %s:%d\n", server_ip, server_port);
@@ -317,6 +436,17 @@ int main(int argc, char *argv[]) {
         tcp_close_client(&session.client);
         return -1;
     }
+    ratectl_init(&ratectl, H264_DEFAULT_KBPS, RATECTL_MIN_KBPS);
+    if (engine_path) {
+#ifdef HAVE_YOLO
+        yolo_ctx = yolo_init(engine_path, width, height, YOLO_MAX_DETECTIONS);
+        if (!yolo_ctx) {
+            fprintf(stderr, "加载模型 %s 失败，只推视频\n", engine_path);
+        }
+#else
+        fprintf(stderr, "提示: 推理需要实现 yolo_infer.cc 并在编译时定义HAVE_YOLO，忽略 -e\n");
+#endif
+    }
     
     /* 构建RTSP URL */
     snprintf(rtsp_url, sizeof(rtsp_url), "rtsp://%s:%d%s", server_ip, server_port, url);
@@ -385,6 +515,20 @@ int main(int argc, char *argv[]) {
         goto cleanup;
     }
     
+    /* udp传输时RTCP从SETUP里声明的client_port收发，服务器的RR回到这个端口 */
+    if (strcmp(session.transType, "udp") == 0) {
+        if (udp_init(&session.rtcp_socket, server_ip, session.server_rtcp_port) < 0 ||
+            udp_bind(&session.rtcp_socket, rtcp_port) < 0) {
+            fprintf(stderr, "初始化RTCP socket失败，不发送RTCP\n");
+            udp_close(&session.rtcp_socket);
+        }
+    }
+    rtcp_stats_init(&session.rtcp);
+    if (strcmp(transType, "fec") == 0) {
+        fec_encoder_init(&fec_encoder, &session.rtp_socket);
+        session.fec = &fec_encoder;
+    }
+
     session.state = RTSP_STATE_READY;
     
     session.kcp = kcp_init(&session.rtp_socket);
@@ -420,6 +564,9 @@ int main(int argc, char *argv[]) {
     if (session.rtp_socket.fd > maxfd) {
         maxfd = session.rtp_socket.fd;
     }
+    if (session.rtcp_socket.fd > maxfd) {
+        maxfd = session.rtcp_socket.fd;
+    }
     next_kcp_update_time = iclock();
     while(running){
         IUINT32 current_ms = iclock();
@@ -440,11 +587,20 @@ int main(int argc, char *argv[]) {
             // 理论上不会发生，但作为保护，确保select不会阻塞
             wait_ms = 1; 
         }
+        // 到间隔发SR，select 最多等到下一次SR
+        rtsp_send_rtcp_sr(&session);
+        long rtcp_wait = (long)(session.rtcp.next_report_ms - rtcp_now_ms());
+        if (rtcp_wait < wait_ms) {
+            wait_ms = rtcp_wait > 0 ? rtcp_wait : 1;
+        }
         tv.tv_sec = wait_ms / 1000;
         tv.tv_usec = (wait_ms % 1000) * 1000;
         FD_ZERO(&read_fds);
         FD_SET(session.client.fd, &read_fds); // RTSP TCP
         FD_SET(session.rtp_socket.fd, &read_fds); // KCP UDP
+        if (session.rtcp_socket.fd >= 0) {
+            FD_SET(session.rtcp_socket.fd, &read_fds); // RTCP UDP
+        }
         set_socket_nonblocking(session.rtp_socket.fd);
         int activity = select(maxfd + 1, &read_fds, NULL, NULL, &tv);
         
@@ -467,13 +623,11 @@ int main(int argc, char *argv[]) {
         // A. RTSP TCP Socket (接收 TEARDOWN, PAUSE 等控制)
         if (FD_ISSET(session.client.fd, &read_fds)) {
             // 注意: 假设 rtsp_client_read_response 能处理非阻塞或 EAGAIN 的情况
-            int len = rtsp_client_read_response(&session, response, sizeof(response));
+            int len = tcp_read(&session.client, server_buf + server_len, sizeof(server_buf) - server_len);
             
             if (len > 0) {
-                LOG_INFO("Received RTSP control message:\n%.*s", len, response);
-                // 简单的退出逻辑：收到 TEARDOWN 或错误时停止
-                if (strstr(response, "TEARDOWN") || strstr(response, "400")) {
-                    LOG_WARNING("Server requested TEARDOWN or error. Stopping.");
+                server_len += len;
+                if (handle_server_data(&session) < 0) {
                     running = 0;
                 }
             } else if (len == 0) {
@@ -516,6 +670,17 @@ int main(int argc, char *argv[]) {
                 }
             }
         }
+
+        // C. RTCP UDP Socket (服务器的 RR)
+        if (session.rtcp_socket.fd >= 0 && FD_ISSET(session.rtcp_socket.fd, &read_fds)) {
+            uint8_t rtcp_buffer[MAX_BUFFER_SIZE];
+            int n;
+            while ((n = udp_recv(&session.rtcp_socket, rtcp_buffer, sizeof(rtcp_buffer))) > 0) {
+                if (rtcp_parse_rr(&session.rtcp, session.rtp_ssrc, rtcp_buffer, n) == 0) {
+                    on_rtcp_report(&session);
+                }
+            }
+        }
     }
 
 
@@ -534,6 +699,11 @@ cleanup:
     // fclose(h264_file);
     /* 清理资源 */
     h264_encoder_cleanup(&encoder);
+#ifdef HAVE_YOLO
+    if (yolo_ctx) {
+        yolo_cleanup(yolo_ctx);
+    }
+#endif
     v4l2_stream_off();
     v4l2_cleanup();
     rtsp_session_cleanup(&session);
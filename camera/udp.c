@@ -43,6 +43,21 @@ int udp_recv(udp_socket_t *udp, void *buf, int len){
     return n;
 }
 
+int udp_bind(udp_socket_t *udp, int local_port) {
+    struct sockaddr_in local;
+    int opt = 1;
+    setsockopt(udp->fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = INADDR_ANY;
+    local.sin_port = htons(local_port);
+    if (bind(udp->fd, (struct sockaddr *)&local, sizeof(local)) < 0) {
+        perror("udp bind");
+        return -1;
+    }
+    return 0;
+}
+
 /* 关闭UDP socket */
 void udp_close(udp_socket_t *udp) {
     if (udp->fd >= 0) {
@@ -22,6 +22,8 @@ int udp_init(udp_socket_t *udp, const char *ip, int port);
 int udp_send(udp_socket_t *udp, const void *buf, int len);
 
 int udp_recv(udp_socket_t *udp, void *buf, int len);
+/* 绑定本地端口（如SETUP里声明的client_port），对端按这个端口回包 */
+int udp_bind(udp_socket_t *udp, int local_port);
 /* 关闭UDP socket */
 void udp_close(udp_socket_t *udp);
 
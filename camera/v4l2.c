@@ -312,14 +312,14 @@ int h264_encoder_init(h264_encoder_t *encoder, int width, int height, int fps) {
             param.rc.f_rf_constant = 23;
     */
     param.rc.i_rc_method = X264_RC_ABR;
-    param.rc.i_bitrate   = 2000;  // 平均码率
+    param.rc.i_bitrate   = H264_DEFAULT_KBPS;  // 平均码率
     /*
         VBV =Virtual Buffer Verifier
         用一个“虚拟缓冲区”限制瞬时码率，
         防止一瞬间把网络/播放器打爆。
     */
-    param.rc.i_vbv_max_bitrate = 2000;//峰值码率，瞬时不允许超过的码率
-    param.rc.i_vbv_buffer_size = 2000;//缓冲大小，允许“借用”的缓冲
+    param.rc.i_vbv_max_bitrate = H264_DEFAULT_KBPS;//峰值码率，瞬时不允许超过的码率
+    param.rc.i_vbv_buffer_size = H264_DEFAULT_KBPS;//缓冲大小，允许“借用”的缓冲
     param.rc.i_qp_min = 20;//最高画面质量，qp值越小画质越清晰
     param.rc.i_qp_max = 45;//最低画面质量
     //其他设置
@@ -338,10 +338,36 @@ int h264_encoder_init(h264_encoder_t *encoder, int width, int height, int fps) {
     encoder->width = width;
     encoder->height = height;
     encoder->fps = fps;
+    encoder->bitrate_kbps = H264_DEFAULT_KBPS;
+    atomic_store(&encoder->pending_kbps, 0);
     encoder->initialized = 1;
     return 0;
 }
 
+void h264_encoder_set_bitrate(h264_encoder_t *encoder, int kbps) {
+    atomic_store(&encoder->pending_kbps, kbps);
+}
+
+/* 编码线程里应用新码率：x264_encoder_reconfig 不能和 encode 并发，所以不在请求的线程里直接改 */
+static void apply_pending_bitrate(h264_encoder_t *encoder) {
+    int kbps = atomic_exchange(&encoder->pending_kbps, 0);
+    if (kbps <= 0 || kbps == encoder->bitrate_kbps) {
+        return;
+    }
+    x264_t *x264_enc = (x264_t *)encoder->x264_encoder;
+    x264_param_t param;
+    x264_encoder_parameters(x264_enc, &param);
+    param.rc.i_bitrate = kbps;
+    param.rc.i_vbv_max_bitrate = kbps;
+    param.rc.i_vbv_buffer_size = kbps;
+    if (x264_encoder_reconfig(x264_enc, &param) < 0) {
+        fprintf(stderr, "x264_encoder_reconfig failed: %d kbps\n", kbps);
+        return;
+    }
+    printf("编码码率: %d -> %d kbps\n", encoder->bitrate_kbps, kbps);
+    encoder->bitrate_kbps = kbps;
+}
+
 int mjpeg_to_h264(h264_encoder_t *encoder, const unsigned char *mjpeg,
                   size_t mjpeg_size, unsigned char *h264_data,
                   size_t h264_buf_size, int *h264_len)
@@ -349,6 +375,7 @@ int mjpeg_to_h264(h264_encoder_t *encoder, const unsigned char *mjpeg,
     if (!encoder || !encoder->initialized || !h264_data || !h264_len) return -1;
     if (ensure_tj_decoder() != 0)
         return -1;
+    apply_pending_bitrate(encoder);
     x264_t *x264_enc = (x264_t *)encoder->x264_encoder;
     x264_picture_t pic_in,pic_out;//创建输入帧和输出帧
     x264_nal_t *nals = NULL;
@@ -14,6 +14,7 @@
 #include <linux/videodev2.h> 
 #include <linux/fb.h> 
 #include <stddef.h>
+#include <stdatomic.h>
 #include "log.h"
 #include <turbojpeg.h>
 #include <x264.h>
@@ -23,6 +24,7 @@ extern "C" {
 #endif
 
 #define FRAMEBUFFER_COUNT   3               //帧缓冲数量 
+#define H264_DEFAULT_KBPS   2000            //初始码率，也是码率自适应的上限
 
 /*** 摄像头像素格式及其描述信息 ***/ 
 typedef struct camera_format { 
@@ -44,6 +46,8 @@ typedef struct h264_encoder {
     int fps;
     // x264_picture_t *pic_in;
     int initialized;
+    int bitrate_kbps;           // 当前生效的码率，只在编码线程访问
+    atomic_int pending_kbps;    // 其他线程请求的新码率，0 表示没有
 } h264_encoder_t;
 
 extern int v4l2_fd;
@@ -82,6 +86,9 @@ int v4l2_qbuf(struct v4l2_buffer *buf);
 /* 初始化H264编码器 */
 int h264_encoder_init(h264_encoder_t *encoder, int width, int height, int fps);
 
+/* 请求修改码率（ABR 平均码率和 VBV 同时改），任意线程可调，编码下一帧前生效 */
+void h264_encoder_set_bitrate(h264_encoder_t *encoder, int kbps);
+
 /* 将MJPEG数据转换为YUV420P格式（用于编码） */
 int mjpeg_to_yuv420p(const unsigned char *mjpeg, size_t mjpeg_size,
                      unsigned char *yuv420p, int width, int height);
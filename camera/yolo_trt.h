@@ -5,6 +5,11 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+// 实现在 yolo_infer.cc（TensorRT），由 C 代码调用
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 // 定义一个结构体来表示检测到的目标框
 // 确保这个结构体足够通用，以便于服务器解析
 typedef struct {
@@ -44,4 +49,8 @@ int yolo_infer_frame(
 // 3. 清理资源
 void yolo_cleanup(trt_context_t context);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif // YOLO_TRT_H
\ No newline at end of file
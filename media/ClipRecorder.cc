@@ -0,0 +1,79 @@
+#include "ClipRecorder.h"
+#include "Logger.h"
+#include <ctype.h>
+
+ClipRecorder::Options &ClipRecorder::options() {
+    static Options options;
+    return options;
+}
+
+ClipRecorder::ClipRecorder(const std::string &streamName, const Options &options,
+                           AsyncFileWriter &writer)
+:_name(streamName)
+,_options(options)
+,_writer(writer)
+,_ring(options.preSeconds, options.maxRingBytes)
+,_lastTs(0)
+,_startTs(0)
+,_endTs(0){
+}
+
+ClipRecorder::~ClipRecorder() {
+    close();
+}
+
+void ClipRecorder::onPacket(const BufferPtr &pkt) {
+    _lastTs = PreEventRing::rtpTimestamp(*pkt);
+    _ring.onPacket(pkt);
+    if (!_clip) return;
+    if (static_cast<int32_t>(_lastTs - _endTs) > 0) {
+        close();
+        return;
+    }
+    _clip->onRtp(pkt->data(), pkt->size());
+}
+
+void ClipRecorder::trigger(const std::string &reason) {
+    ++_stats.triggers;
+    uint32_t now = _lastTs;
+    if (_clip) {
+        // 片段还没结束，顺延；以开头为准封顶
+        uint32_t end = now + _options.postSeconds * Fmp4Muxer::kTimescale;
+        uint32_t limit = _startTs + _options.maxClipSeconds * Fmp4Muxer::kTimescale;
+        if (static_cast<int32_t>(end - limit) > 0) end = limit;
+        if (static_cast<int32_t>(end - _endTs) > 0) _endTs = end;
+        LOG_INFO("ClipRecorder %s: %s extends clip %s", _name.c_str(), reason.c_str(),
+                 _clip->currentPath().c_str());
+        return;
+    }
+
+    std::string tag;
+    for (char c : reason) {
+        if (isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_') tag += c;
+    }
+    if (tag.empty()) tag = "event";
+    Mp4Recorder::Options clipOptions;
+    clipOptions.dir = _options.dir;
+    clipOptions.segmentSeconds = _options.maxClipSeconds + _options.preSeconds + _options.postSeconds;
+    clipOptions.segmentBytes = ~0ull;
+    _clip.reset(new Mp4Recorder(_name + "_" + tag, clipOptions, _writer));
+
+    // 预录部分：缓存从关键帧开始，直接按原报文喂给封装
+    const std::deque<BufferPtr> &packets = _ring.packets();
+    _startTs = packets.empty() ? now : now - _ring.duration();
+    _endTs = now + _options.postSeconds * Fmp4Muxer::kTimescale;
+    for (const BufferPtr &pkt : packets) {
+        _clip->onRtp(pkt->data(), pkt->size());
+    }
+    ++_stats.clips;
+    LOG_INFO("ClipRecorder %s: %s, clip with %.1fs pre-roll to %s", _name.c_str(),
+             reason.c_str(), _ring.duration() / double(Fmp4Muxer::kTimescale),
+             _clip->currentPath().empty() ? "(waiting for keyframe)" : _clip->currentPath().c_str());
+}
+
+void ClipRecorder::close() {
+    if (_clip) {
+        _clip->close();
+        _clip.reset();
+    }
+}
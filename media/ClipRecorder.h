@@ -0,0 +1,58 @@
+#ifndef __CLIPRECORDER_H__
+#define __CLIPRECORDER_H__
+
+#include <memory>
+#include <string>
+#include <stdint.h>
+#include "AsyncFileWriter.h"
+#include "BufferChain.h"
+#include "Mp4Recorder.h"
+#include "PreEventRing.h"
+
+// 事件片段：平时只在内存里保留最近 preSeconds 秒（从关键帧开始），
+// 触发时把这段连同之后 postSeconds 秒原样封装成一个 MP4，不重新编码。
+// 片段进行中再次触发只延长结束时间，整段不超过 maxClipSeconds。
+// 作为摄像头 StreamFanout 的订阅者，所有接口都在摄像头所在 loop 线程里调用
+class ClipRecorder {
+public:
+    struct Options {
+        std::string dir;                            // 片段目录，空表示不启用
+        uint32_t preSeconds = 10;
+        uint32_t postSeconds = 10;
+        uint32_t maxClipSeconds = 120;
+        size_t maxRingBytes = 16 << 20;             // 每路预录缓存上限
+    };
+    struct Stats {
+        uint64_t triggers = 0;
+        uint64_t clips = 0;
+    };
+
+    // 进程级配置，main 里在 loop 启动前设置
+    static Options &options();
+
+    ClipRecorder(const std::string &streamName, const Options &options,
+                 AsyncFileWriter &writer = AsyncFileWriter::instance());
+    ~ClipRecorder();
+
+    void onPacket(const BufferPtr &pkt);
+    // reason 会出现在文件名里，只保留字母数字和 '-'/'_'
+    void trigger(const std::string &reason);
+    void close();
+
+    bool active() const { return _clip != nullptr; }
+    const Stats &stats() const { return _stats; }
+    const PreEventRing &ring() const { return _ring; }
+
+private:
+    std::string _name;
+    Options _options;
+    AsyncFileWriter &_writer;
+    PreEventRing _ring;
+    std::unique_ptr<Mp4Recorder> _clip;
+    uint32_t _lastTs;
+    uint32_t _startTs;              // 片段开头（预录的第一个报文）
+    uint32_t _endTs;
+    Stats _stats;
+};
+
+#endif
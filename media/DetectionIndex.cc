@@ -0,0 +1,94 @@
+#include "DetectionIndex.h"
+#include <chrono>
+#include <stdarg.h>
+#include <stdio.h>
+
+static const size_t kRtpHeaderLen = 12;
+static const size_t kBlockHeaderLen = 8;   // 版本、框数、保留、时间戳
+static const size_t kBoxLen = 8;
+
+static void appendf(std::string &out, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void appendf(std::string &out, const char *fmt, ...) {
+    char line[256];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    if (n > 0) out.append(line, n < (int)sizeof(line) ? n : sizeof(line) - 1);
+}
+
+bool DetectionIndex::parse(const char *rtp, size_t len, DetectionFrame &frame, size_t &extBegin, size_t &extEnd) {
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(rtp);
+    if (len < kRtpHeaderLen || (p[0] >> 6) != 2 || !(p[0] & 0x10)) return false;
+    size_t off = kRtpHeaderLen + (p[0] & 0x0F) * 4;
+    if (len < off + 4) return false;
+    uint16_t profile = static_cast<uint16_t>((p[off] << 8) | p[off + 1]);
+    size_t end = off + 4 + ((p[off + 2] << 8) | p[off + 3]) * 4;
+    if (profile != kProfile || end > len) return false;
+    size_t extLen = end - off - 4;
+    if (extLen < kBlockHeaderLen) return false;//先确认块头在扩展头范围内再读
+    const uint8_t *b = p + off + 4;
+    size_t n = b[1];
+    if (b[0] != kVersion || extLen - kBlockHeaderLen < n * kBoxLen) return false;
+
+    frame.timestamp = (uint32_t(b[4]) << 24) | (uint32_t(b[5]) << 16) | (uint32_t(b[6]) << 8) | b[7];
+    frame.boxes.resize(n);
+    const uint8_t *q = b + kBlockHeaderLen;
+    for (size_t i = 0; i < n; ++i, q += kBoxLen) {
+        // 4 个 12 位坐标大端排在 6 个字节里
+        uint64_t v = 0;
+        for (int k = 2; k < 8; ++k) v = (v << 8) | q[k];
+        DetectionBox &box = frame.boxes[i];
+        box.classId = q[0];
+        box.score = q[1];
+        box.x0 = static_cast<uint16_t>((v >> 36) & 0xFFF);
+        box.y0 = static_cast<uint16_t>((v >> 24) & 0xFFF);
+        box.x1 = static_cast<uint16_t>((v >> 12) & 0xFFF);
+        box.y1 = static_cast<uint16_t>(v & 0xFFF);
+    }
+    extBegin = off;
+    extEnd = end;
+    return true;
+}
+
+void DetectionIndex::add(DetectionFrame &&frame) {
+    using namespace std::chrono;
+    frame.receivedMs = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+    std::lock_guard<std::mutex> lock(_mtx);
+    ++_totalFrames;
+    _totalBoxes += frame.boxes.size();
+    _frames.push_back(std::move(frame));
+    if (_frames.size() > kMaxFrames) {
+        _frames.pop_front();
+    }
+}
+
+void DetectionIndex::json(std::string &out, bool hasSince, uint32_t since) const {
+    const double scale = kCoordMax;
+    std::lock_guard<std::mutex> lock(_mtx);
+    out += "{\"frames\":[";
+    bool firstFrame = true;
+    for (const DetectionFrame &f : _frames) {
+        if (hasSince && static_cast<int32_t>(f.timestamp - since) <= 0) continue;
+        appendf(out, "%s{\"ts\":%u,\"time\":%llu,\"boxes\":[", firstFrame ? "" : ",",
+                f.timestamp, (unsigned long long)f.receivedMs);
+        firstFrame = false;
+        for (size_t i = 0; i < f.boxes.size(); ++i) {
+            const DetectionBox &b = f.boxes[i];
+            appendf(out, "%s{\"class\":%u,\"score\":%.3f,\"box\":[%.4f,%.4f,%.4f,%.4f]}", i ? "," : "",
+                    b.classId, b.score / 255.0, b.x0 / scale, b.y0 / scale, b.x1 / scale, b.y1 / scale);
+        }
+        out += "]}";
+    }
+    out += "]}\n";
+}
+
+uint64_t DetectionIndex::frames() const {
+    std::lock_guard<std::mutex> lock(_mtx);
+    return _totalFrames;
+}
+
+uint64_t DetectionIndex::boxes() const {
+    std::lock_guard<std::mutex> lock(_mtx);
+    return _totalBoxes;
+}
@@ -0,0 +1,51 @@
+#ifndef __DETECTIONINDEX_H__
+#define __DETECTIONINDEX_H__
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+struct DetectionBox {
+    uint8_t classId;
+    uint8_t score;                  // 置信度 x255
+    uint16_t x0, y0, x1, y1;        // 按画面宽高归一到 0..kCoordMax
+};
+
+struct DetectionFrame {
+    uint32_t timestamp = 0;         // 推理所用那一帧的 RTP 时间戳（90kHz）
+    uint64_t receivedMs = 0;        // 服务器收到的时间，Unix 毫秒
+    std::vector<DetectionBox> boxes;
+};
+
+// 摄像头端推理的检测结果：摄像头放在该帧第一个 RTP 包的扩展头里随视频送来（格式见 camera/detect.h），
+// RtspConnect 分发前取出登记到这里，观看端、录像拿到的 RTP 已经去掉扩展头。
+// 中心不用再解码视频，按流查最近的结果即可。
+// 每路流只留最近 kMaxFrames 次推理；摄像头 loop 写，HTTP 请求在其他 loop 上读，加锁
+class DetectionIndex {
+public:
+    static const uint16_t kProfile = 0x4454;    // 扩展头的 profile 字段，'D''T'
+    static const uint8_t kVersion = 1;
+    static const uint16_t kCoordMax = 4095;     // 坐标量化为 12 位
+    static const size_t kMaxFrames = 600;
+
+    // rtp 带本格式的扩展头时解析到 frame，[extBegin, extEnd) 是扩展头（含 4 字节头）在包内的位置
+    static bool parse(const char *rtp, size_t len, DetectionFrame &frame, size_t &extBegin, size_t &extEnd);
+
+    void add(DetectionFrame &&frame);
+    // 以 JSON 输出时间戳在 since 之后的结果（RTP 时间戳按回绕比较），hasSince 为 false 时输出全部
+    void json(std::string &out, bool hasSince, uint32_t since) const;
+
+    uint64_t frames() const;
+    uint64_t boxes() const;
+
+private:
+    mutable std::mutex _mtx;
+    std::deque<DetectionFrame> _frames;
+    uint64_t _totalFrames = 0;
+    uint64_t _totalBoxes = 0;
+};
+
+#endif
@@ -0,0 +1,365 @@
+#include "Fec.h"
+#include "Logger.h"
+#include <string.h>
+
+namespace {
+
+// GF(2^8)，本原多项式 x^8+x^4+x^3+x^2+1（0x11D）
+struct GaloisTables {
+    uint8_t exp[512];
+    uint8_t log[256];
+    uint8_t coef[Fec::kMaxParity][Fec::kMaxData];
+
+    GaloisTables() {
+        int x = 1;
+        for (int i = 0; i < 255; ++i) {
+            exp[i] = static_cast<uint8_t>(x);
+            log[x] = static_cast<uint8_t>(i);
+            x <<= 1;
+            if (x & 0x100) x ^= 0x11D;
+        }
+        for (int i = 255; i < 512; ++i) exp[i] = exp[i - 255];
+        log[0] = 0;
+        // Cauchy 矩阵 1/(x_r + y_c)，x_r = kMaxData + r，y_c = c；每列除以第 0 行，第 0 行变成全 1
+        for (int r = 0; r < Fec::kMaxParity; ++r) {
+            for (int c = 0; c < Fec::kMaxData; ++c) {
+                uint8_t x0 = static_cast<uint8_t>(Fec::kMaxData ^ c);
+                uint8_t xr = static_cast<uint8_t>((Fec::kMaxData + r) ^ c);
+                coef[r][c] = mul(x0, exp[255 - log[xr]]);
+            }
+        }
+    }
+    uint8_t mul(uint8_t a, uint8_t b) const {
+        return (a == 0 || b == 0) ? 0 : exp[log[a] + log[b]];
+    }
+};
+
+const GaloisTables &gf() {
+    static const GaloisTables tables;
+    return tables;
+}
+
+uint16_t get16(const uint8_t *p) {
+    return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+void put16(uint8_t *p, uint16_t v) {
+    p[0] = static_cast<uint8_t>(v >> 8);
+    p[1] = static_cast<uint8_t>(v);
+}
+
+} // namespace
+
+uint8_t Fec::mul(uint8_t a, uint8_t b) {
+    return gf().mul(a, b);
+}
+
+uint8_t Fec::inv(uint8_t a) {
+    const GaloisTables &t = gf();
+    return a == 0 ? 0 : t.exp[255 - t.log[a]];
+}
+
+uint8_t Fec::coefficient(int row, int col) {
+    return gf().coef[row][col];
+}
+
+void Fec::mulAdd(uint8_t *dst, const uint8_t *src, uint8_t c, size_t n) {
+    if (c == 0) {
+        return;
+    }
+    if (c == 1) {
+        for (size_t i = 0; i < n; ++i) dst[i] ^= src[i];//XOR 校验的快速路径
+        return;
+    }
+    const GaloisTables &t = gf();
+    unsigned lc = t.log[c];
+    for (size_t i = 0; i < n; ++i) {
+        if (src[i]) dst[i] ^= t.exp[t.log[src[i]] + lc];
+    }
+}
+
+void Fec::paramsForLoss(uint8_t fractionLost, int &k, int &m) {
+    // 丢包越多组越小、校验越多；不到 1% 时只用一个 XOR 包，开销约 6%
+    if (fractionLost < 2) {
+        k = 16; m = 1;
+    } else if (fractionLost < 8) {
+        k = 10; m = 1;
+    } else if (fractionLost < 20) {
+        k = 10; m = 2;
+    } else if (fractionLost < 40) {
+        k = 8; m = 3;
+    } else {
+        k = 6; m = 4;
+    }
+}
+
+FecEncoder::FecEncoder(int k, int m)
+:_k(k)
+,_m(m)
+,_nextK(k)
+,_nextM(m)
+,_count(0)
+,_baseSeq(0)
+,_fecSeq(0)
+,_ssrc(0)
+,_timestamp(0)
+,_blockLen(0)
+,_parity(Fec::kMaxParity){
+}
+
+void FecEncoder::setParams(int k, int m) {
+    _nextK = k < 1 ? 1 : (k > Fec::kMaxData ? Fec::kMaxData : k);
+    _nextM = m < 1 ? 1 : (m > Fec::kMaxParity ? Fec::kMaxParity : m);
+}
+
+void FecEncoder::add(const uint8_t *rtp, size_t len) {
+    if (len < 12 || len > 0xFFFF - 2) {
+        return;
+    }
+    uint16_t seq = get16(rtp + 2);
+    if (_count > 0 && seq != static_cast<uint16_t>(_baseSeq + _count)) {
+        flush();//序号不连续，前一组就到这里
+    }
+    if (_count == 0) {
+        _k = _nextK;
+        _m = _nextM;
+        _baseSeq = seq;
+        _blockLen = 0;
+    }
+    size_t blockLen = len + 2;
+    uint8_t lenBytes[2];
+    put16(lenBytes, static_cast<uint16_t>(len));
+    for (int r = 0; r < _m; ++r) {
+        std::vector<uint8_t> &parity = _parity[r];
+        if (parity.size() < blockLen) parity.resize(blockLen, 0);
+        uint8_t c = Fec::coefficient(r, static_cast<int>(_count));
+        Fec::mulAdd(parity.data(), lenBytes, c, 2);
+        Fec::mulAdd(parity.data() + 2, rtp, c, len);
+    }
+    if (blockLen > _blockLen) _blockLen = blockLen;
+    _timestamp = (uint32_t(rtp[4]) << 24) | (uint32_t(rtp[5]) << 16) | (uint32_t(rtp[6]) << 8) | rtp[7];
+    _ssrc = (uint32_t(rtp[8]) << 24) | (uint32_t(rtp[9]) << 16) | (uint32_t(rtp[10]) << 8) | rtp[11];
+    if (++_count == static_cast<size_t>(_k)) {
+        flush();
+    }
+}
+
+void FecEncoder::flush() {
+    if (_count == 0) {
+        return;
+    }
+    for (int r = 0; r < _m; ++r) {
+        _packet.resize(12 + Fec::kHeaderLen + _blockLen);
+        uint8_t *p = reinterpret_cast<uint8_t *>(&_packet[0]);
+        p[0] = 0x80;
+        p[1] = Fec::kPayloadType;
+        put16(p + 2, _fecSeq++);
+        put16(p + 4, static_cast<uint16_t>(_timestamp >> 16));
+        put16(p + 6, static_cast<uint16_t>(_timestamp));
+        put16(p + 8, static_cast<uint16_t>(_ssrc >> 16));
+        put16(p + 10, static_cast<uint16_t>(_ssrc));
+        put16(p + 12, _baseSeq);
+        p[14] = static_cast<uint8_t>(_count);
+        p[15] = static_cast<uint8_t>(_m);
+        p[16] = static_cast<uint8_t>(r);
+        p[17] = 0;
+        put16(p + 18, static_cast<uint16_t>(_blockLen));
+        memcpy(p + 20, _parity[r].data(), _blockLen);
+        if (_output) {
+            _output(p, _packet.size());
+        }
+        memset(_parity[r].data(), 0, _blockLen);
+    }
+    _count = 0;
+}
+
+FecDecoder::FecDecoder()
+:_slots(kSlots){
+}
+
+void FecDecoder::store(uint16_t seq, const char *data, size_t len) {
+    Slot &s = _slots[seq % kSlots];
+    s.valid = true;
+    s.seq = seq;
+    s.pkt.assign(data, len);
+}
+
+void FecDecoder::input(const char *data, size_t len) {
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(data);
+    if (len < 12 || (p[0] & 0xC0) != 0x80) {
+        return;
+    }
+    if ((p[1] & 0x7F) == Fec::kPayloadType) {
+        onParity(p, len);
+        return;
+    }
+    uint16_t seq = get16(p + 2);
+    if (!have(seq)) {
+        ++_stats.data;
+        store(seq, data, len);
+    }
+    _packetCb(data, len, false);
+    Group *g = findGroup(seq);
+    if (g && !g->done) {
+        tryRecover(*g);//之前校验不够，这个包补上后可能够了
+    }
+}
+
+FecDecoder::Group *FecDecoder::findGroup(uint16_t seq) {
+    for (Group &g : _groups) {
+        if (static_cast<uint16_t>(seq - g.base) < static_cast<uint16_t>(g.k)) {
+            return &g;
+        }
+    }
+    return nullptr;
+}
+
+void FecDecoder::onParity(const uint8_t *p, size_t len) {
+    if (len < 12 + Fec::kHeaderLen) {
+        return;
+    }
+    uint16_t base = get16(p + 12);
+    int k = p[14], m = p[15], row = p[16];
+    size_t blockLen = get16(p + 18);
+    if (k < 1 || k > Fec::kMaxData || m < 1 || m > Fec::kMaxParity || row >= m ||
+        blockLen < 14 || len - 12 - Fec::kHeaderLen < blockLen) {
+        return;
+    }
+    ++_stats.parity;
+    Group *g = nullptr;
+    for (Group &each : _groups) {
+        if (each.base == base) {
+            g = &each;
+            break;
+        }
+    }
+    if (!g) {
+        // 新组：太旧（数据槽位可能已被覆盖）或超出个数的组先出局
+        while (!_groups.empty() && (_groups.size() >= kMaxGroups ||
+               static_cast<int16_t>(base - _groups.front().base) > static_cast<int>(kSlots / 2))) {
+            retire(_groups.front());
+            _groups.erase(_groups.begin());
+        }
+        _groups.push_back(Group());
+        g = &_groups.back();
+        g->base = base;
+        g->k = k;
+        g->m = m;
+        g->blockLen = blockLen;
+        g->parityMask = 0;
+        g->parity.resize(m);
+        g->done = false;
+        ++_stats.groups;
+    }
+    if (g->done || row >= g->m || (g->parityMask & (1u << row)) || blockLen != g->blockLen) {
+        return;
+    }
+    g->parity[row].assign(reinterpret_cast<const char *>(p + 12 + Fec::kHeaderLen), blockLen);
+    g->parityMask |= 1u << row;
+    tryRecover(*g);
+}
+
+void FecDecoder::tryRecover(Group &g) {
+    int missing[Fec::kMaxParity];
+    int e = 0;
+    for (int i = 0; i < g.k; ++i) {
+        if (!have(static_cast<uint16_t>(g.base + i))) {
+            if (e == Fec::kMaxParity) return;//超出校验能力
+            missing[e++] = i;
+        }
+    }
+    if (e == 0) {
+        g.done = true;
+        return;
+    }
+    int rows[Fec::kMaxParity];
+    int r = 0;
+    for (int j = 0; j < g.m && r < e; ++j) {
+        if (g.parityMask & (1u << j)) rows[r++] = j;
+    }
+    if (r < e) {
+        return;//校验包还不够
+    }
+
+    // 校验减去已收到的数据包的贡献，剩下的只和缺的包有关
+    size_t L = g.blockLen;
+    _work.assign(2 * e * L, 0);
+    uint8_t *syndrome = _work.data();
+    uint8_t *out = _work.data() + e * L;
+    for (int a = 0; a < e; ++a) {
+        uint8_t *s = syndrome + a * L;
+        memcpy(s, g.parity[rows[a]].data(), L);
+        for (int i = 0; i < g.k; ++i) {
+            uint16_t seq = static_cast<uint16_t>(g.base + i);
+            if (!have(seq)) continue;
+            const std::string &pkt = _slots[seq % kSlots].pkt;
+            if (pkt.size() + 2 > L) return;//与校验不符，放弃这一组
+            uint8_t lenBytes[2];
+            put16(lenBytes, static_cast<uint16_t>(pkt.size()));
+            uint8_t c = Fec::coefficient(rows[a], i);
+            Fec::mulAdd(s, lenBytes, c, 2);
+            Fec::mulAdd(s + 2, reinterpret_cast<const uint8_t *>(pkt.data()), c, pkt.size());
+        }
+    }
+
+    // 解 e 元方程组：A[a][b] = coef(rows[a], missing[b])，Gauss-Jordan 求逆
+    uint8_t A[Fec::kMaxParity][Fec::kMaxParity];
+    uint8_t B[Fec::kMaxParity][Fec::kMaxParity] = {};
+    for (int a = 0; a < e; ++a) {
+        for (int b = 0; b < e; ++b) A[a][b] = Fec::coefficient(rows[a], missing[b]);
+        B[a][a] = 1;
+    }
+    for (int col = 0; col < e; ++col) {
+        int pivot = col;
+        while (pivot < e && A[pivot][col] == 0) ++pivot;
+        if (pivot == e) return;//Cauchy 子式不会奇异，防御
+        if (pivot != col) {
+            for (int b = 0; b < e; ++b) {
+                std::swap(A[pivot][b], A[col][b]);
+                std::swap(B[pivot][b], B[col][b]);
+            }
+        }
+        uint8_t f = Fec::inv(A[col][col]);
+        for (int b = 0; b < e; ++b) {
+            A[col][b] = Fec::mul(A[col][b], f);
+            B[col][b] = Fec::mul(B[col][b], f);
+        }
+        for (int a = 0; a < e; ++a) {
+            if (a == col || A[a][col] == 0) continue;
+            uint8_t g2 = A[a][col];
+            for (int b = 0; b < e; ++b) {
+                A[a][b] ^= Fec::mul(g2, A[col][b]);
+                B[a][b] ^= Fec::mul(g2, B[col][b]);
+            }
+        }
+    }
+    for (int b = 0; b < e; ++b) {
+        for (int a = 0; a < e; ++a) {
+            Fec::mulAdd(out + b * L, syndrome + a * L, B[b][a], L);
+        }
+    }
+
+    g.done = true;
+    for (int b = 0; b < e; ++b) {
+        const uint8_t *block = out + b * L;
+        size_t len = get16(block);
+        uint16_t seq = static_cast<uint16_t>(g.base + missing[b]);
+        if (len < 12 || len + 2 > L || (block[2] & 0xC0) != 0x80 || get16(block + 4) != seq) {
+            LOG_WARN("FecDecoder: bad recovered packet seq=%u len=%zu", seq, len);
+            continue;
+        }
+        ++_stats.recovered;
+        const char *pkt = reinterpret_cast<const char *>(block + 2);
+        store(seq, pkt, len);
+        _packetCb(pkt, len, true);
+    }
+}
+
+void FecDecoder::retire(const Group &g) {
+    if (g.done) {
+        return;
+    }
+    for (int i = 0; i < g.k; ++i) {
+        if (!have(static_cast<uint16_t>(g.base + i))) ++_stats.unrecovered;
+    }
+}
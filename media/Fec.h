@@ -0,0 +1,122 @@
+#ifndef __FEC_H__
+#define __FEC_H__
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+// 摄像头 -> 服务器的前向纠错（代替 KCP 重传的传输方式，RECORD 带 "Fec: 1" 头选用）。
+// 每 k 个 RTP 包一组，附 m 个校验包，组内任意丢 m 个以内都能恢复：
+//   - 校验系数取 GF(2^8) 上的 Cauchy 矩阵，按列缩放使第 0 行全为 1，
+//     所以 m=1 就是逐字节 XOR，m>1 是 Reed-Solomon（任意方阵子式非奇异，MDS）
+//   - 每个数据包按 [长度高字节, 长度低字节, RTP包..., 补零] 对齐到组内最长，长度一起受保护
+// 数据包原样发送（普通 RTP），校验包是 PT=kPayloadType 的 RTP 包，与数据包走同一个端口：
+//   RTP头(12) | 组首序号(2) | k(1) | m(1) | 行号(1) | 保留(1) | 块长度(2) | 校验数据(块长度)
+// 摄像头侧的 C 实现在 camera/fec.c，两边的系数和包格式必须一致
+class Fec {
+public:
+    static const uint8_t kPayloadType = 100;
+    static const int kMaxData = 32;         // k 的上限
+    static const int kMaxParity = 4;        // m 的上限
+    static const size_t kHeaderLen = 8;     // 紧跟在 RTP 头后面
+
+    static uint8_t mul(uint8_t a, uint8_t b);
+    static uint8_t inv(uint8_t a);
+    // 第 row 个校验包里第 col 个数据包的系数
+    static uint8_t coefficient(int row, int col);
+    // dst ^= c * src
+    static void mulAdd(uint8_t *dst, const uint8_t *src, uint8_t c, size_t n);
+
+    // 按接收端报告的丢包比例（RTCP RR 的 fraction lost，x256）选组大小和校验个数
+    static void paramsForLoss(uint8_t fractionLost, int &k, int &m);
+};
+
+// 发送端：逐包累加进 m 个校验块，凑满 k 个或调用 flush 时输出校验包。
+// 测试程序和以后服务器转发用，摄像头用的是 camera/fec.c
+class FecEncoder {
+public:
+    using PacketCallback = std::function<void(const uint8_t *data, size_t len)>;
+
+    FecEncoder(int k, int m);
+
+    void setOutput(PacketCallback &&cb) { _output = std::move(cb); }
+    // 下一组起生效
+    void setParams(int k, int m);
+    // 数据包已经由调用方发出，这里只计入校验
+    void add(const uint8_t *rtp, size_t len);
+    // 组没凑满也输出校验（组首包等待太久时）
+    void flush();
+    size_t pending() const { return _count; }
+
+private:
+    PacketCallback _output;
+    int _k, _m;
+    int _nextK, _nextM;
+    size_t _count;
+    uint16_t _baseSeq;
+    uint16_t _fecSeq;
+    uint32_t _ssrc, _timestamp;
+    size_t _blockLen;                       // 组内最长的块
+    std::vector<std::vector<uint8_t>> _parity;
+    std::vector<uint8_t> _block;
+    std::string _packet;
+};
+
+// 接收端：数据包直接放出并留一份，收到校验包后恢复组内缺的包，恢复出来的也从同一个回调放出
+// （顺序由后面的 RtpJitterBuffer 整理）。只在摄像头所在 loop 线程里使用
+class FecDecoder {
+public:
+    struct Stats {
+        uint64_t data = 0;                  // 收到的数据包
+        uint64_t parity = 0;
+        uint64_t recovered = 0;
+        uint64_t unrecovered = 0;           // 组已经过期仍缺的数据包
+        uint64_t groups = 0;
+    };
+    using PacketCallback = std::function<void(const char *data, size_t len, bool recovered)>;
+
+    FecDecoder();
+
+    void setPacketCallback(PacketCallback &&cb) { _packetCb = std::move(cb); }
+    void input(const char *data, size_t len);
+    const Stats &stats() const { return _stats; }
+
+private:
+    static const size_t kSlots = 1024;      // 留存的数据包序号窗口
+    static const size_t kMaxGroups = 32;
+
+    struct Slot {
+        bool valid = false;
+        uint16_t seq = 0;
+        std::string pkt;
+    };
+    struct Group {
+        uint16_t base;
+        int k, m;
+        size_t blockLen;
+        int received;                       // 组内已有的数据包
+        uint32_t parityMask;
+        std::vector<std::string> parity;
+        bool done;
+    };
+
+    bool have(uint16_t seq) const {
+        const Slot &s = _slots[seq % kSlots];
+        return s.valid && s.seq == seq;
+    }
+    void store(uint16_t seq, const char *data, size_t len);
+    void onParity(const uint8_t *p, size_t len);
+    Group *findGroup(uint16_t seq);
+    void tryRecover(Group &g);
+    void retire(const Group &g);
+
+    PacketCallback _packetCb;
+    std::vector<Slot> _slots;
+    std::vector<Group> _groups;             // 按到达顺序，最旧的在前
+    std::vector<uint8_t> _work;
+    Stats _stats;
+};
+
+#endif
@@ -0,0 +1,368 @@
+#include "Fmp4Muxer.h"
+
+namespace {
+
+// 大端写盒子，begin 先占位长度，end 回填
+class BoxWriter {
+public:
+    explicit BoxWriter(std::string &out) : _out(out) {}
+
+    void u8(uint32_t v) { _out.push_back(static_cast<char>(v)); }
+    void u16(uint32_t v) { u8(v >> 8); u8(v); }
+    void u24(uint32_t v) { u8(v >> 16); u16(v); }
+    void u32(uint32_t v) { u16(v >> 16); u16(v); }
+    void u64(uint64_t v) { u32(static_cast<uint32_t>(v >> 32)); u32(static_cast<uint32_t>(v)); }
+    void bytes(const char *data, size_t len) { _out.append(data, len); }
+    void zeros(size_t n) { _out.append(n, '\0'); }
+
+    size_t begin(const char *type) {
+        size_t start = _out.size();
+        u32(0);
+        bytes(type, 4);
+        return start;
+    }
+    // FullBox：version + flags
+    size_t begin(const char *type, uint8_t version, uint32_t flags) {
+        size_t start = begin(type);
+        u8(version);
+        u24(flags);
+        return start;
+    }
+    void end(size_t start) {
+        uint32_t size = static_cast<uint32_t>(_out.size() - start);
+        _out[start] = static_cast<char>(size >> 24);
+        _out[start + 1] = static_cast<char>(size >> 16);
+        _out[start + 2] = static_cast<char>(size >> 8);
+        _out[start + 3] = static_cast<char>(size);
+    }
+    size_t size() const { return _out.size(); }
+
+private:
+    std::string &_out;
+};
+
+// 去掉防竞争字节（00 00 03）后按位读 SPS
+class BitReader {
+public:
+    explicit BitReader(const std::string &nal) : _pos(0) {
+        _rbsp.reserve(nal.size());
+        int zeros = 0;
+        for (size_t i = 1; i < nal.size(); ++i) {      // 跳过 NAL 头
+            uint8_t c = static_cast<uint8_t>(nal[i]);
+            if (zeros >= 2 && c == 3) {
+                zeros = 0;
+                continue;
+            }
+            zeros = c == 0 ? zeros + 1 : 0;
+            _rbsp.push_back(static_cast<char>(c));
+        }
+    }
+    bool ok() const { return _pos <= _rbsp.size() * 8; }
+    uint32_t bit() {
+        size_t byte = _pos >> 3;
+        uint32_t v = byte < _rbsp.size() ? (uint8_t(_rbsp[byte]) >> (7 - (_pos & 7))) & 1 : 0;
+        ++_pos;
+        return v;
+    }
+    uint32_t bits(int n) {
+        uint32_t v = 0;
+        while (n-- > 0) v = (v << 1) | bit();
+        return v;
+    }
+    uint32_t ue() {
+        int zeros = 0;
+        while (bit() == 0) {
+            if (++zeros > 31 || !ok()) return 0;
+        }
+        return ((1u << zeros) - 1) + bits(zeros);
+    }
+    int32_t se() {
+        uint32_t v = ue();
+        return (v & 1) ? static_cast<int32_t>((v + 1) / 2) : -static_cast<int32_t>(v / 2);
+    }
+
+private:
+    std::string _rbsp;
+    size_t _pos;
+};
+
+} // namespace
+
+static void skipScalingList(BitReader &br, int size) {
+    int last = 8, next = 8;
+    for (int j = 0; j < size; ++j) {
+        if (next != 0) {
+            next = (last + br.se() + 256) % 256;
+        }
+        last = next == 0 ? last : next;
+    }
+}
+
+bool Fmp4Muxer::parseSps(const std::string &sps, SpsInfo &info) {
+    if (sps.size() < 4 || (sps[0] & 0x1F) != 7) return false;
+    BitReader br(sps);
+    info.profile = br.bits(8);
+    br.bits(16);                                        // constraint flags + level
+    br.ue();                                            // seq_parameter_set_id
+    info.chromaFormat = 1;
+    info.bitDepthLuma = info.bitDepthChroma = 8;
+    int p = info.profile;
+    if (p == 100 || p == 110 || p == 122 || p == 244 || p == 44 || p == 83 ||
+        p == 86 || p == 118 || p == 128 || p == 138 || p == 139 || p == 134 || p == 135) {
+        info.chromaFormat = br.ue();
+        if (info.chromaFormat == 3) br.bit();          // separate_colour_plane_flag
+        info.bitDepthLuma = br.ue() + 8;
+        info.bitDepthChroma = br.ue() + 8;
+        br.bit();                                       // qpprime_y_zero_transform_bypass_flag
+        if (br.bit()) {                                 // seq_scaling_matrix_present_flag
+            int lists = info.chromaFormat != 3 ? 8 : 12;
+            for (int i = 0; i < lists; ++i) {
+                if (br.bit()) skipScalingList(br, i < 6 ? 16 : 64);
+            }
+        }
+    }
+    br.ue();                                            // log2_max_frame_num_minus4
+    uint32_t pocType = br.ue();
+    if (pocType == 0) {
+        br.ue();
+    } else if (pocType == 1) {
+        br.bit();
+        br.se();
+        br.se();
+        uint32_t n = br.ue();
+        for (uint32_t i = 0; i < n && br.ok(); ++i) br.se();
+    }
+    br.ue();                                            // max_num_ref_frames
+    br.bit();                                           // gaps_in_frame_num_value_allowed_flag
+    uint32_t widthMbs = br.ue() + 1;
+    uint32_t heightMaps = br.ue() + 1;
+    uint32_t frameMbsOnly = br.bit();
+    if (!frameMbsOnly) br.bit();                        // mb_adaptive_frame_field_flag
+    br.bit();                                           // direct_8x8_inference_flag
+    uint32_t cropLeft = 0, cropRight = 0, cropTop = 0, cropBottom = 0;
+    if (br.bit()) {
+        cropLeft = br.ue();
+        cropRight = br.ue();
+        cropTop = br.ue();
+        cropBottom = br.ue();
+    }
+    if (!br.ok()) return false;
+    uint32_t cropX = info.chromaFormat == 1 || info.chromaFormat == 2 ? 2 : 1;
+    uint32_t cropY = (info.chromaFormat == 1 ? 2 : 1) * (2 - frameMbsOnly);
+    info.width = widthMbs * 16 - (cropLeft + cropRight) * cropX;
+    info.height = (2 - frameMbsOnly) * heightMaps * 16 - (cropTop + cropBottom) * cropY;
+    return true;
+}
+
+Fmp4Muxer::Fmp4Muxer()
+:_sequence(0)
+,_decodeTime(0){
+}
+
+bool Fmp4Muxer::reset(const std::string &sps, const std::string &pps) {
+    if (!parseSps(sps, _info) || pps.empty()) return false;
+    _sps = sps;
+    _pps = pps;
+    _samples.clear();
+    _mdat.clear();
+    _sequence = 0;
+    _decodeTime = 0;
+    return true;
+}
+
+static const uint32_t kMatrix[9] = {0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000};
+
+void Fmp4Muxer::writeInit(std::string &out) const {
+    BoxWriter w(out);
+    size_t ftyp = w.begin("ftyp");
+    w.bytes("iso5", 4);
+    w.u32(512);
+    w.bytes("iso5iso6avc1mp41", 16);
+    w.end(ftyp);
+
+    size_t moov = w.begin("moov");
+    size_t mvhd = w.begin("mvhd", 0, 0);
+    w.u32(0);                                           // creation_time
+    w.u32(0);                                           // modification_time
+    w.u32(1000);                                        // timescale
+    w.u32(0);                                           // duration，分片文件为 0
+    w.u32(0x00010000);                                  // rate
+    w.u16(0x0100);                                      // volume
+    w.zeros(10);
+    for (uint32_t m : kMatrix) w.u32(m);
+    w.zeros(24);                                        // pre_defined
+    w.u32(2);                                           // next_track_ID
+    w.end(mvhd);
+
+    size_t trak = w.begin("trak");
+    size_t tkhd = w.begin("tkhd", 0, 3);                // enabled | in_movie
+    w.u32(0);
+    w.u32(0);
+    w.u32(1);                                           // track_ID
+    w.u32(0);
+    w.u32(0);                                           // duration
+    w.zeros(8);
+    w.u16(0);                                           // layer
+    w.u16(0);                                           // alternate_group
+    w.u16(0);                                           // volume
+    w.u16(0);
+    for (uint32_t m : kMatrix) w.u32(m);
+    w.u32(_info.width << 16);
+    w.u32(_info.height << 16);
+    w.end(tkhd);
+
+    size_t mdia = w.begin("mdia");
+    size_t mdhd = w.begin("mdhd", 0, 0);
+    w.u32(0);
+    w.u32(0);
+    w.u32(kTimescale);
+    w.u32(0);
+    w.u16(0x55C4);                                      // language: und
+    w.u16(0);
+    w.end(mdhd);
+    size_t hdlr = w.begin("hdlr", 0, 0);
+    w.u32(0);
+    w.bytes("vide", 4);
+    w.zeros(12);
+    w.bytes("VideoHandler", 13);
+    w.end(hdlr);
+
+    size_t minf = w.begin("minf");
+    size_t vmhd = w.begin("vmhd", 0, 1);
+    w.zeros(8);                                         // graphicsmode + opcolor
+    w.end(vmhd);
+    size_t dinf = w.begin("dinf");
+    size_t dref = w.begin("dref", 0, 0);
+    w.u32(1);
+    size_t url = w.begin("url ", 0, 1);                 // 数据在本文件内
+    w.end(url);
+    w.end(dref);
+    w.end(dinf);
+
+    size_t stbl = w.begin("stbl");
+    size_t stsd = w.begin("stsd", 0, 0);
+    w.u32(1);
+    size_t avc1 = w.begin("avc1");
+    w.zeros(6);
+    w.u16(1);                                           // data_reference_index
+    w.zeros(16);
+    w.u16(_info.width);
+    w.u16(_info.height);
+    w.u32(0x00480000);                                  // 72 dpi
+    w.u32(0x00480000);
+    w.u32(0);
+    w.u16(1);                                           // frame_count
+    w.zeros(32);                                        // compressorname
+    w.u16(0x0018);                                      // depth
+    w.u16(0xFFFF);                                      // pre_defined = -1
+    size_t avcC = w.begin("avcC");
+    w.u8(1);
+    w.u8(static_cast<uint8_t>(_sps[1]));                // profile
+    w.u8(static_cast<uint8_t>(_sps[2]));                // compatibility
+    w.u8(static_cast<uint8_t>(_sps[3]));                // level
+    w.u8(0xFF);                                         // NAL 长度 4 字节
+    w.u8(0xE1);                                         // 1 个 SPS
+    w.u16(static_cast<uint32_t>(_sps.size()));
+    w.bytes(_sps.data(), _sps.size());
+    w.u8(1);
+    w.u16(static_cast<uint32_t>(_pps.size()));
+    w.bytes(_pps.data(), _pps.size());
+    int p = _info.profile;
+    if (p == 100 || p == 110 || p == 122 || p == 144 || p == 244) {
+        w.u8(0xFC | _info.chromaFormat);
+        w.u8(0xF8 | (_info.bitDepthLuma - 8));
+        w.u8(0xF8 | (_info.bitDepthChroma - 8));
+        w.u8(0);                                        // numOfSequenceParameterSetExt
+    }
+    w.end(avcC);
+    w.end(avc1);
+    w.end(stsd);
+    // 样本表为空，样本都在分片里
+    size_t stts = w.begin("stts", 0, 0);
+    w.u32(0);
+    w.end(stts);
+    size_t stsc = w.begin("stsc", 0, 0);
+    w.u32(0);
+    w.end(stsc);
+    size_t stsz = w.begin("stsz", 0, 0);
+    w.u32(0);
+    w.u32(0);
+    w.end(stsz);
+    size_t stco = w.begin("stco", 0, 0);
+    w.u32(0);
+    w.end(stco);
+    w.end(stbl);
+    w.end(minf);
+    w.end(mdia);
+    w.end(trak);
+
+    size_t mvex = w.begin("mvex");
+    size_t trex = w.begin("trex", 0, 0);
+    w.u32(1);                                           // track_ID
+    w.u32(1);                                           // default_sample_description_index
+    w.u32(0);
+    w.u32(0);
+    w.u32(0);
+    w.end(trex);
+    w.end(mvex);
+    w.end(moov);
+}
+
+void Fmp4Muxer::addSample(const char *data, size_t size, bool key) {
+    _samples.push_back(Sample{0, static_cast<uint32_t>(size), key});
+    _mdat.append(data, size);
+}
+
+void Fmp4Muxer::setLastDuration(uint32_t duration) {
+    if (!_samples.empty()) _samples.back().duration = duration;
+}
+
+uint64_t Fmp4Muxer::fragmentDuration() const {
+    uint64_t d = 0;
+    for (const Sample &s : _samples) d += s.duration;
+    return d;
+}
+
+void Fmp4Muxer::writeFragmentHeader(std::string &out) {
+    if (_samples.empty()) return;
+    BoxWriter w(out);
+    size_t moof = w.begin("moof");
+    size_t mfhd = w.begin("mfhd", 0, 0);
+    w.u32(++_sequence);
+    w.end(mfhd);
+    size_t traf = w.begin("traf");
+    size_t tfhd = w.begin("tfhd", 0, 0x020000);         // default-base-is-moof
+    w.u32(1);
+    w.end(tfhd);
+    size_t tfdt = w.begin("tfdt", 1, 0);
+    w.u64(_decodeTime);
+    w.end(tfdt);
+    // data-offset | sample-duration | sample-size | sample-flags
+    size_t trun = w.begin("trun", 0, 0x000701);
+    w.u32(static_cast<uint32_t>(_samples.size()));
+    size_t dataOffset = w.size();
+    w.u32(0);
+    for (const Sample &s : _samples) {
+        w.u32(s.duration);
+        w.u32(s.size);
+        // 关键帧：不依赖其他帧；其余：依赖其他帧且非同步样本
+        w.u32(s.key ? 0x02000000 : 0x01010000);
+        _decodeTime += s.duration;
+    }
+    w.end(trun);
+    w.end(traf);
+    w.end(moof);
+    uint32_t offset = static_cast<uint32_t>(w.size() - moof + 8);  // moof 开头到 mdat 负载
+    out[dataOffset] = static_cast<char>(offset >> 24);
+    out[dataOffset + 1] = static_cast<char>(offset >> 16);
+    out[dataOffset + 2] = static_cast<char>(offset >> 8);
+    out[dataOffset + 3] = static_cast<char>(offset);
+
+    w.u32(static_cast<uint32_t>(_mdat.size() + 8));
+    w.bytes("mdat", 4);
+}
+
+void Fmp4Muxer::clearFragment() {
+    _samples.clear();
+    _mdat.clear();
+}
@@ -0,0 +1,67 @@
+#ifndef __FMP4MUXER_H__
+#define __FMP4MUXER_H__
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+// 单路 H.264 视频的分片 MP4（ISO BMFF fragmented）封装，只生成字节，不碰文件。
+// 文件布局：ftyp + moov（不含样本表，mvex 声明分片）后接若干 moof + mdat，
+// 时间刻度直接用 RTP 的 90kHz。每个分片的样本先攒在内存里，写出时 moof 在前、mdat 在后
+class Fmp4Muxer {
+public:
+    static const uint32_t kTimescale = 90000;
+
+    struct SpsInfo {
+        int profile = 0;
+        int chromaFormat = 1;
+        int bitDepthLuma = 8;
+        int bitDepthChroma = 8;
+        uint32_t width = 0;
+        uint32_t height = 0;
+    };
+    // 解析 SPS（NAL 头起），取宽高等封装头需要的字段
+    static bool parseSps(const std::string &sps, SpsInfo &info);
+
+    Fmp4Muxer();
+
+    // 新文件开始：设参数集并把分片序号、解码时间归零
+    bool reset(const std::string &sps, const std::string &pps);
+    // ftyp + moov
+    void writeInit(std::string &out) const;
+
+    // 追加一帧（AVCC），时长在下一帧到来时由 setLastDuration 补上
+    void addSample(const char *data, size_t size, bool key);
+    void setLastDuration(uint32_t duration);
+    // 没写进文件的帧：只推进解码时间
+    void skip(uint32_t duration) { _decodeTime += duration; }
+    // 当前分片的 moof 和 mdat 头写到 out，mdat 负载就是 payload()，不再拷贝一次；
+    // 两者都写出后调用 clearFragment 开始下一个分片
+    void writeFragmentHeader(std::string &out);
+    const std::string &payload() const { return _mdat; }
+    void clearFragment();
+
+    size_t sampleCount() const { return _samples.size(); }
+    size_t pendingBytes() const { return _mdat.size(); }
+    uint64_t fragmentDuration() const;      // 当前分片已知的时长（90kHz）
+    uint64_t decodeTime() const { return _decodeTime; }   // 已写出分片的总时长
+    uint32_t width() const { return _info.width; }
+    uint32_t height() const { return _info.height; }
+
+private:
+    struct Sample {
+        uint32_t duration;
+        uint32_t size;
+        bool key;
+    };
+
+    std::string _sps;
+    std::string _pps;
+    SpsInfo _info;
+    std::vector<Sample> _samples;
+    std::string _mdat;
+    uint32_t _sequence;
+    uint64_t _decodeTime;
+};
+
+#endif
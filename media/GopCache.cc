@@ -0,0 +1,95 @@
+#include "GopCache.h"
+
+static const int kNalSei = 6;
+static const int kNalSps = 7;
+static const int kNalPps = 8;
+static const int kNalIdr = 5;
+static const int kNalFuA = 28;
+static const size_t kRtpHeaderLen = 12;
+
+GopCache::GopCache()
+:_bytes(0)
+,_ready(false){
+}
+
+void GopCache::clear() {
+    _gop.clear();
+    _params.clear();
+    _bytes = 0;
+    _ready = false;
+}
+
+size_t GopCache::nalOffset(const std::string &rtp) {
+    if (rtp.size() <= kRtpHeaderLen) return 0;
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(rtp.data());
+    size_t off = kRtpHeaderLen + (p[0] & 0x0F) * 4;   // CSRC
+    if (p[0] & 0x10) {                                 // 扩展头
+        if (rtp.size() < off + 4) return 0;
+        off += 4 + ((p[off + 2] << 8) | p[off + 3]) * 4;
+    }
+    return rtp.size() > off ? off : 0;
+}
+
+int GopCache::nalType(const std::string &rtp, bool *start) {
+    *start = true;
+    size_t off = nalOffset(rtp);
+    if (off == 0) return -1;
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(rtp.data());
+    int type = p[off] & 0x1F;
+    if (type == kNalFuA) {
+        if (rtp.size() <= off + 1) return -1;
+        *start = (p[off + 1] & 0x80) != 0;
+        type = p[off + 1] & 0x1F;
+    }
+    return type;
+}
+
+bool GopCache::isKeyFrameStart(const std::string &rtp) {
+    bool start;
+    int type = nalType(rtp, &start);
+    return type == kNalSps || (type == kNalIdr && start);
+}
+
+void GopCache::onPacket(const BufferPtr &pkt) {
+    bool start;
+    int type = nalType(*pkt, &start);
+    if (type == kNalSps || type == kNalPps || type == kNalSei) {
+        if (type == kNalSps) _sps = pkt;
+        if (type == kNalPps) _pps = pkt;
+        _params.push_back(pkt);
+        return;
+    }
+    if (type == kNalIdr && start) {
+        // 新 GOP：参数集 + IDR 开头；从没见过 SPS/PPS 的话缓存了也解不出来
+        std::vector<BufferPtr> params;
+        params.swap(_params);
+        clear();
+        _ready = _sps && _pps;
+        bool hasSps = false, hasPps = false;
+        for (const BufferPtr &p : params) {
+            bool s;
+            int t = nalType(*p, &s);
+            hasSps |= t == kNalSps;
+            hasPps |= t == kNalPps;
+        }
+        if (!hasSps) append(_sps);
+        if (!hasPps) append(_pps);
+        for (const BufferPtr &p : params) append(p);
+        append(pkt);
+        return;
+    }
+    // 普通报文：前面攒下的参数集不是紧挨 IDR 的，按普通报文顺序补进去
+    for (const BufferPtr &p : _params) append(p);
+    _params.clear();
+    append(pkt);
+}
+
+void GopCache::append(const BufferPtr &pkt) {
+    if (!_ready) return;                    // 还没遇到可用的 IDR，不缓存
+    if (_bytes + pkt->size() > kMaxBytes) {
+        clear();                            // GOP 太大，放弃，等下一个 IDR
+        return;
+    }
+    _gop.push_back(pkt);
+    _bytes += pkt->size();
+}
@@ -0,0 +1,41 @@
+#ifndef __GOPCACHE_H__
+#define __GOPCACHE_H__
+
+#include <vector>
+#include "BufferChain.h"
+
+// 每路流缓存最近一个 GOP：最后的 SPS/PPS + IDR 及其后的全部 RTP 报文。
+// 新订阅者先收到这一段再接实时数据，不必等下一个关键帧。
+// 报文是与分发共用的引用计数数据块，缓存本身不再拷贝；总字节数超过上限时放弃本 GOP，
+// 等下一个 IDR 重新开始
+class GopCache {
+public:
+    static const size_t kMaxBytes = 2 * 1024 * 1024;
+
+    GopCache();
+
+    void onPacket(const BufferPtr &pkt);
+    bool ready() const { return _ready; }
+    const std::vector<BufferPtr> &packets() const { return _gop; }
+    size_t bytes() const { return _bytes; }
+    void clear();
+
+    // RTP 负载中的 H.264 NAL 类型；FU-A 取分片里的原始类型，start 表示首个分片（单包 NAL 恒为 true）
+    static int nalType(const std::string &rtp, bool *start);
+    // 关键帧的开头：SPS，或前面没带 SPS 的 IDR 首个分片；丢包后从这里恢复解码不花屏
+    static bool isKeyFrameStart(const std::string &rtp);
+    // NAL 头在 RTP 包中的偏移（跳过 CSRC 和扩展头），包不完整时返回 0
+    static size_t nalOffset(const std::string &rtp);
+
+private:
+    void append(const BufferPtr &pkt);
+
+    std::vector<BufferPtr> _gop;
+    std::vector<BufferPtr> _params;  // IDR 之前紧挨着的 SPS/PPS/SEI
+    BufferPtr _sps;                  // 最近一次的 SPS/PPS，IDR 前没带时补上
+    BufferPtr _pps;
+    size_t _bytes;
+    bool _ready;                     // 缓存以 IDR 开头且完整
+};
+
+#endif
@@ -0,0 +1,161 @@
+#include "H264Depacketizer.h"
+
+static const size_t kNoNal = std::string::npos;
+
+H264Depacketizer::H264Depacketizer()
+:_nalStart(kNoNal)
+,_timestamp(0)
+,_hasFrame(false)
+,_key(false)
+,_broken(false)
+,_waitKey(false)
+,_started(false)
+,_lastSeq(0)
+,_lost(0)
+,_paramsChanged(false){
+}
+
+bool H264Depacketizer::takeParamsChanged() {
+    bool changed = _paramsChanged;
+    _paramsChanged = false;
+    return changed;
+}
+
+void H264Depacketizer::input(const char *rtp, size_t len) {
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(rtp);
+    if (len < 12 || (p[0] >> 6) != 2) return;
+    size_t off = 12 + (p[0] & 0x0F) * 4;
+    size_t end = len;
+    if (p[0] & 0x10) {                                  // 扩展头
+        if (len < off + 4) return;
+        off += 4 + ((p[off + 2] << 8) | p[off + 3]) * 4;
+    }
+    if (p[0] & 0x20) {                                  // padding
+        if (p[len - 1] > len) return;
+        end -= p[len - 1];
+    }
+    if (off >= end) return;
+    bool marker = (p[1] & 0x80) != 0;
+    uint16_t seq = static_cast<uint16_t>((p[2] << 8) | p[3]);
+    uint32_t ts = (uint32_t(p[4]) << 24) | (uint32_t(p[5]) << 16) | (uint32_t(p[6]) << 8) | p[7];
+
+    bool gap = _started && seq != static_cast<uint16_t>(_lastSeq + 1);
+    if (gap) {
+        _lost += static_cast<uint16_t>(seq - _lastSeq - 1);
+        _broken = true;
+    }
+    _started = true;
+    _lastSeq = seq;
+
+    if (_hasFrame && ts != _timestamp) {
+        emit();
+        _broken = gap;  // 不知道丢的是哪一帧的，前后两帧都不要
+    }
+    if (!_hasFrame) {
+        _hasFrame = true;
+        _timestamp = ts;
+    }
+
+    const char *payload = rtp + off;
+    size_t size = end - off;
+    int type = payload[0] & 0x1F;
+    if (type >= 1 && type <= 23) {
+        addNal(payload, size);
+    } else if (type == 24) {                            // STAP-A
+        size_t pos = 1;
+        while (pos + 2 <= size) {
+            size_t n = (uint8_t(payload[pos]) << 8) | uint8_t(payload[pos + 1]);
+            pos += 2;
+            if (n == 0 || pos + n > size) break;
+            addNal(payload + pos, n);
+            pos += n;
+        }
+    } else if (type == 28 && size >= 2) {               // FU-A
+        uint8_t fuHdr = payload[1];
+        if (fuHdr & 0x80) {
+            if (_nalStart != kNoNal) {                  // 上一个 NAL 没收到结尾
+                _frame.resize(_nalStart);
+                _broken = true;
+            }
+            beginNal(static_cast<uint8_t>((payload[0] & 0xE0) | (fuHdr & 0x1F)));
+        } else if (_nalStart == kNoNal) {
+            _broken = true;                             // 首个分片丢了
+            if (marker) emit();
+            return;
+        }
+        _frame.append(payload + 2, size - 2);
+        if (fuHdr & 0x40) {
+            endNal();
+        }
+    }
+    if (marker) {
+        emit();
+    }
+}
+
+void H264Depacketizer::flush() {
+    if (_hasFrame) emit();
+}
+
+void H264Depacketizer::addNal(const char *nal, size_t len) {
+    int type = nal[0] & 0x1F;
+    if (type == 7 || type == 8) {
+        std::string &dst = type == 7 ? _sps : _pps;
+        if (dst.size() != len || dst.compare(0, len, nal, len) != 0) {
+            dst.assign(nal, len);
+            _paramsChanged = true;
+        }
+        return;
+    }
+    if (type == 9) return;                              // AUD
+    if (type == 5) _key = true;
+    char head[4] = {char(len >> 24), char(len >> 16), char(len >> 8), char(len)};
+    _frame.append(head, 4);
+    _frame.append(nal, len);
+}
+
+void H264Depacketizer::beginNal(uint8_t header) {
+    _nalStart = _frame.size();
+    _frame.append(4, '\0');
+    _frame.push_back(static_cast<char>(header));
+}
+
+void H264Depacketizer::endNal() {
+    size_t start = _nalStart;
+    _nalStart = kNoNal;
+    size_t len = _frame.size() - start - 4;
+    int type = _frame[start + 4] & 0x1F;
+    if (type == 7 || type == 8 || type == 9) {
+        // 很少见的分片参数集：挪出帧
+        std::string nal = _frame.substr(start + 4);
+        _frame.resize(start);
+        addNal(nal.data(), nal.size());
+        return;
+    }
+    if (type == 5) _key = true;
+    _frame[start] = char(len >> 24);
+    _frame[start + 1] = char(len >> 16);
+    _frame[start + 2] = char(len >> 8);
+    _frame[start + 3] = char(len);
+}
+
+void H264Depacketizer::emit() {
+    if (_nalStart != kNoNal) {                          // 末尾 NAL 没收全
+        _frame.resize(_nalStart);
+        _nalStart = kNoNal;
+        _broken = true;
+    }
+    if (_broken) {
+        _waitKey = true;
+    } else if (_waitKey && _key) {
+        _waitKey = false;
+    }
+    if (!_broken && !_waitKey && !_frame.empty() && _frameCb) {
+        Frame frame{_frame.data(), _frame.size(), _timestamp, _key};
+        _frameCb(frame);
+    }
+    _frame.clear();
+    _hasFrame = false;
+    _key = false;
+    _broken = false;
+}
@@ -0,0 +1,58 @@
+#ifndef __H264DEPACKETIZER_H__
+#define __H264DEPACKETIZER_H__
+
+#include <functional>
+#include <string>
+#include <stdint.h>
+
+// RTP(H.264, RFC 6184) -> 访问单元。支持单 NAL、STAP-A、FU-A，
+// 按时间戳/marker 位切分帧，输出 AVCC 格式（每个 NAL 前 4 字节大端长度）。
+// SPS/PPS 不放进帧里，单独记下供封装头使用；AUD 丢弃。
+// 丢包时丢掉残缺的 NAL，同时丢掉本帧直到下一个关键帧，不输出花屏数据
+class H264Depacketizer {
+public:
+    struct Frame {
+        const char *data;       // AVCC，回调返回后失效
+        size_t size;
+        uint32_t timestamp;     // RTP 时间戳，90kHz
+        bool key;               // 含 IDR
+    };
+    using FrameCallback = std::function<void(const Frame &)>;
+
+    H264Depacketizer();
+
+    void setFrameCallback(FrameCallback &&cb) { _frameCb = std::move(cb); }
+    void input(const char *rtp, size_t len);
+    // 输出还在组装的帧（流结束时调用）
+    void flush();
+
+    const std::string &sps() const { return _sps; }
+    const std::string &pps() const { return _pps; }
+    // 上次调用以来 SPS/PPS 是否变过
+    bool takeParamsChanged();
+
+    uint64_t lostPackets() const { return _lost; }
+
+private:
+    void addNal(const char *nal, size_t len);
+    void beginNal(uint8_t header);
+    void endNal();
+    void emit();
+
+    FrameCallback _frameCb;
+    std::string _frame;         // 组装中的帧
+    size_t _nalStart;           // FU-A 组装中的 NAL 在 _frame 里的起点（长度字段处），npos 表示没有
+    uint32_t _timestamp;
+    bool _hasFrame;
+    bool _key;
+    bool _broken;               // 本帧有丢失
+    bool _waitKey;              // 丢包后等关键帧
+    bool _started;
+    uint16_t _lastSeq;
+    uint64_t _lost;
+    std::string _sps;
+    std::string _pps;
+    bool _paramsChanged;
+};
+
+#endif
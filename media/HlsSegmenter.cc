@@ -0,0 +1,272 @@
+#include "HlsSegmenter.h"
+#include "Logger.h"
+#include <stdarg.h>
+#include <stdio.h>
+
+HlsSegmenter::Options &HlsSegmenter::options() {
+    static Options options;
+    return options;
+}
+
+HlsSegmenter::HlsSegmenter(const std::string &streamName, const Options &options)
+:_name(streamName)
+,_options(options)
+,_initId(0)
+,_started(false)
+,_discontinuity(false)
+,_partIndependent(false)
+,_lastTs(0)
+,_lastDuration(0)
+,_hasLast(false)
+,_segmentDuration(0)
+,_nextMsn(0)
+,_discontinuitySeq(0)
+,_targetDuration((options.segmentMs + 999) / 1000)
+,_closed(false){
+    _depacketizer.setFrameCallback([this](const H264Depacketizer::Frame &frame) {
+        onFrame(frame);
+    });
+}
+
+HlsSegmenter::~HlsSegmenter() {
+    close();
+}
+
+void HlsSegmenter::onRtp(const char *data, size_t len) {
+    _depacketizer.input(data, len);
+}
+
+void HlsSegmenter::close() {
+    std::vector<Pending> waiters;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _closed = true;
+        waiters.swap(_waiters);
+    }
+    for (Pending &p : waiters) {
+        p.waiter();//请求方重新查找，得到 404
+    }
+}
+
+void HlsSegmenter::onFrame(const H264Depacketizer::Frame &frame) {
+    if (!_started && !frame.key) {
+        return;//等第一个关键帧
+    }
+    if (_hasLast && _muxer.sampleCount() > 0) {
+        // 上一帧的时长到这一帧才知道，与 Mp4Recorder 相同的处理
+        uint32_t duration = frame.timestamp - _lastTs;
+        if (duration == 0 || duration > 10 * Fmp4Muxer::kTimescale) {
+            duration = _lastDuration ? _lastDuration : Fmp4Muxer::kTimescale / 25;
+        }
+        _muxer.setLastDuration(duration);
+        _lastDuration = duration;
+    }
+    _lastTs = frame.timestamp;
+    _hasLast = true;
+
+    bool paramsChanged = frame.key && _depacketizer.takeParamsChanged();
+    if (frame.key && _started) {
+        uint64_t duration = _segmentDuration + _muxer.fragmentDuration();
+        if (paramsChanged || duration * 1000 >= uint64_t(_options.segmentMs) * Fmp4Muxer::kTimescale) {
+            flushPart();
+            finishSegment();//新分段从这个关键帧开始
+        }
+    }
+    // 再加一帧就超过 PART-TARGET 时先把已有的帧作为一个 part 发布
+    if (_muxer.sampleCount() > 0 &&
+        (_muxer.fragmentDuration() + _lastDuration) * 1000 > uint64_t(_options.partMs) * Fmp4Muxer::kTimescale) {
+        flushPart();
+    }
+    if (!_started || paramsChanged) {
+        if (!_muxer.reset(_depacketizer.sps(), _depacketizer.pps())) {
+            _hasLast = false;
+            return;//还没收到参数集
+        }
+        std::string init;
+        _muxer.writeInit(init);
+        _init = std::make_shared<const std::string>(std::move(init));
+        _discontinuity = _started;
+        ++_initId;
+        _started = true;
+        LOG_INFO("HlsSegmenter %s: %ux%u, init%u", _name.c_str(), _muxer.width(), _muxer.height(), _initId);
+    }
+    if (_muxer.sampleCount() == 0) {
+        _partIndependent = frame.key;
+    }
+    _muxer.addSample(frame.data, frame.size, frame.key);
+}
+
+void HlsSegmenter::flushPart() {
+    if (_muxer.sampleCount() == 0) return;
+    uint32_t duration = static_cast<uint32_t>(_muxer.fragmentDuration());
+    _header.clear();
+    _muxer.writeFragmentHeader(_header);
+    const std::string &payload = _muxer.payload();
+    std::string data;
+    data.reserve(_header.size() + payload.size());
+    data.append(_header).append(payload);
+    _muxer.clearFragment();
+    _segmentDuration += duration;
+
+    Part part = {std::make_shared<const std::string>(std::move(data)), duration, _partIndependent};
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_segments.empty() || _segments.back().complete) {
+            Segment segment = {_nextMsn++, _initId, _init, {}, 0, _discontinuity, false};
+            _segments.push_back(std::move(segment));
+            _discontinuity = false;
+        }
+        _segments.back().parts.push_back(std::move(part));
+        _segments.back().duration += duration;
+    }
+    wakeReached();
+}
+
+void HlsSegmenter::finishSegment() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_segments.empty() || _segments.back().complete) return;
+        Segment &segment = _segments.back();
+        segment.complete = true;
+        uint32_t seconds = static_cast<uint32_t>((segment.duration + Fmp4Muxer::kTimescale - 1) / Fmp4Muxer::kTimescale);
+        if (seconds > _targetDuration) {
+            _targetDuration = seconds;//关键帧间隔比目标长，只能跟着放宽
+        }
+        while (_segments.size() > _options.windowSegments) {
+            if (_segments.front().discontinuity) ++_discontinuitySeq;
+            _segments.pop_front();
+        }
+    }
+    _segmentDuration = 0;
+    wakeReached();
+}
+
+bool HlsSegmenter::reached(uint64_t msn, uint32_t part) const {
+    if (_segments.empty()) return false;
+    const Segment &last = _segments.back();
+    if (part == kWholeSegment) {
+        return last.complete ? last.msn >= msn : last.msn > msn;
+    }
+    // 分段 msn 完成后，它之后的 part 序号指的是下一个分段的开头
+    return last.msn > msn || (last.msn == msn && last.parts.size() > part);
+}
+
+void HlsSegmenter::wakeReached() {
+    std::vector<Pending> ready;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        size_t keep = 0;
+        for (size_t i = 0; i < _waiters.size(); ++i) {
+            if (reached(_waiters[i].msn, _waiters[i].part)) {
+                ready.push_back(std::move(_waiters[i]));
+            } else {
+                if (keep != i) _waiters[keep] = std::move(_waiters[i]);
+                ++keep;
+            }
+        }
+        _waiters.resize(keep);
+    }
+    for (Pending &p : ready) {
+        p.waiter();
+    }
+}
+
+HlsSegmenter::WaitResult HlsSegmenter::waitFor(uint64_t msn, uint32_t part, Waiter &&waiter) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (reached(msn, part)) {
+        return Reached;
+    }
+    uint64_t latest = _segments.empty() ? 0 : _segments.back().msn;
+    if (_closed || msn > latest + 2) {
+        return Rejected;
+    }
+    _waiters.push_back(Pending{msn, part, std::move(waiter)});
+    return Waiting;
+}
+
+static void appendf(std::string &out, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void appendf(std::string &out, const char *fmt, ...) {
+    char line[256];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    if (n > 0) out.append(line, n < (int)sizeof(line) ? n : sizeof(line) - 1);
+}
+
+bool HlsSegmenter::playlist(std::string &out) {
+    const double scale = Fmp4Muxer::kTimescale;
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_segments.empty()) return false;
+    out += "#EXTM3U\n#EXT-X-VERSION:6\n";
+    appendf(out, "#EXT-X-TARGETDURATION:%u\n", _targetDuration);
+    appendf(out, "#EXT-X-PART-INF:PART-TARGET=%.3f\n", _options.partMs / 1000.0);
+    appendf(out, "#EXT-X-SERVER-CONTROL:CAN-BLOCK-RELOAD=YES,PART-HOLD-BACK=%.3f\n",
+            _options.partMs * 3 / 1000.0);
+    appendf(out, "#EXT-X-MEDIA-SEQUENCE:%llu\n", (unsigned long long)_segments.front().msn);
+    if (_discontinuitySeq > 0) {
+        appendf(out, "#EXT-X-DISCONTINUITY-SEQUENCE:%llu\n", (unsigned long long)_discontinuitySeq);
+    }
+    // 只列出最后三个分段（含生成中的）的 part，更早的只需要整段
+    size_t partsFrom = _segments.size() > 3 ? _segments.size() - 3 : 0;
+    uint32_t mapId = 0;
+    for (size_t i = 0; i < _segments.size(); ++i) {
+        const Segment &seg = _segments[i];
+        if (seg.discontinuity) {
+            out += "#EXT-X-DISCONTINUITY\n";
+        }
+        if (seg.initId != mapId) {
+            appendf(out, "#EXT-X-MAP:URI=\"init%u.mp4\"\n", seg.initId);
+            mapId = seg.initId;
+        }
+        if (i >= partsFrom) {
+            for (size_t j = 0; j < seg.parts.size(); ++j) {
+                appendf(out, "#EXT-X-PART:DURATION=%.5f,URI=\"part%llu.%zu.m4s\"%s\n",
+                        seg.parts[j].duration / scale, (unsigned long long)seg.msn, j,
+                        seg.parts[j].independent ? ",INDEPENDENT=YES" : "");
+            }
+        }
+        if (seg.complete) {
+            appendf(out, "#EXTINF:%.5f,\nseg%llu.m4s\n", seg.duration / scale, (unsigned long long)seg.msn);
+        }
+    }
+    const Segment &last = _segments.back();
+    if (last.complete) {
+        appendf(out, "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"part%llu.0.m4s\"\n", (unsigned long long)last.msn + 1);
+    } else {
+        appendf(out, "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"part%llu.%zu.m4s\"\n",
+                (unsigned long long)last.msn, last.parts.size());
+    }
+    return true;
+}
+
+bool HlsSegmenter::findInit(uint32_t id, BufferPtr &out) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const Segment &seg : _segments) {
+        if (seg.initId == id) {
+            out = seg.init;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool HlsSegmenter::findPart(uint64_t msn, uint32_t part, BufferPtr &out) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_segments.empty() || msn < _segments.front().msn || msn > _segments.back().msn) return false;
+    const Segment &seg = _segments[msn - _segments.front().msn];
+    if (part >= seg.parts.size()) return false;
+    out = seg.parts[part].data;
+    return true;
+}
+
+bool HlsSegmenter::findSegment(uint64_t msn, std::vector<BufferPtr> &out) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_segments.empty() || msn < _segments.front().msn || msn > _segments.back().msn) return false;
+    const Segment &seg = _segments[msn - _segments.front().msn];
+    if (!seg.complete) return false;
+    for (const Part &part : seg.parts) {
+        out.push_back(part.data);
+    }
+    return true;
+}
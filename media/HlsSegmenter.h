@@ -0,0 +1,105 @@
+#ifndef __HLSSEGMENTER_H__
+#define __HLSSEGMENTER_H__
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "BufferChain.h"
+#include "Fmp4Muxer.h"
+#include "H264Depacketizer.h"
+
+// 一路流的 LL-HLS 输出：RTP -> 访问单元 -> fMP4 部分分片（part），
+// 若干个 part 组成一个从关键帧开始的分段（segment），最近几个分段留在内存里由 HlsServer 提供。
+// part 封装好后是一块只读数据，part 请求、分段请求都直接引用它发送，不再拷贝。
+// onRtp/close 只在摄像头所在 loop 线程里调用；其余接口在 HTTP 连接所在 loop 上调用，由 _mutex 保护
+class HlsSegmenter {
+public:
+    struct Options {
+        bool enabled = false;
+        uint32_t segmentMs = 2000;      // 分段目标时长，到时长后在下一个关键帧处切
+        uint32_t partMs = 500;          // part 时长上限（PART-TARGET）
+        size_t windowSegments = 6;      // 播放列表保留的完整分段数
+    };
+    static const uint32_t kWholeSegment = UINT32_MAX;
+
+    // 进程级配置，main 里在 loop 启动前设置
+    static Options &options();
+
+    // 阻塞请求的回调：等的 part/分段出现或流结束时在摄像头 loop 线程里调用，只能转交给别的 loop
+    using Waiter = std::function<void()>;
+    enum WaitResult { Reached, Waiting, Rejected };
+
+    HlsSegmenter(const std::string &streamName, const Options &options);
+    ~HlsSegmenter();
+
+    void onRtp(const char *data, size_t len);
+    // 流结束：唤醒所有等待者，之后不再有新内容
+    void close();
+
+    // 播放列表已经包含 msn 分段的第 part 个 part（kWholeSegment 表示整个分段完成）时返回 Reached；
+    // 还没有时登记 waiter 返回 Waiting；msn 超出最新分段 2 个以上或流已结束时返回 Rejected
+    WaitResult waitFor(uint64_t msn, uint32_t part, Waiter &&waiter);
+    // 还没有任何 part 时返回 false
+    bool playlist(std::string &out);
+    bool findInit(uint32_t id, BufferPtr &out);
+    bool findPart(uint64_t msn, uint32_t part, BufferPtr &out);
+    // 只找完整的分段，按顺序给出它的全部 part
+    bool findSegment(uint64_t msn, std::vector<BufferPtr> &out);
+    // 阻塞请求的最长等待，三个分段目标时长
+    uint32_t holdMs() const { return _options.segmentMs * 3; }
+
+private:
+    struct Part {
+        BufferPtr data;             // moof + mdat
+        uint32_t duration;          // 90kHz
+        bool independent;           // 从关键帧开始
+    };
+    struct Segment {
+        uint64_t msn;
+        uint32_t initId;
+        BufferPtr init;
+        std::vector<Part> parts;
+        uint64_t duration;
+        bool discontinuity;         // 参数集变化后的第一个分段
+        bool complete;
+    };
+    struct Pending {
+        uint64_t msn;
+        uint32_t part;
+        Waiter waiter;
+    };
+
+    void onFrame(const H264Depacketizer::Frame &frame);
+    void flushPart();
+    void finishSegment();
+    bool reached(uint64_t msn, uint32_t part) const;   // 持 _mutex 调用
+    void wakeReached();
+
+    std::string _name;
+    Options _options;
+    H264Depacketizer _depacketizer;
+    Fmp4Muxer _muxer;
+    std::string _header;            // moof 缓冲，复用容量
+    BufferPtr _init;                // 当前参数集的 ftyp+moov
+    uint32_t _initId;
+    bool _started;
+    bool _discontinuity;
+    bool _partIndependent;
+    uint32_t _lastTs;
+    uint32_t _lastDuration;
+    bool _hasLast;
+    uint64_t _segmentDuration;      // 当前分段已经写出的 part 时长
+    uint64_t _nextMsn;
+
+    std::mutex _mutex;              // 保护以下成员
+    std::deque<Segment> _segments;  // 最后一个可能还在生成
+    std::vector<Pending> _waiters;
+    uint64_t _discontinuitySeq;     // 移出窗口的 DISCONTINUITY 个数
+    uint32_t _targetDuration;       // 秒，取见过的最长分段向上取整
+    bool _closed;
+};
+
+#endif
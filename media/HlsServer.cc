@@ -0,0 +1,266 @@
+#include "HlsServer.h"
+#include "HlsSegmenter.h"
+#include "DetectionIndex.h"
+#include "StreamRegistry.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+// 查询串里 key=数字 的值
+static bool queryValue(StringPiece query, StringPiece key, unsigned long &value) {
+    while (!query.empty()) {
+        size_t amp = query.find("&");
+        StringPiece item = query.substr(0, amp);
+        size_t eq = item.find("=");
+        if (eq != StringPiece::npos && item.substr(0, eq).equals(key)) {
+            value = item.substr(eq + 1).toULong();
+            return true;
+        }
+        if (amp == StringPiece::npos) break;
+        query = query.substr(amp + 1);
+    }
+    return false;
+}
+
+static bool startsWith(StringPiece s, StringPiece prefix) {
+    return s.len >= prefix.len && memcmp(s.data, prefix.data, prefix.len) == 0;
+}
+
+static bool endsWith(StringPiece s, StringPiece suffix) {
+    return s.len >= suffix.len && memcmp(s.data + s.len - suffix.len, suffix.data, suffix.len) == 0;
+}
+
+HlsServer &HlsServer::instance() {
+    static HlsServer inst;
+    return inst;
+}
+
+void HlsServer::start(const std::vector<EventLoop*> &loops, const std::string &ip, unsigned short port) {
+    if (_started) return;
+    _started = true;
+    for (EventLoop *loop : loops) {
+        _acceptors.emplace_back(new Acceptor(ip, port));
+        _acceptors.back()->ready();
+        Acceptor &acceptor = *_acceptors.back();
+        loop->runInLoop([this, loop, &acceptor]() {
+            setupLoop(loop, acceptor);
+        });
+    }
+    LOG_INFO("HlsServer listening on %s:%u over %zu loops", ip.c_str(), port, loops.size());
+}
+
+void HlsServer::setupLoop(EventLoop *loop, Acceptor &acceptor) {
+    loop->addAcceptor(acceptor, [this, loop](int connfd) {
+        onConnection(loop, connfd);
+    });
+}
+
+void HlsServer::onConnection(EventLoop *loop, int connfd) {
+    TcpConnectionPtr conn(new TcpConnection(loop, connfd));
+    loop->addTcpConnection(conn);
+    HttpClientPtr client = std::make_shared<HttpClient>();
+    client->loop = loop;
+    conn->setMessageCallback([this, client](const TcpConnectionPtr &c) { onMessage(c, client); });
+    conn->setCloseCallback([client](const TcpConnectionPtr &c) {
+        if (!client->blocked.empty()) {
+            client->loop->removeTimer(client->timer);
+            client->blocked.clear();
+            ++client->waitId;//segmenter 上登记的唤醒随后作废
+        }
+        client->queued.clear();
+    });
+}
+
+void HlsServer::onMessage(const TcpConnectionPtr &conn, const HttpClientPtr &client) {
+    const std::vector<RecvItemView> &items = conn->recvItems();
+    for (const RecvItemView &item : items) {
+        if (item.type != RecvItemType::RtspRequest) {
+            continue;
+        }
+        if (!client->blocked.empty()) {
+            client->queued.emplace_back(item.data, item.len);//前一个请求还在等，视图下次就失效了
+        } else {
+            handleRequest(conn, client, item.data, item.len, true);
+        }
+    }
+}
+
+bool HlsServer::handleRequest(const TcpConnectionPtr &conn, const HttpClientPtr &client,
+                              const char *data, size_t len, bool mayBlock) {
+    RtspRequest req;
+    if (req.parse(data, len) != RtspRequest::Complete) {
+        sendStatus(conn, *client, 400);
+        return true;
+    }
+    if (!req.method().equals("GET")) {
+        sendStatus(conn, *client, 405);
+        return true;
+    }
+    // /name/file?query，流名称里可以有 '/'
+    StringPiece url = req.url();
+    size_t q = url.find("?");
+    StringPiece path = url.substr(0, q);
+    StringPiece query = q == StringPiece::npos ? StringPiece() : url.substr(q + 1);
+    size_t slash = path.len;
+    while (slash > 0 && path.data[slash - 1] != '/') --slash;
+    if (slash < 2 || path.data[0] != '/') {
+        sendStatus(conn, *client, 404);
+        return true;
+    }
+    StringPiece name = path.substr(1, slash - 2);
+    StringPiece file = path.substr(slash);
+    StreamFanoutPtr fanout = StreamRegistry::instance().find(name.toString());
+    if (fanout && file.equals("detections.json")) {
+        std::shared_ptr<DetectionIndex> detections = fanout->detections();
+        if (!detections) {
+            sendStatus(conn, *client, 404);
+            return true;
+        }
+        unsigned long since = 0;
+        bool hasSince = queryValue(query, "since", since);
+        client->body.clear();
+        detections->json(client->body, hasSince, static_cast<uint32_t>(since));
+        writeHeader(*client, 200, "application/json", client->body.size(), "no-cache");
+        client->response += client->body;
+        conn->send(client->response);
+        return true;
+    }
+    std::shared_ptr<HlsSegmenter> hls = fanout ? fanout->hls() : nullptr;
+    if (!hls) {
+        sendStatus(conn, *client, 404);
+        return true;
+    }
+
+    if (file.equals("index.m3u8")) {
+        unsigned long msn = 0, part = HlsSegmenter::kWholeSegment;
+        bool blocking = queryValue(query, "_HLS_msn", msn);
+        if (blocking) {
+            queryValue(query, "_HLS_part", part);
+            if (mayBlock) {
+                HlsSegmenter::WaitResult result = wait(conn, client, *hls, msn, static_cast<uint32_t>(part), data, len);
+                if (result == HlsSegmenter::Rejected) {
+                    sendStatus(conn, *client, 400);//超前太多
+                    return true;
+                } else if (result == HlsSegmenter::Waiting) {
+                    return false;
+                }
+            }
+        }
+        client->body.clear();
+        if (!hls->playlist(client->body)) {
+            sendStatus(conn, *client, 404);//还没有第一个 part
+            return true;
+        }
+        // 阻塞请求的应答对应确定的一版播放列表，可以交给 CDN 缓存
+        writeHeader(*client, 200, "application/vnd.apple.mpegurl", client->body.size(),
+                    blocking ? "max-age=60" : "no-cache");
+        client->response += client->body;
+        conn->send(client->response);
+        return true;
+    }
+
+    BufferPtr buf;
+    if (startsWith(file, "init") && endsWith(file, ".mp4")) {
+        if (hls->findInit(static_cast<uint32_t>(file.substr(4).toULong()), buf)) {
+            writeHeader(*client, 200, "video/mp4", buf->size(), "max-age=3600");
+            conn->send(client->response.data(), client->response.size(), buf, 0, buf->size());
+        } else {
+            sendStatus(conn, *client, 404);
+        }
+    } else if (startsWith(file, "seg") && endsWith(file, ".m4s")) {
+        std::vector<BufferPtr> parts;
+        if (hls->findSegment(file.substr(3).toULong(), parts)) {
+            size_t total = 0;
+            for (const BufferPtr &p : parts) total += p->size();
+            writeHeader(*client, 200, "video/mp4", total, "max-age=3600");
+            conn->send(client->response.data(), client->response.size(), parts[0], 0, parts[0]->size());
+            for (size_t i = 1; i < parts.size(); ++i) {
+                conn->send(parts[i], 0, parts[i]->size());
+            }
+        } else {
+            sendStatus(conn, *client, 404);
+        }
+    } else if (startsWith(file, "part") && endsWith(file, ".m4s")) {
+        StringPiece id = file.substr(4);
+        size_t dot = id.find(".");
+        uint64_t msn = id.toULong();
+        uint32_t part = static_cast<uint32_t>(id.substr(dot + 1).toULong());
+        if (hls->findPart(msn, part, buf)) {
+            writeHeader(*client, 200, "video/mp4", buf->size(), "max-age=3600");
+            conn->send(client->response.data(), client->response.size(), buf, 0, buf->size());
+        } else if (mayBlock) {
+            // 预加载提示的下一个 part：等它生成；刚好生成了就重新查一次
+            HlsSegmenter::WaitResult result = wait(conn, client, *hls, msn, part, data, len);
+            if (result == HlsSegmenter::Waiting) {
+                return false;
+            }
+            return handleRequest(conn, client, data, len, false);
+        } else {
+            sendStatus(conn, *client, 404);
+        }
+    } else {
+        sendStatus(conn, *client, 404);
+    }
+    return true;
+}
+
+HlsSegmenter::WaitResult HlsServer::wait(const TcpConnectionPtr &conn, const HttpClientPtr &client,
+                                         HlsSegmenter &hls, uint64_t msn, uint32_t part,
+                                         const char *data, size_t len) {
+    uint64_t id = ++client->waitId;
+    std::weak_ptr<TcpConnection> weak(conn);
+    EventLoop *loop = client->loop;
+    HlsSegmenter::WaitResult result = hls.waitFor(msn, part, [this, loop, weak, client, id]() {
+        // 在摄像头的 loop 线程里被调用，转回连接所在的 loop
+        loop->runInLoop([this, weak, client, id]() {
+            if (TcpConnectionPtr c = weak.lock()) {
+                resume(c, client, id, false);
+            }
+        });
+    });
+    if (result == HlsSegmenter::Waiting) {
+        client->blocked.assign(data, len);
+        client->timer = loop->addOneTimer(static_cast<int>(hls.holdMs()), [this, weak, client, id]() {
+            if (TcpConnectionPtr c = weak.lock()) {
+                resume(c, client, id, true);
+            }
+        });
+    }
+    return result;
+}
+
+void HlsServer::resume(const TcpConnectionPtr &conn, const HttpClientPtr &client, uint64_t waitId, bool timedOut) {
+    if (client->blocked.empty() || waitId != client->waitId) {
+        return;//已经由另一方处理过
+    }
+    if (!timedOut) {
+        client->loop->removeTimer(client->timer);
+    }
+    ++client->waitId;
+    std::string request;
+    request.swap(client->blocked);
+    // 超时也不再等：播放列表给当前版本，part 给 404
+    handleRequest(conn, client, request.data(), request.size(), false);
+    while (client->blocked.empty() && !client->queued.empty()) {
+        request = std::move(client->queued.front());
+        client->queued.pop_front();
+        handleRequest(conn, client, request.data(), request.size(), true);
+    }
+}
+
+void HlsServer::writeHeader(HttpClient &client, int status, StringPiece type, size_t length, StringPiece cache) {
+    client.response.assign("HTTP/1.1 ");
+    RtspWriter writer(client.response);
+    writer.status(status, false);
+    if (!type.empty()) {
+        writer.header("Content-Type", type);
+    }
+    writer.header("Content-Length", static_cast<unsigned long>(length))
+          .header("Cache-Control", cache)
+          .header("Access-Control-Allow-Origin", "*")
+          .end();
+}
+
+void HlsServer::sendStatus(const TcpConnectionPtr &conn, HttpClient &client, int status) {
+    writeHeader(client, status, StringPiece(), 0, "no-cache");
+    conn->send(client.response);
+}
@@ -0,0 +1,61 @@
+#ifndef __HLS_SERVER_H__
+#define __HLS_SERVER_H__
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Acceptor.h"
+#include "TcpConnection.h"
+#include "RtspParser.h"
+#include "HlsSegmenter.h"
+
+// 浏览器观看用的 LL-HLS（HTTP/1.1 GET）。与 MonitorServer 一样挂在反应堆的各个子loop上监听，
+// 请求头和 RTSP 同格式，沿用 TcpConnection 的取条目和 RtspRequest 的解析。
+//   /<流名称>/index.m3u8[?_HLS_msn=M[&_HLS_part=P]]   带 _HLS_msn 时阻塞到该分段/part 出现
+//   /<流名称>/init<N>.mp4  /<流名称>/seg<M>.m4s  /<流名称>/part<M>.<P>.m4s（预加载提示的 part 阻塞到生成）
+//   /<流名称>/detections.json[?since=T]   摄像头送来的检测结果（DetectionIndex），T 为上次取到的最后一个 ts
+// 分段和 part 都在 HlsSegmenter 的内存里，响应直接引用其数据块发送。
+// 每个连接的状态只在所在loop线程里访问，不需要锁
+class HlsServer {
+public:
+    static HlsServer &instance();
+
+    // 在每个 loop 上监听 ip:port，需在 loop 启动前调用
+    void start(const std::vector<EventLoop*> &loops, const std::string &ip, unsigned short port);
+
+private:
+    struct HttpClient {
+        EventLoop *loop;
+        std::string response;           // 响应头缓冲，复用容量
+        std::string body;
+        std::string blocked;            // 正在等待的请求原文，空表示没有
+        std::deque<std::string> queued; // 等待期间收到的后续请求，按顺序应答
+        uint64_t waitId = 0;            // 唤醒和超时谁先到谁处理，另一个按编号作废
+        TimerId timer = 0;
+    };
+    using HttpClientPtr = std::shared_ptr<HttpClient>;
+
+    HlsServer() = default;
+    HlsServer(const HlsServer &) = delete;
+    HlsServer &operator=(const HlsServer &) = delete;
+
+    void setupLoop(EventLoop *loop, Acceptor &acceptor);//在loop线程里登记
+    void onConnection(EventLoop *loop, int connfd);
+    void onMessage(const TcpConnectionPtr &conn, const HttpClientPtr &client);
+    // 处理一条请求；mayBlock 时可能挂起等待（返回 false），由 resume 继续
+    bool handleRequest(const TcpConnectionPtr &conn, const HttpClientPtr &client,
+                       const char *data, size_t len, bool mayBlock);
+    // 没到时挂起当前请求：登记到 segmenter 上，同时设超时
+    HlsSegmenter::WaitResult wait(const TcpConnectionPtr &conn, const HttpClientPtr &client, HlsSegmenter &hls,
+                                  uint64_t msn, uint32_t part, const char *data, size_t len);
+    void resume(const TcpConnectionPtr &conn, const HttpClientPtr &client, uint64_t waitId, bool timedOut);
+    void sendStatus(const TcpConnectionPtr &conn, HttpClient &client, int status);
+    // 响应头写到 client.response，返回后由调用方附上 body 发送
+    void writeHeader(HttpClient &client, int status, StringPiece type, size_t length, StringPiece cache);
+
+    bool _started{false};
+    std::vector<std::unique_ptr<Acceptor>> _acceptors;//每个loop一个监听socket
+};
+
+#endif
@@ -0,0 +1,82 @@
+#include "KcpScheduler.h"
+#include "EventLoop.h"
+#include <chrono>
+
+KcpScheduler &KcpScheduler::instance(EventLoop *loop) {
+    // 一个线程只跑一个 EventLoop，调度器跟着线程走
+    static thread_local std::unique_ptr<KcpScheduler> scheduler;
+    if (!scheduler) {
+        scheduler.reset(new KcpScheduler(loop));
+    }
+    return *scheduler;
+}
+
+KcpScheduler::KcpScheduler(EventLoop *loop)
+:_loop(loop){
+}
+
+KcpScheduler::~KcpScheduler() {
+}
+
+uint32_t KcpScheduler::iclock() {
+    using namespace std::chrono;
+    return (uint32_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void KcpScheduler::add(ikcpcb *kcp, FlushCallback &&flushCb) {
+    Entry &entry = _entries[kcp];
+    entry.flushCb = std::move(flushCb);
+    schedule(kcp, entry, iclock());
+}
+
+void KcpScheduler::remove(ikcpcb *kcp) {
+    auto it = _entries.find(kcp);
+    if (it == _entries.end()) return;
+    if (it->second.timerId) {
+        _loop->removeTimer(it->second.timerId);
+    }
+    _entries.erase(it);
+}
+
+void KcpScheduler::touch(ikcpcb *kcp) {
+    auto it = _entries.find(kcp);
+    if (it == _entries.end()) return;
+    Entry &entry = it->second;
+    uint32_t now = iclock();
+    if (entry.timerId && (int32_t)(entry.due - ikcp_check(kcp, now)) <= 0) {
+        return;//已经挂着不晚于需要时刻的定时器
+    }
+    schedule(kcp, entry, now);
+}
+
+void KcpScheduler::schedule(ikcpcb *kcp, Entry &entry, uint32_t now) {
+    if (entry.timerId) {
+        _loop->removeTimer(entry.timerId);
+    }
+    uint32_t due = ikcp_check(kcp, now);
+    int delay = (int32_t)(due - now);
+    entry.due = due;
+    entry.timerId = _loop->addOneTimer(delay > 0 ? delay : 0, [this, kcp]() {
+        onTimer(kcp);
+    });
+}
+
+void KcpScheduler::onTimer(ikcpcb *kcp) {
+    auto it = _entries.find(kcp);
+    if (it == _entries.end()) return;
+    Entry &entry = it->second;
+    entry.timerId = 0;
+    uint32_t now = iclock();
+    ikcp_update(kcp, now);
+    ++_stats.updates;
+    if (entry.flushCb) entry.flushCb();
+    if (isIdle(kcp)) {
+        ++_stats.parked;//没有要发的和要确认的，等 touch 再调度
+        return;
+    }
+    schedule(kcp, entry, now);
+}
+
+bool KcpScheduler::isIdle(const ikcpcb *kcp) {
+    return kcp->nsnd_buf == 0 && kcp->nsnd_que == 0 && kcp->ackcount == 0 && kcp->probe == 0;
+}
@@ -0,0 +1,59 @@
+#ifndef __KCPSCHEDULER_H__
+#define __KCPSCHEDULER_H__
+
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <stdint.h>
+extern "C"{
+#include "ikcp.h"
+}
+
+class EventLoop;
+
+// 每个 EventLoop 一个 KCP 调度器：按 ikcp_check 给出的下次更新时间在 loop 上挂一次性定时器，
+// 会话只在所属 loop 线程里更新，不需要额外线程，也不需要会话锁。
+// 没有待发/待确认数据的会话不再挂定时器，ikcp_send/ikcp_input 之后调用 touch 重新唤醒
+class KcpScheduler {
+public:
+    using FlushCallback = std::function<void()>;
+
+    struct Stats {
+        uint64_t updates = 0;   // ikcp_update 次数
+        uint64_t parked = 0;    // 空闲后停止调度的次数
+    };
+
+    // 当前线程所跑 loop 的调度器，必须在 loop 线程里调用
+    static KcpScheduler &instance(EventLoop *loop);
+
+    // 开始调度，每次 ikcp_update 之后调用 flushCb（用于把批量攒下的报文发出去）
+    void add(ikcpcb *kcp, FlushCallback &&flushCb);
+    void remove(ikcpcb *kcp);
+    // ikcp_send/ikcp_input 之后调用，必要时提前下次更新
+    void touch(ikcpcb *kcp);
+
+    size_t size() const { return _entries.size(); }
+    const Stats &stats() const { return _stats; }
+
+    static uint32_t iclock();
+
+    explicit KcpScheduler(EventLoop *loop);
+    ~KcpScheduler();
+
+private:
+    struct Entry {
+        FlushCallback flushCb;
+        uint64_t timerId = 0;   // 0 表示当前没有挂定时器
+        uint32_t due = 0;       // 定时器到期时刻（iclock）
+    };
+
+    void schedule(ikcpcb *kcp, Entry &entry, uint32_t now);
+    void onTimer(ikcpcb *kcp);
+    static bool isIdle(const ikcpcb *kcp);
+
+    EventLoop *_loop;
+    std::unordered_map<ikcpcb *, Entry> _entries;
+    Stats _stats;
+};
+
+#endif
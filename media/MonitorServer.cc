@@ -1,244 +1,155 @@
 #include "MonitorServer.h"
 #include "Logger.h"
+#include "EventLoop.h"
+#include "KcpScheduler.h"
+#include "ClipRecorder.h"
 
-#include <sys/socket.h>
-#include <netinet/in.h>
 #include <arpa/inet.h>
-#include <unistd.h>
 #include <cstring>
 #include <string>
-#include <chrono>
-#include <sstream>
 #include <algorithm>
-#include <iomanip>
-#include <iostream>
-#include "ikcp.h"  
 
-int MonitorServer::_udpServerRtpFd = -1;
-int MonitorServer::_udpServerRtcpFd = -1;
+static const unsigned short kKcpPort = 8910;//qt客户端KCP视频端口
+static const size_t kKcpHeaderLen = 24;//KCP报文头长度（ikcp.c 中的 IKCP_OVERHEAD）
 static inline uint32_t kcp_getu32(const uint8_t *p) {
     return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
 }
 
+// 只删除仍指向该会话的索引项，conv 可能已被新会话占用
+static void unindexSession(ConvIndex &index, const udpSessionPtr &session) {
+    auto it = index.find(session->conv);
+    if (it != index.end() && it->second == session) {
+        index.erase(it);
+    }
+}
+
+// qt端回的ACK，在会话所在loop线程里处理
+static void inputAck(const udpSessionPtr &session, const char *data, size_t len) {
+    if (session->ikcp) {
+        ikcp_input(session->ikcp, data, (long)len);
+        KcpScheduler::instance(session->loop).touch(session->ikcp);
+        session->fanout->pump(session->ikcp);//窗口腾出空位，继续送积压数据
+    }
+}
+
 MonitorServer &MonitorServer::instance() {
     static MonitorServer inst;
     return inst;
 }
 MonitorServer::~MonitorServer(){
-    if(_udpServerRtpFd >= 0) ::close(_udpServerRtpFd);
-    if(_udpServerRtcpFd >= 0) ::close(_udpServerRtcpFd);
-    if(_epfd >= 0) ::close(_epfd);
-    if(_listenFd >= 0) ::close(_listenFd);
 }
-MonitorServer::MonitorServer():_evtList(1024){
-    createEpollFd();
-    _udpServerRtpFd = socket(AF_INET,SOCK_DGRAM,0);//绑定RTP over UDP 端口发送
-    struct sockaddr_in serverAddr1;
-    serverAddr1.sin_family = AF_INET;
-    serverAddr1.sin_port = htons(8910);
-    inet_aton("0.0.0.0",&serverAddr1.sin_addr);
-    ::bind(_udpServerRtpFd,(struct sockaddr *)&serverAddr1,sizeof(serverAddr1));
-
-    _udpServerRtcpFd = socket(AF_INET,SOCK_DGRAM,0);//绑定RTCP over UDP 端口发送
-    struct sockaddr_in serverAddr2;
-    serverAddr2.sin_family = AF_INET;
-    serverAddr2.sin_port = htons(8911);
-    inet_aton("0.0.0.0",&serverAddr2.sin_addr);
-    ::bind(_udpServerRtpFd,(struct sockaddr *)&serverAddr2,sizeof(serverAddr2));
+MonitorServer::MonitorServer():_convIndex(std::make_shared<ConvIndex>()){
 }
-void MonitorServer::start(const std::string &ip, unsigned short port) {
+void MonitorServer::start(const std::vector<EventLoop*> &loops, const std::string &ip, unsigned short port) {
     if (_started) return;
     _started = true;
     _server = InetAddress(ip,port);
-    std::thread([this, ip, port]() {
-        acceptLoop();
-    }).detach();
+    for (EventLoop *loop : loops) {
+        _acceptors.emplace_back(new Acceptor(ip, port));
+        _acceptors.back()->ready();
+        UdpConnectionPtr udpConn = std::make_shared<UdpConnection>(ip, kKcpPort, InetAddress(), loop, true);
+        _udpConns[loop] = udpConn;
+        Acceptor &acceptor = *_acceptors.back();
+        loop->runInLoop([this, loop, &acceptor, udpConn]() {
+            setupLoop(loop, acceptor, udpConn);
+        });
+    }
+    LOG_INFO("MonitorServer listening on %s over %zu loops", _server.toString().c_str(), loops.size());
 }
 
-void MonitorServer::acceptLoop() {
-    int listenfd = ::socket(AF_INET, SOCK_STREAM, 0);
-    if (listenfd < 0) {
-        LOG_ERROR("MonitorServer socket create failed: %s", strerror(errno));
-        return;
+void MonitorServer::setupLoop(EventLoop *loop, Acceptor &acceptor, const UdpConnectionPtr &udpConn) {
+    loop->addAcceptor(acceptor, [this, loop](int connfd) {
+        onConnection(loop, connfd);
+    });
+    udpConn->setMessageCallback([this](const UdpConnectionPtr &conn) {
+        onKcpData(conn);
+    });
+    loop->addUdpConnection(udpConn);
+}
+
+void MonitorServer::onConnection(EventLoop *loop, int connfd) {//qt客户端连接
+    TcpConnectionPtr conn(new TcpConnection(loop, connfd));
+    loop->addTcpConnection(conn);
+    conn->setMessageCallback([this](const TcpConnectionPtr &c) { onMessage(c); });
+    conn->setCloseCallback([this](const TcpConnectionPtr &c) { onClose(c); });
+    QtClient qtClient;
+    qtClient.conn = conn;
+    qtClient._clientIp = conn->getPeerAddr().ip();
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _qtClients[connfd] = std::move(qtClient);
     }
-    
-    int on = 1;
-    ::setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    LOG_INFO("MonitorServer new client fd=%d", connfd);
+}
 
-    if (::bind(listenfd, (sockaddr*)_server.getInetAddrPtr(), _server.getInetAddrLen()) < 0) {
-        LOG_ERROR("MonitorServer bind failed on %s:%d: %s", _server.ip(), _server.port(), strerror(errno));
-        ::close(listenfd);
+void MonitorServer::onMessage(const TcpConnectionPtr &conn) {
+    // 一次可读事件里可能有多条请求，逐条解析处理，视图直接指向接收缓冲区
+    const std::vector<RecvItemView> &items = conn->recvItems();
+    std::lock_guard<std::mutex> lock(_mtx);
+    auto it = _qtClients.find(conn->getFd());
+    if (it == _qtClients.end()) {
         return;
     }
+    for (const RecvItemView &item : items) {
+        if (item.type != RecvItemType::RtspRequest) {
+            continue;
+        }
+        RtspRequest req;
+        if (req.parse(item.data, item.len) != RtspRequest::Complete) {
+            LOG_WARN("Malformed Qt client request on fd %d", conn->getFd());
+            continue;
+        }
+        LOG_DEBUG("Recv QTClient Request:\n%.*s", (int)item.len, item.data);
+        handleClientRequest(it->second, req);
+    }
+}
 
-    if (::listen(listenfd, 8) < 0) {
-        LOG_ERROR("MonitorServer listen failed: %s", strerror(errno));
-        ::close(listenfd);
+void MonitorServer::onClose(const TcpConnectionPtr &conn) {
+    LOG_DEBUG("Qt Client closed!");
+    std::lock_guard<std::mutex> lock(_mtx);
+    auto it = _qtClients.find(conn->getFd());
+    if (it == _qtClients.end() || it->second.conn != conn) {
         return;
     }
-
-    {
-        std::lock_guard<std::mutex> lock(_mtx);
-        _listenFd = listenfd;
+    auto index = copyConvIndex();
+    for(auto &s : it->second._sessionMap){
+        unindexSession(*index, s.second);
+        releaseKcp(s.second);
     }
-    LOG_INFO("MonitorServer listening on %s", _server.toString());
-    addEpollReadFd(_listenFd);
-    addEpollReadFd(_udpServerRtpFd);
+    publishConvIndex(std::move(index));
+    _qtClients.erase(it);
+}
+
+void MonitorServer::onKcpData(const UdpConnectionPtr &conn) {
+    // 同一loop线程共用一个收包批，一次 recvmmsg 收多个报文；每次可读事件取一次索引快照
+    static thread_local UdpRecvBatch batch;
+    std::shared_ptr<const ConvIndex> index = std::atomic_load(&_convIndex);
     while (true) {
-        int readyNum = epoll_wait(_epfd,&*_evtList.begin(),_evtList.size(),3000);
-        if(-1 == readyNum){
-            LOG_ERROR("epoll_wait failed: %s", strerror(errno));
-            return; 
-        }else if(0 == readyNum){
-            LOG_DEBUG("MonitorServer epoll_wait timeout, thread id: %zu", std::hash<std::thread::id>{}(std::this_thread::get_id()));
-        }else{
-            for(int i = 0; i < readyNum; i++){
-                int fd = _evtList[i].data.fd;
-                if(fd == _listenFd){//qt客户端连接
-                    sockaddr_in cliAddr;
-                    socklen_t len = sizeof(cliAddr);
-                    int connfd = ::accept(listenfd, (sockaddr*)&cliAddr, &len);
-                    if (connfd < 0) {
-                        LOG_ERROR("MonitorServer accept failed: %s", strerror(errno));
-                        continue;
-                    }
-                    QtClient qtClient{};
-                    qtClient.tcpFd = connfd;
-                    qtClient._clientIp = inet_ntoa(cliAddr.sin_addr);
-                    {
-                        std::lock_guard<std::mutex> lock(_mtx);
-                        _qtClients[connfd] = std::move(qtClient);
-                    }
-                    addEpollReadFd(connfd);
-                    LOG_INFO("MonitorServer new client fd=%d", connfd);
-                }else if(_qtClients.find(fd) != _qtClients.end()){
-                    char buf[256];
-                    std::string method;
-                    std::string url;
-                    std::map<std::string, std::string> headers;
-                    std::string recvRequest;
-                    int n = ::recv(fd,buf,sizeof(buf),0);
-                    {
-                        std::lock_guard<std::mutex> lock(_mtx);
-                        if(n==0){
-                            LOG_DEBUG("Qt Client closed!");
-                            delEpollReadFd(fd);
-                            for(auto &s : _qtClients[fd]._sessionMap){
-                                s.second->kcp_runing = false;
-                                if(s.second->_kcpThread.joinable()){
-                                    s.second->_kcpThread.join();
-                                }
-                                if(s.second->ikcp){
-                                    ikcp_release(s.second->ikcp);
-                                    s.second->ikcp = nullptr;
-                                }
-                            }
-                            _qtClients.erase(fd);
-                            break;
-                        }
-                        _qtClients[fd]._buffer.append(buf,n);
-                        size_t end = _qtClients[fd]._buffer.find("\r\n\r\n");
-                        recvRequest = _qtClients[fd]._buffer.substr(0,end);
-                        _qtClients[fd]._buffer.erase(0,end + 4);
-                        parseRequest(recvRequest,method,url,headers);
-                    }
-                    LOG_DEBUG("Recv QTClient Request:\n%s",recvRequest.c_str());
-                    _qtClients[fd].Cseq++;
-                    if(method == "SETUP"){
-                        std::map<std::string, std::string> extraHeaders{};
-                        extraHeaders["CamNum"] = std::to_string(_cams.size());
-                        int i=0;
-                        for(auto e:_cams){
-                            extraHeaders[std::to_string(i)]=e.first;
-                            i++;
-                        }    
-                        sendRespond(extraHeaders, _qtClients[fd]);
-                    } else if(method == "MESSAGE"){
-                        std::lock_guard<std::mutex> lock(_mtx);
-                        for(auto e:headers){
-                            if(e.first=="cseq")
-                                continue;
-                            std::istringstream iss(e.second);
-                            std::string port;
-                            std::vector<std::string> ports;
-                            while (std::getline(iss, port, ' ')) {
-                                ports.push_back(port);
-                            }
-                            auto rtpAddr = InetAddress(_qtClients[fd]._clientIp, static_cast<unsigned short>(std::stoul(ports[0])));
-                            auto rtcpAddr = InetAddress(_qtClients[fd]._clientIp, static_cast<unsigned short>(std::stoul(ports[1])));
-                            _qtClients[fd]._sessionMap[e.first] = std::make_unique<udpSession>();
-                            _qtClients[fd]._sessionMap[e.first]->_videoUdpRtp = std::move(rtpAddr);
-                            _qtClients[fd]._sessionMap[e.first]->_videoUdpRtcp = std::move(rtcpAddr);
-                            _qtClients[fd]._sessionMap[e.first]->conv = std::move(std::stoul(ports[2]));
-                            _qtClients[fd]._sessionMap[e.first]->ikcp = kcp_init(_qtClients[fd]._sessionMap[e.first]->conv,
-                                                                        &_qtClients[fd]._sessionMap[e.first]->_videoUdpRtp);
-                            _qtClients[fd]._sessionMap[e.first]->kcp_runing = true;
-                            _qtClients[fd]._sessionMap[e.first]->_kcpThread = std::thread([this,fd,e]{
-                                kcp_update_thread(_qtClients[fd]._sessionMap[e.first].get());
-                            });
-                        }
-                    } else if(method == "ADDCAM"){//收到qt端发送的添加端口信息，更新列表
-                        LOG_DEBUG("Recieved Qt Client ADDCAM Respond");
-                        std::lock_guard<std::mutex> lock(_mtx);
-                        for(auto e:headers){
-                            if(e.first=="cseq")
-                                continue;
-                            std::istringstream iss(e.second);
-                            std::string port;
-                            std::vector<std::string> ports;
-                            while (std::getline(iss, port, ' ')) {
-                                ports.push_back(port);
-                            }
-                            auto rtpAddr = InetAddress(_qtClients[fd]._clientIp, static_cast<unsigned short>(std::stoul(ports[0])));
-                            auto rtcpAddr = InetAddress(_qtClients[fd]._clientIp, static_cast<unsigned short>(std::stoul(ports[1])));
-                            _qtClients[fd]._sessionMap[e.first] = std::make_unique<udpSession>();
-                            _qtClients[fd]._sessionMap[e.first]->_videoUdpRtp = std::move(rtpAddr);
-                            _qtClients[fd]._sessionMap[e.first]->_videoUdpRtcp = std::move(rtcpAddr);
-                            _qtClients[fd]._sessionMap[e.first]->conv = std::move(std::stoul(ports[2]));
-                            _qtClients[fd]._sessionMap[e.first]->ikcp = kcp_init(_qtClients[fd]._sessionMap[e.first]->conv,
-                                                                        &_qtClients[fd]._sessionMap[e.first]->_videoUdpRtp);
-                            _qtClients[fd]._sessionMap[e.first]->kcp_runing = true;
-                            _qtClients[fd]._sessionMap[e.first]->_kcpThread = std::thread([this,fd,e]{
-                                kcp_update_thread(_qtClients[fd]._sessionMap[e.first].get());
-                            });
-                        }
-                    }
-                }else if(fd == _udpServerRtpFd){
-                    char udp_buffer[2048]; 
-                    ssize_t n;
-                    // 循环读取所有待处理的 UDP 包
-                    while (true) {  
-                        n= ::recv(_udpServerRtpFd, udp_buffer, sizeof(udp_buffer), MSG_DONTWAIT);
-                        //1.如果没有数据直接跳过
-                        if (n <= 0) {
-                            if (n == -1 && (errno != EAGAIN && errno != EWOULDBLOCK)) {
-                                LOG_ERROR("UDP recv error: %s", strerror(errno));
-                            }
-                            break;
-                        }
-                        uint32_t conv = kcp_getu32((const uint8_t*)udp_buffer);
-                        udpSession* targetSession = nullptr;
-                        // 2. 使用全局锁查找 Session
-                        {
-                            std::lock_guard<std::mutex> lock(_mtx);
-                            for (const auto& qt : _qtClients) {
-                                for (const auto& s : qt.second._sessionMap) {
-                                    if (s.second->conv == conv) {
-                                        targetSession = s.second.get(); // 获取原生指针
-                                        break;
-                                    }
-                                }
-                                if (targetSession) break;
-                            }
-                        }
-                        {
-                            std::lock_guard<std::mutex> kcpLock(targetSession->_kcpMutex);
-                            ikcp_input(targetSession->ikcp, udp_buffer, (int)n);
-                        }
-                    }
-                }
+        int num = conn->recvBatch(batch);
+        if (num <= 0) {
+            break;
+        }
+        for (int k = 0; k < num; ++k) {
+            const char *data = batch.data(k);
+            size_t n = batch.len(k);
+            if (n < kKcpHeaderLen) {
+                continue;//不是KCP报文
+            }
+            auto it = index->find(kcp_getu32((const uint8_t*)data));
+            if (it == index->end()) {
+                continue;//会话已删除或conv未知
+            }
+            const udpSessionPtr &session = it->second;
+            if (session->loop->isInLoopThread()) {
+                inputAck(session, data, n);//摄像头也在本loop，直接处理
+            } else {
+                std::string packet(data, n);
+                session->loop->runInLoop([session, packet]() {
+                    inputAck(session, packet.data(), packet.size());
+                });
             }
         }
+        if (num < UdpRecvBatch::kMaxMsgs) break;//没收满说明已经读空
     }
 }
 /*
@@ -248,41 +159,103 @@ request:
     Header2: value\r\n
     \r\n
 */
-void MonitorServer::parseRequest(const std::string& request, 
-                    std::string& method, 
-                    std::string& url,
-                    std::map<std::string, std::string>& headers){
-    // 解析请求行
-    std::istringstream iss(request);
-    std::string line;
-    if (std::getline(iss, line)) {
-        std::istringstream requestLine(line);
-        requestLine >> method >> url;
-        // 去除RTSP/1.0部分
-    }
-    
-    // 解析头部
-    while (std::getline(iss, line)) {
-        if (line.empty() || line == "\r") break;
-        
-        size_t colonPos = line.find(':');
-        if (colonPos != std::string::npos) {
-            std::string key = line.substr(0, colonPos);
-            std::string value = line.substr(colonPos + 2);
-            
-            // 去除前后空格
-            key.erase(0, key.find_first_not_of(" \t\r\n"));
-            key.erase(key.find_last_not_of(" \t\r\n") + 1);
-            value.erase(0, value.find_first_not_of(" \t\r\n"));
-            value.erase(value.find_last_not_of(" \t\r\n") + 1);
-            
-            // 转换为小写以便查找
-            std::string keyLower = key;
-            std::transform(keyLower.begin(), keyLower.end(), keyLower.begin(), ::tolower);
-            headers[keyLower] = value;
+void MonitorServer::handleClientRequest(QtClient &client, const RtspRequest &req){
+    client.Cseq++;
+    StringPiece method = req.method();
+    if(method.equals("SETUP")){
+        _response.clear();
+        RtspWriter writer(_response);
+        writer.status(200, false)
+              .header("CSeq", static_cast<unsigned long>(client.Cseq))
+              .header("CamNum", static_cast<unsigned long>(_cams.size()));
+        char index[16];
+        int i=0;
+        for(auto &e:_cams){
+            int len = snprintf(index, sizeof(index), "%d", i);
+            writer.header(StringPiece(index, len), e.first);
+            i++;
         }
+        writer.end();
+        sendRespond(client);
+    } else if(method.equals("MESSAGE") || method.equals("ADDCAM")){
+        //MESSAGE 为全部摄像头的端口信息，ADDCAM 为qt端对新增摄像头的回应，格式相同
+        LOG_DEBUG("Recieved Qt Client %.*s", (int)method.len, method.data);
+        auto index = copyConvIndex();
+        for(int i = 0; i < req.fieldCount(); ++i){
+            const RtspRequest::Field &f = req.field(i);
+            if(f.name.iequals("cseq"))
+                continue;
+            //value: "rtp端口 rtcp端口 conv"
+            const char *p = f.value.data;
+            const char *end = f.value.data + f.value.len;
+            unsigned long ports[3] = {0, 0, 0};
+            for(int k = 0; k < 3 && p < end; ++k){
+                const char *sp = static_cast<const char*>(memchr(p, ' ', end - p));
+                if(!sp) sp = end;
+                ports[k] = StringPiece(p, sp - p).toULong();
+                p = sp + 1;
+            }
+            std::string key = f.name.toString();
+            auto camIt = _camFanouts.find(key);
+            if(camIt == _camFanouts.end()){
+                LOG_WARN("Qt client requested unknown camera %s", key.c_str());
+                continue;
+            }
+            auto udpIt = _udpConns.find(camIt->second->loop());
+            if(udpIt == _udpConns.end()){
+                LOG_WARN("Camera %s is not on a monitor loop", key.c_str());
+                continue;
+            }
+            auto session = std::make_shared<udpSession>();
+            session->_videoUdpRtp = InetAddress(client._clientIp, static_cast<unsigned short>(ports[0]));
+            session->_videoUdpRtcp = InetAddress(client._clientIp, static_cast<unsigned short>(ports[1]));
+            session->conv = static_cast<uint32_t>(ports[2]);
+            session->_sendBatch.setFd(udpIt->second->getUdpFd());
+            session->ikcp = kcp_init(session->conv, session.get());
+            session->fanout = camIt->second;
+            session->loop = session->fanout->loop();
+            auto old = client._sessionMap.find(key);
+            if(old != client._sessionMap.end()){//同一路摄像头重复请求，替换旧会话
+                unindexSession(*index, old->second);
+                releaseKcp(old->second);
+            }
+            client._sessionMap[key] = session;
+            (*index)[session->conv] = session;
+            //交给摄像头所在loop的调度器和分发器，之后ikcp只在那个线程里使用
+            session->loop->runInLoop([session]() {
+                udpSession *raw = session.get();
+                KcpScheduler::instance(raw->loop).add(raw->ikcp, [raw]() {
+                    raw->_sendBatch.flush();//本轮flush出的KCP报文一次发出
+                    raw->fanout->pump(raw->ikcp);
+                });
+                raw->fanout->addSubscriber(raw->ikcp);
+            });
+        }
+        publishConvIndex(std::move(index));
+    } else if(method.equals("CLIP")){
+        //手动触发事件片段，头部 Camera: 摄像头sessionId，可选 Reason: 原因（出现在文件名里）
+        std::string cam = req.header("Camera").toString();
+        std::string reason = req.header("Reason").toString();
+        if(reason.empty())
+            reason = "manual";
+        auto camIt = _camFanouts.find(cam);
+        int status = 404;
+        if(camIt != _camFanouts.end()){
+            StreamFanoutPtr fanout = camIt->second;
+            fanout->loop()->runInLoop([fanout, reason]() {
+                if(const std::shared_ptr<ClipRecorder> &clip = fanout->clipRecorder())
+                    clip->trigger(reason);
+            });
+            status = 200;
+        } else {
+            LOG_WARN("Qt client requested clip of unknown camera %s", cam.c_str());
+        }
+        _response.clear();
+        RtspWriter(_response).status(status, false)
+              .header("CSeq", static_cast<unsigned long>(client.Cseq))
+              .end();
+        sendRespond(client);
     }
-    
 }
 /*
     respond:
@@ -290,146 +263,61 @@ void MonitorServer::parseRequest(const std::string& request,
         Cseq: value\r\n
         \r\n
 */
-void MonitorServer::sendRespond(const std::map<std::string, std::string>& extraHeaders,const QtClient& client){
-    std::ostringstream oss;
-    int statusCode = 200;
-    std::string statusText = "OK";
-    // RTSP响应行
-    oss << statusCode << " " << statusText << "\r\n";
+void MonitorServer::sendRespond(const QtClient& client){
+    LOG_DEBUG("Sending RTSP response:\n%s", _response.c_str());
     
-    // CSeq头
-    oss << "CSeq: " << client.Cseq << "\r\n";
-    
-    // 额外头部
-    for (const auto& pair : extraHeaders) {
-        oss << pair.first << ": " << pair.second << "\r\n";
-    }
-    
-    // 结束标志
-    oss << "\r\n";
-    
-    std::string response = oss.str();
-    LOG_DEBUG("Sending RTSP response:\n%s", response.c_str());
-    
-    ::send(client.tcpFd,response.c_str(),response.size(),0);
-    // if (auto tcpConn = _tcpConn.lock()) {
-    //     tcpConn->send(response);
-    // } else {
-    //     LOG_WARN("TCP connection expired when sending RTSP response");
-    // }
+    client.conn->send(_response);//在客户端所在loop线程里调用
 }
 
-void MonitorServer::onNaluTcp(const std::string &streamName,
-                           const uint8_t *data, size_t len) {
-    if (streamName.empty() || !data || len == 0) return;
-    std::lock_guard<std::mutex> lock(_mtx);
-    if (_qtClients.empty()) return;
-    std::string buf;
-    uint16_t nameLen = static_cast<uint16_t>(streamName.size());//长度为10
-    uint16_t nameLenNet = htons(nameLen);
-    buf.resize(sizeof(nameLenNet) + nameLen + len);
-    size_t offset = 0;
-    std::memcpy(&buf[offset],&nameLenNet,sizeof(nameLenNet));
-    offset += sizeof(nameLenNet);
-    std::memcpy(&buf[offset],streamName.data(),nameLen);
-    offset += nameLen;
-    std::memcpy(&buf[offset],data,len);
-    // 发送给所有已连接客户端；若发送失败则移除该客户端
-    std::set<int> badFds;
-    for (auto &m : _qtClients) {
-        ssize_t n = ::send(m.first, buf.data(), buf.size(), MSG_NOSIGNAL|MSG_DONTWAIT);
-        // LOG_DEBUG("send %d seq, %d data",(data[6]<<8|data[7]),n);
-        if (n < 0) {
-            LOG_WARN("MonitorServer send failed on fd %d: %s", m.first, strerror(errno));
-            badFds.insert(m.first);
-        }
-    }
-    for (int fd : badFds) {
-        ::close(fd);
-        _qtClients.erase(fd);
-    }
-}
-
-void MonitorServer::onNaluUdp(std::string sessionId,const char *data, size_t len){
-    for (auto &m : _qtClients) {
-        if(m.second._sessionMap.count(sessionId)){
-            std::lock_guard<std::mutex> lock(m.second._sessionMap[sessionId]->_kcpMutex);
-            ikcp_send(m.second._sessionMap[sessionId]->ikcp,data,len);
-        }
-    }
-}
-
-
-void MonitorServer::createEpollFd(){
-    _epfd = ::epoll_create1(0);
-    if(_epfd < 0){
-        LOG_ERROR("MonitorServer epoll_create failed: %s", strerror(errno));
-    }
-    LOG_DEBUG("Created MonitorServer Epoll fd: %d", _epfd);
-}
-
-void MonitorServer::addEpollReadFd(int fd){
-    struct  epoll_event evt;
-    evt.events = EPOLLIN|EPOLLET;
-    evt.data.fd = fd;
-    
-    int ret = ::epoll_ctl(_epfd,EPOLL_CTL_ADD,fd,&evt);
-    if(ret < 0){
-        LOG_ERROR("MonitorServerepoll_ctl_add failed for fd %d: %s", fd, strerror(errno));
-        return;
-    }
-    LOG_INFO("MonitorServer AddEpollReadFd fd=%d, loop thread id=%lu", fd, std::this_thread::get_id());
-    
-}
-
-void MonitorServer::delEpollReadFd(int fd){
-    struct  epoll_event evt;
-    evt.data.fd = fd;
-    
-    int ret = ::epoll_ctl(_epfd,EPOLL_CTL_DEL,fd,&evt);
-    if(ret < 0){
-        LOG_ERROR("MonitorServer Epoll_ctl_del failed for fd %d: %s", fd, strerror(errno));
-        return;
-    }
-    LOG_DEBUG("MonitorServer Removed fd %d from epoll read events", fd);
-}
-
-void MonitorServer::addCam(std::string sessionId,std::string stringName){//向qt客户端发送新增摄像头消息
+void MonitorServer::addCam(std::string sessionId,std::string stringName,StreamFanoutPtr fanout){//向qt客户端发送新增摄像头消息
     std::lock_guard<std::mutex> lock(_mtx);
     _cams[sessionId] = stringName;
+    _camFanouts[sessionId] = fanout;
     if(_qtClients.empty()){
         return;
     }
     for(auto &qtc : _qtClients){
         if(!qtc.second._sessionMap.count(sessionId)){//qt端没有添加该摄像头信息
-            std::string addCamReq = "ADDCAM " + _server.toString() + "\r\n"
-                                    "Cseq: " + std::to_string(++qtc.second.Cseq) + "\r\n"
-                                    "SessionId: " + sessionId + "\r\n\r\n";
-            ::send(qtc.second.tcpFd,addCamReq.c_str(),addCamReq.size(),0);
+            _request.clear();
+            RtspWriter(_request).requestLine("ADDCAM", _server.toString())
+                                .header("Cseq", static_cast<unsigned long>(++qtc.second.Cseq))
+                                .header("SessionId", sessionId)
+                                .end();
+            qtc.second.conn->sendInLoop(_request);
             LOG_DEBUG("MonitorServer Send ADDCAM Request.");
         }
     }
 }
 
-void MonitorServer::kcp_update_thread(udpSession *session){
-    while (session->kcp_runing) {
-        {
-            std::lock_guard<std::mutex> lock(session->_kcpMutex);
-            if(session->ikcp){
-                ikcp_update(session->ikcp, iclock());
-            }
+std::shared_ptr<ConvIndex> MonitorServer::copyConvIndex() const{
+    return std::make_shared<ConvIndex>(*std::atomic_load(&_convIndex));
+}
+
+void MonitorServer::publishConvIndex(std::shared_ptr<ConvIndex> index){
+    //旧快照在最后一个读者放手后释放
+    std::atomic_store(&_convIndex, std::shared_ptr<const ConvIndex>(std::move(index)));
+}
+
+void MonitorServer::releaseKcp(const udpSessionPtr &session){
+    //会话对象由lambda持有，等loop里释放完才析构
+    session->loop->runInLoop([session]() {
+        if(session->ikcp){
+            session->fanout->removeSubscriber(session->ikcp);
+            KcpScheduler::instance(session->loop).remove(session->ikcp);
+            ikcp_release(session->ikcp);
+            session->ikcp = nullptr;
         }
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    }
+    });
 }
 int MonitorServer::kcp_output(const char *buf, int len, ikcpcb *kcp, void *user) {
-    auto addr = (InetAddress*)(user);
+    auto session = static_cast<udpSession*>(user);
     // LOG_DEBUG("send %d data",len);
-    return ::sendto(_udpServerRtpFd,buf,len,MSG_DONTWAIT,(struct sockaddr*)addr->getInetAddrPtr(),addr->getInetAddrLen());
+    session->_sendBatch.append(buf, len, *session->_videoUdpRtp.getInetAddrPtr());
+    return len;
 }
 
-ikcpcb* MonitorServer::kcp_init(uint32_t conv,InetAddress *addr){
-    ikcpcb* kcp = ikcp_create(conv,addr);
+ikcpcb* MonitorServer::kcp_init(uint32_t conv,udpSession *session){
+    ikcpcb* kcp = ikcp_create(conv,session);
     kcp->output = kcp_output;
     ikcp_nodelay(kcp, 1, 10, 2, 0);
     ikcp_wndsize(kcp, 256, 256);
@@ -440,24 +328,20 @@ ikcpcb* MonitorServer::kcp_init(uint32_t conv,InetAddress *addr){
 void MonitorServer::removeCam(std::string sessionId){
     std::lock_guard<std::mutex> lock(_mtx);
     _cams.erase(sessionId);
+    _camFanouts.erase(sessionId);
+    auto index = copyConvIndex();
     for(auto& qtc : _qtClients){
         if(qtc.second._sessionMap.count(sessionId)){//qt端有该摄像头信息
-            std::string removeCamReq = "DELCAM " + _server.toString() + "\r\n"
-                                    "Cseq: " + std::to_string(qtc.second.Cseq) + "\r\n"
-                                    "SessionId: " + sessionId + "\r\n\r\n";
-            ::send(qtc.second.tcpFd,removeCamReq.c_str(),removeCamReq.size(),0);
-            {
-                std::lock_guard<std::mutex> lock(qtc.second._sessionMap[sessionId]->_kcpMutex);
-                qtc.second._sessionMap[sessionId]->kcp_runing = false;
-                if(qtc.second._sessionMap[sessionId]->_kcpThread.joinable()){
-                    qtc.second._sessionMap[sessionId]->_kcpThread.join();
-                }
-                if(qtc.second._sessionMap[sessionId]->ikcp){
-                    ikcp_release(qtc.second._sessionMap[sessionId]->ikcp);
-                    qtc.second._sessionMap[sessionId]->ikcp = nullptr;
-                }
-            }
+            _request.clear();
+            RtspWriter(_request).requestLine("DELCAM", _server.toString())
+                                .header("Cseq", static_cast<unsigned long>(qtc.second.Cseq))
+                                .header("SessionId", sessionId)
+                                .end();
+            qtc.second.conn->sendInLoop(_request);
+            unindexSession(*index, qtc.second._sessionMap[sessionId]);
+            releaseKcp(qtc.second._sessionMap[sessionId]);
             qtc.second._sessionMap.erase(sessionId);
         }
     }
+    publishConvIndex(std::move(index));
 }
@@ -1,100 +1,94 @@
 #ifndef __MONITOR_SERVER_H__
 #define __MONITOR_SERVER_H__
 
-#include <set>
 #include <string>
 #include <mutex>
-#include <thread>
 #include <cstdint>
-#include <sys/epoll.h>
 #include <memory>
+#include <vector>
+#include <unordered_map>
+#include "Acceptor.h"
+#include "TcpConnection.h"
 #include "UdpConnection.h"
 #include "InetAddress.h"
+#include "RtspParser.h"
+#include "StreamFanout.h"
 #include <map>
 extern "C"{
 #include "ikcp.h"
 }
-// 简单的多路监控服务器（独立线程）：
-// - 在一个 TCP 端口上接受 Qt 客户端
+// 多路监控服务（Qt 客户端）：
+// - 挂在反应堆的子EventLoop上，每个loop各自监听TCP端口和KCP的UDP端口（SO_REUSEPORT），
+//   qt客户端连接、ACK收包都在loop线程里处理，不再有独立线程和私有epoll
+// - 摄像头数据经 StreamFanout 在摄像头所在loop上分发，不经过本类，也不拿 _mtx
+// - _mtx 只保护摄像头列表、客户端表这些控制面状态
 
+// 一个qt客户端观看一路摄像头的KCP会话。挂在该摄像头所在的EventLoop上，
+// ikcp 的所有操作都在那个loop线程里做（由 KcpScheduler 驱动），不需要锁
 struct udpSession{
     InetAddress _videoUdpRtp;
     InetAddress _videoUdpRtcp;
     ikcpcb * ikcp;
     uint32_t conv;
-    bool kcp_runing;
-    std::thread _kcpThread;
-    std::mutex _kcpMutex;
+    EventLoop *loop;//摄像头所在的loop
+    StreamFanoutPtr fanout;//摄像头的分发器，本会话是其订阅者之一
+    UdpSendBatch _sendBatch;//kcp_output 攒下的报文，ikcp_update 后从所在loop的UDP端口一次 sendmmsg
 };
+using udpSessionPtr = std::shared_ptr<udpSession>;
+using ConvIndex = std::unordered_map<uint32_t, udpSessionPtr>;
 
 struct QtClient{
-    int tcpFd;
+    TcpConnectionPtr conn;
     std::string _clientIp;      // 客户端IP
-    map<std::string,std::unique_ptr<udpSession>> _sessionMap;
-    std::string _buffer;
-    int Cseq;
-    // 新增：启用移动语义
-    QtClient() = default; // 默认构造
-    
-    // 禁用拷贝（由 unique_ptr 隐式删除，但显式声明更清晰）
-    QtClient(const QtClient&) = delete;
-    QtClient& operator=(const QtClient&) = delete;
-
-    // 启用移动
-    QtClient(QtClient&&) = default; 
-    QtClient& operator=(QtClient&&) = default;
+    map<std::string,udpSessionPtr> _sessionMap;
+    int Cseq = 0;
 };
 
 class MonitorServer {
 public:
     static MonitorServer &instance();
 
-    // 启动监听线程（如果已启动则忽略）
-    // ip 为服务器绑定 IP，port 为监听端口，例如 9000
-    void start(const std::string &ip, unsigned short port);
-
-    // 有新的 H264 NALU 到来时调用（线程安全）
-    void onNaluTcp(const std::string &streamName,
-                const uint8_t *data, size_t len);
+    // 在每个 loop 上监听 ip:port（TCP）和 KCP 端口（UDP），需在 loop 启动前调用
+    void start(const std::vector<EventLoop*> &loops, const std::string &ip, unsigned short port);
 
-    void onNaluUdp(std::string sessionId,const char *data, size_t len);
-    void addCam(std::string sessionId,std::string stringName);
+    // fanout 为摄像头的分发器，观看该摄像头的KCP会话作为订阅者挂在它所在的loop上
+    void addCam(std::string sessionId,std::string stringName,StreamFanoutPtr fanout);
     void removeCam(std::string sessionId);
-    
+
 private:
     MonitorServer();
     ~MonitorServer();
     MonitorServer(const MonitorServer &) = delete;
     MonitorServer &operator=(const MonitorServer &) = delete;
-    
-    void acceptLoop();
-    void createEpollFd();
-    void addEpollReadFd(int fd);
-    void delEpollReadFd(int fd);
 
-    void parseRequest(const std::string& request, 
-                        std::string& method, 
-                        std::string& url,
-                        std::map<std::string, std::string>& headers);
-    void sendRespond(const std::map<std::string, std::string>& extraHeaders,const QtClient & client);
-    ikcpcb* kcp_init(uint32_t conv,InetAddress *addr);
+    void setupLoop(EventLoop *loop, Acceptor &acceptor, const UdpConnectionPtr &udpConn);//在loop线程里登记
+    void onConnection(EventLoop *loop, int connfd);
+    void onMessage(const TcpConnectionPtr &conn);
+    void onClose(const TcpConnectionPtr &conn);
+    void onKcpData(const UdpConnectionPtr &conn);//qt端回的ACK
+
+    void handleClientRequest(QtClient &client, const RtspRequest &req);//持 _mtx 调用
+    void sendRespond(const QtClient & client);//发送 _response
+    ikcpcb* kcp_init(uint32_t conv,udpSession *session);
     static int kcp_output(const char *buf, int len, ikcpcb *kcp, void *user);
-    uint32_t iclock() {
-        using namespace std::chrono;
-        return (uint32_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
-    }
-    void kcp_update_thread(udpSession* session);
+    void releaseKcp(const udpSessionPtr &session);//到会话所在loop上停止调度并释放ikcp
+    // conv 索引的修改：持 _mtx 时复制一份，改完后整体替换
+    std::shared_ptr<ConvIndex> copyConvIndex() const;
+    void publishConvIndex(std::shared_ptr<ConvIndex> index);
 private:
     std::mutex _mtx;
     std::map<int,QtClient> _qtClients; // 客户端 socket fd
-    int _epfd;
-    int _listenFd{-1};
     bool _started{false};
-    static int _udpServerRtpFd;
-    static int _udpServerRtcpFd;
-    vector<struct epoll_event> _evtList;
+    std::vector<std::unique_ptr<Acceptor>> _acceptors;//每个loop一个监听socket
+    map<EventLoop*,UdpConnectionPtr> _udpConns;//每个loop一个KCP端口socket，start 后只读
     map<std::string,std::string> _cams;
+    map<std::string,StreamFanoutPtr> _camFanouts;
+    // conv -> 会话的只读快照，随 MESSAGE/ADDCAM/DELCAM/客户端断开更新（类似RCU）。
+    // 收ACK时用 atomic_load 取快照直接查，不拿 _mtx
+    std::shared_ptr<const ConvIndex> _convIndex;
     InetAddress _server;
+    std::string _response;  // 回复qt客户端的缓冲，复用容量（持 _mtx 时使用）
+    std::string _request;   // 发给qt客户端的ADDCAM/DELCAM请求缓冲（持 _mtx 时使用）
 };
 
 #endif
@@ -0,0 +1,164 @@
+#include "Mp4Recorder.h"
+#include "Logger.h"
+#include <time.h>
+
+Mp4Recorder::Options &Mp4Recorder::options() {
+    static Options options;
+    return options;
+}
+
+Mp4Recorder::Mp4Recorder(const std::string &streamName, const Options &options,
+                         AsyncFileWriter &writer)
+:_name(streamName)
+,_options(options)
+,_writer(writer)
+,_pathSuffix(0)
+,_lastTs(0)
+,_lastDuration(0)
+,_hasLast(false)
+,_dropUntilKey(false)
+,_segmentDuration(0){
+    // 流名称可能带 '/'，文件名里换成 '_'
+    for (char &c : _name) {
+        if (c == '/' || c == '\\') c = '_';
+    }
+    _depacketizer.setFrameCallback([this](const H264Depacketizer::Frame &frame) {
+        onFrame(frame);
+    });
+}
+
+Mp4Recorder::~Mp4Recorder() {
+    close();
+}
+
+const std::string &Mp4Recorder::currentPath() const {
+    static const std::string kNone;
+    return _file ? _file->path() : kNone;
+}
+
+void Mp4Recorder::onRtp(const char *data, size_t len) {
+    _depacketizer.input(data, len);
+}
+
+void Mp4Recorder::close() {
+    _depacketizer.flush();
+    if (_file) {
+        closeSegment();
+    }
+    _hasLast = false;
+}
+
+void Mp4Recorder::onFrame(const H264Depacketizer::Frame &frame) {
+    if (!_file && !frame.key) {
+        return;//等第一个关键帧
+    }
+    if (_hasLast) {
+        // 上一帧的时长到这一帧才知道；时间戳回退或跳变过大时沿用上一帧的时长
+        uint32_t duration = frame.timestamp - _lastTs;
+        if (duration == 0 || duration > 10 * Fmp4Muxer::kTimescale) {
+            duration = _lastDuration ? _lastDuration : Fmp4Muxer::kTimescale / 25;
+        }
+        if (_muxer.sampleCount() > 0) {
+            _muxer.setLastDuration(duration);
+        } else {
+            _muxer.skip(duration);//丢掉的帧也占时间线，后面的分片时间不前移
+        }
+        _lastDuration = duration;
+        _segmentDuration += duration;
+    }
+    _lastTs = frame.timestamp;
+    _hasLast = true;
+    if (frame.key) {
+        _dropUntilKey = false;
+        bool paramsChanged = _depacketizer.takeParamsChanged();
+        if (_file) {
+            uint64_t bytes = _file->bytes() + _muxer.pendingBytes();
+            if (paramsChanged ||
+                _segmentDuration >= uint64_t(_options.segmentSeconds) * Fmp4Muxer::kTimescale ||
+                bytes >= _options.segmentBytes) {
+                closeSegment();//新文件从这个关键帧开始
+            } else if (_muxer.fragmentDuration() * 1000 >= uint64_t(_options.fragmentMs) * Fmp4Muxer::kTimescale) {
+                writeFragment();
+            }
+        }
+        if (!_file && !openSegment()) {
+            _hasLast = false;
+            return;
+        }
+    } else if (_dropUntilKey) {
+        return;//前面的分片没写进去，参考帧缺了，到下个关键帧再接着录
+    } else if (_muxer.pendingBytes() + frame.size > kMaxFragmentBytes) {
+        writeFragment();
+    }
+    _muxer.addSample(frame.data, frame.size, frame.key);
+    ++_stats.frames;
+}
+
+std::string Mp4Recorder::segmentPath() {
+    char stamp[32];
+    time_t now = time(nullptr);
+    struct tm tmNow;
+    localtime_r(&now, &tmNow);
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tmNow);
+    std::string path = _options.dir + "/" + _name + "_" + stamp;
+    if (path == _lastPath) {
+        // 同一秒内切了两次（参数集变化），加序号区分
+        path += "_" + std::to_string(++_pathSuffix);
+    } else {
+        _lastPath = path;
+        _pathSuffix = 0;
+    }
+    return path + ".mp4";
+}
+
+bool Mp4Recorder::openSegment() {
+    if (!_muxer.reset(_depacketizer.sps(), _depacketizer.pps())) {
+        return false;//还没收到参数集
+    }
+    _file = _writer.open(segmentPath());
+    _segmentDuration = 0;
+    _dropUntilKey = false;
+    _header.clear();
+    _muxer.writeInit(_header);
+    if (!_file->append(_header.data(), _header.size())) {
+        _file.reset();//没有文件头的文件放不了，下个关键帧再试
+        ++_stats.droppedFragments;
+        return false;
+    }
+    ++_stats.segments;
+    LOG_INFO("Mp4Recorder %s: recording to %s (%ux%u)", _name.c_str(),
+             _file->path().c_str(), _muxer.width(), _muxer.height());
+    return true;
+}
+
+void Mp4Recorder::closeSegment() {
+    if (_muxer.sampleCount() > 0) {
+        _muxer.setLastDuration(_lastDuration ? _lastDuration : Fmp4Muxer::kTimescale / 25);
+        writeFragment();
+    }
+    _file->close();
+    LOG_INFO("Mp4Recorder %s: closed %s, %lu bytes", _name.c_str(),
+             _file->path().c_str(), (unsigned long)_file->bytes());
+    _file.reset();
+}
+
+void Mp4Recorder::writeFragment() {
+    if (_muxer.sampleCount() == 0) return;
+    _header.clear();
+    _muxer.writeFragmentHeader(_header);
+    const std::string &payload = _muxer.payload();
+    struct iovec iov[2] = {
+        {const_cast<char *>(_header.data()), _header.size()},
+        {const_cast<char *>(payload.data()), payload.size()},
+    };
+    if (_file->append(iov, 2)) {
+        ++_stats.fragments;
+    } else {
+        _dropUntilKey = true;
+        if (_stats.droppedFragments++ % 100 == 0) {
+            LOG_WARN("Mp4Recorder %s: disk writer backlogged, dropped %lu fragments",
+                     _name.c_str(), (unsigned long)_stats.droppedFragments);
+        }
+    }
+    _muxer.clearFragment();
+}
@@ -0,0 +1,68 @@
+#ifndef __MP4RECORDER_H__
+#define __MP4RECORDER_H__
+
+#include <string>
+#include <stdint.h>
+#include "AsyncFileWriter.h"
+#include "Fmp4Muxer.h"
+#include "H264Depacketizer.h"
+
+// 一路流的连续录像：RTP -> 访问单元 -> 分片 MP4，按时长/大小切文件。
+// 挂在摄像头的 StreamFanout 上作为订阅者，在摄像头所在 loop 线程里调用；
+// 这里只做组帧和封装，写盘交给 AsyncFileWriter 的 I/O 线程，磁盘卡住时丢分片而不是阻塞 loop。
+// 每个文件以 ftyp+moov 开头、第一个分片从关键帧开始，单独拿出来也能播放
+class Mp4Recorder {
+public:
+    struct Options {
+        std::string dir;                            // 录像目录，空表示不录像
+        uint32_t segmentSeconds = 300;              // 单个文件最长时长
+        uint64_t segmentBytes = 512ull << 20;       // 单个文件最大字节数
+        uint32_t fragmentMs = 1000;                 // 分片目标时长，到时长后在下一个关键帧处切
+    };
+    struct Stats {
+        uint64_t frames = 0;
+        uint64_t fragments = 0;
+        uint64_t segments = 0;
+        uint64_t droppedFragments = 0;              // 写盘缓冲耗尽丢掉的分片
+    };
+    static const size_t kMaxFragmentBytes = 4 << 20;    // 关键帧间隔过长时按大小提前切分片
+
+    // 进程级录像配置，main 里在 loop 启动前设置
+    static Options &options();
+
+    Mp4Recorder(const std::string &streamName, const Options &options,
+                AsyncFileWriter &writer = AsyncFileWriter::instance());
+    ~Mp4Recorder();
+
+    void onRtp(const char *data, size_t len);
+    // 写出最后一个分片并关闭文件
+    void close();
+
+    const Stats &stats() const { return _stats; }
+    const std::string &currentPath() const;
+
+private:
+    void onFrame(const H264Depacketizer::Frame &frame);
+    bool openSegment();
+    void closeSegment();
+    void writeFragment();
+    std::string segmentPath();
+
+    std::string _name;
+    Options _options;
+    AsyncFileWriter &_writer;
+    H264Depacketizer _depacketizer;
+    Fmp4Muxer _muxer;
+    AsyncFilePtr _file;
+    std::string _header;            // ftyp/moov、moof 的缓冲，复用容量
+    std::string _lastPath;
+    int _pathSuffix;
+    uint32_t _lastTs;
+    uint32_t _lastDuration;
+    bool _hasLast;
+    bool _dropUntilKey;             // 丢过分片，等关键帧
+    uint64_t _segmentDuration;      // 当前文件已知时长（90kHz）
+    Stats _stats;
+};
+
+#endif
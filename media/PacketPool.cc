@@ -0,0 +1,213 @@
+#include "PacketPool.h"
+#include <atomic>
+#include <mutex>
+#include <new>
+extern "C"{
+#include "ikcp.h"
+}
+
+namespace {
+
+const size_t kBatch = 64;          // 线程缓存和全局链表之间一次交换的个数
+const size_t kHeader = 16;         // 内存块前面记录来源，释放时据此区分
+const uint32_t kFromSlab = 0x51ab51ab;
+const uint32_t kFromHeap = 0x4ea94ea9;
+
+struct BlockNode {
+    BlockNode *next;               // 空闲时借用块头的位置
+};
+
+struct PacketNode {
+    PacketNode *next;
+    std::string data;              // 回收时不释放，容量留给下一个报文
+    alignas(16) unsigned char ctrl[64];  // shared_ptr 的引用计数块
+};
+
+// 全局空闲链表，线程缓存成批存取
+template <typename Node>
+class FreeList {
+public:
+    void put(Node *head, Node *tail) {
+        std::lock_guard<std::mutex> lock(_mtx);
+        tail->next = _head;
+        _head = head;
+    }
+    // 取走最多 kBatch 个，个数写到 n
+    Node *take(size_t &n) {
+        std::lock_guard<std::mutex> lock(_mtx);
+        Node *head = _head;
+        Node *tail = nullptr;
+        n = 0;
+        for (Node *p = _head; p && n < kBatch; p = p->next) {
+            tail = p;
+            ++n;
+        }
+        if (tail) {
+            _head = tail->next;
+            tail->next = nullptr;
+        }
+        return head;
+    }
+
+private:
+    std::mutex _mtx;
+    Node *_head = nullptr;
+};
+
+template <typename Node>
+class LocalCache {
+public:
+    explicit LocalCache(FreeList<Node> *global) : _global(global) {}
+    // 线程退出时把缓存还给全局链表；之后（进程退出时的静态析构）再释放的只会留在这里
+    ~LocalCache() {
+        if (_head) {
+            Node *tail = _head;
+            while (tail->next) tail = tail->next;
+            _global->put(_head, tail);
+            _head = nullptr;
+            _count = 0;
+        }
+    }
+
+    Node *pop() {
+        if (!_head) {
+            _head = _global->take(_count);
+            if (!_head) return nullptr;
+        }
+        Node *n = _head;
+        _head = n->next;
+        --_count;
+        return n;
+    }
+
+    void push(Node *n) {
+        n->next = _head;
+        _head = n;
+        if (++_count >= 2 * kBatch) {
+            // 只释放不申请的线程（观看端 loop）攒多了，还一批给全局
+            Node *tail = _head;
+            for (size_t i = 1; i < kBatch; ++i) tail = tail->next;
+            Node *rest = tail->next;
+            _global->put(_head, tail);
+            _head = rest;
+            _count -= kBatch;
+        }
+    }
+
+private:
+    FreeList<Node> *_global;
+    Node *_head = nullptr;
+    size_t _count = 0;
+};
+
+FreeList<BlockNode> g_blocks;
+FreeList<PacketNode> g_packets;
+thread_local LocalCache<BlockNode> t_blocks(&g_blocks);
+thread_local LocalCache<PacketNode> t_packets(&g_packets);
+std::atomic<uint64_t> g_blockSlabs{0};
+std::atomic<uint64_t> g_packetSlabs{0};
+std::atomic<uint64_t> g_fallbacks{0};
+
+const size_t kStride = PacketPool::kBlockSize + kHeader;
+
+BlockNode *growBlocks() {
+    char *slab = static_cast<char *>(::operator new(PacketPool::kPerSlab * kStride, std::nothrow));
+    if (!slab) return nullptr;
+    g_blockSlabs.fetch_add(1, std::memory_order_relaxed);
+    // 第一块直接用，其余进本线程缓存（多出来的成批转给全局）
+    for (size_t i = PacketPool::kPerSlab - 1; i > 0; --i) {
+        t_blocks.push(reinterpret_cast<BlockNode *>(slab + i * kStride));
+    }
+    return reinterpret_cast<BlockNode *>(slab);
+}
+
+PacketNode *growPackets() {
+    PacketNode *slab = new (std::nothrow) PacketNode[PacketPool::kPerSlab];
+    if (!slab) return nullptr;
+    g_packetSlabs.fetch_add(1, std::memory_order_relaxed);
+    for (size_t i = PacketPool::kPerSlab - 1; i > 0; --i) {
+        t_packets.push(&slab[i]);
+    }
+    return &slab[0];
+}
+
+// 引用计数块放在节点自带的空间里；它析构之后才调 deallocate，这时整个节点都可以重用
+template <typename T>
+struct NodeAllocator {
+    using value_type = T;
+
+    explicit NodeAllocator(PacketNode *n) : node(n) {}
+    template <typename U>
+    NodeAllocator(const NodeAllocator<U> &other) : node(other.node) {}
+
+    T *allocate(size_t) {
+        static_assert(sizeof(T) <= sizeof(PacketNode::ctrl) && alignof(T) <= 16,
+                      "shared_ptr control block does not fit in PacketNode");
+        return reinterpret_cast<T *>(node->ctrl);
+    }
+    void deallocate(T *, size_t) { t_packets.push(node); }
+
+    PacketNode *node;
+};
+
+template <typename T, typename U>
+bool operator==(const NodeAllocator<T> &a, const NodeAllocator<U> &b) { return a.node == b.node; }
+template <typename T, typename U>
+bool operator!=(const NodeAllocator<T> &a, const NodeAllocator<U> &b) { return a.node != b.node; }
+
+// string 留在节点里，下一个报文直接覆盖
+struct KeepString {
+    void operator()(const std::string *) const {}
+};
+
+}
+
+void *PacketPool::allocate(size_t size) {
+    char *p;
+    if (size > kBlockSize) {
+        g_fallbacks.fetch_add(1, std::memory_order_relaxed);
+        p = static_cast<char *>(::operator new(size + kHeader, std::nothrow));
+        if (!p) return nullptr;
+        *reinterpret_cast<uint32_t *>(p) = kFromHeap;
+        return p + kHeader;
+    }
+    BlockNode *n = t_blocks.pop();
+    if (!n && !(n = growBlocks())) return nullptr;
+    p = reinterpret_cast<char *>(n);
+    *reinterpret_cast<uint32_t *>(p) = kFromSlab;
+    return p + kHeader;
+}
+
+void PacketPool::deallocate(void *ptr) {
+    if (!ptr) return;
+    char *p = static_cast<char *>(ptr) - kHeader;
+    if (*reinterpret_cast<uint32_t *>(p) == kFromHeap) {
+        ::operator delete(p);
+    } else {
+        t_blocks.push(reinterpret_cast<BlockNode *>(p));
+    }
+}
+
+BufferPtr PacketPool::makeBuffer(const char *data, size_t len) {
+    PacketNode *node = t_packets.pop();
+    if (!node && !(node = growPackets())) {
+        return std::make_shared<const std::string>(data, len);
+    }
+    if (node->data.capacity() < kPacketCapacity) {
+        node->data.reserve(kPacketCapacity);//节点第一次使用
+    }
+    node->data.assign(data, len);
+    return BufferPtr(&node->data, KeepString(), NodeAllocator<void>(node));
+}
+
+void PacketPool::installKcpAllocator() {
+    ikcp_allocator(&PacketPool::allocate, &PacketPool::deallocate);
+}
+
+PacketPool::Stats PacketPool::stats() {
+    Stats st;
+    st.blockSlabs = g_blockSlabs.load(std::memory_order_relaxed);
+    st.packetSlabs = g_packetSlabs.load(std::memory_order_relaxed);
+    st.fallbacks = g_fallbacks.load(std::memory_order_relaxed);
+    return st;
+}
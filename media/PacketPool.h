@@ -0,0 +1,37 @@
+#ifndef __PACKETPOOL_H__
+#define __PACKETPOOL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "BufferChain.h"
+
+// 数据通路上 MTU 大小报文的 slab 池，稳定推流时收发一个报文不再走 malloc：
+// - allocate/deallocate：固定 kBlockSize 的内存块，和 malloc/free 同语义，装给 ikcp_allocator，
+//   KCP 分片从这里分；超过块大小的（KCP 的发送缓冲、ACK 列表，只在建连和扩容时）交给 malloc
+// - makeBuffer：把收到的 RTP 报文拷成共享数据块，std::string 连同已经预留好的容量、
+//   shared_ptr 的引用计数块整体回收重用
+// 两种对象都是一次向系统要一片（kPerSlab 个），释放后挂回空闲链表，不还给系统。
+// 每个线程先用自己的空闲缓存，缓存空了或攒多了再和全局链表成批交换（一次加锁），
+// 在推流 loop 上申请、在观看端 loop 上释放的数据块也能回到池里
+class PacketPool {
+public:
+    static const size_t kBlockSize = 2048;      // 可用大小，放得下一个 KCP 分片（MTU 1450）连同分片头
+    static const size_t kPacketCapacity = 1600; // 共享数据块预留的容量，大于 MTU 的报文照常扩容
+    static const size_t kPerSlab = 256;
+
+    struct Stats {
+        uint64_t blockSlabs = 0;    // 向系统申请过的内存块片数
+        uint64_t packetSlabs = 0;   // 共享数据块的片数
+        uint64_t fallbacks = 0;     // 超过块大小转给 malloc 的次数
+    };
+
+    static void *allocate(size_t size);
+    static void deallocate(void *p);
+    static BufferPtr makeBuffer(const char *data, size_t len);
+
+    // 把 ikcp 的内存分配换成本池，必须在创建任何 ikcpcb 之前调用
+    static void installKcpAllocator();
+    static Stats stats();
+};
+
+#endif
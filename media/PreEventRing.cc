@@ -0,0 +1,81 @@
+#include "PreEventRing.h"
+#include "GopCache.h"
+
+PreEventRing::PreEventRing(uint32_t seconds, size_t maxBytes)
+:_span(seconds * 90000)
+,_maxBytes(maxBytes)
+,_bytes(0)
+,_paramCount(0)
+,_paramBytes(0)
+,_lastType(-1)
+,_lastTs(0){
+}
+
+uint32_t PreEventRing::rtpTimestamp(const std::string &rtp) {
+    if (rtp.size() < 8) return 0;
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(rtp.data());
+    return (uint32_t(p[4]) << 24) | (uint32_t(p[5]) << 16) | (uint32_t(p[6]) << 8) | p[7];
+}
+
+void PreEventRing::clear() {
+    _packets.clear();
+    _gops.clear();
+    _bytes = 0;
+    _paramCount = 0;
+    _paramBytes = 0;
+}
+
+uint32_t PreEventRing::duration() const {
+    return _gops.empty() ? 0 : _lastTs - _gops.front().timestamp;
+}
+
+void PreEventRing::onPacket(const BufferPtr &pkt) {
+    bool start;
+    int type = GopCache::nalType(*pkt, &start);
+    uint32_t ts = rtpTimestamp(*pkt);
+    bool param = type == 6 || type == 7 || type == 8;
+    if (type == 5 && start && (_lastType != 5 || ts != _lastTs)) {
+        // 新 GOP：从前面紧挨着的参数集开始
+        if (!_gops.empty()) {
+            _gops.back().count -= _paramCount;
+            _gops.back().bytes -= _paramBytes;
+        }
+        _gops.push_back(Gop{_paramCount, _paramBytes, ts});
+    } else if (_gops.empty() && !param) {
+        clear();//还没等到 IDR
+        _lastType = type;
+        return;
+    }
+    _packets.push_back(pkt);
+    _bytes += pkt->size();
+    if (!_gops.empty()) {
+        _gops.back().count++;
+        _gops.back().bytes += pkt->size();
+    }
+    if (param) {
+        _paramCount++;
+        _paramBytes += pkt->size();
+    } else {
+        _paramCount = 0;
+        _paramBytes = 0;
+        _lastType = type;
+        _lastTs = ts;
+    }
+
+    // 第二个 GOP 起已经够 N 秒时，最早的 GOP 就用不上了
+    while (_gops.size() > 1 &&
+           (_lastTs - _gops[1].timestamp >= _span || _bytes > _maxBytes)) {
+        popFront();
+    }
+    if (_bytes > _maxBytes) {
+        clear();
+        _lastType = -1;
+    }
+}
+
+void PreEventRing::popFront() {
+    const Gop &gop = _gops.front();
+    _packets.erase(_packets.begin(), _packets.begin() + gop.count);
+    _bytes -= gop.bytes;
+    _gops.pop_front();
+}
@@ -0,0 +1,47 @@
+#ifndef __PREEVENTRING_H__
+#define __PREEVENTRING_H__
+
+#include <deque>
+#include <stdint.h>
+#include "BufferChain.h"
+
+// 每路流最近 N 秒的 RTP 报文，按 GOP 对齐：总是从某个 IDR（连同紧挨着的 SPS/PPS/SEI）开始，
+// 超过时长或字节上限时从头部整 GOP 淘汰，剩下的至少覆盖 N 秒（只剩一个 GOP 时除外）。
+// 报文是与分发共用的引用计数数据块，这里只多持有引用，不拷贝。
+// 单个 GOP 就超过字节上限时整体清空，等下一个 IDR
+class PreEventRing {
+public:
+    PreEventRing(uint32_t seconds, size_t maxBytes);
+
+    void onPacket(const BufferPtr &pkt);
+    void clear();
+
+    const std::deque<BufferPtr> &packets() const { return _packets; }
+    size_t bytes() const { return _bytes; }
+    size_t gopCount() const { return _gops.size(); }
+    // 缓存覆盖的时长（最早 GOP 开头到最新报文，90kHz）
+    uint32_t duration() const;
+
+    static uint32_t rtpTimestamp(const std::string &rtp);
+
+private:
+    struct Gop {
+        size_t count;       // 报文数
+        size_t bytes;
+        uint32_t timestamp; // IDR 的 RTP 时间戳
+    };
+
+    void popFront();
+
+    uint32_t _span;         // N 秒（90kHz）
+    size_t _maxBytes;
+    std::deque<BufferPtr> _packets;
+    std::deque<Gop> _gops;
+    size_t _bytes;
+    size_t _paramCount;     // 末尾连续的参数集报文，下一个 IDR 到来时归入新 GOP
+    size_t _paramBytes;
+    int _lastType;          // 上一个非参数集报文的 NAL 类型
+    uint32_t _lastTs;
+};
+
+#endif
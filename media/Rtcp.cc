@@ -0,0 +1,324 @@
+#include "Rtcp.h"
+#include <chrono>
+
+static const uint64_t kNtpUnixOffset = 2208988800ULL; // 1900 到 1970 的秒数
+static const uint32_t kSeqMod = 1u << 16;
+static const uint32_t kMaxDropout = 3000;
+static const uint32_t kMaxMisorder = 100;
+
+static void put8(std::string &out, uint8_t v) {
+    out.push_back(static_cast<char>(v));
+}
+
+static void put16(std::string &out, uint16_t v) {
+    out.push_back(static_cast<char>(v >> 8));
+    out.push_back(static_cast<char>(v));
+}
+
+static void put32(std::string &out, uint32_t v) {
+    put16(out, static_cast<uint16_t>(v >> 16));
+    put16(out, static_cast<uint16_t>(v));
+}
+
+static uint16_t get16(const uint8_t *p) {
+    return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+static uint32_t get32(const uint8_t *p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+}
+
+// 公共头：V=2，count 为 RC/SC，length 为包长（32 位字数）减一
+static void putHeader(std::string &out, int count, int type, size_t bytes) {
+    put8(out, static_cast<uint8_t>(0x80 | (count & 0x1F)));
+    put8(out, static_cast<uint8_t>(type));
+    put16(out, static_cast<uint16_t>(bytes / 4 - 1));
+}
+
+static void putBlocks(std::string &out, const RtcpReportBlock *blocks, int count) {
+    for (int i = 0; i < count; ++i) {
+        const RtcpReportBlock &b = blocks[i];
+        put32(out, b.ssrc);
+        put8(out, b.fractionLost);
+        uint32_t lost = static_cast<uint32_t>(b.cumulativeLost) & 0xFFFFFF;
+        put8(out, static_cast<uint8_t>(lost >> 16));
+        put16(out, static_cast<uint16_t>(lost));
+        put32(out, b.highestSeq);
+        put32(out, b.jitter);
+        put32(out, b.lsr);
+        put32(out, b.dlsr);
+    }
+}
+
+static void parseBlocks(const uint8_t *p, int count, RtcpMessage &out) {
+    for (int i = 0; i < count && out.blockCount < RtcpMessage::kMaxBlocks; ++i, p += 24) {
+        RtcpReportBlock &b = out.blocks[out.blockCount++];
+        b.ssrc = get32(p);
+        b.fractionLost = p[4];
+        uint32_t lost = (uint32_t(p[5]) << 16) | get16(p + 6);
+        if (lost & 0x800000) lost |= 0xFF000000;//24 位有符号扩展
+        b.cumulativeLost = static_cast<int32_t>(lost);
+        b.highestSeq = get32(p + 8);
+        b.jitter = get32(p + 12);
+        b.lsr = get32(p + 16);
+        b.dlsr = get32(p + 20);
+    }
+}
+
+uint64_t Rtcp::ntpNow() {
+    using namespace std::chrono;
+    uint64_t us = duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+    uint64_t sec = us / 1000000 + kNtpUnixOffset;
+    uint64_t frac = ((us % 1000000) << 32) / 1000000;
+    return (sec << 32) | frac;
+}
+
+size_t Rtcp::writeSenderReport(std::string &out, uint32_t ssrc, const RtcpSenderInfo &info,
+                               const RtcpReportBlock *blocks, int count) {
+    size_t bytes = 28 + 24 * count;
+    putHeader(out, count, SR, bytes);
+    put32(out, ssrc);
+    put32(out, static_cast<uint32_t>(info.ntp >> 32));
+    put32(out, static_cast<uint32_t>(info.ntp));
+    put32(out, info.rtpTimestamp);
+    put32(out, info.packets);
+    put32(out, info.octets);
+    putBlocks(out, blocks, count);
+    return bytes;
+}
+
+size_t Rtcp::writeReceiverReport(std::string &out, uint32_t ssrc, const RtcpReportBlock *blocks, int count) {
+    size_t bytes = 8 + 24 * count;
+    putHeader(out, count, RR, bytes);
+    put32(out, ssrc);
+    putBlocks(out, blocks, count);
+    return bytes;
+}
+
+size_t Rtcp::writeSdes(std::string &out, uint32_t ssrc, const std::string &cname) {
+    size_t nameLen = cname.size() > 255 ? 255 : cname.size();
+    // SSRC + CNAME 项 + 结束项，补零到 32 位对齐（至少一个零字节）
+    size_t chunk = 4 + 2 + nameLen + 1;
+    chunk = (chunk + 3) & ~size_t(3);
+    size_t bytes = 4 + chunk;
+    putHeader(out, 1, SDES, bytes);
+    put32(out, ssrc);
+    put8(out, 1);//CNAME
+    put8(out, static_cast<uint8_t>(nameLen));
+    out.append(cname.data(), nameLen);
+    out.append(chunk - 6 - nameLen, '\0');
+    return bytes;
+}
+
+size_t Rtcp::writeBye(std::string &out, uint32_t ssrc) {
+    putHeader(out, 1, BYE, 8);
+    put32(out, ssrc);
+    return 8;
+}
+
+bool Rtcp::parse(const uint8_t *data, size_t len, RtcpMessage &out) {
+    out = RtcpMessage();
+    bool first = true;
+    while (len >= 4) {
+        if ((data[0] & 0xC0) != 0x80) return false;
+        int count = data[0] & 0x1F;
+        int type = data[1];
+        size_t bytes = (size_t(get16(data + 2)) + 1) * 4;
+        if (bytes > len) return false;
+        if (first && type != SR && type != RR) return false;
+        first = false;
+        if (type == SR && bytes >= 28 + 24u * count) {
+            out.ssrc = get32(data + 4);
+            out.hasSenderInfo = true;
+            out.sender.ntp = (uint64_t(get32(data + 8)) << 32) | get32(data + 12);
+            out.sender.rtpTimestamp = get32(data + 16);
+            out.sender.packets = get32(data + 20);
+            out.sender.octets = get32(data + 24);
+            parseBlocks(data + 28, count, out);
+        } else if (type == RR && bytes >= 8 + 24u * count) {
+            out.ssrc = get32(data + 4);
+            parseBlocks(data + 8, count, out);
+        } else if (type == BYE) {
+            out.bye = true;
+        }
+        data += bytes;
+        len -= bytes;
+    }
+    return !first;
+}
+
+RtcpReceiver::RtcpReceiver(uint32_t clockRate)
+:_clockRate(clockRate)
+,_started(false)
+,_ssrc(0)
+,_maxSeq(0)
+,_cycles(0)
+,_baseSeq(0)
+,_badSeq(kSeqMod + 1)
+,_received(0)
+,_octets(0)
+,_expectedPrior(0)
+,_receivedPrior(0)
+,_lastTransit(0)
+,_jitter16(0)
+,_fractionLost(0)
+,_cumulativeLost(0)
+,_lsr(0)
+,_lastSrNtp(0){
+}
+
+void RtcpReceiver::resetSeq(uint16_t seq) {
+    _baseSeq = seq;
+    _maxSeq = seq;
+    _badSeq = kSeqMod + 1;
+    _cycles = 0;
+    _received = 0;
+    _receivedPrior = 0;
+    _expectedPrior = 0;
+}
+
+void RtcpReceiver::onRtp(const uint8_t *data, size_t len, uint32_t nowMs) {
+    if (len < 12 || (data[0] & 0xC0) != 0x80) {
+        return;
+    }
+    uint16_t seq = get16(data + 2);
+    uint32_t ts = get32(data + 4);
+    uint32_t ssrc = get32(data + 8);
+    int32_t transit = static_cast<int32_t>(static_cast<uint32_t>(uint64_t(nowMs) * _clockRate / 1000) - ts);
+    if (!_started || ssrc != _ssrc) {
+        // 第一个包，或推流端重启换了 SSRC：重新统计
+        _started = true;
+        _ssrc = ssrc;
+        resetSeq(seq);
+        _jitter16 = 0;
+        _lastTransit = transit;
+        _lsr = 0;
+    } else {
+        // RFC 3550 A.1：跳变太大的序号连续出现两次才认为是重新开始
+        uint16_t udelta = static_cast<uint16_t>(seq - _maxSeq);
+        if (udelta < kMaxDropout) {
+            if (seq < _maxSeq) {
+                _cycles += kSeqMod;
+            }
+            _maxSeq = seq;
+        } else if (udelta <= kSeqMod - kMaxMisorder) {
+            if (seq == _badSeq) {
+                resetSeq(seq);
+            } else {
+                _badSeq = (seq + 1) & (kSeqMod - 1);
+                return;
+            }
+        }
+        // 其余是重复或乱序的包，照常计数
+        int32_t d = transit - _lastTransit;
+        if (d < 0) d = -d;
+        _jitter16 += d - ((_jitter16 + 8) >> 4);
+        _lastTransit = transit;
+    }
+    ++_received;
+    _octets += len - 12;
+}
+
+void RtcpReceiver::onSenderReport(const RtcpSenderInfo &info, uint64_t nowNtp) {
+    _lastSr = info;
+    _lsr = Rtcp::ntpMiddle(info.ntp);
+    _lastSrNtp = nowNtp;
+}
+
+bool RtcpReceiver::makeReport(RtcpReportBlock &block, uint64_t nowNtp) {
+    if (!_started) {
+        return false;
+    }
+    // RFC 3550 A.3
+    uint32_t extendedMax = _cycles + _maxSeq;
+    uint32_t expected = extendedMax - _baseSeq + 1;
+    int64_t lost = int64_t(expected) - int64_t(_received);
+    if (lost > 0x7FFFFF) lost = 0x7FFFFF;
+    if (lost < -0x800000) lost = -0x800000;
+    _cumulativeLost = static_cast<int32_t>(lost);
+    uint32_t expectedInterval = expected - _expectedPrior;
+    _expectedPrior = expected;
+    int64_t receivedInterval = int64_t(_received - _receivedPrior);
+    _receivedPrior = _received;
+    int64_t lostInterval = int64_t(expectedInterval) - receivedInterval;
+    _fractionLost = (expectedInterval == 0 || lostInterval <= 0)
+                    ? 0 : static_cast<uint8_t>((lostInterval << 8) / expectedInterval);
+
+    block.ssrc = _ssrc;
+    block.fractionLost = _fractionLost;
+    block.cumulativeLost = _cumulativeLost;
+    block.highestSeq = extendedMax;
+    block.jitter = static_cast<uint32_t>(_jitter16 >> 4);
+    block.lsr = _lsr;
+    block.dlsr = _lsr ? static_cast<uint32_t>((nowNtp - _lastSrNtp) >> 16) : 0;
+    return true;
+}
+
+void RtcpReceiver::fillStats(RtcpStats &stats) const {
+    stats.packets = _received;
+    stats.octets = _octets;
+    stats.fractionLost = _fractionLost;
+    stats.cumulativeLost = _cumulativeLost;
+    stats.jitter = static_cast<uint32_t>(_jitter16 >> 4);
+    stats.peerNtp = _lastSr.ntp;
+    stats.peerRtpTimestamp = _lastSr.rtpTimestamp;
+}
+
+RtcpSender::RtcpSender(uint32_t clockRate)
+:_clockRate(clockRate)
+,_ssrc(0)
+,_packets(0)
+,_octets(0)
+,_mapping(0)
+,_rttMs(-1){
+}
+
+void RtcpSender::onRtp(const BufferPtr &pkt, uint32_t nowMs) {
+    if (pkt->size() < 12) {
+        return;
+    }
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(pkt->data());
+    _ssrc.store(get32(p + 8), std::memory_order_relaxed);
+    _octets.fetch_add(pkt->size() - 12, std::memory_order_relaxed);
+    _mapping.store((uint64_t(get32(p + 4)) << 32) | nowMs, std::memory_order_relaxed);
+    _packets.fetch_add(1, std::memory_order_release);
+}
+
+bool RtcpSender::makeSenderInfo(RtcpSenderInfo &info, uint32_t &ssrc, uint64_t nowNtp, uint32_t nowMs) const {
+    uint64_t packets = _packets.load(std::memory_order_acquire);
+    if (packets == 0) {
+        return false;
+    }
+    // 最近转发的包的 RTP 时间戳按时钟频率外推到现在，和 NTP 时间成对
+    uint64_t mapping = _mapping.load(std::memory_order_relaxed);
+    uint32_t elapsed = nowMs - static_cast<uint32_t>(mapping);
+    info.ntp = nowNtp;
+    info.rtpTimestamp = static_cast<uint32_t>(mapping >> 32) + static_cast<uint32_t>(uint64_t(elapsed) * _clockRate / 1000);
+    info.packets = static_cast<uint32_t>(packets);
+    info.octets = static_cast<uint32_t>(_octets.load(std::memory_order_relaxed));
+    ssrc = _ssrc.load(std::memory_order_relaxed);
+    return true;
+}
+
+void RtcpSender::onReceiverReport(const RtcpReportBlock &block, uint64_t nowNtp) {
+    if (block.ssrc != mediaSsrc()) {
+        return;
+    }
+    _lastReport = block;
+    if (block.lsr != 0) {
+        // RTT = 收到 RR 的时间 - LSR - DLSR，单位 1/65536 秒
+        uint32_t rtt = Rtcp::ntpMiddle(nowNtp) - block.lsr - block.dlsr;
+        if (static_cast<int32_t>(rtt) >= 0) {
+            _rttMs = static_cast<int32_t>((uint64_t(rtt) * 1000) >> 16);
+        }
+    }
+}
+
+void RtcpSender::fillStats(RtcpStats &stats) const {
+    stats.packets = _packets.load(std::memory_order_relaxed);
+    stats.octets = _octets.load(std::memory_order_relaxed);
+    stats.fractionLost = _lastReport.fractionLost;
+    stats.cumulativeLost = _lastReport.cumulativeLost;
+    stats.jitter = _lastReport.jitter;
+    stats.rttMs = _rttMs;
+}
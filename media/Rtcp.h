@@ -0,0 +1,137 @@
+#ifndef __RTCP_H__
+#define __RTCP_H__
+
+#include <atomic>
+#include <string>
+#include <stdint.h>
+#include <stddef.h>
+#include "BufferChain.h"
+
+// RTCP（RFC 3550）：SR/RR/SDES/BYE 复合包的生成与解析，以及收发两端的统计。
+// 推流会话里服务器是接收端（RtcpReceiver，回 RR），拉流会话里是发送端（RtcpSender，发 SR、从 RR 算 RTT）
+
+struct RtcpReportBlock {
+    uint32_t ssrc = 0;              // 被报告的媒体源
+    uint8_t fractionLost = 0;       // 上个报告间隔的丢包比例 x256
+    int32_t cumulativeLost = 0;     // 24 位有符号
+    uint32_t highestSeq = 0;        // 扩展最大序号（高 16 位是回绕次数）
+    uint32_t jitter = 0;            // 到达间隔抖动，RTP 时钟单位
+    uint32_t lsr = 0;               // 最近收到的 SR 的 NTP 中间 32 位
+    uint32_t dlsr = 0;              // 收到那个 SR 到发出本报告的间隔，1/65536 秒
+};
+
+struct RtcpSenderInfo {
+    uint64_t ntp = 0;               // 与 rtpTimestamp 对应的墙上时间
+    uint32_t rtpTimestamp = 0;
+    uint32_t packets = 0;
+    uint32_t octets = 0;            // 只算负载
+};
+
+// 一个复合包解析出来的内容，报告块只留前几个（单路视频只会有一个）
+struct RtcpMessage {
+    static const int kMaxBlocks = 4;
+    uint32_t ssrc = 0;              // SR/RR 的发送者
+    bool hasSenderInfo = false;
+    RtcpSenderInfo sender;
+    int blockCount = 0;
+    RtcpReportBlock blocks[kMaxBlocks];
+    bool bye = false;
+};
+
+// 一个会话的 RTCP 统计，报告间隔刷新一次到 SessionManager
+struct RtcpStats {
+    uint64_t packets = 0;           // 收到（推流）或发出（拉流）的 RTP 包
+    uint64_t octets = 0;
+    uint8_t fractionLost = 0;       // 推流：本端算出的；拉流：播放端 RR 报的
+    int32_t cumulativeLost = 0;
+    uint32_t jitter = 0;            // 90kHz
+    int32_t rttMs = -1;             // 拉流：由 RR 的 LSR/DLSR 算出，-1 表示还没有
+    uint64_t peerNtp = 0;           // 推流：摄像头最近一个 SR 的 NTP/RTP 时间对应关系
+    uint32_t peerRtpTimestamp = 0;
+    uint32_t reportsSent = 0;
+    uint32_t reportsReceived = 0;
+};
+
+class Rtcp {
+public:
+    enum { SR = 200, RR = 201, SDES = 202, BYE = 203 };
+
+    // 当前墙上时间的 NTP 64 位表示（1900 年起，高 32 位秒，低 32 位小数）
+    static uint64_t ntpNow();
+    static uint32_t ntpMiddle(uint64_t ntp) { return static_cast<uint32_t>(ntp >> 16); }
+
+    // 以下写入函数都追加到 out，返回追加的字节数
+    static size_t writeSenderReport(std::string &out, uint32_t ssrc, const RtcpSenderInfo &info,
+                                    const RtcpReportBlock *blocks, int count);
+    static size_t writeReceiverReport(std::string &out, uint32_t ssrc,
+                                      const RtcpReportBlock *blocks, int count);
+    static size_t writeSdes(std::string &out, uint32_t ssrc, const std::string &cname);
+    static size_t writeBye(std::string &out, uint32_t ssrc);
+
+    // 解析复合包，首个包不是 SR/RR 或长度不对时返回 false
+    static bool parse(const uint8_t *data, size_t len, RtcpMessage &out);
+};
+
+// RTP 接收端的统计（RFC 3550 A.1 序号、A.3 丢包、A.8 抖动），生成 RR 的报告块。
+// 只在摄像头所在 loop 线程里使用
+class RtcpReceiver {
+public:
+    explicit RtcpReceiver(uint32_t clockRate = 90000);
+
+    void onRtp(const uint8_t *data, size_t len, uint32_t nowMs);
+    void onSenderReport(const RtcpSenderInfo &info, uint64_t nowNtp);
+    // 还没收到 RTP 时返回 false；会开始新的丢包统计间隔
+    bool makeReport(RtcpReportBlock &block, uint64_t nowNtp);
+    void fillStats(RtcpStats &stats) const;
+    // 按扩展最大序号应收的包数和实收包数、负载字节数，供 RR 之外按自己的间隔取差值（码率反馈）
+    uint32_t expected() const { return _started ? _cycles + _maxSeq - _baseSeq + 1 : 0; }
+    uint64_t received() const { return _received; }
+    uint64_t octets() const { return _octets; }
+
+private:
+    void resetSeq(uint16_t seq);
+
+    uint32_t _clockRate;
+    bool _started;
+    uint32_t _ssrc;
+    uint16_t _maxSeq;
+    uint32_t _cycles;               // 回绕次数 << 16
+    uint32_t _baseSeq;
+    uint32_t _badSeq;
+    uint64_t _received;
+    uint64_t _octets;
+    uint32_t _expectedPrior;
+    uint64_t _receivedPrior;
+    int32_t _lastTransit;
+    int32_t _jitter16;              // 抖动 x16，RFC 3550 的定点算法
+    uint8_t _fractionLost;
+    int32_t _cumulativeLost;
+    uint32_t _lsr;
+    uint64_t _lastSrNtp;            // 收到最近 SR 时本端的 NTP 时间，算 DLSR 用
+    RtcpSenderInfo _lastSr;
+};
+
+// RTP 发送端（向播放端转发）：计数和 NTP/RTP 时间对应关系，生成 SR；由播放端的 RR 算 RTT。
+// onRtp 在推流所在 loop 上调用，其余在会话所在 loop 上调用，两边只通过原子变量交换
+class RtcpSender {
+public:
+    explicit RtcpSender(uint32_t clockRate = 90000);
+
+    void onRtp(const BufferPtr &pkt, uint32_t nowMs);
+    // 还没有转发过 RTP 时返回 false
+    bool makeSenderInfo(RtcpSenderInfo &info, uint32_t &ssrc, uint64_t nowNtp, uint32_t nowMs) const;
+    uint32_t mediaSsrc() const { return _ssrc.load(std::memory_order_relaxed); }
+    void onReceiverReport(const RtcpReportBlock &block, uint64_t nowNtp);
+    void fillStats(RtcpStats &stats) const;
+
+private:
+    uint32_t _clockRate;
+    std::atomic<uint32_t> _ssrc;    // 转发的是推流端的 RTP，SR 也用它的 SSRC
+    std::atomic<uint64_t> _packets;
+    std::atomic<uint64_t> _octets;
+    std::atomic<uint64_t> _mapping; // 最近一个包的 RTP 时间戳 << 32 | 转发时的 steady 毫秒
+    RtcpReportBlock _lastReport;
+    int32_t _rttMs;
+};
+
+#endif
@@ -0,0 +1,167 @@
+#include "RtpJitterBuffer.h"
+#include "Logger.h"
+#include "PacketPool.h"
+#include <chrono>
+
+RtpJitterBuffer::Options &RtpJitterBuffer::options() {
+    static Options options;
+    return options;
+}
+
+uint32_t RtpJitterBuffer::nowMs() {
+    using namespace std::chrono;
+    return (uint32_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+RtpJitterBuffer::RtpJitterBuffer(const Options &options)
+:_options(options)
+,_slots(kSlots)
+,_started(false)
+,_nextSeq(0)
+,_highestSeq(0)
+,_buffered(0)
+,_hasTransit(false)
+,_lastTransit(0)
+,_jitter16(0)
+,_hasReleased(false)
+,_lastTs(0)
+,_lastMarker(false)
+,_gap(false)
+,_frameBroken(false){
+}
+
+void RtpJitterBuffer::input(const char *data, size_t len, uint32_t now) {
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(data);
+    if (len < 12 || (p[0] & 0xC0) != 0x80) {
+        return;//不是 RTP v2
+    }
+    uint16_t seq = (uint16_t(p[2]) << 8) | p[3];
+    uint32_t ts = (uint32_t(p[4]) << 24) | (uint32_t(p[5]) << 16) | (uint32_t(p[6]) << 8) | p[7];
+    ++_stats.received;
+
+    // RFC 3550 A.8，到达时间换算成 90kHz
+    int32_t transit = static_cast<int32_t>(now * 90u - ts);
+    if (_hasTransit) {
+        int32_t d = transit - _lastTransit;
+        if (d < 0) d = -d;
+        _jitter16 += d - ((_jitter16 + 8) >> 4);
+        _stats.jitter = _jitter16 >> 4;
+    }
+    _lastTransit = transit;
+    _hasTransit = true;
+
+    if (!_started) {
+        _started = true;
+        _nextSeq = _highestSeq = seq;
+    }
+    int16_t diff = static_cast<int16_t>(seq - _nextSeq);
+    if (diff < 0 && diff > -static_cast<int>(kSlots)) {
+        ++_stats.late;//位置已经放出去了
+        return;
+    }
+    if (diff < 0 || static_cast<size_t>(diff) >= kSlots) {
+        // 序号跳变（推流端重启等），放出积压的包后从这个包重新开始
+        LOG_WARN("RtpJitterBuffer: seq jump %u -> %u, resync", _nextSeq, seq);
+        flush();
+        _nextSeq = _highestSeq = seq;
+    }
+    Slot &s = slot(seq);
+    if (s.pkt) {
+        ++_stats.duplicates;
+        return;
+    }
+    if (static_cast<int16_t>(seq - _highestSeq) < 0) {
+        ++_stats.reordered;
+    } else {
+        _highestSeq = seq;
+    }
+    s.pkt = PacketPool::makeBuffer(data, len);
+    s.arrival = now;
+    s.timestamp = ts;
+    s.marker = (p[1] & 0x80) != 0;
+    ++_buffered;
+}
+
+size_t RtpJitterBuffer::completeFrame() {
+    const Slot &head = slot(_nextSeq);
+    if (!head.pkt) return 0;
+    for (size_t n = 0; n < kSlots; ) {
+        const Slot &s = slot(static_cast<uint16_t>(_nextSeq + n));
+        if (!s.pkt) return 0;
+        if (s.timestamp != head.timestamp) return n;//下一帧的首包已到，本帧没有 marker 也算结束
+        ++n;
+        if (s.marker) return n;
+    }
+    return 0;
+}
+
+int RtpJitterBuffer::poll(uint32_t now) {
+    while (_buffered > 0) {
+        size_t n = completeFrame();
+        if (n > 0) {
+            release(n);
+            continue;
+        }
+        // 队头的帧不完整：从缺口后第一个到达的包算起等 depthMs
+        uint16_t seq = _nextSeq;
+        while (!slot(seq).pkt) ++seq;
+        const Slot &first = slot(seq);
+        int32_t wait = static_cast<int32_t>(first.arrival + _options.depthMs - now);
+        if (wait > 0) {
+            return wait;
+        }
+        // 超时：跳过缺口，放出这一帧已有的连续部分
+        release(static_cast<uint16_t>(seq - _nextSeq));
+        uint32_t ts = first.timestamp;
+        size_t m = 0;
+        for (uint16_t s = seq; slot(s).pkt && slot(s).timestamp == ts; ++s) {
+            ++m;
+            if (slot(s).marker) break;
+        }
+        release(m);
+    }
+    return -1;
+}
+
+void RtpJitterBuffer::flush() {
+    if (_buffered > 0) {
+        release(static_cast<uint16_t>(_highestSeq - _nextSeq) + 1);
+    }
+}
+
+void RtpJitterBuffer::release(size_t n) {
+    for (size_t i = 0; i < n; ++i, ++_nextSeq) {
+        Slot &s = slot(_nextSeq);
+        if (!s.pkt) {
+            ++_stats.lost;
+            _gap = true;
+            continue;
+        }
+        emit(s);
+        s.pkt.reset();
+        --_buffered;
+    }
+}
+
+void RtpJitterBuffer::emit(const Slot &s) {
+    // 帧按时间戳划分；缺口在新帧之前时，上一帧没收到 marker 算上一帧残缺，否则算这一帧残缺
+    bool newFrame = !_hasReleased || s.timestamp != _lastTs;
+    if (newFrame) {
+        if (_hasReleased && (_frameBroken || (_gap && !_lastMarker))) {
+            if (_stats.incompleteFrames++ % 100 == 0) {
+                LOG_WARN("RtpJitterBuffer: %lu incomplete frames, %lu packets lost, %lu late",
+                         (unsigned long)_stats.incompleteFrames, (unsigned long)_stats.lost,
+                         (unsigned long)_stats.late);
+            }
+        }
+        ++_stats.frames;
+        _frameBroken = _gap && (_lastMarker || !_hasReleased);
+    } else if (_gap) {
+        _frameBroken = true;
+    }
+    _gap = false;
+    _lastTs = s.timestamp;
+    _lastMarker = s.marker;
+    _hasReleased = true;
+    _packetCb(s.pkt);
+}
@@ -0,0 +1,81 @@
+#ifndef __RTPJITTERBUFFER_H__
+#define __RTPJITTERBUFFER_H__
+
+#include <functional>
+#include <vector>
+#include <stdint.h>
+#include "BufferChain.h"
+
+// 普通 RTP/UDP 推流的重排缓冲：按序号放进环形槽位，一个访问单元（同一时间戳，到 marker 为止）
+// 连续收齐后按序号整帧放出；中间缺包时最多等 depthMs，超时跳过缺口，把已有的部分放出去
+// （残缺帧交给下游的 H264Depacketizer 按序号缺口丢弃、等关键帧）。
+// 同时统计丢包、迟到、重复、乱序和 RFC 3550 的到达间隔抖动。
+// 只在摄像头所在 loop 线程里使用
+class RtpJitterBuffer {
+public:
+    struct Options {
+        uint32_t depthMs = 100;             // 缺包时最多等待的时间，0 表示不重排
+    };
+    struct Stats {
+        uint64_t received = 0;
+        uint64_t lost = 0;                  // 超时仍未到、被跳过的序号
+        uint64_t late = 0;                  // 所在位置已经放出后才到的包（丢弃）
+        uint64_t duplicates = 0;
+        uint64_t reordered = 0;             // 比已收到的最大序号小的包
+        uint64_t frames = 0;                // 放出的访问单元
+        uint64_t incompleteFrames = 0;      // 其中有缺包的
+        uint32_t jitter = 0;                // 到达间隔抖动，90kHz
+    };
+    static const size_t kSlots = 1024;      // 序号窗口，超出视为重新同步
+    using PacketCallback = std::function<void(const BufferPtr &)>;
+
+    // 进程级配置，main 里在 loop 启动前设置
+    static Options &options();
+    static uint32_t nowMs();
+
+    explicit RtpJitterBuffer(const Options &options);
+
+    void setPacketCallback(PacketCallback &&cb) { _packetCb = std::move(cb); }
+    void input(const char *data, size_t len, uint32_t now);
+    // 放出已经收齐或等待超时的帧；返回下一次需要调用的时间距现在的毫秒数，-1 表示没有积压
+    int poll(uint32_t now);
+    // 流结束：按序放出所有积压的包
+    void flush();
+
+    const Stats &stats() const { return _stats; }
+
+private:
+    struct Slot {
+        BufferPtr pkt;
+        uint32_t arrival;
+        uint32_t timestamp;
+        bool marker;
+    };
+
+    Slot &slot(uint16_t seq) { return _slots[seq % kSlots]; }
+    // 从 _nextSeq 开始的一个完整帧（连续、以 marker 或下一帧的首包结束）的包数，不完整返回 0
+    size_t completeFrame();
+    // 放出 n 个序号，缺的记为丢失
+    void release(size_t n);
+    void emit(const Slot &s);
+
+    Options _options;
+    PacketCallback _packetCb;
+    std::vector<Slot> _slots;
+    bool _started;
+    uint16_t _nextSeq;              // 下一个要放出的序号
+    uint16_t _highestSeq;           // 收到的最大序号（按回绕比较）
+    size_t _buffered;
+    bool _hasTransit;
+    int32_t _lastTransit;
+    int32_t _jitter16;              // 抖动 x16，RFC 3550 的定点算法
+    // 残缺帧统计
+    bool _hasReleased;
+    uint32_t _lastTs;
+    bool _lastMarker;
+    bool _gap;                      // 上次放出之后跳过了序号
+    bool _frameBroken;
+    Stats _stats;
+};
+
+#endif
@@ -2,25 +2,68 @@
 #include "TcpConnection.h"
 #include "UdpConnection.h"
 #include "Logger.h"
-#include <sstream>
 #include <algorithm>
 #include <cstdlib>
 #include <ctime>
 #include <cstring>
+#include <functional>
+#include <mutex>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <vector>
 #include "MonitorServer.h"
+#include "KcpScheduler.h"
+#include "StreamRegistry.h"
 
 SessionManager RtspConnect::_sessionManager;
+static const int kRtcpIntervalMs = 5000; // RTCP 报告间隔，单路视频带宽很小，不按 RFC 3550 的带宽比例算
+static const int kFeedbackIntervalMs = 1000; // 码率反馈间隔，比 RR 密，弱网时几秒内就能降下来
+
+// TCP 观看端发送链积压超过这个字节数就丢包，直到下一个关键帧；要放得下新观看端先收到的整个 GOP
+static const size_t kMaxSinkBacklog = 2 * GopCache::kMaxBytes;
+
+namespace {
+// 观看端的跨线程发送批：推流 loop 上攒报文，一批只投递一个发送任务到观看端 loop，
+// 任务执行时把这段时间攒下的报文一起发出（UDP 一次 sendmmsg）
+struct SinkBatch {
+    std::mutex mtx;
+    std::vector<BufferPtr> pending;
+    bool flushQueued = false;
+    // 以下只在观看端 loop 上访问
+    bool dropping = false;      // 积压过多，丢到下一个关键帧
+    uint64_t dropped = 0;
+
+    // 推流 loop 上调用，返回 true 时由调用方投递发送任务
+    bool push(const BufferPtr &buf) {
+        std::lock_guard<std::mutex> lock(mtx);
+        pending.push_back(buf);
+        if (flushQueued) return false;//前一个发送任务还没执行，会一并带走
+        flushQueued = true;
+        return true;
+    }
+    void take(std::vector<BufferPtr> &packets) {
+        std::lock_guard<std::mutex> lock(mtx);
+        packets.swap(pending);
+        flushQueued = false;
+    }
+};
+}
 
 RtspConnect::RtspConnect(std::shared_ptr<TcpConnection> tcpConn, EventLoop* loop)
     : _tcpConn(tcpConn)
     , _loop(loop)
     , _state(RtspState::INIT)
     , _clientIp(tcpConn->getPeerAddr().ip())
-    , _serverIp(tcpConn->getLocalAddr().ip()){
+    , _serverIp(tcpConn->getLocalAddr().ip())
+    , _camKcp(nullptr)
+    , _fanout(std::make_shared<StreamFanout>(loop)){
 
     _session.sessionId = _sessionManager.generateSessionId();
     _session.lastActive = std::chrono::steady_clock::now();
+    _session.clientIp = _clientIp;
     _sessionManager.addSession(_session);
+    _rtcpSsrc = static_cast<uint32_t>(std::hash<std::string>()(_session.sessionId));
     // _RtpUnpacker = std::make_unique<RtpH264Unpacker>();
     // 默认流名称先用会话ID，可在解析 URL 后覆盖
     _session.setStreamName(_session.sessionId);
@@ -28,7 +71,6 @@ RtspConnect::RtspConnect(std::shared_ptr<TcpConnection> tcpConn, EventLoop* loop
     // _RtpUnpacker->setNaluCallback([this](const uint8_t *data, size_t len, uint32_t ts) {
     //     MonitorServer::instance().onNalu(_session.getStreamName(), data, len, ts);
     // });
-    MonitorServer::instance().addCam(_session.sessionId,_session.stringName);
     LOG_INFO("RtspConnect created - Session: %s, Client: %s", 
              _session.sessionId.c_str(), _clientIp.c_str());
 }
@@ -37,113 +79,80 @@ RtspConnect::~RtspConnect() {
     LOG_INFO("RtspConnect destroyed - Session: %s", _session.sessionId.c_str());
 }
 
-void RtspConnect::handleRequest(const std::string& request) {
-    LOG_DEBUG("Handling RTSP request:\n%s", request.c_str());
-    
-    std::string method;
-    std::string url;
-    std::map<std::string, std::string> headers;
-    
-    parseRequest(request, method, url, headers);
+void RtspConnect::handleRequest(const char* data, size_t len) {
+    LOG_DEBUG("Handling RTSP request:\n%.*s", (int)len, data);
     
-    int cseq = extractCSeq(headers);
-    
-    // 根据方法分发处理
-    if (method == "OPTIONS"){
-        handleOpitions(request, headers, cseq);
-    } else if (method == "ANNOUNCE") {
-        handleAnnounce(request, headers, cseq);
-    } else if (method == "SETUP") {
-        handleSetup(url, headers, cseq);
-    } else if (method == "RECORD") {
-        handleRecord(url, headers, cseq);
-    } else if (method == "TEARDOWN"){
-        handleTeardown(url, headers, cseq);
-    } else {
-        LOG_WARN("Unknown RTSP method: %s", method.c_str());
-        std::map<std::string, std::string> extraHeaders;
-        sendResponse(501, "Not Implemented", extraHeaders, cseq);
+    RtspRequest req;
+    if (req.parse(data, len) != RtspRequest::Complete) {
+        LOG_WARN("Malformed RTSP request (%zu bytes)", len);
+        sendResponse(400, 0);
+        return;
     }
-}
-
-void RtspConnect::parseRequest(const std::string& request, 
-                                std::string& method, 
-                                std::string& url,
-                                std::map<std::string, std::string>& headers) {
-    std::istringstream iss(request);
-    std::string line;
     
-    // 解析请求行
-    if (std::getline(iss, line)) {
-        std::istringstream requestLine(line);
-        requestLine >> method >> url;
-        // 去除RTSP/1.0部分
+    int cseq = req.cseq();
+    StringPiece method = req.method();
+    if (method.substr(0, 5).equals("RTSP/")) {
+        // 摄像头对码率反馈（服务器发起的 SET_PARAMETER）的应答，不用处理
+        LOG_DEBUG("Session %s: response to server request, CSeq %d", _session.sessionId.c_str(), cseq);
+        return;
     }
     
-    // 解析头部
-    while (std::getline(iss, line)) {
-        if (line.empty() || line == "\r") break;
-        
-        size_t colonPos = line.find(':');
-        if (colonPos != std::string::npos) {
-            std::string key = line.substr(0, colonPos);
-            std::string value = line.substr(colonPos + 1);
-            
-            // 去除前后空格
-            key.erase(0, key.find_first_not_of(" \t\r\n"));
-            key.erase(key.find_last_not_of(" \t\r\n") + 1);
-            value.erase(0, value.find_first_not_of(" \t\r\n"));
-            value.erase(value.find_last_not_of(" \t\r\n") + 1);
-            
-            // 转换为小写以便查找
-            std::string keyLower = key;
-            std::transform(keyLower.begin(), keyLower.end(), keyLower.begin(), ::tolower);
-            headers[keyLower] = value;
-        }
-    }
-}
-
-int RtspConnect::extractCSeq(const std::map<std::string, std::string>& headers) {
-    auto it = headers.find("cseq");
-    if (it != headers.end()) {
-        return std::atoi(it->second.c_str());
+    // 根据方法分发处理
+    if (method.equals("OPTIONS")){
+        handleOpitions(req, cseq);
+    } else if (method.equals("ANNOUNCE")) {
+        handleAnnounce(req, cseq);
+    } else if (method.equals("SETUP")) {
+        handleSetup(req, cseq);
+    } else if (method.equals("RECORD")) {
+        handleRecord(req, cseq);
+    } else if (method.equals("DESCRIBE")) {
+        handleDescribe(req, cseq);
+    } else if (method.equals("PLAY")) {
+        handlePlay(req, cseq);
+    } else if (method.equals("SET_PARAMETER")) {
+        handleSetParameter(req, cseq);
+    } else if (method.equals("TEARDOWN")){
+        handleTeardown(req, cseq);
+    } else {
+        LOG_WARN("Unknown RTSP method: %.*s", (int)method.len, method.data);
+        sendResponse(501, cseq);
     }
-    return 0;
 }
 
-void RtspConnect::handleOpitions(const std::string& request,
-    const std::map<std::string, std::string>& headers, int cseq) {
+void RtspConnect::handleOpitions(const RtspRequest& req, int cseq) {
     LOG_INFO("Handling OPITIONS request, CSeq: %d", cseq);
-    std::map<std::string, std::string> extraHeaders;
-    extraHeaders["Public"] = "OPTIONS, ANNOUNCE, SETUP, TEARDOWN, RECORD";
-    sendResponse(200, "OK", extraHeaders, cseq);
+    RtspWriter writer = beginResponse(200, cseq);
+    writer.header("Public", "OPTIONS, DESCRIBE, ANNOUNCE, SETUP, PLAY, TEARDOWN, RECORD, SET_PARAMETER");
+    finishResponse(writer);
 }
 
-void RtspConnect::handleAnnounce(const std::string& request,
-                                 const std::map<std::string, std::string>& headers, int cseq) {
+void RtspConnect::handleAnnounce(const RtspRequest& req, int cseq) {
     LOG_INFO("Handling ANNOUNCE request, CSeq: %d", cseq);
     // 读取SDP body
-    _sdp = extractBody(request, headers);
+    _sdp = req.body().toString();
     if (_sdp.empty()) {
         LOG_WARN("ANNOUNCE without SDP body or Content-Length=0");
     } else {
         LOG_DEBUG("Received SDP via ANNOUNCE:\n%s", _sdp.c_str());
     }
+    std::string name = streamNameOf(req.url());
+    if (!name.empty()) {
+        setStreamName(name);
+    }
 
-    std::map<std::string, std::string> extraHeaders;
-    sendResponse(200, "OK", extraHeaders, cseq);
+    sendResponse(200, cseq);
 }
 
-void RtspConnect::handleSetup(const std::string& url, 
-                              const std::map<std::string, std::string>& headers, int cseq) {
-    LOG_INFO("Handling SETUP request, URL: %s, CSeq: %d", url.c_str(), cseq);
+void RtspConnect::handleSetup(const RtspRequest& req, int cseq) {
+    StringPiece url = req.url();
+    LOG_INFO("Handling SETUP request, URL: %.*s, CSeq: %d", (int)url.len, url.data, cseq);
     
     // 从Transport头中解析传输方式和端口
-    auto transportIt = headers.find("transport");
-    if (transportIt == headers.end()) {
+    StringPiece transport = req.header(RtspHeader::Transport);
+    if (transport.empty()) {
         LOG_ERROR("SETUP request missing Transport header");
-        std::map<std::string, std::string> extraHeaders;
-        sendResponse(400, "Bad Request", extraHeaders, cseq);
+        sendResponse(400, cseq);
         return;
     }
     std::string transportType;
@@ -151,37 +160,68 @@ void RtspConnect::handleSetup(const std::string& url,
     uint16_t serverRtpPort = 0, serverRtcpPort = 0;
     uint8_t rtpChannel = 0, rtcpChannel = 0;
     
-    if (!parseTransport(transportIt->second, transportType, 
+    if (!parseTransport(transport, transportType, 
                        clientRtpPort, clientRtcpPort,
                        serverRtpPort, serverRtcpPort,
                        rtpChannel, rtcpChannel)) {
-        LOG_ERROR("Failed to parse Transport header: %s", transportIt->second.c_str());
-        std::map<std::string, std::string> extraHeaders;
-        sendResponse(400, "Bad Request", extraHeaders, cseq);
+        LOG_ERROR("Failed to parse Transport header: %.*s", (int)transport.len, transport.data);
+        sendResponse(400, cseq);
+        return;
+    }
+    if (_state == RtspState::PLAYING) {
+        // 观看端的发送回调、推流的 KCP 都绑在当前的 UDP 连接上，传输中途不换
+        LOG_WARN("SETUP in wrong state: %d", (int)_state);
+        sendResponse(455, cseq);
         return;
     }
     _session.transportType = transportType;
     LOG_INFO("Transport type: %s", transportType.c_str());
 
-    std::map<std::string, std::string> extraHeaders;
-    std::ostringstream transportOss;
+    char transportBuf[128];
+    int transportLen = 0;
     if (transportType == "UDP") {
         // UDP模式处理
         //判断是否是视频
-        if (url.find("trackID=0") != std::string::npos) {    
+        if (url.contains("trackID=0")) {    
+            //重复 SETUP：旧连接先从 loop 上摘掉、端口放回池里，再换一对新的
+            releaseUdpTrack(_session.videoRtpConn, _session.videoRtcpConn, _session.videoPort);
             if (serverRtpPort == 0) {//客户端未指定服务器端口
-                serverRtpPort = _sessionManager.allocateUdpPorts();
+                _session.videoPort = _sessionManager.allocateUdpPorts();
+                if (_session.videoPort == 0) {
+                    sendResponse(503, cseq);
+                    return;
+                }
+                serverRtpPort = _session.videoPort;
                 serverRtcpPort = serverRtpPort + 1;
             }
             _session.videoRtpConn = std::make_shared<UdpConnection>(_serverIp,serverRtpPort
                 ,InetAddress(_clientIp,clientRtpPort),_loop);
-            // _session.videoRtcpConn = std::make_shared<UdpConnection>(_serverIp,serverRtcpPort
-            //     ,InetAddress(_clientIp,clientRtcpPort),_loop);
+            _session.videoRtcpConn = std::make_shared<UdpConnection>(_serverIp,serverRtcpPort
+                ,InetAddress(_clientIp,clientRtcpPort),_loop);
+            // 推流在 RECORD 时换成KCP收包；拉流端发来的打洞包等直接丢掉，避免水平触发空转
+            _session.videoRtpConn->setMessageCallback([](const UdpConnectionPtr &conn) {
+                char buf[2048];
+                while (conn->recv(buf, sizeof(buf)) > 0) {}
+            });
             _loop->addUdpConnection(_session.videoRtpConn);
-            // _loop->addUdpConnection(_session.videoRtcpConn);
-        }else if(url.find("trackID=1") != std::string::npos){   
+            // 推流端的 SR、拉流端的 RR，收到对端的第一个包后按来源地址回报告（可穿过NAT）
+            _session.videoRtcpConn->setMessageCallback([this](const UdpConnectionPtr &conn) {
+                char buf[1500];
+                int n;
+                while ((n = conn->recv(buf, sizeof(buf))) > 0) {
+                    onRtcp(reinterpret_cast<const uint8_t *>(buf), n);
+                }
+            });
+            _loop->addUdpConnection(_session.videoRtcpConn);
+        }else if(url.contains("trackID=1")){   
+            releaseUdpTrack(_session.audioRtpConn, _session.audioRtcpConn, _session.audioPort);
             if (serverRtpPort == 0) {
-                serverRtpPort = _sessionManager.allocateUdpPorts() + 2;
+                _session.audioPort = _sessionManager.allocateUdpPorts();
+                if (_session.audioPort == 0) {
+                    sendResponse(503, cseq);
+                    return;
+                }
+                serverRtpPort = _session.audioPort;
                 serverRtcpPort = serverRtpPort + 1;
             }
             _session.audioRtpConn = std::make_shared<UdpConnection>(_serverIp,serverRtpPort
@@ -194,10 +234,9 @@ void RtspConnect::handleSetup(const std::string& url,
         LOG_INFO("UDP mode - Client RTP ports: %d-%d, Server RTP ports: %d-%d", 
                  clientRtpPort, clientRtcpPort, serverRtpPort, serverRtcpPort);
         // 构建Transport响应
-        transportOss << "RTP/AVP/UDP;unicast;client_port=" << clientRtpPort 
-                     << "-" << clientRtcpPort 
-                     << ";server_port=" << serverRtpPort 
-                     << "-" << serverRtcpPort;
+        transportLen = snprintf(transportBuf, sizeof(transportBuf),
+                                "RTP/AVP/UDP;unicast;client_port=%u-%u;server_port=%u-%u",
+                                clientRtpPort, clientRtcpPort, serverRtpPort, serverRtcpPort);
     } else if (transportType == "TCP") {
         // TCP模式处理（interleaved）
         // TCP模式下，RTP/RTCP数据通过RTSP TCP连接传输
@@ -212,188 +251,459 @@ void RtspConnect::handleSetup(const std::string& url,
         
         LOG_INFO("TCP mode - RTP channel: %d, RTCP channel: %d", 
                  rtpChannel, rtcpChannel);
+        _rtpChannel = rtpChannel;
+        _rtcpChannel = rtcpChannel;
         
         // 构建Transport响应
-        transportOss << "RTP/AVP/TCP;unicast;interleaved=" 
-                     << static_cast<int>(rtpChannel) 
-                     << "-" << static_cast<int>(rtcpChannel);
+        transportLen = snprintf(transportBuf, sizeof(transportBuf),
+                                "RTP/AVP/TCP;unicast;interleaved=%u-%u",
+                                rtpChannel, rtcpChannel);
     } else {
         LOG_ERROR("Unsupported transport type: %s", transportType.c_str());
-        std::map<std::string, std::string> extraHeaders;
-        sendResponse(461, "Unsupported Transport", extraHeaders, cseq);
+        sendResponse(461, cseq);
         return;
     }
     
     _state = RtspState::READY;
     
-    extraHeaders["Transport"] = transportOss.str();
-    extraHeaders["Session"] = _session.sessionId + ";timeout=60";
-    
-    sendResponse(200, "OK", extraHeaders, cseq);
+    RtspWriter writer = beginResponse(200, cseq);
+    writer.header("Transport", StringPiece(transportBuf, transportLen));
+    char sessionBuf[96];
+    int sessionLen = snprintf(sessionBuf, sizeof(sessionBuf), "%s;timeout=60", _session.sessionId.c_str());
+    writer.header("Session", StringPiece(sessionBuf, sessionLen));
+    finishResponse(writer);
 }
 
 
-void RtspConnect::handleRecord(const std::string& url,
-                               const std::map<std::string, std::string>& headers, int cseq) {
-    LOG_INFO("Handling RECORD request, URL: %s, CSeq: %d", url.c_str(), cseq);
+void RtspConnect::handleRecord(const RtspRequest& req, int cseq) {
+    StringPiece url = req.url();
+    LOG_INFO("Handling RECORD request, URL: %.*s, CSeq: %d", (int)url.len, url.data, cseq);
 
     // 检查Session ID
-    auto sessionIt = headers.find("session");
-    if (sessionIt == headers.end() || sessionIt->second.find(_session.sessionId) == std::string::npos) {
+    if (!req.header(RtspHeader::Session).contains(_session.sessionId)) {
         LOG_WARN("RECORD request with invalid Session ID");
-        std::map<std::string, std::string> extraHeaders;
-        sendResponse(454, "Session Not Found", extraHeaders, cseq);
+        sendResponse(454, cseq);
         return;
     }
     
-    auto it = headers.find("kcpid");
-    if (it != headers.end()) {
-        std::string kcpIdStr = it->second;
-        unsigned long kcpIdLong = std::stoul(kcpIdStr);
-        uint32_t conv = static_cast<unsigned int>(kcpIdLong);
+    // TCP 推流的数据走 interleaved 帧（onInterleavedFrame），没有 UDP 端口，也不用 KCP
+    StringPiece kcpId = req.header(RtspHeader::KcpId);
+    // "Fec: 1"：不用 KCP，数据包是普通 RTP，另附校验包（见 Fec.h）
+    bool fec = !req.header("Fec").empty() && kcpId.empty();
+    bool feedback = !req.header("Rate-Feedback").empty();
+    if (!kcpId.empty() && _session.videoRtpConn) {
+        uint32_t conv = static_cast<uint32_t>(kcpId.toULong());
         initCamKcp(conv, _session.videoRtpConn);
     }
-    _kcpRunning = true;
-    _kcpThread = std::thread([this](){
-        while(_kcpRunning){
-            {
-                std::lock_guard<std::mutex> lock(_kcpMutex);
-                if (_camKcp) {
-                    ikcp_update(_camKcp, iclock());
+    if (!_rtcpReceiver) {
+        _rtcpReceiver.reset(new RtcpReceiver());
+    }
+    if (_session.videoRtpConn && kcpId.empty()) {
+        // 普通 RTP/UDP 推流：没有重传，经重排缓冲按序整帧交给分发器
+        if (!_jitter) {
+            _jitter.reset(new RtpJitterBuffer(RtpJitterBuffer::options()));
+            _jitter->setPacketCallback([this](const BufferPtr &pkt) {
+                if (pkt->size() > 0 && ((*pkt)[0] & 0x10)) {
+                    publishRtp(pkt->data(), pkt->size());//带扩展头的只有推理过的帧的首包
+                } else {
+                    _fanout->publish(pkt);
                 }
-            }
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            });
         }
-    });
-    _session.videoRtpConn->setMessageCallback([this](const UdpConnectionPtr &conn){
-        uint8_t buffer[1500];
-        while (true) {
-            int n = conn->recv(buffer, sizeof(buffer));
-            if (n <= 0) break;
-            std::lock_guard<std::mutex> lock(_kcpMutex);
-            ikcp_input(_camKcp, reinterpret_cast<const char*>(buffer), n);
-            char kcp_buffer[1500];
-            int rtp_len = ikcp_recv(_camKcp, kcp_buffer, sizeof(kcp_buffer));
-            if (rtp_len > 0) {
-                // LOG_DEBUG("Recived KCP %d data",rtp_len);
-                MonitorServer::instance().onNaluUdp(_session.sessionId, kcp_buffer, rtp_len);
-            }
+        if (fec && !_fec) {
+            // 恢复出的包不计入 RTCP 接收统计，RR 报的是线路上的丢包，摄像头按它调整组大小
+            _fec.reset(new FecDecoder());
+            _fec->setPacketCallback([this](const char *data, size_t len, bool recovered) {
+                uint32_t now = RtpJitterBuffer::nowMs();
+                _jitter->input(data, len, now);
+                if (!recovered) {
+                    _rtcpReceiver->onRtp(reinterpret_cast<const uint8_t *>(data), len, now);
+                }
+            });
         }
-    });
+        _session.videoRtpConn->setMessageCallback([this](const UdpConnectionPtr &conn){
+            static thread_local UdpRecvBatch batch;
+            uint32_t now = RtpJitterBuffer::nowMs();
+            while (true) {
+                int n = conn->recvBatch(batch);
+                if (n <= 0) break;
+                for (int i = 0; i < n; ++i) {
+                    if (_fec) {
+                        _fec->input(batch.data(i), batch.len(i));
+                        continue;
+                    }
+                    _jitter->input(batch.data(i), batch.len(i), now);
+                    _rtcpReceiver->onRtp(reinterpret_cast<const uint8_t *>(batch.data(i)), batch.len(i), now);
+                }
+                if (n < UdpRecvBatch::kMaxMsgs) break;//没收满说明已经读空
+            }
+            pollJitter();
+        });
+    } else if (_session.videoRtpConn) {
+        _session.videoRtpConn->setMessageCallback([this](const UdpConnectionPtr &conn){
+            // 同一loop线程上的摄像头共用一个收包批，一次 recvmmsg 收多个KCP报文
+            static thread_local UdpRecvBatch batch;
+            while (true) {
+                int n = conn->recvBatch(batch);
+                if (n <= 0 || !_camKcp) break;
+                for (int i = 0; i < n; ++i) {
+                    ikcp_input(_camKcp, batch.data(i), (long)batch.len(i));
+                }
+                KcpScheduler::instance(_loop).touch(_camKcp);//有ACK要回，按需提前更新
+                char kcp_buffer[1500];
+                int rtp_len;
+                uint32_t now = RtpJitterBuffer::nowMs();
+                while ((rtp_len = ikcp_recv(_camKcp, kcp_buffer, sizeof(kcp_buffer))) > 0) {
+                    // LOG_DEBUG("Recived KCP %d data",rtp_len);
+                    // KCP 已经重传补齐，这里的丢包和抖动反映的是重传之后的结果
+                    _rtcpReceiver->onRtp(reinterpret_cast<const uint8_t *>(kcp_buffer), rtp_len, now);
+                    publishRtp(kcp_buffer, rtp_len);
+                }
+                if (n < UdpRecvBatch::kMaxMsgs) break;//没收满说明已经读空
+            }
+        });
+    }
     if (_state != RtspState::READY) {
         LOG_WARN("RECORD request in wrong state: %d", (int)_state);
-        std::map<std::string, std::string> extraHeaders;
-        sendResponse(455, "Method Not Valid in This State", extraHeaders, cseq);
+        sendResponse(455, cseq);
         return;
     }
 
     _state = RtspState::PLAYING; // 标记为接收中
+    if (!_publishing) {
+        // 登记推流，供 RTSP 播放端按名称拉流；名称被占用时用会话ID
+        _publishing = true;
+        std::string name = streamNameOf(req.url());
+        if (_session.stringName == _session.sessionId && !name.empty()) {
+            setStreamName(name); // 没有 ANNOUNCE 时按 RECORD 的 URL 命名
+        }
+        if (!StreamRegistry::instance().add(_session.stringName, _fanout)) {
+            LOG_WARN("Stream name %s already in use, publishing as %s",
+                     _session.stringName.c_str(), _session.sessionId.c_str());
+            setStreamName(_session.sessionId);
+            StreamRegistry::instance().add(_session.stringName, _fanout);
+        }
+        MonitorServer::instance().addCam(_session.sessionId,_session.stringName,_fanout);
+        _detections = std::make_shared<DetectionIndex>();
+        _fanout->setDetections(_detections);
+        if (!Mp4Recorder::options().dir.empty()) {
+            // 录像作为分发器的一个订阅者，从缓存的关键帧开始录
+            auto recorder = std::make_shared<Mp4Recorder>(_session.stringName, Mp4Recorder::options());
+            _recorder = recorder;
+            _recordSinkId = StreamFanout::nextSinkId();
+            _fanout->addSink(_recordSinkId, [recorder](const BufferPtr &buf) {
+                recorder->onRtp(buf->data(), buf->size());
+            });
+        }
+        if (HlsSegmenter::options().enabled) {
+            // 分段在内存里，HTTP 请求经 StreamRegistry 找到分发器后取用
+            auto hls = std::make_shared<HlsSegmenter>(_session.stringName, HlsSegmenter::options());
+            _fanout->setHls(hls);
+            _hlsSinkId = StreamFanout::nextSinkId();
+            _fanout->addSink(_hlsSinkId, [hls](const BufferPtr &buf) {
+                hls->onRtp(buf->data(), buf->size());
+            });
+        }
+        if (!ClipRecorder::options().dir.empty()) {
+            // 挂上后先收到缓存的 GOP，预录从这里开始积累
+            auto clip = std::make_shared<ClipRecorder>(_session.stringName, ClipRecorder::options());
+            _fanout->setClipRecorder(clip);
+            _clipSinkId = StreamFanout::nextSinkId();
+            _fanout->addSink(_clipSinkId, [clip](const BufferPtr &buf) {
+                clip->onPacket(buf);
+            });
+        }
+    }
 
-    std::map<std::string, std::string> extraHeaders;
-    extraHeaders["Session"] = _session.sessionId;
-    sendResponse(200, "OK", extraHeaders, cseq);
+    RtspWriter writer = beginResponse(200, cseq);
+    writer.header("Session", _session.sessionId);
+    if (_fec) {
+        writer.header("Fec", "1");
+    }
+    if (feedback) {
+        writer.header("Rate-Feedback", "1");
+    }
+    finishResponse(writer);
+    startRtcp();
+    if (feedback) {
+        startFeedback();
+    }
 }
 
-void RtspConnect::handleTeardown(const std::string& url,
-                    const std::map<std::string, std::string>& headers, int cseq){
-    LOG_INFO("Handling TEARDOWN request, URL: %s, CSeq: %d", url.c_str(), cseq);
-    auto sessionIt = headers.find("session");
-    if (sessionIt == headers.end() || sessionIt->second.find(_session.sessionId) == std::string::npos) {
-        LOG_WARN("RECORD request with invalid Session ID");
-        std::map<std::string, std::string> extraHeaders;
-        sendResponse(454, "Session Not Found", extraHeaders, cseq);
-        return;
+void RtspConnect::handleSetParameter(const RtspRequest& req, int cseq) {
+    // 摄像头推流时用 "event: <原因>" 通知检测事件，其余（含空 body 的保活）直接应答
+    StringPiece body = req.body();
+    size_t pos = body.find("event:");
+    if (pos != StringPiece::npos && _publishing) {
+        StringPiece reason = body.substr(pos + 6);
+        size_t eol = reason.find("\r");
+        if (eol == StringPiece::npos) eol = reason.find("\n");
+        if (eol != StringPiece::npos) reason = reason.substr(0, eol);
+        reason = reason.trim();
+        if (const std::shared_ptr<ClipRecorder> &clip = _fanout->clipRecorder()) {
+            clip->trigger(reason.toString());
+        } else {
+            LOG_DEBUG("Event %.*s on %s ignored, clip recording disabled",
+                      (int)reason.len, reason.data, _session.stringName.c_str());
+        }
     }
-    releaseSession();
-    
-    std::map<std::string, std::string> extraHeaders;
-    sendResponse(200, "OK", extraHeaders, cseq);
+    sendResponse(200, cseq);
 }
 
-void RtspConnect::sendResponse(int statusCode, const std::string& statusText,
-                               const std::map<std::string, std::string>& extraHeaders, int cseq) {
-    std::ostringstream oss;
-    
-    // RTSP响应行
-    oss << "RTSP/1.0 " << statusCode << " " << statusText << "\r\n";
-    
-    // CSeq头
-    oss << "CSeq: " << cseq << "\r\n";
-    
-    // Server头
-    oss << "Server: RTSP Server/1.0\r\n";
-    
-    // 额外头部
-    for (const auto& pair : extraHeaders) {
-        oss << pair.first << ": " << pair.second << "\r\n";
+std::string RtspConnect::streamNameOf(StringPiece url) {
+    size_t scheme = url.find("://");
+    StringPiece path = scheme == StringPiece::npos ? url : url.substr(scheme + 3);
+    size_t slash = path.find("/");
+    if (slash == StringPiece::npos) {
+        return std::string();
     }
-    
-    // 结束标志
-    oss << "\r\n";
-    
-    std::string response = oss.str();
-    LOG_DEBUG("Sending RTSP response:\n%s", response.c_str());
-    
-    if (auto tcpConn = _tcpConn.lock()) {
-        tcpConn->send(response);
-    } else {
-        LOG_WARN("TCP connection expired when sending RTSP response");
+    path = path.substr(slash + 1);
+    size_t query = path.find("?");
+    if (query != StringPiece::npos) {
+        path = path.substr(0, query);
+    }
+    size_t track = path.find("/trackID=");
+    if (track != StringPiece::npos) {
+        path = path.substr(0, track);
     }
+    while (!path.empty() && path.data[path.len - 1] == '/') {
+        --path.len;
+    }
+    return path.toString();
 }
 
-void RtspConnect::sendResponse(int statusCode, const std::string& statusText,
-                               const std::map<std::string, std::string>& extraHeaders, int cseq,
-                               const std::string& body) {
-    std::ostringstream oss;
-    
-    // RTSP响应行
-    oss << "RTSP/1.0 " << statusCode << " " << statusText << "\r\n";
-    
-    // CSeq头
-    oss << "CSeq: " << cseq << "\r\n";
-    
-    // Server头
-    oss << "Server: RTSP Server/1.0\r\n";
-    
-    // 额外头部（复制一遍，并确保有Content-Length）
-    bool hasContentLength = false;
-    for (const auto& pair : extraHeaders) {
-        if (pair.first == "Content-Length" || pair.first == "content-length") {
-            hasContentLength = true;
+static std::string base64Encode(const std::string &in) {
+    static const char kTable[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    out.reserve((in.size() + 2) / 3 * 4);
+    size_t i = 0;
+    for (; i + 2 < in.size(); i += 3) {
+        uint32_t v = ((uint8_t)in[i] << 16) | ((uint8_t)in[i + 1] << 8) | (uint8_t)in[i + 2];
+        out.push_back(kTable[v >> 18]);
+        out.push_back(kTable[(v >> 12) & 0x3F]);
+        out.push_back(kTable[(v >> 6) & 0x3F]);
+        out.push_back(kTable[v & 0x3F]);
+    }
+    if (i < in.size()) {
+        uint32_t v = (uint8_t)in[i] << 16;
+        if (i + 1 < in.size()) v |= (uint8_t)in[i + 1] << 8;
+        out.push_back(kTable[v >> 18]);
+        out.push_back(kTable[(v >> 12) & 0x3F]);
+        out.push_back(i + 1 < in.size() ? kTable[(v >> 6) & 0x3F] : '=');
+        out.push_back('=');
+    }
+    return out;
+}
+
+void RtspConnect::handleDescribe(const RtspRequest& req, int cseq) {
+    StringPiece url = req.url();
+    LOG_INFO("Handling DESCRIBE request, URL: %.*s, CSeq: %d", (int)url.len, url.data, cseq);
+    std::string name = streamNameOf(url);
+    StreamFanoutPtr stream = StreamRegistry::instance().find(name);
+    if (!stream) {
+        LOG_WARN("DESCRIBE for unknown stream: %s", name.c_str());
+        sendResponse(404, cseq);
+        return;
+    }
+    _playStream = stream;
+
+    // 参数集从推流里取，播放端不必等到带内的 SPS/PPS 才能初始化解码器
+    std::string fmtp = "packetization-mode=1";
+    std::string sps, pps;
+    if (stream->parameterSets(sps, pps)) {
+        if (sps.size() >= 4) {
+            char profile[32];
+            snprintf(profile, sizeof(profile), ";profile-level-id=%02X%02X%02X",
+                     (uint8_t)sps[1], (uint8_t)sps[2], (uint8_t)sps[3]);
+            fmtp += profile;
         }
-        oss << pair.first << ": " << pair.second << "\r\n";
+        fmtp += ";sprop-parameter-sets=" + base64Encode(sps) + "," + base64Encode(pps);
     }
-    if (!hasContentLength) {
-        oss << "Content-Length: " << body.size() << "\r\n";
+    std::string sdp = "v=0\r\n"
+                      "o=- 0 0 IN IP4 " + _serverIp + "\r\n"
+                      "s=" + name + "\r\n"
+                      "c=IN IP4 0.0.0.0\r\n"
+                      "t=0 0\r\n"
+                      "a=control:*\r\n"
+                      "m=video 0 RTP/AVP 96\r\n"
+                      "a=rtpmap:96 H264/90000\r\n"
+                      "a=fmtp:96 " + fmtp + "\r\n"
+                      "a=control:trackID=0\r\n";
+
+    std::string base = url.toString();
+    if (base.empty() || base.back() != '/') {
+        base.push_back('/');
     }
+    RtspWriter writer = beginResponse(200, cseq);
+    writer.header("Content-Base", base)
+          .header("Content-Type", "application/sdp");
+    finishResponse(writer, sdp);
+}
+
+void RtspConnect::handlePlay(const RtspRequest& req, int cseq) {
+    StringPiece url = req.url();
+    LOG_INFO("Handling PLAY request, URL: %.*s, CSeq: %d", (int)url.len, url.data, cseq);
+    if (!req.header(RtspHeader::Session).contains(_session.sessionId)) {
+        LOG_WARN("PLAY request with invalid Session ID");
+        sendResponse(454, cseq);
+        return;
+    }
+    if (_state != RtspState::READY) {
+        LOG_WARN("PLAY request in wrong state: %d", (int)_state);
+        sendResponse(455, cseq);
+        return;
+    }
+    if (!_playStream) {
+        _playStream = StreamRegistry::instance().find(streamNameOf(url));
+    }
+    if (!_playStream) {
+        sendResponse(404, cseq);
+        return;
+    }
+
+    // 按传输方式构造订阅回调：回调在推流 loop 上执行，数据块只传引用，交给本连接的 loop 发送
+    StreamFanout::PacketSink sink;
+    std::shared_ptr<RtcpSender> sender = std::make_shared<RtcpSender>();
+    if (_session.transportType == "TCP") {
+        std::weak_ptr<TcpConnection> weakConn = _tcpConn;
+        uint8_t channel = _rtpChannel;
+        EventLoop *loop = _loop;
+        std::shared_ptr<SinkBatch> batch = std::make_shared<SinkBatch>();
+        sink = [weakConn, channel, loop, sender, batch](const BufferPtr &buf) {
+            if (!batch->push(buf)) return;
+            loop->runInLoop([weakConn, channel, sender, batch]() {
+                std::vector<BufferPtr> packets;
+                batch->take(packets);
+                auto conn = weakConn.lock();
+                if (!conn) return;
+                uint32_t now = RtpJitterBuffer::nowMs();
+                for (const BufferPtr &pkt : packets) {
+                    // 播放端收得慢，发送链越积越长：丢到下一个关键帧，恢复后画面不花
+                    if (batch->dropping && !GopCache::isKeyFrameStart(*pkt)) {
+                        ++batch->dropped;
+                        continue;
+                    }
+                    batch->dropping = false;
+                    if (conn->pendingBytes() > kMaxSinkBacklog) {
+                        batch->dropping = true;
+                        if (batch->dropped++ % 1000 == 0) {
+                            LOG_WARN("TCP viewer fd=%d too slow (%zu bytes queued), dropped %lu packets",
+                                     conn->getFd(), conn->pendingBytes(), (unsigned long)batch->dropped);
+                        }
+                        continue;
+                    }
+                    sender->onRtp(pkt, now);
+                    char head[4] = {'$', (char)channel, (char)(pkt->size() >> 8), (char)pkt->size()};
+                    conn->send(head, sizeof(head), pkt, 0, pkt->size());
+                }
+            });
+        };
+    } else if (_session.videoRtpConn) {
+        UdpConnectionPtr udpConn = _session.videoRtpConn;
+        EventLoop *loop = _loop;
+        std::shared_ptr<SinkBatch> batch = std::make_shared<SinkBatch>();
+        sink = [udpConn, loop, sender, batch](const BufferPtr &buf) {
+            if (!batch->push(buf)) return;
+            loop->runInLoop([udpConn, sender, batch]() {
+                std::vector<BufferPtr> packets;
+                batch->take(packets);
+                uint32_t now = RtpJitterBuffer::nowMs();
+                for (const BufferPtr &pkt : packets) {
+                    sender->onRtp(pkt, now);
+                    udpConn->queueSend(pkt->data(), (int)pkt->size());
+                }
+                udpConn->flushSend();
+            });
+        };
+    } else {
+        LOG_WARN("PLAY without a video transport set up");
+        sendResponse(455, cseq);
+        return;
+    }
+    _state = RtspState::PLAYING;
+    _rtcpSender = sender;
+
+    // 先回 200，再开始送数据，避免 interleaved 数据插在响应前面
+    RtspWriter writer = beginResponse(200, cseq);
+    writer.header("Session", _session.sessionId)
+          .header("Range", "npt=0.000-");
+    finishResponse(writer);
+
+    StreamFanoutPtr stream = _playStream;
+    uint64_t id = StreamFanout::nextSinkId();
+    _sinkId = id;
+    stream->loop()->runInLoop([stream, id, sink]() {
+        stream->addSink(id, StreamFanout::PacketSink(sink));
+    });
+    startRtcp();
+}
+
+void RtspConnect::handleTeardown(const RtspRequest& req, int cseq){
+    StringPiece url = req.url();
+    LOG_INFO("Handling TEARDOWN request, URL: %.*s, CSeq: %d", (int)url.len, url.data, cseq);
+    if (!req.header(RtspHeader::Session).contains(_session.sessionId)) {
+        LOG_WARN("TEARDOWN request with invalid Session ID");
+        sendResponse(454, cseq);
+        return;
+    }
+    releaseSession();
     
-    // 结束头部
-    oss << "\r\n";
-    
-    // 拼接body
-    oss << body;
-    
-    std::string response = oss.str();
-    LOG_DEBUG("Sending RTSP response with body (len=%zu):\n%s", response.size(), response.c_str());
+    sendResponse(200, cseq);
+}
+
+RtspWriter RtspConnect::beginResponse(int statusCode, int cseq) {
+    _response.clear();
+    RtspWriter writer(_response);
+    writer.status(statusCode)
+          .header("CSeq", static_cast<unsigned long>(cseq))
+          .header("Server", "RTSP Server/1.0");
+    return writer;
+}
+
+void RtspConnect::finishResponse(RtspWriter& writer, StringPiece body) {
+    writer.end(body);
+    LOG_DEBUG("Sending RTSP response:\n%s", _response.c_str());
     
     if (auto tcpConn = _tcpConn.lock()) {
-        tcpConn->send(response);
+        tcpConn->send(_response);
     } else {
-        LOG_WARN("TCP connection expired when sending RTSP response with body");
+        LOG_WARN("TCP connection expired when sending RTSP response");
     }
 }
 
+void RtspConnect::sendResponse(int statusCode, int cseq) {
+    RtspWriter writer = beginResponse(statusCode, cseq);
+    finishResponse(writer);
+}
+
 void RtspConnect::onInterleavedFrame(uint8_t ch, const uint8_t* data, size_t len) {
-    if ((ch % 2) == 0) {
-        //RTP
-        // MonitorServer::instance().onNaluTcp(_session.getStreamName(), data, len);
-    } else {
-        // RTCP
-        
+    if (ch == _rtpChannel) {
+        //RTP：和 KCP 推流一样交给分发器，包成一块共享数据后发给所有观看端
+        if (_publishing) {
+            _rtcpReceiver->onRtp(data, len, RtpJitterBuffer::nowMs());
+            publishRtp(reinterpret_cast<const char *>(data), len);
+        }
+    } else if (ch == _rtcpChannel) {
+        onRtcp(data, len);
     }
 }
 
-bool RtspConnect::parseTransport(const std::string& transport, 
+// 解析 key=a-b 形式的一对数字，如 client_port=5004-5005
+static bool parseRange(StringPiece transport, StringPiece key,
+                       unsigned long& first, unsigned long& second) {
+    size_t pos = transport.find(key);
+    if (pos == StringPiece::npos) return false;
+    StringPiece value = transport.substr(pos + key.len);
+    size_t end = value.find(";");
+    value = value.substr(0, end);
+    size_t dashPos = value.find("-");
+    if (dashPos == StringPiece::npos) return false;
+    first = value.substr(0, dashPos).toULong();
+    second = value.substr(dashPos + 1).toULong();
+    return true;
+}
+
+bool RtspConnect::parseTransport(StringPiece transport, 
                                  std::string& transportType,
                                  uint16_t& clientRtpPort, uint16_t& clientRtcpPort,
                                  uint16_t& serverRtpPort, uint16_t& serverRtcpPort,
@@ -406,91 +716,34 @@ bool RtspConnect::parseTransport(const std::string& transport,
     serverRtcpPort = 0;
     rtpChannel = 0;
     rtcpChannel = 0;
+    unsigned long first = 0, second = 0;
     
-    // 判断传输类型: RTP/AVP/UDP 或 RTP/AVP/TCP
-    if (transport.find("RTP/AVP/UDP") != std::string::npos || 
-        transport.find("RTP/AVP;UDP") != std::string::npos) {
+    // 判断传输类型: RTP/AVP/UDP 或 RTP/AVP/TCP；播放器常发的 RTP/AVP;unicast 按 UDP 处理
+    bool tcp = transport.contains("RTP/AVP/TCP") || transport.contains("RTP/AVP;TCP");
+    if (!tcp && transport.contains("RTP/AVP")) {
         transportType = "UDP";
         
         // 解析UDP模式: client_port=5004-5005;server_port=6000-6001
-        size_t pos = transport.find("client_port=");
-        if (pos != std::string::npos) {
-            pos += 12;  // "client_port="长度
-            size_t dashPos = transport.find("-", pos);
-            if (dashPos != std::string::npos) {
-                std::string rtpPortStr = transport.substr(pos, dashPos - pos);
-                std::string rtcpPortStr = transport.substr(dashPos + 1);
-                
-                // 去除可能的分号或空格
-                size_t semicolonPos = rtcpPortStr.find(";");
-                if (semicolonPos != std::string::npos) {
-                    rtcpPortStr = rtcpPortStr.substr(0, semicolonPos);
-                }
-                // 去除空格
-                rtpPortStr.erase(0, rtpPortStr.find_first_not_of(" \t"));
-                rtpPortStr.erase(rtpPortStr.find_last_not_of(" \t") + 1);
-                rtcpPortStr.erase(0, rtcpPortStr.find_first_not_of(" \t"));
-                rtcpPortStr.erase(rtcpPortStr.find_last_not_of(" \t") + 1);
-                
-                clientRtpPort = static_cast<uint16_t>(std::atoi(rtpPortStr.c_str()));
-                clientRtcpPort = static_cast<uint16_t>(std::atoi(rtcpPortStr.c_str()));
-            }
+        if (parseRange(transport, "client_port=", first, second)) {
+            clientRtpPort = static_cast<uint16_t>(first);
+            clientRtcpPort = static_cast<uint16_t>(second);
         }
         
         // 解析server_port (可选)
-        pos = transport.find("server_port=");
-        if (pos != std::string::npos) {
-            pos += 12;  // "server_port="长度
-            size_t dashPos = transport.find("-", pos);
-            if (dashPos != std::string::npos) {
-                std::string rtpPortStr = transport.substr(pos, dashPos - pos);
-                std::string rtcpPortStr = transport.substr(dashPos + 1);
-                
-                // 去除可能的分号或空格
-                size_t semicolonPos = rtcpPortStr.find(";");
-                if (semicolonPos != std::string::npos) {
-                    rtcpPortStr = rtcpPortStr.substr(0, semicolonPos);
-                }
-                // 去除空格
-                rtpPortStr.erase(0, rtpPortStr.find_first_not_of(" \t"));
-                rtpPortStr.erase(rtpPortStr.find_last_not_of(" \t") + 1);
-                rtcpPortStr.erase(0, rtcpPortStr.find_first_not_of(" \t"));
-                rtcpPortStr.erase(rtcpPortStr.find_last_not_of(" \t") + 1);
-                
-                serverRtpPort = static_cast<uint16_t>(std::atoi(rtpPortStr.c_str()));
-                serverRtcpPort = static_cast<uint16_t>(std::atoi(rtcpPortStr.c_str()));
-            }
+        if (parseRange(transport, "server_port=", first, second)) {
+            serverRtpPort = static_cast<uint16_t>(first);
+            serverRtcpPort = static_cast<uint16_t>(second);
         }
         
         return (clientRtpPort > 0 && clientRtcpPort > 0);
         
-    } else if (transport.find("RTP/AVP/TCP") != std::string::npos ||
-               transport.find("RTP/AVP;TCP") != std::string::npos) {
+    } else if (tcp) {
         transportType = "TCP";
         
         // 解析TCP模式: interleaved=0-1
-        size_t pos = transport.find("interleaved=");
-        if (pos != std::string::npos) {
-            pos += 12;  // "interleaved="长度
-            size_t dashPos = transport.find("-", pos);
-            if (dashPos != std::string::npos) {
-                std::string rtpChStr = transport.substr(pos, dashPos - pos);
-                std::string rtcpChStr = transport.substr(dashPos + 1);
-                
-                // 去除可能的分号或空格
-                size_t semicolonPos = rtcpChStr.find(";");
-                if (semicolonPos != std::string::npos) {
-                    rtcpChStr = rtcpChStr.substr(0, semicolonPos);
-                }
-                // 去除空格
-                rtpChStr.erase(0, rtpChStr.find_first_not_of(" \t"));
-                rtpChStr.erase(rtpChStr.find_last_not_of(" \t") + 1);
-                rtcpChStr.erase(0, rtcpChStr.find_first_not_of(" \t"));
-                rtcpChStr.erase(rtcpChStr.find_last_not_of(" \t") + 1);
-                
-                rtpChannel = static_cast<uint8_t>(std::atoi(rtpChStr.c_str()));
-                rtcpChannel = static_cast<uint8_t>(std::atoi(rtcpChStr.c_str()));
-            }
+        if (parseRange(transport, "interleaved=", first, second)) {
+            rtpChannel = static_cast<uint8_t>(first);
+            rtcpChannel = static_cast<uint8_t>(second);
         }
         
         return true;
@@ -500,65 +753,305 @@ bool RtspConnect::parseTransport(const std::string& transport,
 }
 static int kcp_output(const char *buf, int len, ikcpcb *kcp, void *user) {
     auto kcpClient = static_cast<UdpConnection*>(user);
-    std::string data(buf, len);
-    return kcpClient->send(data,data.size());
+    kcpClient->queueSend(buf, len);//ikcp_update 结束后统一 flushSend
+    return len;
 }
 void RtspConnect::initCamKcp(uint32_t conv,UdpConnectionPtr kcpClient){
+    releaseCamKcp();//重复 RECORD，按新的 conv 重建
     UdpConnection *udpConn = kcpClient.get();
     _camKcp = ikcp_create(conv,udpConn);
     _camKcp->output = kcp_output;
     ikcp_nodelay(_camKcp, 1, 10, 2, 0);
     ikcp_wndsize(_camKcp, 128, 128);
     ikcp_setmtu(_camKcp, 1450);
+    // 由本loop的调度器按 ikcp_check 驱动，更新后把攒下的ACK一次发出
+    KcpScheduler::instance(_loop).add(_camKcp, [udpConn]() {
+        udpConn->flushSend();
+    });
 }
-void RtspConnect::kcp_update_thread(){
-    while (true) {
-        ikcp_update(_camKcp, iclock());
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+void RtspConnect::releaseCamKcp() {
+    if (_camKcp) {
+        KcpScheduler::instance(_loop).remove(_camKcp);
+        ikcp_release(_camKcp);
+        _camKcp = nullptr;
     }
 }
-std::string RtspConnect::extractBody(const std::string& request,
-                                     const std::map<std::string, std::string>& headers) {
-    size_t pos = request.find("\r\n\r\n");
-    if (pos == std::string::npos) return std::string();
-    pos += 4;
-    size_t contentLength = 0;
-    auto it = headers.find("content-length");
-    if (it != headers.end()) {
-        contentLength = static_cast<size_t>(std::atoi(it->second.c_str()));
+
+void RtspConnect::releaseUdpTrack(UdpConnectionPtr &rtpConn, UdpConnectionPtr &rtcpConn, uint16_t &port) {
+    if (rtpConn) {
+        _loop->removeUdpConnection(rtpConn);
+        rtpConn.reset();
     }
-    if (contentLength == 0) {
-        // 若未知长度，返回剩余全部作为尝试
-        return request.substr(pos);
+    if (rtcpConn) {
+        _loop->removeUdpConnection(rtcpConn);
+        rtcpConn.reset();
     }
-    if (pos + contentLength > request.size()) {
-        // 不完整
-        return std::string();
+    // 端口在连接对象从 loop 上摘掉之后才放回池里，而且要等分配游标绕一圈才会再用
+    if (port) {
+        _sessionManager.releaseUdpPorts(port);
+        port = 0;
     }
-    return request.substr(pos, contentLength);
 }
 
-void RtspConnect::releaseSession(){
-    MonitorServer::instance().removeCam(_session.sessionId);
-    _kcpRunning = false;          // 通知线程退出
-    if (_kcpThread.joinable()) {
-        _kcpThread.join();        // 等待线程退出
+void RtspConnect::pollJitter() {
+    int wait = _jitter->poll(RtpJitterBuffer::nowMs());
+    if (wait >= 0 && _jitterTimer == 0) {
+        // 队头缺包，到期时即使没有新包到达也要放出
+        _jitterTimer = _loop->addOneTimer(wait > 0 ? wait : 1, [this]() {
+            _jitterTimer = 0;
+            pollJitter();
+        });
     }
-    if (_camKcp) {
-        ikcp_release(_camKcp);
-        _camKcp = nullptr;
+}
+
+void RtspConnect::publishRtp(const char *data, size_t len) {
+    DetectionFrame frame;
+    size_t extBegin, extEnd;
+    if (!_detections || !DetectionIndex::parse(data, len, frame, extBegin, extEnd)) {
+        _fanout->publish(data, len);
+        return;
+    }
+    _detections->add(std::move(frame));
+    // 固定头和 CSRC 原样保留、清掉扩展位，接上扩展头之后的负载
+    _stripped.assign(data, extBegin);
+    _stripped[0] = static_cast<char>(_stripped[0] & ~0x10);
+    _stripped.append(data + extEnd, len - extEnd);
+    _fanout->publish(_stripped.data(), _stripped.size());
+}
+
+void RtspConnect::onRtcp(const uint8_t* data, size_t len) {
+    RtcpMessage msg;
+    if (!Rtcp::parse(data, len, msg)) {
+        LOG_DEBUG("Session %s: ignoring malformed RTCP (%zu bytes)", _session.sessionId.c_str(), len);
+        return;
+    }
+    uint64_t now = Rtcp::ntpNow();
+    ++_rtcpStats.reportsReceived;
+    if (msg.hasSenderInfo && _rtcpReceiver) {
+        _rtcpReceiver->onSenderReport(msg.sender, now);
+    }
+    if (_rtcpSender) {
+        for (int i = 0; i < msg.blockCount; ++i) {
+            _rtcpSender->onReceiverReport(msg.blocks[i], now);
+        }
+    }
+    if (msg.bye) {
+        LOG_INFO("Session %s: RTCP BYE from SSRC %08x", _session.sessionId.c_str(), msg.ssrc);
+    }
+}
+
+void RtspConnect::startRtcp() {
+    if (_rtcpTimer == 0) {
+        _rtcpTimer = _loop->addPeriodicTimer(kRtcpIntervalMs, kRtcpIntervalMs, [this]() {
+            sendRtcpReport();
+        });
+    }
+}
+
+void RtspConnect::sendRtcpReport() {
+    uint64_t now = Rtcp::ntpNow();
+    std::string cname = "rtsp-server@" + _serverIp;
+    _rtcpBuf.assign(4, '\0');
+    if (_rtcpReceiver) {
+        // 推流：RR 报告摄像头那一路的丢包、抖动，带上它最近 SR 的 LSR/DLSR 供摄像头算 RTT
+        RtcpReportBlock block;
+        bool hasBlock = _rtcpReceiver->makeReport(block, now);
+        Rtcp::writeReceiverReport(_rtcpBuf, _rtcpSsrc, &block, hasBlock ? 1 : 0);
+        Rtcp::writeSdes(_rtcpBuf, _rtcpSsrc, cname);
+        _rtcpReceiver->fillStats(_rtcpStats);
+    } else if (_rtcpSender) {
+        // 拉流：SR 给出转发的这一路 RTP 时间戳和 NTP 的对应关系，播放端据此回 RR
+        RtcpSenderInfo info;
+        uint32_t ssrc = 0;
+        if (!_rtcpSender->makeSenderInfo(info, ssrc, now, RtpJitterBuffer::nowMs())) {
+            return;//还没转发过 RTP
+        }
+        Rtcp::writeSenderReport(_rtcpBuf, ssrc, info, nullptr, 0);
+        Rtcp::writeSdes(_rtcpBuf, ssrc, cname);
+        _rtcpSender->fillStats(_rtcpStats);
+    } else {
+        return;
+    }
+    sendRtcp();
+    ++_rtcpStats.reportsSent;
+    _sessionManager.updateRtcpStats(_session.sessionId, _rtcpStats);
+    LOG_DEBUG("Session %s RTCP: packets=%lu lost=%d fraction=%u/256 jitter=%.1fms rtt=%dms",
+              _session.sessionId.c_str(), (unsigned long)_rtcpStats.packets, _rtcpStats.cumulativeLost,
+              _rtcpStats.fractionLost, _rtcpStats.jitter / 90.0, _rtcpStats.rttMs);
+}
+
+void RtspConnect::sendRtcp() {
+    size_t len = _rtcpBuf.size() - 4;
+    if (_session.transportType == "TCP") {
+        if (auto conn = _tcpConn.lock()) {
+            _rtcpBuf[0] = '$';
+            _rtcpBuf[1] = static_cast<char>(_rtcpChannel);
+            _rtcpBuf[2] = static_cast<char>(len >> 8);
+            _rtcpBuf[3] = static_cast<char>(len);
+            conn->send(_rtcpBuf);
+        }
+    } else if (_session.videoRtcpConn) {
+        _session.videoRtcpConn->queueSend(_rtcpBuf.data() + 4, static_cast<int>(len));
+        _session.videoRtcpConn->flushSend();
     }
-    if(_session.videoRtpConn != nullptr){
-        _loop->removeUdpConnection(_session.videoRtpConn);
+}
+
+void RtspConnect::stopRtcp() {
+    if (_rtcpTimer == 0) {
+        return;
     }
-    if(_session.videoRtcpConn != nullptr){
-        _loop->removeUdpConnection(_session.videoRtcpConn);
+    _loop->removeTimer(_rtcpTimer);
+    _rtcpTimer = 0;
+    // UDP 传输离开会话时发 BYE，SSRC 和报告里用的一致；TCP 多半是对端已经断开，不再写
+    if (_session.transportType != "TCP") {
+        uint32_t ssrc = _rtcpReceiver ? _rtcpSsrc : (_rtcpSender ? _rtcpSender->mediaSsrc() : 0);
+        _rtcpBuf.assign(4, '\0');
+        Rtcp::writeReceiverReport(_rtcpBuf, ssrc, nullptr, 0);
+        Rtcp::writeBye(_rtcpBuf, ssrc);
+        sendRtcp();
     }
-    if(_session.audioRtpConn != nullptr){
-        _loop->removeUdpConnection(_session.audioRtpConn);
+    if (_rtcpReceiver) {
+        _rtcpReceiver->fillStats(_rtcpStats);
+    } else if (_rtcpSender) {
+        _rtcpSender->fillStats(_rtcpStats);
     }
-    if(_session.audioRtcpConn != nullptr){
-        _loop->removeUdpConnection(_session.audioRtcpConn);
+    _sessionManager.updateRtcpStats(_session.sessionId, _rtcpStats);
+    LOG_INFO("Session %s (%s) RTCP: packets=%lu octets=%lu lost=%d jitter=%.1fms rtt=%dms "
+             "reports sent=%u received=%u", _session.sessionId.c_str(), _session.stringName.c_str(),
+             (unsigned long)_rtcpStats.packets, (unsigned long)_rtcpStats.octets, _rtcpStats.cumulativeLost,
+             _rtcpStats.jitter / 90.0, _rtcpStats.rttMs, _rtcpStats.reportsSent, _rtcpStats.reportsReceived);
+}
+
+void RtspConnect::startFeedback() {
+    if (_feedbackTimer == 0) {
+        _feedbackExpected = _rtcpReceiver->expected();
+        _feedbackReceived = _rtcpReceiver->received();
+        _feedbackOctets = _rtcpReceiver->octets();
+        _feedbackTimer = _loop->addPeriodicTimer(kFeedbackIntervalMs, kFeedbackIntervalMs, [this]() {
+            sendFeedback();
+        });
     }
+}
+
+void RtspConnect::sendFeedback() {
+    std::shared_ptr<TcpConnection> conn = _tcpConn.lock();
+    if (!conn) {
+        return;
+    }
+    // 丢包按上次反馈以来的应收/实收算；KCP 推流是重传之后的，FEC 推流是线路上的（恢复出的包不计）
+    uint32_t expected = _rtcpReceiver->expected();
+    uint64_t received = _rtcpReceiver->received();
+    uint64_t octets = _rtcpReceiver->octets();
+    if (expected < _feedbackExpected || received < _feedbackReceived) {
+        // 摄像头换了 SSRC，接收统计重新开始
+        _feedbackExpected = 0;
+        _feedbackReceived = 0;
+    }
+    uint32_t expectedInterval = expected - _feedbackExpected;
+    int64_t lostInterval = int64_t(expectedInterval) - int64_t(received - _feedbackReceived);
+    unsigned loss = (expectedInterval == 0 || lostInterval <= 0)
+                    ? 0 : static_cast<unsigned>(std::min<int64_t>((lostInterval << 8) / expectedInterval, 255));
+    unsigned long kbps = static_cast<unsigned long>((octets - _feedbackOctets) * 8 / kFeedbackIntervalMs);
+    _feedbackExpected = expected;
+    _feedbackReceived = received;
+    _feedbackOctets = octets;
+    RtcpStats stats;
+    _rtcpReceiver->fillStats(stats);
+    // RTSP 连接的 RTT：反馈的 ACK 和上行的媒体走同一方向，摄像头上行排队时会跟着变大
+    int rttMs = -1;
+    struct tcp_info info;
+    socklen_t infoLen = sizeof(info);
+    if (getsockopt(conn->getFd(), IPPROTO_TCP, TCP_INFO, &info, &infoLen) == 0 && info.tcpi_rtt > 0) {
+        rttMs = static_cast<int>(info.tcpi_rtt / 1000);
+    }
+
+    char body[128];
+    int bodyLen = snprintf(body, sizeof(body), "ingest_kbps: %lu\r\nloss: %u\r\nrtt_ms: %d\r\njitter_ms: %u\r\n",
+                           kbps, loss, rttMs, stats.jitter / 90);
+    std::string request;
+    RtspWriter writer(request);
+    writer.requestLine("SET_PARAMETER", "*", true)
+          .header("CSeq", static_cast<unsigned long>(++_feedbackCseq))
+          .header("Session", _session.sessionId)
+          .header("Content-Type", "text/parameters")
+          .end(StringPiece(body, static_cast<size_t>(bodyLen)));
+    conn->send(request);
+    LOG_DEBUG("Session %s feedback: ingest=%lukbps loss=%u/256 rtt=%dms", _session.sessionId.c_str(), kbps, loss, rttMs);
+}
+
+void RtspConnect::stopFeedback() {
+    if (_feedbackTimer) {
+        _loop->removeTimer(_feedbackTimer);
+        _feedbackTimer = 0;
+    }
+}
+
+void RtspConnect::releaseSession(){
+    stopFeedback();
+    stopRtcp();
+    if (_publishing) {
+        _publishing = false;
+        StreamRegistry::instance().remove(_session.stringName, _fanout);
+        MonitorServer::instance().removeCam(_session.sessionId);
+        if (_detections) {
+            LOG_INFO("Session %s: %lu detection frames, %lu boxes", _session.sessionId.c_str(),
+                     (unsigned long)_detections->frames(), (unsigned long)_detections->boxes());
+            _fanout->setDetections(nullptr);
+            _detections.reset();
+        }
+        if (_recorder) {
+            _fanout->removeSink(_recordSinkId);
+            _recorder->close();
+            _recorder.reset();
+        }
+        if (_hlsSinkId) {
+            _fanout->removeSink(_hlsSinkId);
+            _fanout->hls()->close();
+            _fanout->setHls(nullptr);
+            _hlsSinkId = 0;
+        }
+        if (_clipSinkId) {
+            _fanout->removeSink(_clipSinkId);
+            _fanout->clipRecorder()->close();
+            _fanout->setClipRecorder(nullptr);
+            _clipSinkId = 0;
+        }
+    }
+    if (_sinkId) {
+        StreamFanoutPtr stream = _playStream;
+        uint64_t id = _sinkId;
+        stream->loop()->runInLoop([stream, id]() {
+            stream->removeSink(id);
+        });
+        _sinkId = 0;
+    }
+    if (_jitter) {
+        if (_jitterTimer) {
+            _loop->removeTimer(_jitterTimer);
+            _jitterTimer = 0;
+        }
+        const RtpJitterBuffer::Stats &st = _jitter->stats();
+        LOG_INFO("Stream %s RTP/UDP ingest: received=%lu lost=%lu late=%lu reordered=%lu duplicates=%lu "
+                 "frames=%lu incomplete=%lu jitter=%.1fms", _session.stringName.c_str(),
+                 (unsigned long)st.received, (unsigned long)st.lost, (unsigned long)st.late,
+                 (unsigned long)st.reordered, (unsigned long)st.duplicates, (unsigned long)st.frames,
+                 (unsigned long)st.incompleteFrames, st.jitter / 90.0);
+        _jitter.reset();
+    }
+    if (_fec) {
+        const FecDecoder::Stats &st = _fec->stats();
+        LOG_INFO("Stream %s FEC: data=%lu parity=%lu groups=%lu recovered=%lu unrecovered=%lu",
+                 _session.stringName.c_str(), (unsigned long)st.data, (unsigned long)st.parity,
+                 (unsigned long)st.groups, (unsigned long)st.recovered, (unsigned long)st.unrecovered);
+        _fec.reset();
+    }
+    releaseCamKcp();
+    releaseUdpTrack(_session.videoRtpConn, _session.videoRtcpConn, _session.videoPort);
+    releaseUdpTrack(_session.audioRtpConn, _session.audioRtcpConn, _session.audioPort);
     _sessionManager.removeSession(_session.sessionId);
 }
+
+void RtspConnect::setStreamName(const std::string &name) {
+    _session.setStreamName(name);
+    _sessionManager.setStreamName(_session.sessionId, name);
+}
@@ -5,8 +5,16 @@
 #include "UdpConnection.h"
 #include <memory>
 #include <string>
-#include <map>
 #include "SessionManager.h"
+#include "RtspParser.h"
+#include "StreamFanout.h"
+#include "Mp4Recorder.h"
+#include "ClipRecorder.h"
+#include "HlsSegmenter.h"
+#include "RtpJitterBuffer.h"
+#include "Rtcp.h"
+#include "Fec.h"
+#include "DetectionIndex.h"
 #include <memory>
 extern "C"{
 #include "ikcp.h"
@@ -14,8 +22,6 @@ extern "C"{
 class TcpConnection;
 class UdpConnection;
 class EventLoop;
-// class RtpH264Mp4Recorder;
-class RtpH264Unpacker;
 
 
 // RTSP会话状态
@@ -29,8 +35,8 @@ public:
     RtspConnect(std::shared_ptr<TcpConnection> tcpConn, EventLoop* loop);
     ~RtspConnect();
 
-    // 处理RTSP请求
-    void handleRequest(const std::string& request);
+    // 处理RTSP请求（data 指向接收缓冲区中一条完整请求）
+    void handleRequest(const char* data, size_t len);
     
     // 获取会话状态
     RtspState getState() const { return _state; }
@@ -39,59 +45,69 @@ public:
     void onInterleavedFrame(uint8_t ch, const uint8_t* data, size_t len);
     
 private:
-    // 解析RTSP请求
-    void parseRequest(const std::string& request, std::string& method, 
-                     std::string& url, std::map<std::string, std::string>& headers);
-    
-    // 提取CSeq
-    int extractCSeq(const std::map<std::string, std::string>& headers);
-    
     // 处理OPITIONS请求
-    void handleOpitions(const std::string& request,
-        const std::map<std::string, std::string>& headers, int cseq);
+    void handleOpitions(const RtspRequest& req, int cseq);
     // 处理ANNOUNCE请求（推流场景）
-    void handleAnnounce(const std::string& request,
-                        const std::map<std::string, std::string>& headers, int cseq);
+    void handleAnnounce(const RtspRequest& req, int cseq);
     
     // 处理SETUP请求
-    void handleSetup(const std::string& url, 
-                    const std::map<std::string, std::string>& headers, int cseq);
+    void handleSetup(const RtspRequest& req, int cseq);
     
 
     // 处理RECORD请求（推流开始）
-    void handleRecord(const std::string& url,
-                      const std::map<std::string, std::string>& headers, int cseq);
+    void handleRecord(const RtspRequest& req, int cseq);
+
+    // 处理DESCRIBE请求（拉流）：按URL中的流名称返回SDP，参数集取自推流
+    void handleDescribe(const RtspRequest& req, int cseq);
+    // 处理PLAY请求（拉流开始）：把本会话挂到对应推流的分发器上
+    void handlePlay(const RtspRequest& req, int cseq);
+    // 处理SET_PARAMETER请求：保活，或推流摄像头上报的检测事件（触发事件片段）
+    void handleSetParameter(const RtspRequest& req, int cseq);
+    // rtsp://host:port/name[/trackID=N] 中的 name
+    static std::string streamNameOf(StringPiece url);
     
-    void handleTeardown(const std::string& url,
-                        const std::map<std::string, std::string>& headers, int cseq);
-    // 发送RTSP响应
-    void sendResponse(int statusCode, const std::string& statusText, 
-                     const std::map<std::string, std::string>& extraHeaders, int cseq);
-    // 发送RTSP响应（包含可选body）
-    void sendResponse(int statusCode, const std::string& statusText,
-                     const std::map<std::string, std::string>& extraHeaders, int cseq,
-                     const std::string& body);
-    void handleTeardown();
+    void handleTeardown(const RtspRequest& req, int cseq);
+    // 开始一条响应：状态行、CSeq、Server，之后可继续追加头部
+    RtspWriter beginResponse(int statusCode, int cseq);
+    // 结束头部（可带body）并发送
+    void finishResponse(RtspWriter& writer, StringPiece body = StringPiece());
+    // 发送只有公共头部的RTSP响应
+    void sendResponse(int statusCode, int cseq);
     // 从Transport头中解析传输方式和端口
     // 返回: true=成功, false=失败
     // 输出: transportType="UDP"或"TCP"
     //      UDP模式: clientRtpPort, clientRtcpPort, serverRtpPort, serverRtcpPort
     //      TCP模式: rtpChannel, rtcpChannel (interleaved通道号)
-    bool parseTransport(const std::string& transport, 
+    bool parseTransport(StringPiece transport, 
                        std::string& transportType,
                        uint16_t& clientRtpPort, uint16_t& clientRtcpPort,
                        uint16_t& serverRtpPort, uint16_t& serverRtcpPort,
                        uint8_t& rtpChannel, uint8_t& rtcpChannel);
-    // 从完整请求中提取body（按Content-Length）
-    std::string extractBody(const std::string& request, const std::map<std::string, std::string>& headers);
     
-    uint32_t iclock() {
-        using namespace std::chrono;
-        return (uint32_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
-    }
-    void kcp_update_thread();
     // void initCamKcp(uint32_t conv,kcpClient_t *kcpClient);
     void initCamKcp(uint32_t conv,UdpConnectionPtr kcpClient);
+    void releaseCamKcp();
+    // 一路 UDP 的 RTP/RTCP 连接从 loop 上摘掉，再把端口对放回池里
+    void releaseUdpTrack(UdpConnectionPtr &rtpConn, UdpConnectionPtr &rtcpConn, uint16_t &port);
+    // 重排缓冲放出到期的帧，还有积压时定时再来
+    void pollJitter();
+    // 收到 RTCP 复合包（UDP 的 RTCP 端口或 interleaved 的 RTCP 通道）
+    void onRtcp(const uint8_t* data, size_t len);
+    // RECORD/PLAY 后按报告间隔发 RR（推流）或 SR（拉流），并刷新会话的 RTCP 统计
+    void startRtcp();
+    void sendRtcpReport();
+    void stopRtcp();
+    // 发送 _rtcpBuf（前 4 字节留给 interleaved 头）
+    void sendRtcp();
+    // 推流：RECORD 带 "Rate-Feedback: 1" 时按间隔经 RTSP 连接发 SET_PARAMETER，
+    // 告诉摄像头收到的码率、丢包、RTT，摄像头据此调整编码码率
+    void startFeedback();
+    void sendFeedback();
+    void stopFeedback();
+    // 同时更新 SessionManager 里按名称的索引
+    void setStreamName(const std::string &name);
+    // 推流收到的 RTP 交给分发器；带检测结果扩展头的先取出登记，去掉扩展头再分发
+    void publishRtp(const char *data, size_t len);
     
 private:
     std::weak_ptr<TcpConnection> _tcpConn;
@@ -101,11 +117,35 @@ private:
     std::string _serverIp;
     RtspSession _session;
     std::string _sdp; // 客户端通过ANNOUNCE提供的SDP
+    std::string _response; // 响应缓冲，复用容量
     static SessionManager _sessionManager;
-    ikcpcb *_camKcp;
-    std::atomic<bool> _kcpRunning{false};
-    std::thread _kcpThread;
-    std::mutex _kcpMutex;
+    ikcpcb *_camKcp; // 只在 _loop 线程里使用，由 KcpScheduler 驱动
+    StreamFanoutPtr _fanout; // 收到的报文分发给观看本摄像头的qt客户端和RTSP播放端
+    bool _publishing = false; // RECORD 后已登记为推流
+    uint8_t _rtpChannel = 0; // TCP 传输时的 RTP interleaved 通道
+    StreamFanoutPtr _playStream; // 拉流时订阅的推流
+    uint64_t _sinkId = 0; // 在 _playStream 上的订阅 id，0 表示未订阅
+    std::shared_ptr<Mp4Recorder> _recorder; // 配置了录像目录时，推流期间挂在 _fanout 上
+    uint64_t _recordSinkId = 0;
+    uint64_t _hlsSinkId = 0; // HLS 输出的订阅 id，HlsSegmenter 本身挂在 _fanout 上
+    uint64_t _clipSinkId = 0; // 事件片段的订阅 id，ClipRecorder 本身挂在 _fanout 上
+    std::unique_ptr<RtpJitterBuffer> _jitter; // 不带 KcpId 的 UDP 推流（普通 RTP）
+    TimerId _jitterTimer = 0;
+    std::unique_ptr<FecDecoder> _fec; // RECORD 带 Fec 头的 UDP 推流：先纠错再进重排缓冲
+    std::shared_ptr<DetectionIndex> _detections; // 推流期间挂在 _fanout 上
+    std::string _stripped; // 去掉扩展头后的 RTP，复用容量
+    uint8_t _rtcpChannel = 1; // TCP 传输时的 RTCP interleaved 通道
+    uint32_t _rtcpSsrc; // 本端作为 RR 发送者的 SSRC
+    std::unique_ptr<RtcpReceiver> _rtcpReceiver; // 推流：服务器是 RTP 接收端
+    std::shared_ptr<RtcpSender> _rtcpSender; // 拉流：订阅回调在推流 loop 上计数
+    RtcpStats _rtcpStats;
+    TimerId _rtcpTimer = 0;
+    std::string _rtcpBuf; // RTCP 发送缓冲，复用容量
+    TimerId _feedbackTimer = 0;
+    int _feedbackCseq = 0; // 服务器发起的请求的 CSeq
+    uint32_t _feedbackExpected = 0; // 上次反馈时 _rtcpReceiver 的计数
+    uint64_t _feedbackReceived = 0;
+    uint64_t _feedbackOctets = 0;
 };
 
 #endif
@@ -0,0 +1,243 @@
+#include "RtspParser.h"
+#include <limits.h>
+#include <strings.h>
+
+bool StringPiece::iequals(StringPiece other) const {
+    return len == other.len && strncasecmp(data, other.data, len) == 0;
+}
+
+size_t StringPiece::find(StringPiece needle, size_t pos) const {
+    if (pos > len || needle.len > len - pos) return npos;
+    if (needle.len == 0) return pos;
+    const void *p = memmem(data + pos, len - pos, needle.data, needle.len);
+    return p ? static_cast<const char *>(p) - data : npos;
+}
+
+StringPiece StringPiece::substr(size_t pos, size_t n) const {
+    if (pos > len) pos = len;
+    if (n > len - pos) n = len - pos;
+    return StringPiece(data + pos, n);
+}
+
+static inline bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+StringPiece StringPiece::trim() const {
+    size_t b = 0, e = len;
+    while (b < e && isBlank(data[b])) ++b;
+    while (e > b && isBlank(data[e - 1])) --e;
+    return StringPiece(data + b, e - b);
+}
+
+unsigned long StringPiece::toULong() const {
+    unsigned long value;
+    return toULong(value) ? value : 0;
+}
+
+bool StringPiece::toULong(unsigned long &value) const {
+    size_t i = 0;
+    while (i < len && (data[i] == ' ' || data[i] == '\t')) ++i;
+    value = 0;
+    size_t digits = i;
+    for (; i < len && data[i] >= '0' && data[i] <= '9'; ++i) {
+        unsigned d = data[i] - '0';
+        if (value > (ULONG_MAX - d) / 10) {
+            value = 0;
+            return false;
+        }
+        value = value * 10 + d;
+    }
+    return i > digits;
+}
+
+// 常用头部名按长度分开，比较一次就能确定
+static int knownHeaderIndex(StringPiece name) {
+    RtspHeader h;
+    switch (name.len) {
+    case 4:  h = RtspHeader::CSeq; break;
+    case 5:  h = RtspHeader::KcpId; break;
+    case 7:  h = RtspHeader::Session; break;
+    case 9:  h = RtspHeader::Transport; break;
+    case 12: h = RtspHeader::ContentType; break;
+    case 14: h = RtspHeader::ContentLength; break;
+    default: return -1;
+    }
+    static const char *const kNames[] = {
+        "CSeq", "Session", "Transport", "Content-Length", "Content-Type", "KcpId"
+    };
+    return name.iequals(kNames[static_cast<int>(h)]) ? static_cast<int>(h) : -1;
+}
+
+void RtspRequest::reset() {
+    _method = _url = _version = _body = StringPiece();
+    _fieldNum = 0;
+    memset(_known, 0, sizeof(_known));
+    _scanned = 0;
+    _headerLen = 0;
+    _length = 0;
+}
+
+RtspRequest::Result RtspRequest::parse(const char *data, size_t len) {
+    if (_headerLen == 0) {
+        // 找 header 结束，上次已经找过的部分不再重复扫描
+        size_t from = _scanned > 3 ? _scanned - 3 : 0;
+        const char *found = nullptr;
+        if (len > from) {
+            found = static_cast<const char *>(memmem(data + from, len - from, "\r\n\r\n", 4));
+        }
+        if (!found) {
+            _scanned = len;
+            return len > kMaxHeaderLen ? Error : Incomplete;
+        }
+        _headerLen = found - data + 4;
+    }
+    // 缓冲区可能在两次调用之间搬移过，视图每次都按当前地址重新建立
+    if (parseHeader(data, _headerLen) == Error) {
+        return Error;
+    }
+    size_t bodyLen = 0;
+    StringPiece contentLength = header(RtspHeader::ContentLength);
+    if (!contentLength.empty()) {
+        unsigned long value;
+        if (!contentLength.toULong(value) || value > kMaxBodyLen) {
+            return Error;
+        }
+        bodyLen = value;
+    }
+    if (len - _headerLen < bodyLen) {
+        return Incomplete; // body 未收全
+    }
+    _body = StringPiece(data + _headerLen, bodyLen);
+    _length = _headerLen + bodyLen;
+    return Complete;
+}
+
+RtspRequest::Result RtspRequest::parseHeader(const char *data, size_t headerLen) {
+    _fieldNum = 0;
+    memset(_known, 0, sizeof(_known));
+    const char *end = data + headerLen;
+
+    // 请求行：METHOD URL [RTSP/1.0]
+    const char *eol = static_cast<const char *>(memchr(data, '\n', headerLen));
+    StringPiece line = StringPiece(data, eol - data).trim();
+    size_t sp1 = line.find(" ");
+    if (line.empty() || sp1 == StringPiece::npos) {
+        _method = line;
+        _url = _version = StringPiece();
+        return line.empty() ? Error : Complete;
+    }
+    _method = line.substr(0, sp1);
+    StringPiece rest = line.substr(sp1 + 1).trim();
+    size_t sp2 = rest.find(" ");
+    _url = rest.substr(0, sp2);
+    _version = sp2 == StringPiece::npos ? StringPiece() : rest.substr(sp2 + 1).trim();
+
+    // 头部：Name: value，空行结束
+    for (const char *p = eol + 1; p < end; p = eol + 1) {
+        eol = static_cast<const char *>(memchr(p, '\n', end - p));
+        if (!eol) eol = end;
+        StringPiece field(p, eol - p);
+        const char *colon = static_cast<const char *>(memchr(field.data, ':', field.len));
+        if (!colon) continue;
+        if (_fieldNum == kMaxFields) break;
+        Field &f = _fields[_fieldNum++];
+        f.name = StringPiece(p, colon - p).trim();
+        f.value = StringPiece(colon + 1, eol - colon - 1).trim();
+        int known = knownHeaderIndex(f.name);
+        if (known >= 0 && _known[known] == 0) {
+            _known[known] = static_cast<uint8_t>(_fieldNum);
+        }
+    }
+    return Complete;
+}
+
+StringPiece RtspRequest::header(RtspHeader h) const {
+    uint8_t idx = _known[static_cast<int>(h)];
+    return idx ? _fields[idx - 1].value : StringPiece();
+}
+
+StringPiece RtspRequest::header(StringPiece name) const {
+    for (int i = 0; i < _fieldNum; ++i) {
+        if (_fields[i].name.iequals(name)) return _fields[i].value;
+    }
+    return StringPiece();
+}
+
+struct StatusLine {
+    int code;
+    StringPiece line;
+};
+
+#define STATUS_LINE(code, text) { code, StringPiece(#code " " text "\r\n", sizeof(#code " " text "\r\n") - 1) }
+static const StatusLine kStatusLines[] = {
+    STATUS_LINE(200, "OK"),
+    STATUS_LINE(400, "Bad Request"),
+    STATUS_LINE(401, "Unauthorized"),
+    STATUS_LINE(404, "Not Found"),
+    STATUS_LINE(405, "Method Not Allowed"),
+    STATUS_LINE(454, "Session Not Found"),
+    STATUS_LINE(455, "Method Not Valid in This State"),
+    STATUS_LINE(459, "Aggregate Operation Not Allowed"),
+    STATUS_LINE(461, "Unsupported Transport"),
+    STATUS_LINE(500, "Internal Server Error"),
+    STATUS_LINE(501, "Not Implemented"),
+    STATUS_LINE(503, "Service Unavailable"),
+};
+#undef STATUS_LINE
+
+RtspWriter &RtspWriter::status(int code, bool withVersion) {
+    if (withVersion) append(StringPiece("RTSP/1.0 ", 9));
+    for (const StatusLine &s : kStatusLines) {
+        if (s.code == code) {
+            append(s.line);
+            return *this;
+        }
+    }
+    appendNumber(static_cast<unsigned long>(code));
+    append(StringPiece(" Unknown\r\n", 10));
+    return *this;
+}
+
+RtspWriter &RtspWriter::requestLine(StringPiece method, StringPiece url, bool withVersion) {
+    append(method);
+    _out.push_back(' ');
+    append(url);
+    if (withVersion) append(StringPiece(" RTSP/1.0", 9));
+    append(StringPiece("\r\n", 2));
+    return *this;
+}
+
+RtspWriter &RtspWriter::header(StringPiece name, StringPiece value) {
+    append(name);
+    append(StringPiece(": ", 2));
+    append(value);
+    append(StringPiece("\r\n", 2));
+    return *this;
+}
+
+RtspWriter &RtspWriter::header(StringPiece name, unsigned long value) {
+    append(name);
+    append(StringPiece(": ", 2));
+    appendNumber(value);
+    append(StringPiece("\r\n", 2));
+    return *this;
+}
+
+void RtspWriter::end(StringPiece body) {
+    if (!body.empty()) {
+        header(StringPiece("Content-Length", 14), static_cast<unsigned long>(body.len));
+    }
+    append(StringPiece("\r\n", 2));
+    append(body);
+}
+
+void RtspWriter::appendNumber(unsigned long value) {
+    char buf[24];
+    char *p = buf + sizeof(buf);
+    do {
+        *--p = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value);
+    _out.append(p, buf + sizeof(buf) - p);
+}
@@ -0,0 +1,118 @@
+#ifndef __RTSPPARSER_H__
+#define __RTSPPARSER_H__
+
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// 只读字符串视图（C++14 没有 std::string_view），指向请求缓冲区，不拥有内存
+struct StringPiece {
+    static const size_t npos = static_cast<size_t>(-1);
+
+    const char *data = nullptr;
+    size_t len = 0;
+
+    StringPiece() = default;
+    StringPiece(const char *d, size_t l) : data(d), len(l) {}
+    StringPiece(const char *cstr) : data(cstr), len(strlen(cstr)) {}
+    StringPiece(const std::string &s) : data(s.data()), len(s.size()) {}
+
+    bool empty() const { return len == 0; }
+    bool equals(StringPiece other) const {
+        return len == other.len && memcmp(data, other.data, len) == 0;
+    }
+    bool iequals(StringPiece other) const;    // 忽略大小写比较
+    size_t find(StringPiece needle, size_t pos = 0) const;
+    bool contains(StringPiece needle) const { return find(needle) != npos; }
+    StringPiece substr(size_t pos, size_t n = npos) const;
+    StringPiece trim() const;                 // 去掉首尾空白
+    unsigned long toULong() const;            // 取开头的十进制整数，没有或溢出则为 0
+    bool toULong(unsigned long &value) const; // 同上，没有数字或溢出时返回 false
+    std::string toString() const { return std::string(data, len); }
+};
+
+// 常用头部，解析时直接记下位置，查找不再遍历
+enum class RtspHeader : uint8_t {
+    CSeq,
+    Session,
+    Transport,
+    ContentLength,
+    ContentType,
+    KcpId,
+    Num
+};
+
+// RTSP（以及监控端同格式的自定义协议）请求解析，结果全部指向输入缓冲区，不分配内存。
+// 输入可以只是已收到的一部分，返回 Incomplete 时等数据到齐后用同一个对象再次 parse，
+// 已经扫描过的部分不会重复查找
+class RtspRequest {
+public:
+    enum Result { Complete, Incomplete, Error };
+    static const int kMaxFields = 32;
+    static const size_t kMaxHeaderLen = 8192;
+    static const size_t kMaxBodyLen = 1024 * 1024;  // 和 TcpConnection 分帧的上限一致
+
+    struct Field {
+        StringPiece name;
+        StringPiece value;
+    };
+
+    RtspRequest() { reset(); }
+    void reset();
+
+    Result parse(const char *data, size_t len);
+
+    // 整条请求（头部 + body）的长度，Complete 后有效
+    size_t length() const { return _length; }
+
+    StringPiece method() const { return _method; }
+    StringPiece url() const { return _url; }
+    StringPiece version() const { return _version; }
+    StringPiece body() const { return _body; }
+
+    StringPiece header(RtspHeader h) const;
+    StringPiece header(StringPiece name) const; // 不在常用表里的头部，线性查找
+    int cseq() const { return static_cast<int>(header(RtspHeader::CSeq).toULong()); }
+
+    int fieldCount() const { return _fieldNum; }
+    const Field &field(int i) const { return _fields[i]; }
+
+private:
+    Result parseHeader(const char *data, size_t headerLen);
+
+    StringPiece _method;
+    StringPiece _url;
+    StringPiece _version;
+    StringPiece _body;
+    Field _fields[kMaxFields];
+    int _fieldNum;
+    uint8_t _known[static_cast<int>(RtspHeader::Num)]; // 常用头部在 _fields 中的下标+1，0 表示没有
+    size_t _scanned;        // 已经找过 \r\n\r\n 的长度
+    size_t _headerLen;      // 0 表示头部还没收全
+    size_t _length;
+};
+
+// 响应/请求构造：状态行预先格式化好，数字直接转换，追加到调用方复用的 string 中，
+// 容量够时不分配内存
+class RtspWriter {
+public:
+    explicit RtspWriter(std::string &out) : _out(out) {}
+
+    // "RTSP/1.0 200 OK\r\n"；withVersion=false 时只写 "200 OK\r\n"（监控端协议）
+    RtspWriter &status(int code, bool withVersion = true);
+    // "METHOD url\r\n"（监控端协议的请求行不带版本号）；withVersion=true 时是 "METHOD url RTSP/1.0\r\n"
+    RtspWriter &requestLine(StringPiece method, StringPiece url, bool withVersion = false);
+    RtspWriter &header(StringPiece name, StringPiece value);
+    RtspWriter &header(StringPiece name, unsigned long value);
+    // 结束头部；body 非空时补上 Content-Length 并追加 body
+    void end(StringPiece body = StringPiece());
+
+private:
+    void append(StringPiece s) { _out.append(s.data, s.len); }
+    void appendNumber(unsigned long value);
+
+    std::string &_out;
+};
+
+#endif
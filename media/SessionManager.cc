@@ -9,34 +9,131 @@ SessionManager::~SessionManager() {
 }
 
 std::string SessionManager::generateSessionId() {
-    _sessionCounter++;
+    uint32_t counter = _sessionCounter.fetch_add(1, std::memory_order_relaxed) + 1;
     std::ostringstream oss;
-    oss << std::hex << std::time(nullptr) << "-" << _sessionCounter;
+    oss << std::hex << std::time(nullptr) << "-" << counter;
     return oss.str();
 }
 
-void SessionManager::addSession(RtspSession session) {
-    std::lock_guard<std::mutex> lock(_sessionMutex);
-    _sessions[session.sessionId] = session;
-    _sessionCounter++;
+void SessionManager::addSession(const RtspSession &session) {
+    SessionInfo info;
+    info.sessionId = session.sessionId;
+    info.clientIp = session.clientIp;
+    info.streamName = session.stringName;
+    info.lastActive = session.lastActive;
+    info.rtcp = session.rtcp;
+    Shard &shard = shardOf(session.sessionId);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    if (shard.sessions.emplace(session.sessionId, std::move(info)).second) {
+        _sessionNumber.fetch_add(1, std::memory_order_relaxed);
+    }
 }
 
 void SessionManager::removeSession(const std::string& sessionId) {
-    std::lock_guard<std::mutex> lock(_sessionMutex);
-    _sessions.erase(sessionId);
+    std::string name;
+    {
+        Shard &shard = shardOf(sessionId);
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        auto it = shard.sessions.find(sessionId);
+        if (it == shard.sessions.end()) {
+            return;
+        }
+        name = std::move(it->second.streamName);
+        shard.sessions.erase(it);
+        _sessionNumber.fetch_sub(1, std::memory_order_relaxed);
+    }
+    // 两把锁先后拿，不嵌套
+    removeName(name, sessionId);
+}
+
+void SessionManager::removeName(const std::string &name, const std::string &sessionId) {
+    if (name.empty()) {
+        return;
+    }
+    Shard &shard = shardOf(name);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    auto it = shard.names.find(name);
+    if (it != shard.names.end() && it->second == sessionId) {
+        shard.names.erase(it);
+    }
+}
+
+bool SessionManager::getSession(const std::string& sessionId, SessionInfo &info) {
+    Shard &shard = shardOf(sessionId);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    auto it = shard.sessions.find(sessionId);
+    if (it == shard.sessions.end()) {
+        return false;
+    }
+    info = it->second;
+    return true;
+}
+
+void SessionManager::setStreamName(const std::string& sessionId, const std::string& name) {
+    std::string old;
+    {
+        Shard &shard = shardOf(sessionId);
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        auto it = shard.sessions.find(sessionId);
+        if (it == shard.sessions.end() || it->second.streamName == name) {
+            return;
+        }
+        old = it->second.streamName;
+        it->second.streamName = name;
+    }
+    removeName(old, sessionId);
+    if (!name.empty()) {
+        Shard &shard = shardOf(name);
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        shard.names[name] = sessionId;
+    }
+}
+
+bool SessionManager::findByStreamName(const std::string& name, SessionInfo &info) {
+    std::string sessionId;
+    {
+        Shard &shard = shardOf(name);
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        auto it = shard.names.find(name);
+        if (it == shard.names.end()) {
+            return false;
+        }
+        sessionId = it->second;
+    }
+    return getSession(sessionId, info);
+}
+
+void SessionManager::updateRtcpStats(const std::string& sessionId, const RtcpStats& stats) {
+    Shard &shard = shardOf(sessionId);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    auto it = shard.sessions.find(sessionId);
+    if (it != shard.sessions.end()) {
+        it->second.rtcp = stats;
+        it->second.lastActive = std::chrono::steady_clock::now();
+    }
 }
 
-RtspSession* SessionManager::getSession(const std::string& sessionId) {
-    std::lock_guard<std::mutex> lock(_sessionMutex);
-    auto it = _sessions.find(sessionId);
-    if (it != _sessions.end()) {
-        return &it->second;
+bool SessionManager::getRtcpStats(const std::string& sessionId, RtcpStats& stats) {
+    Shard &shard = shardOf(sessionId);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    auto it = shard.sessions.find(sessionId);
+    if (it == shard.sessions.end()) {
+        return false;
     }
-    return nullptr;
+    stats = it->second.rtcp;
+    return true;
 }
+
 uint16_t SessionManager::allocateUdpPorts(){
-    std::lock_guard<std::mutex> lock(_portMutex);
-    int basePort = nextUdpPort.fetch_add(2);
-    LOG_DEBUG("Allocated UDP ports starting from: %d", basePort);
+    uint16_t basePort = _ports.allocate();
+    if (basePort == 0) {
+        LOG_ERROR("UDP port pool exhausted (%zu pairs in use)", _ports.inUse());
+    } else {
+        LOG_DEBUG("Allocated UDP ports starting from: %d", basePort);
+    }
     return basePort;
-}
\ No newline at end of file
+}
+
+void SessionManager::releaseUdpPorts(uint16_t port) {
+    _ports.release(port);
+}
@@ -1,13 +1,15 @@
 #ifndef __SESSIONMANAGER_H_
 #define __SESSIONMANAGER_H_
 
-#include <map>
 #include <mutex>
 #include <string>
 #include <atomic>
 #include <memory>
+#include <unordered_map>
 #include "UdpConnection.h"
+#include "UdpPortPool.h"
 #include "Logger.h"
+#include "Rtcp.h"
 
 
 struct RtspSession{
@@ -18,33 +20,65 @@ struct RtspSession{
     std::shared_ptr<UdpConnection> videoRtcpConn = nullptr;
     std::shared_ptr<UdpConnection> audioRtpConn = nullptr;
     std::shared_ptr<UdpConnection> audioRtcpConn = nullptr;
+    uint16_t videoPort = 0;    // 从端口池分到的 RTP 端口，0 表示没有分配（客户端指定或 TCP）
+    uint16_t audioPort = 0;
     std::string transportType;
     std::string stringName;
+    RtcpStats rtcp;            // 视频的 RTCP 统计，按报告间隔刷新
     void setStreamName(const std::string &name) { this->stringName = name; }
     const std::string &getStreamName() const { return this->stringName; }
 };
 
+// 登记在 SessionManager 里的会话信息。连接对象只归 RtspConnect 所有，这里不持有
+struct SessionInfo {
+    std::string sessionId;
+    std::string clientIp;
+    std::string streamName;
+    std::chrono::steady_clock::time_point lastActive;
+    RtcpStats rtcp;
+};
+
+// 所有 loop 共用的会话表：按会话ID哈希分片，各片一把锁，另有按流名称的索引（同样分片）。
+// 查找都是拷贝出来，不返回指向表内的指针
 class SessionManager{
 public:
     SessionManager();
     ~SessionManager();
-    void addSession(RtspSession session);
+    void addSession(const RtspSession &session);
     void removeSession(const std::string& sessionId);
-    RtspSession* getSession(const std::string& sessionId);
-    uint16_t allocateUdpPorts(); 
+    bool getSession(const std::string& sessionId, SessionInfo &info);
+    // 流名称（ANNOUNCE/RECORD 的 URL）变化时更新索引，名称被占用时以后登记的为准
+    void setStreamName(const std::string& sessionId, const std::string& name);
+    bool findByStreamName(const std::string& name, SessionInfo &info);
+    // 会话所在 loop 每个 RTCP 报告间隔写一次，其他线程按需读一份拷贝
+    void updateRtcpStats(const std::string& sessionId, const RtcpStats& stats);
+    bool getRtcpStats(const std::string& sessionId, RtcpStats& stats);
+    // 一对 RTP/RTCP 端口，返回偶数端口，用完时返回 0；会话结束时释放
+    uint16_t allocateUdpPorts();
+    void releaseUdpPorts(uint16_t port);
+    size_t udpPortsInUse() const { return _ports.inUse(); }
     std::string generateSessionId();
     uint32_t getSessionCount(){
-        return _sessionCounter;
+        return _sessionCounter.load(std::memory_order_relaxed);
     }
     int getSessionNumber(){
-        return _sessions.size();
+        return _sessionNumber.load(std::memory_order_relaxed);
     }
-private:  
-    std::map<std::string, RtspSession> _sessions;
-    std::mutex _sessionMutex;
-    std::mutex _portMutex; 
-    std::atomic<int> nextUdpPort{10000};
-    uint32_t _sessionCounter = 0;
+private:
+    static const size_t kShards = 16;
+
+    struct Shard {
+        std::mutex mtx;
+        std::unordered_map<std::string, SessionInfo> sessions;
+        std::unordered_map<std::string, std::string> names;    // 流名称 -> 会话ID
+    };
+    Shard &shardOf(const std::string &key) { return _shards[std::hash<std::string>()(key) % kShards]; }
+    void removeName(const std::string &name, const std::string &sessionId);
+
+    Shard _shards[kShards];
+    UdpPortPool _ports;
+    std::atomic<uint32_t> _sessionCounter{0};
+    std::atomic<int> _sessionNumber{0};
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,115 @@
+#include "StreamFanout.h"
+#include "KcpScheduler.h"
+#include "PacketPool.h"
+#include "Logger.h"
+#include <string.h>
+
+StreamFanout::StreamFanout(EventLoop *loop, bool gopCache)
+:_loop(loop)
+,_dropped(0)
+,_gopCacheEnabled(gopCache){
+}
+
+StreamFanout::~StreamFanout() {
+}
+
+void StreamFanout::publish(const char *data, size_t len) {
+    publish(PacketPool::makeBuffer(data, len));//整路只拷贝这一次，数据块从池里取
+}
+
+void StreamFanout::publish(const BufferPtr &buf) {
+    updateParameterSets(buf);
+    if (_gopCacheEnabled) {
+        _gop.onPacket(buf);
+    }
+    for (auto &s : _sinks) {
+        s.second(buf);
+    }
+    for (auto &s : _subscribers) {
+        std::deque<BufferPtr> &pending = s.second;
+        if (pending.size() >= kMaxPending) {
+            pending.pop_front();
+            if (_dropped++ % 1000 == 0) {
+                LOG_WARN("StreamFanout subscriber conv=%u too slow, dropped %lu packets",
+                         s.first->conv, (unsigned long)_dropped);
+            }
+        }
+        pending.push_back(buf);
+        pump(s.first, pending);
+    }
+}
+
+void StreamFanout::addSubscriber(ikcpcb *kcp) {
+    std::deque<BufferPtr> &pending = _subscribers[kcp];
+    // 先把缓存的 GOP 一次性排上，之后接实时数据；比积压上限还长的话排上也会被挤掉头部，不如不发
+    if (_gop.ready() && _gop.packets().size() < kMaxPending) {
+        pending.assign(_gop.packets().begin(), _gop.packets().end());
+        pump(kcp, pending);
+    }
+}
+
+uint64_t StreamFanout::nextSinkId() {
+    static std::atomic<uint64_t> id{0};
+    return ++id;
+}
+
+void StreamFanout::addSink(uint64_t id, PacketSink &&sink) {
+    if (_gop.ready()) {
+        for (const BufferPtr &pkt : _gop.packets()) {
+            sink(pkt);
+        }
+    }
+    _sinks[id] = std::move(sink);
+}
+
+void StreamFanout::removeSink(uint64_t id) {
+    _sinks.erase(id);
+}
+
+void StreamFanout::updateParameterSets(const BufferPtr &pkt) {
+    bool start;
+    int type = GopCache::nalType(*pkt, &start);
+    if (type != 7 && type != 8) return;
+    size_t off = GopCache::nalOffset(*pkt);
+    if ((pkt->data()[off] & 0x1F) != type) return;//分片的参数集不处理
+    std::string &dst = type == 7 ? _sps : _pps;
+    if (dst.size() == pkt->size() - off && memcmp(dst.data(), pkt->data() + off, dst.size()) == 0) {
+        return;//每个 IDR 前都会重复，内容不变时不加锁
+    }
+    std::lock_guard<std::mutex> lock(_paramMutex);
+    dst.assign(pkt->data() + off, pkt->size() - off);
+}
+
+bool StreamFanout::parameterSets(std::string &sps, std::string &pps) {
+    std::lock_guard<std::mutex> lock(_paramMutex);
+    if (_sps.empty() || _pps.empty()) return false;
+    sps = _sps;
+    pps = _pps;
+    return true;
+}
+
+void StreamFanout::removeSubscriber(ikcpcb *kcp) {
+    _subscribers.erase(kcp);
+}
+
+void StreamFanout::pump(ikcpcb *kcp) {
+    auto it = _subscribers.find(kcp);
+    if (it != _subscribers.end()) {
+        pump(kcp, it->second);
+    }
+}
+
+void StreamFanout::pump(ikcpcb *kcp, std::deque<BufferPtr> &pending) {
+    if (pending.empty()) return;
+    // 只填满发送窗口，窗口外的数据留在共享队列里，不再为每个订阅者各拷一份
+    bool sent = false;
+    while (!pending.empty() && ikcp_waitsnd(kcp) < (int)kcp->snd_wnd) {
+        const BufferPtr &buf = pending.front();
+        ikcp_send(kcp, buf->data(), (int)buf->size());
+        pending.pop_front();
+        sent = true;
+    }
+    if (sent) {
+        KcpScheduler::instance(_loop).touch(kcp);
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef __STREAMFANOUT_H__
+#define __STREAMFANOUT_H__
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "BufferChain.h"
+#include "GopCache.h"
+extern "C"{
+#include "ikcp.h"
+}
+
+class EventLoop;
+class ClipRecorder;
+class HlsSegmenter;
+class DetectionIndex;
+
+// 一路摄像头到多个观看端的分发：收到的每个报文只包装成一份引用计数的只读数据块。
+// - KCP 订阅者（qt客户端）：挂到各自的待发队列上，KCP发送窗口有空位时才 ikcp_send 进去，
+//   窗口外排队的数据所有订阅者共用同一份
+// - RTP 订阅者（RTSP PLAY）：每个报文回调一次，由回调自己交给播放端连接所在的 loop 发送
+// 新订阅者先收到缓存的最近一个 GOP，可以立即解码。
+// 除 parameterSets、hls 外，所有接口只能在摄像头所在 loop 线程里调用
+class StreamFanout {
+public:
+    static const size_t kMaxPending = 2048;   // 单个订阅者最多积压的报文数，超出丢最旧的
+    using PacketSink = std::function<void(const BufferPtr &)>;
+
+    explicit StreamFanout(EventLoop *loop, bool gopCache = true);
+    ~StreamFanout();
+
+    EventLoop *loop() const { return _loop; }
+
+    void publish(const char *data, size_t len);
+    // 已经是共享数据块的报文（如重排缓冲放出的），不再拷贝
+    void publish(const BufferPtr &buf);
+    void addSubscriber(ikcpcb *kcp);
+    void removeSubscriber(ikcpcb *kcp);
+    // 把待发队列按窗口余量送进 KCP，ACK 到达或 ikcp_update 之后调用
+    void pump(ikcpcb *kcp);
+
+    // RTP 订阅者，id 由 nextSinkId 分配
+    static uint64_t nextSinkId();
+    void addSink(uint64_t id, PacketSink &&sink);
+    void removeSink(uint64_t id);
+
+    // 最近一次的 SPS/PPS（不含 RTP 头的 NAL），还没收到时返回 false；任意线程可调用
+    bool parameterSets(std::string &sps, std::string &pps);
+
+    size_t subscriberCount() const { return _subscribers.size() + _sinks.size(); }
+    uint64_t dropped() const { return _dropped; }
+    const GopCache &gopCache() const { return _gop; }
+
+    // 事件片段录制（同时作为 RTP 订阅者挂着），触发方按摄像头找到它
+    void setClipRecorder(const std::shared_ptr<ClipRecorder> &clip) { _clip = clip; }
+    const std::shared_ptr<ClipRecorder> &clipRecorder() const { return _clip; }
+    // HLS 输出，HTTP 请求在各自的 loop 上按流名称找到分发器后取用，任意线程可调用
+    void setHls(const std::shared_ptr<HlsSegmenter> &hls) { std::atomic_store(&_hls, hls); }
+    std::shared_ptr<HlsSegmenter> hls() const { return std::atomic_load(&_hls); }
+    // 摄像头送来的检测结果，同样按流名称找到后取用，任意线程可调用
+    void setDetections(const std::shared_ptr<DetectionIndex> &index) { std::atomic_store(&_detections, index); }
+    std::shared_ptr<DetectionIndex> detections() const { return std::atomic_load(&_detections); }
+
+private:
+    void pump(ikcpcb *kcp, std::deque<BufferPtr> &pending);
+    void updateParameterSets(const BufferPtr &pkt);
+
+    EventLoop *_loop;
+    std::unordered_map<ikcpcb *, std::deque<BufferPtr>> _subscribers;
+    std::unordered_map<uint64_t, PacketSink> _sinks;
+    uint64_t _dropped;
+    bool _gopCacheEnabled;
+    GopCache _gop;
+    std::mutex _paramMutex;     // 保护 _sps/_pps，DESCRIBE 在播放端 loop 上读取
+    std::string _sps;
+    std::string _pps;
+    std::shared_ptr<ClipRecorder> _clip;
+    std::shared_ptr<HlsSegmenter> _hls;
+    std::shared_ptr<DetectionIndex> _detections;
+};
+
+using StreamFanoutPtr = std::shared_ptr<StreamFanout>;
+
+#endif
@@ -0,0 +1,25 @@
+#include "StreamRegistry.h"
+
+StreamRegistry &StreamRegistry::instance() {
+    static StreamRegistry inst;
+    return inst;
+}
+
+bool StreamRegistry::add(const std::string &name, const StreamFanoutPtr &fanout) {
+    std::lock_guard<std::mutex> lock(_mtx);
+    return _streams.emplace(name, fanout).second;
+}
+
+void StreamRegistry::remove(const std::string &name, const StreamFanoutPtr &fanout) {
+    std::lock_guard<std::mutex> lock(_mtx);
+    auto it = _streams.find(name);
+    if (it != _streams.end() && it->second == fanout) {
+        _streams.erase(it);
+    }
+}
+
+StreamFanoutPtr StreamRegistry::find(const std::string &name) {
+    std::lock_guard<std::mutex> lock(_mtx);
+    auto it = _streams.find(name);
+    return it == _streams.end() ? StreamFanoutPtr() : it->second;
+}
@@ -0,0 +1,28 @@
+#ifndef __STREAMREGISTRY_H__
+#define __STREAMREGISTRY_H__
+
+#include <map>
+#include <mutex>
+#include <string>
+#include "StreamFanout.h"
+
+// 推流名称 -> 分发器。摄像头 RECORD 时登记，RTSP 播放端 DESCRIBE/PLAY 按名称查找，
+// 只在建立/断开会话时访问，用一把锁即可
+class StreamRegistry {
+public:
+    static StreamRegistry &instance();
+
+    // 名称已被占用时返回 false
+    bool add(const std::string &name, const StreamFanoutPtr &fanout);
+    // 只删除仍指向 fanout 的登记项
+    void remove(const std::string &name, const StreamFanoutPtr &fanout);
+    StreamFanoutPtr find(const std::string &name);
+
+private:
+    StreamRegistry() = default;
+
+    std::mutex _mtx;
+    std::map<std::string, StreamFanoutPtr> _streams;
+};
+
+#endif
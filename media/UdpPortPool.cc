@@ -0,0 +1,56 @@
+#include "UdpPortPool.h"
+
+UdpPortPool::UdpPortPool(uint16_t first, uint16_t last)
+:_first(static_cast<uint16_t>((first + 1) & ~1))
+,_pairs(last > _first ? (last - _first + 1) / 2 : 0)
+,_wordCount((_pairs + 63) / 64)
+,_words(new std::atomic<uint64_t>[_wordCount])
+,_cursor(0)
+,_inUse(0){
+    for (size_t i = 0; i < _wordCount; ++i) {
+        _words[i].store(0, std::memory_order_relaxed);
+    }
+    if (_pairs % 64) {
+        // 最后一个字里超出范围的位当作已分配
+        _words[_wordCount - 1].store(~0ULL << (_pairs % 64), std::memory_order_relaxed);
+    }
+}
+
+uint16_t UdpPortPool::allocate() {
+    if (_wordCount == 0) {
+        return 0;
+    }
+    size_t start = _cursor.load(std::memory_order_relaxed) % _pairs;
+    // 从游标所在的字开始绕一圈，最后回到这个字时再看游标之前的位
+    for (size_t scanned = 0; scanned <= _wordCount; ++scanned) {
+        size_t w = (start / 64 + scanned) % _wordCount;
+        uint64_t mask = scanned == 0 ? ~0ULL << (start % 64) : ~0ULL;
+        uint64_t bits = _words[w].load(std::memory_order_relaxed);
+        uint64_t free;
+        while ((free = ~bits & mask) != 0) {
+            int bit = __builtin_ctzll(free);
+            if (_words[w].compare_exchange_weak(bits, bits | (1ULL << bit),
+                                                std::memory_order_acq_rel, std::memory_order_relaxed)) {
+                size_t index = w * 64 + bit;
+                _cursor.store(index + 1, std::memory_order_relaxed);
+                _inUse.fetch_add(1, std::memory_order_relaxed);
+                return static_cast<uint16_t>(_first + index * 2);
+            }
+        }
+    }
+    return 0;
+}
+
+void UdpPortPool::release(uint16_t port) {
+    if (port < _first || (port - _first) % 2) {
+        return;
+    }
+    size_t index = (port - _first) / 2;
+    if (index >= _pairs) {
+        return;
+    }
+    uint64_t bit = 1ULL << (index % 64);
+    if (_words[index / 64].fetch_and(~bit, std::memory_order_acq_rel) & bit) {
+        _inUse.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef __UDPPORTPOOL_H__
+#define __UDPPORTPOOL_H__
+
+#include <atomic>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+// 服务器 RTP/RTCP 端口对的分配：[first, last] 内的偶数端口各占位图的一位，会话结束时释放重用。
+// 位图按 64 位字做 CAS，各个 loop 线程同时分配/释放不用加锁。
+// 分配从轮转游标往后找空位，刚释放的端口要等游标绕一圈才会再分出去，
+// 旧会话迟到的包不会马上打到新会话上
+class UdpPortPool {
+public:
+    UdpPortPool(uint16_t first = 10000, uint16_t last = 65535);
+
+    // 返回一对端口里的偶数端口（RTP），+1 是 RTCP；端口用完时返回 0
+    uint16_t allocate();
+    // 只接受 allocate 分出去的端口，重复释放忽略
+    void release(uint16_t port);
+
+    size_t inUse() const { return _inUse.load(std::memory_order_relaxed); }
+    size_t capacity() const { return _pairs; }
+
+private:
+    uint16_t _first;
+    size_t _pairs;
+    size_t _wordCount;
+    std::unique_ptr<std::atomic<uint64_t>[]> _words;  // 1 表示已分配
+    std::atomic<size_t> _cursor;                      // 下一次开始找的位
+    std::atomic<size_t> _inUse;
+};
+
+#endif
@@ -0,0 +1,237 @@
+#include "AsyncFileWriter.h"
+#include "Logger.h"
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+struct AsyncFile::Block {
+    char *data;
+    size_t len;
+};
+
+struct AsyncFile::State {
+    std::string path;
+    int fd = -1;
+    bool failed = false;
+    bool direct = false;
+};
+
+AsyncFile::AsyncFile(AsyncFileWriter *writer, const std::string &path)
+:_writer(writer)
+,_path(path)
+,_state(std::make_shared<State>())
+,_block(nullptr)
+,_bytes(0)
+,_dropped(0)
+,_closed(false){
+    _state->path = path;
+}
+
+AsyncFile::~AsyncFile() {
+    close();
+}
+
+bool AsyncFile::append(const char *data, size_t len) {
+    struct iovec iov = {const_cast<char *>(data), len};
+    return append(&iov, 1);
+}
+
+bool AsyncFile::append(const struct iovec *iov, int count) {
+    if (_closed) return false;
+    const size_t kBlockSize = AsyncFileWriter::kBlockSize;
+    size_t len = 0;
+    for (int i = 0; i < count; ++i) len += iov[i].iov_len;
+    size_t room = _block ? kBlockSize - _block->len : 0;
+    std::vector<Block *> blocks;
+    if (len > room) {
+        size_t need = (len - room + kBlockSize - 1) / kBlockSize;
+        if (!_writer->takeBlocks(need, blocks)) {
+            _dropped += len;
+            return false;
+        }
+    }
+    size_t next = 0;
+    for (int i = 0; i < count; ++i) {
+        const char *data = static_cast<const char *>(iov[i].iov_base);
+        size_t left = iov[i].iov_len;
+        while (left > 0) {
+            if (!_block || _block->len == kBlockSize) {
+                if (_block) {
+                    _writer->submit({_state, _block, false});//写满一块交给 I/O 线程
+                }
+                _block = blocks[next++];
+            }
+            size_t n = std::min(left, kBlockSize - _block->len);
+            memcpy(_block->data + _block->len, data, n);
+            _block->len += n;
+            data += n;
+            left -= n;
+        }
+    }
+    _bytes += len;
+    return true;
+}
+
+void AsyncFile::close() {
+    if (_closed) return;
+    _closed = true;
+    Block *last = _block;
+    _block = nullptr;
+    if (last && last->len == 0) {
+        _writer->giveBack(last);
+        last = nullptr;
+    }
+    _writer->submit({_state, last, true});
+}
+
+AsyncFileWriter::AsyncFileWriter(size_t maxBlocks, bool directIo)
+:_maxBlocks(maxBlocks)
+,_directIo(directIo)
+,_allocated(0)
+,_busy(false)
+,_quit(false)
+,_thread(&AsyncFileWriter::run, this){
+}
+
+AsyncFileWriter::~AsyncFileWriter() {
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _quit = true;
+    }
+    _cond.notify_one();
+    _thread.join();
+    for (Block *b : _free) {
+        free(b->data);
+        delete b;
+    }
+}
+
+AsyncFileWriter &AsyncFileWriter::instance() {
+    static AsyncFileWriter writer;
+    return writer;
+}
+
+AsyncFilePtr AsyncFileWriter::open(const std::string &path) {
+    return AsyncFilePtr(new AsyncFile(this, path));
+}
+
+size_t AsyncFileWriter::freeBlocks() {
+    std::lock_guard<std::mutex> lock(_poolMtx);
+    return _free.size() + (_maxBlocks - _allocated);
+}
+
+bool AsyncFileWriter::takeBlocks(size_t n, std::vector<Block *> &out) {
+    std::lock_guard<std::mutex> lock(_poolMtx);
+    if (_free.size() + (_maxBlocks - _allocated) < n) {
+        return false;
+    }
+    while (n > 0 && !_free.empty()) {
+        out.push_back(_free.back());
+        _free.pop_back();
+        --n;
+    }
+    for (; n > 0; --n) {
+        void *mem = nullptr;
+        if (posix_memalign(&mem, kAlign, kBlockSize) != 0) {
+            for (Block *b : out) _free.push_back(b);
+            out.clear();
+            return false;
+        }
+        out.push_back(new Block{static_cast<char *>(mem), 0});
+        ++_allocated;
+    }
+    for (Block *b : out) b->len = 0;
+    return true;
+}
+
+void AsyncFileWriter::giveBack(Block *block) {
+    std::lock_guard<std::mutex> lock(_poolMtx);
+    _free.push_back(block);
+}
+
+void AsyncFileWriter::submit(Job &&job) {
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _jobs.push_back(std::move(job));
+    }
+    _cond.notify_one();
+}
+
+void AsyncFileWriter::run() {
+    std::deque<Job> jobs;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(_mtx);
+            _cond.wait(lock, [this] { return _quit || !_jobs.empty(); });
+            if (_jobs.empty()) break;//_quit 且已写完
+            jobs.swap(_jobs);
+            _busy = true;
+        }
+        for (Job &job : jobs) {
+            if (job.block) {
+                writeBlock(*job.file, job.block);
+                giveBack(job.block);
+            }
+            if (job.close && job.file->fd >= 0) {
+                ::close(job.file->fd);
+                job.file->fd = -1;
+            }
+        }
+        jobs.clear();
+        std::lock_guard<std::mutex> lock(_mtx);
+        _busy = false;
+        if (_jobs.empty()) _idle.notify_all();
+    }
+}
+
+void AsyncFileWriter::flush() {
+    std::unique_lock<std::mutex> lock(_mtx);
+    _idle.wait(lock, [this] { return _jobs.empty() && !_busy; });
+}
+
+void AsyncFileWriter::writeBlock(State &file, Block *block) {
+    if (file.failed) return;
+    if (file.fd < 0) {
+        int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+        if (_directIo) {
+            file.fd = ::open(file.path.c_str(), flags | O_DIRECT, 0644);
+            file.direct = file.fd >= 0;
+        }
+        if (file.fd < 0) {
+            file.fd = ::open(file.path.c_str(), flags, 0644);//文件系统不支持 O_DIRECT
+        }
+        if (file.fd < 0) {
+            LOG_ERROR("AsyncFileWriter open %s failed: %s", file.path.c_str(), strerror(errno));
+            file.failed = true;
+            ++_stats.writeErrors;
+            return;
+        }
+    }
+    if (file.direct && block->len % kAlign != 0) {
+        // 最后不满一页的块，O_DIRECT 写不了，改回普通写
+        fcntl(file.fd, F_SETFL, fcntl(file.fd, F_GETFL) & ~O_DIRECT);
+        file.direct = false;
+    }
+    size_t done = 0;
+    while (done < block->len) {
+        ssize_t n = ::write(file.fd, block->data + done, block->len - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && errno == EINVAL && file.direct) {
+            fcntl(file.fd, F_SETFL, fcntl(file.fd, F_GETFL) & ~O_DIRECT);
+            file.direct = false;
+            continue;
+        }
+        if (n <= 0) {
+            LOG_ERROR("AsyncFileWriter write %s failed: %s", file.path.c_str(), strerror(errno));
+            file.failed = true;
+            ++_stats.writeErrors;
+            return;
+        }
+        done += n;
+    }
+    ++_stats.blocksWritten;
+    _stats.bytesWritten += done;
+}
@@ -0,0 +1,115 @@
+#ifndef __ASYNCFILEWRITER_H__
+#define __ASYNCFILEWRITER_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+#include <sys/uio.h>
+
+class AsyncFileWriter;
+
+// 一个顺序写入的文件，只能由一个线程（通常是某个 EventLoop）调用。
+// 数据先拷进按页对齐的大块缓冲，写满一块才交给 I/O 线程，文件的打开/写/关闭都在 I/O 线程里做
+class AsyncFile {
+public:
+    ~AsyncFile();
+
+    // 整段写入或整段丢弃：缓冲池不够时返回 false，不会只写进一半
+    bool append(const char *data, size_t len);
+    // 多段一起写入或一起丢弃，用于头部和负载分开存放的记录
+    bool append(const struct iovec *iov, int count);
+    // 交出最后不满的一块并关闭文件，之后不能再 append
+    void close();
+
+    uint64_t bytes() const { return _bytes; }       // 已接收（不含丢弃）的字节数
+    uint64_t dropped() const { return _dropped; }   // 因缓冲池耗尽丢弃的字节数
+    const std::string &path() const { return _path; }
+
+private:
+    friend class AsyncFileWriter;
+    struct State;
+    struct Block;
+
+    AsyncFile(AsyncFileWriter *writer, const std::string &path);
+
+    AsyncFileWriter *_writer;
+    std::string _path;
+    std::shared_ptr<State> _state;    // fd 等，只在 I/O 线程里访问
+    Block *_block;                    // 正在填的块
+    uint64_t _bytes;
+    uint64_t _dropped;
+    bool _closed;
+};
+
+using AsyncFilePtr = std::unique_ptr<AsyncFile>;
+
+// 磁盘写线程：所有 AsyncFile 共用一个 I/O 线程和一个固定大小的块池。
+// 块按 kAlign 对齐，能用 O_DIRECT 时绕过页缓存直接写，整块写出；
+// 磁盘卡住时块池会耗尽，此时丢弃新数据并计数，调用方的 loop 永远不会等磁盘
+class AsyncFileWriter {
+public:
+    static const size_t kBlockSize = 256 * 1024;
+    static const size_t kAlign = 4096;
+
+    struct Stats {
+        std::atomic<uint64_t> blocksWritten{0};
+        std::atomic<uint64_t> bytesWritten{0};
+        std::atomic<uint64_t> writeErrors{0};
+    };
+
+    explicit AsyncFileWriter(size_t maxBlocks = 256, bool directIo = true);
+    ~AsyncFileWriter();   // 把队列里的数据写完再退出
+
+    // 进程内共用的写线程，第一次调用时启动
+    static AsyncFileWriter &instance();
+
+    // 不阻塞：文件在 I/O 线程里打开，失败时后续写入被丢弃并记日志
+    AsyncFilePtr open(const std::string &path);
+
+    // 阻塞到已提交的数据都写完（退出前、压测用），不要在 loop 线程里调用
+    void flush();
+
+    size_t freeBlocks();
+    const Stats &stats() const { return _stats; }
+
+private:
+    friend class AsyncFile;
+    using Block = AsyncFile::Block;
+    using State = AsyncFile::State;
+
+    struct Job {
+        std::shared_ptr<State> file;
+        Block *block;     // 可以为空（只关闭）
+        bool close;
+    };
+
+    // 一次取 n 块，不够时一块也不取
+    bool takeBlocks(size_t n, std::vector<Block *> &out);
+    void giveBack(Block *block);
+    void submit(Job &&job);
+    void run();
+    void writeBlock(State &file, Block *block);
+
+    const size_t _maxBlocks;
+    const bool _directIo;
+    std::mutex _poolMtx;
+    std::vector<Block *> _free;
+    size_t _allocated;
+
+    std::mutex _mtx;
+    std::condition_variable _cond;
+    std::condition_variable _idle;
+    std::deque<Job> _jobs;
+    bool _busy;             // I/O 线程手里还有没写完的任务
+    bool _quit;
+    Stats _stats;
+    std::thread _thread;    // 最后构造，启动时其余成员都已就绪
+};
+
+#endif
@@ -0,0 +1,67 @@
+#include "BufferChain.h"
+#include <sys/uio.h>
+#include <errno.h>
+
+static const int kMaxIov = 64;//单次writev最多携带的片段数
+
+BufferChain::BufferChain()
+:_bytes(0){
+}
+
+BufferChain::~BufferChain(){
+}
+
+void BufferChain::append(const BufferPtr &buf, size_t offset, size_t len){
+    if (!buf || len == 0) return;
+    _slices.push_back(BufferSlice{buf, offset, len});
+    _bytes += len;
+}
+
+void BufferChain::append(std::string &&data){
+    size_t len = data.size();
+    if (len == 0) return;
+    append(std::make_shared<const std::string>(std::move(data)), 0, len);
+}
+
+ssize_t BufferChain::flush(int fd){
+    ssize_t total = 0;
+    while (!_slices.empty()) {
+        struct iovec iov[kMaxIov];
+        int cnt = 0;
+        size_t want = 0;
+        for (auto it = _slices.begin(); it != _slices.end() && cnt < kMaxIov; ++it, ++cnt) {
+            iov[cnt].iov_base = const_cast<char *>(it->data());
+            iov[cnt].iov_len = it->len;
+            want += it->len;
+        }
+        ssize_t n = ::writev(fd, iov, cnt);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return -1;
+        }
+        consume(n);
+        total += n;
+        if ((size_t)n < want) break;//内核发送缓冲区已满
+    }
+    return total;
+}
+
+void BufferChain::consume(size_t n){
+    _bytes -= n;
+    while (n > 0) {
+        BufferSlice &front = _slices.front();
+        if (n < front.len) {
+            front.offset += n;
+            front.len -= n;
+            return;
+        }
+        n -= front.len;
+        _slices.pop_front();
+    }
+}
+
+void BufferChain::clear(){
+    _slices.clear();
+    _bytes = 0;
+}
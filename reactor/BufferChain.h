@@ -0,0 +1,42 @@
+#ifndef __BUFFERCHAIN_H__
+#define __BUFFERCHAIN_H__
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <sys/types.h>
+
+// 引用计数的只读数据块，同一份帧数据可以同时挂到多个连接的发送链上
+using BufferPtr = std::shared_ptr<const std::string>;
+
+// 发送链中的一个片段：引用数据块中的 [offset, offset+len)
+struct BufferSlice {
+    BufferPtr buf;
+    size_t offset;
+    size_t len;
+    const char *data() const { return buf->data() + offset; }
+};
+
+// 待发送数据链，用 writev 一次写出多个片段，写了多少就从链头消费多少，不搬移数据
+class BufferChain {
+public:
+    BufferChain();
+    ~BufferChain();
+
+    void append(const BufferPtr &buf, size_t offset, size_t len);
+    void append(std::string &&data);//接管一份私有数据
+    bool empty() const { return _slices.empty(); }
+    size_t bytes() const { return _bytes; }//尚未写出的字节数
+
+    // 向 fd 写出尽量多的数据，返回写出字节数；EAGAIN 返回 0，出错返回 -1
+    ssize_t flush(int fd);
+    void clear();
+
+private:
+    void consume(size_t n);
+
+    std::deque<BufferSlice> _slices;
+    size_t _bytes;
+};
+
+#endif
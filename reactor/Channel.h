@@ -0,0 +1,35 @@
+#ifndef __CHANNEL_H__
+#define __CHANNEL_H__
+
+#include <memory>
+#include <stdint.h>
+
+class TcpConnection;
+class UdpConnection;
+
+// fd 的种类，epoll 就绪后按种类直接分发
+enum class ChannelType : uint8_t {
+    None,       // 空槽位
+    Acceptor,   // 监听 fd
+    Listener,   // addAcceptor 加入的额外监听 fd（如监控端口）
+    Eventor,    // 跨线程唤醒 eventfd
+    Timer,      // timerfd
+    Tcp,        // TcpConnection
+    Udp         // UdpConnection
+};
+
+// EventLoop 中一个 fd 的登记项。EventLoop 以 fd 为下标把 Channel 存在稠密数组里，
+// 分发时 _channels[fd] 一次取到处理对象，不再依次比较特殊 fd 再查 map
+struct Channel {
+    ChannelType type = ChannelType::None;
+    std::shared_ptr<TcpConnection> tcpConn;
+    std::shared_ptr<UdpConnection> udpConn;
+
+    void reset() {
+        type = ChannelType::None;
+        tcpConn.reset();
+        udpConn.reset();
+    }
+};
+
+#endif
@@ -8,6 +8,7 @@
 #include "UdpConnection.h"
 #include <memory>
 #include <cassert>
+#include <algorithm>
 #include <string.h>
 #include "Logger.h"
 
@@ -21,8 +22,9 @@ EventLoop::EventLoop(Acceptor &acceptor, bool isMainLoop)
 ,_evtList(1024)
 ,_isLooping(false)
 ,_acceptor(acceptor)
-,_tcpConns()
-,_udpConns()
+,_channels(1024)
+,_tcpConnNum(0)
+,_udpConnNum(0)
 ,_eventor()//创建用于通信的文件描述符
 ,_isMainLoop(isMainLoop)
 ,_threadId()
@@ -31,10 +33,13 @@ EventLoop::EventLoop(Acceptor &acceptor, bool isMainLoop)
     // addEpollReadFd(_timeMgr.getTimerFd());
     if (isMainLoop) {
         int listenfd = acceptor.fd();
+        channelOf(listenfd).type = ChannelType::Acceptor;
         addEpollReadFd(listenfd);
         LOG_INFO("Main EventLoop created, listening on fd: %d", listenfd);
     }
     else{
+        channelOf(_eventor.getEvtfd()).type = ChannelType::Eventor;
+        channelOf(_timeMgr.getTimerFd()).type = ChannelType::Timer;
         addEpollReadFd(_eventor.getEvtfd());
         addEpollReadFd(_timeMgr.getTimerFd());
         LOG_INFO("Sub EventLoop created");
@@ -79,40 +84,55 @@ void EventLoop::addTcpConnection(const TcpConnectionPtr& conn) {
     assertInLoopThread();
     int fd = conn->getFd();
 
-    _tcpConns[fd] = conn;
+    Channel &ch = channelOf(fd);
+    ch.type = ChannelType::Tcp;
+    ch.tcpConn = conn;
+    ++_tcpConnNum;
     addEpollReadFd(fd);
-    LOG_DEBUG("Added connection fd: %d, total tcpconnections: %zu", fd, _tcpConns.size());
+    LOG_DEBUG("Added connection fd: %d, total tcpconnections: %zu", fd, _tcpConnNum);
 }
 
 void EventLoop::addUdpConnection(const UdpConnectionPtr& conn) {
     assertInLoopThread();
     int fd = conn->getUdpFd();
+    Channel &ch = channelOf(fd);
     // 检查是否已存在
-    if (_udpConns.find(fd) != _udpConns.end()) {
+    if (ch.type == ChannelType::Udp) {
         LOG_WARN("UDP connection fd %d already exists!", fd);
         delEpollReadFd(fd);
-        _udpConns.erase(fd);
+        ch.reset();
+        --_udpConnNum;
         // return; // 或者先移除旧的
     }
-    _udpConns[fd] = conn;
+    ch.type = ChannelType::Udp;
+    ch.udpConn = conn;
+    ++_udpConnNum;
     addEpollReadFd(fd);
-    LOG_DEBUG("Added connection fd: %d,port:%d, total udpconnections: %zu", fd, conn->getLocalAddr().port(), _udpConns.size());
+    LOG_DEBUG("Added connection fd: %d,port:%d, total udpconnections: %zu", fd, conn->getLocalAddr().port(), _udpConnNum);
 }
 
 void EventLoop::removeTcpConnection(const TcpConnectionPtr& conn) {
     assertInLoopThread();
     int fd = conn->getFd();
-    _tcpConns.erase(fd);
+    Channel &ch = channelOf(fd);
+    if (ch.type == ChannelType::Tcp && ch.tcpConn == conn) {
+        ch.reset();
+        --_tcpConnNum;
+    }
     delEpollReadFd(fd);
-    LOG_DEBUG("Removed TcpConnection fd: %d, remaining tcpconnections: %zu", fd, _tcpConns.size());
+    LOG_DEBUG("Removed TcpConnection fd: %d, remaining tcpconnections: %zu", fd, _tcpConnNum);
 }
 
 void EventLoop::removeUdpConnection(const UdpConnectionPtr& conn) {
     assertInLoopThread();
     int fd = conn->getUdpFd();
-    _udpConns.erase(fd);
+    Channel &ch = channelOf(fd);
+    if (ch.type == ChannelType::Udp && ch.udpConn == conn) {
+        ch.reset();
+        --_udpConnNum;
+    }
     delEpollReadFd(fd);
-    LOG_DEBUG("Removed UdpConnection fd: %d, remaining udpconnections: %zu", fd, _udpConns.size());
+    LOG_DEBUG("Removed UdpConnection fd: %d, remaining udpconnections: %zu", fd, _udpConnNum);
 }
 
 void EventLoop::waitEpollFd(){
@@ -137,33 +157,46 @@ void EventLoop::waitEpollFd(){
         for(int idx = 0;idx < nready; ++idx){
             int fd = _evtList[idx].data.fd;
             uint32_t events = _evtList[idx].events;
-            if(fd == _acceptor.fd()){//处理当有客户端连接时
+            //按fd直接取登记项分发；回调里可能增删连接导致_channels扩容，不持有引用
+            ChannelType type = fd < (int)_channels.size() ? _channels[fd].type : ChannelType::None;
+            switch(type){
+            case ChannelType::Acceptor://处理当有客户端连接时
                 if(events & EPOLLIN){
                     LOG_DEBUG("New connection event on acceptor fd: %d", fd);
                     handleNewConnection();
                 }
-            }else if(fd == _eventor.getEvtfd()){//处理触发事件响应
+                break;
+            case ChannelType::Listener://额外监听端口上的新连接
+                if(events & EPOLLIN){
+                    handleListener(fd);
+                }
+                break;
+            case ChannelType::Eventor://处理触发事件响应
                 if(events & EPOLLIN){
                     LOG_DEBUG("Eventor event on fd: %d", fd);
                     _eventor.handleRead();
                 }
-            }else if(fd == _timeMgr.getTimerFd()){//处理时间响应任务
+                break;
+            case ChannelType::Timer://处理时间响应任务
                 if(events & EPOLLIN){
                     // LOG_DEBUG("Timer event on fd: %d", fd);
                     _timeMgr.handleRead();
                 }
-            }else{
+                break;
+            case ChannelType::Tcp:
+            case ChannelType::Udp:
                 if(events & EPOLLIN){
                     // LOG_DEBUG("Read event on fd: %d", fd);
                     handleMessage(fd);
                 }
-                if(events & EPOLLOUT){
+                if((events & EPOLLOUT) && _channels[fd].type == ChannelType::Tcp){
                     // LOG_DEBUG("Write event on fd: %d", fd);
-                    auto itTcp = _tcpConns.find(fd);
-                    if(itTcp != _tcpConns.end()){
-                        itTcp->second->handleWriteCallback();
-                    }
+                    _channels[fd].tcpConn->handleWriteCallback();
                 }
+                break;
+            default:
+                LOG_ERROR("Channel not found for fd: %d", fd);
+                break;
             }
         }
     }
@@ -177,26 +210,45 @@ void EventLoop::handleNewConnection(){
     LOG_INFO("New connection accepted, fd: %d", connfd);
     _onNewConnectionCb(connfd);
 }
+void EventLoop::handleListener(int fd){
+    auto it = _listeners.find(fd);
+    if(it == _listeners.end()){
+        return;
+    }
+    int connfd = it->second.first->accept();
+    if(connfd < 0){
+        LOG_ERROR("handleListener accept failed: %s", strerror(errno));
+        return;
+    }
+    LOG_INFO("New connection accepted on listen fd %d, fd: %d", fd, connfd);
+    it->second.second(connfd);
+}
 void EventLoop::handleMessage(int fd){
-    auto itTcp = _tcpConns.find(fd);
-    auto itUdp = _udpConns.find(fd);
-    if(itTcp != _tcpConns.end()){
-        if(itTcp->second->isClosed()){
+    Channel &ch = _channels[fd];
+    if(ch.type == ChannelType::Tcp){
+        if(ch.tcpConn->isClosed()){
             LOG_DEBUG("Connection fd: %d is closed, handling close callback", fd);
-            itTcp->second->handleCloseCallback();
-            removeTcpConnection(itTcp->second);
+            TcpConnectionPtr conn = ch.tcpConn;//关闭回调期间保持连接存活
+            conn->handleCloseCallback();
+            removeTcpConnection(conn);
         }else{
             // LOG_DEBUG("HandleMessage TCP Message fd: %d", fd);
-            itTcp->second->handleMessageCallback();
+            ch.tcpConn->handleMessageCallback();
         }
-    }else if(itUdp != _udpConns.end()){
+    }else if(ch.type == ChannelType::Udp){
         // LOG_DEBUG("HandleMessage UDP Message fd: %d", fd);
-        itUdp->second->handleMessageCallback();//处理udp消息
+        ch.udpConn->handleMessageCallback();//处理udp消息
     }else{
         LOG_ERROR("Connection not found for fd: %d", fd);
         return;
     }
 }
+Channel &EventLoop::channelOf(int fd){
+    if(fd >= (int)_channels.size()){
+        _channels.resize(std::max<size_t>(fd + 1, _channels.size() * 2));
+    }
+    return _channels[fd];
+}
 int EventLoop::createEpollFd(){
     int fd = ::epoll_create1(0);
     if(fd < 0){
@@ -267,6 +319,22 @@ void EventLoop::setCloseCallback(TcpConnectionCallback &&cb){
     LOG_DEBUG("Close callback set");
 }
 
+void EventLoop::enableAccept(){
+    int listenfd = _acceptor.fd();
+    channelOf(listenfd).type = ChannelType::Acceptor;
+    addEpollReadFd(listenfd);
+    LOG_INFO("EventLoop accepting on its own listen fd: %d", listenfd);
+}
+
+void EventLoop::addAcceptor(Acceptor &acceptor, std::function<void(int)> &&cb){
+    assertInLoopThread();
+    int listenfd = acceptor.fd();
+    channelOf(listenfd).type = ChannelType::Listener;
+    _listeners[listenfd] = std::make_pair(&acceptor, std::move(cb));
+    addEpollReadFd(listenfd);
+    LOG_INFO("EventLoop accepting on extra listen fd: %d", listenfd);
+}
+
 void EventLoop::runInLoop(Functor &&cb){
     if (isInLoopThread()) {
         // LOG_DEBUG("Running function in current loop thread");
@@ -277,14 +345,14 @@ void EventLoop::runInLoop(Functor &&cb){
     }
 }
 
-TimerId EventLoop::addOneTimer(int delaySec, TimerCallback &&cb){
-    LOG_DEBUG("Adding one-shot timer with delay: %d seconds", delaySec);
-    return _timeMgr.addTimer(delaySec,std::move(cb));
+TimerId EventLoop::addOneTimer(int delayMs, TimerCallback &&cb){
+    LOG_DEBUG("Adding one-shot timer with delay: %d ms", delayMs);
+    return _timeMgr.addTimer(delayMs,std::move(cb));
 }
 
-TimerId EventLoop::addPeriodicTimer(int delaySec, int intervalSec, TimerCallback &&cb){
-    LOG_DEBUG("Adding periodic timer with delay: %d seconds, interval: %d seconds", delaySec, intervalSec);
-    return _timeMgr.addPeriodicTimer(delaySec, intervalSec, std::move(cb));
+TimerId EventLoop::addPeriodicTimer(int delayMs, int intervalMs, TimerCallback &&cb){
+    LOG_DEBUG("Adding periodic timer with delay: %d ms, interval: %d ms", delayMs, intervalMs);
+    return _timeMgr.addPeriodicTimer(delayMs, intervalMs, std::move(cb));
 }
 
 void EventLoop::removeTimer(TimerId timerId){
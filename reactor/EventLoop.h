@@ -8,6 +8,7 @@
 #include <mutex>
 #include <thread>
 #include "Eventor.h"
+#include "Channel.h"
 #include "Logger.h"
 #include "TimerManager.h"
 
@@ -38,10 +39,15 @@ public:
     void setNewConnectionCallback(std::function<void(int)> &&cb);
     void setMessageCallback(TcpConnectionCallback &&cb);
     void setCloseCallback(TcpConnectionCallback &&cb);
-    TimerId addOneTimer(int delaySec, TimerCallback &&cb);
-    TimerId addPeriodicTimer(int delaySec, int intervalSec, TimerCallback &&cb);
+    // 定时器时间单位均为毫秒
+    TimerId addOneTimer(int delayMs, TimerCallback &&cb);
+    TimerId addPeriodicTimer(int delayMs, int intervalMs, TimerCallback &&cb);
     void removeTimer(TimerId timerId);
     void runInLoop(Functor &&cb);
+    EventorStats eventorStats() const { return _eventor.stats(); }
+    void enableAccept();//子loop自己监听acceptor（SO_REUSEPORT模式），需在loop线程或loop启动前调用
+    // 再监听一个端口，新连接在本loop线程里交给 cb；需在loop线程里调用
+    void addAcceptor(Acceptor &acceptor, std::function<void(int)> &&cb);
     
     
     bool isInLoopThread() const { return _threadId == std::this_thread::get_id(); }
@@ -60,17 +66,21 @@ public:
 private:
     void waitEpollFd();
     void handleNewConnection();
+    void handleListener(int fd);
     void handleMessage(int fd);
     int createEpollFd();
+    Channel &channelOf(int fd);//按fd取登记项，必要时扩容
 
 private:
     int _epfd;
     vector<struct epoll_event> _evtList;
     bool _isLooping;
     Acceptor &_acceptor;
-    map<int,TcpConnectionPtr> _tcpConns;
-    map<int,UdpConnectionPtr> _udpConns;
+    vector<Channel> _channels;//以fd为下标的登记表
+    size_t _tcpConnNum;
+    size_t _udpConnNum;
     std::function<void(int)> _onNewConnectionCb;
+    map<int, std::pair<Acceptor *, std::function<void(int)>>> _listeners;//addAcceptor 加入的监听fd
     TcpConnectionCallback _onMessageCb;
     TcpConnectionCallback _onCloseCb;
 
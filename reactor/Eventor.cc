@@ -2,13 +2,27 @@
 #include <string.h>
 
 Eventor::Eventor()
-:_evtfd(createEventFd()){
+:_evtfd(createEventFd())
+,_tail(&_stub)
+,_head(&_stub)
+,_wakeupPending(false)
+,_enqueued(0)
+,_wakeups(0)
+,_drains(0)
+,_drained(0)
+,_maxBatch(0){
     LOG_DEBUG("Eventor created with fd: %d", _evtfd);
 }
 
 Eventor::~Eventor(){
     LOG_DEBUG("Eventor destructor, closing fd: %d", _evtfd);
     close(_evtfd);
+    Node *node = _head;
+    while(node){//释放未执行的任务
+        Node *next = node->next.load(std::memory_order_relaxed);
+        if(node != &_stub) delete node;
+        node = next;
+    }
 }
 
 void Eventor::wakeUp(){
@@ -18,7 +32,7 @@ void Eventor::wakeUp(){
         LOG_ERROR("Eventor wakeUp write failed: %s", strerror(errno));
         return;
     }
-    LOG_DEBUG("Eventor wakeUp successful");
+    _wakeups.fetch_add(1, std::memory_order_relaxed);
 }
 
 int Eventor::getEvtfd(){
@@ -32,27 +46,51 @@ void Eventor::handleRead(){
         LOG_ERROR("Eventor handleRead failed: %s", strerror(errno));
         return;
     }
-    LOG_DEBUG("Eventor handleRead successful, processing %zu pending functions", _pendings.size());
     doPenddingFunctors();
 }
 
 void Eventor::addEventcb(Functor &&cb){
-    std::unique_lock<std::mutex> autoLock(_mutex);
-    _pendings.push_back(std::move(cb));
-    LOG_DEBUG("Added event callback, total pending: %zu", _pendings.size());
-    wakeUp();
+    Node *node = new Node;
+    node->cb = std::move(cb);
+    //先挂到队尾，再把前驱的next指向自己；两步之间消费者会把队列看成到前驱为止
+    Node *prev = _tail.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+    _enqueued.fetch_add(1, std::memory_order_relaxed);
+    //已有未处理的唤醒就不再写eventfd
+    if(!_wakeupPending.exchange(true, std::memory_order_acq_rel)){
+        wakeUp();
+    }
 }
 
 void Eventor::doPenddingFunctors(){
-    std::vector<Functor> tmp;
-    std::unique_lock<std::mutex> autoLock(_mutex);
-    tmp.swap(_pendings);
-    autoLock.unlock();//手动提前解锁
-    LOG_DEBUG("Executing %zu pending functions", tmp.size());
-    for(auto &cb:tmp){
+    //先清唤醒标记再取队列：之后入队的生产者会重新写eventfd，不会漏任务
+    _wakeupPending.exchange(false, std::memory_order_acq_rel);
+    uint64_t batch = 0;
+    while(true){
+        Node *next = _head->next.load(std::memory_order_acquire);
+        if(!next) break;
+        Functor cb = std::move(next->cb);
+        if(_head != &_stub) delete _head;
+        _head = next;//next成为新的哨兵
+        ++batch;
         cb();
     }
-    LOG_DEBUG("All pending functions executed");
+    if(batch == 0) return;
+    _drains.fetch_add(1, std::memory_order_relaxed);
+    _drained.fetch_add(batch, std::memory_order_relaxed);
+    if(batch > _maxBatch.load(std::memory_order_relaxed)){
+        _maxBatch.store(batch, std::memory_order_relaxed);
+    }
+}
+
+EventorStats Eventor::stats() const{
+    EventorStats st;
+    st.enqueued = _enqueued.load(std::memory_order_relaxed);
+    st.wakeups = _wakeups.load(std::memory_order_relaxed);
+    st.drains = _drains.load(std::memory_order_relaxed);
+    st.drained = _drained.load(std::memory_order_relaxed);
+    st.maxBatch = _maxBatch.load(std::memory_order_relaxed);
+    return st;
 }
 
 int Eventor::createEventFd(){
@@ -61,4 +99,4 @@ int Eventor::createEventFd(){
         LOG_ERROR("Eventor createEventFd failed: %s", strerror(errno));
     }
     return fd;
-}
\ No newline at end of file
+}
@@ -1,14 +1,26 @@
 #ifndef __EVENTFD_H__
 #define __EVENTFD_H__
 #include <functional>
-#include <mutex>
+#include <atomic>
 #include <sys/eventfd.h>
 #include <unistd.h>
-#include <vector>
+#include <stdint.h>
 #include "Logger.h"
 
 
 using Functor = std::function<void()>;
+
+// 跨线程投递的统计计数
+struct EventorStats {
+    uint64_t enqueued;  // 投递的任务总数
+    uint64_t wakeups;   // 实际写 eventfd 的次数
+    uint64_t drains;    // 批量执行的次数
+    uint64_t drained;   // 批量执行的任务总数
+    uint64_t maxBatch;  // 单次批量执行的最大任务数
+};
+
+// 多生产者单消费者任务队列：任意线程 addEventcb，loop 线程 handleRead 批量执行。
+// 入队无锁（Vyukov 侵入式 MPSC 链表），并合并唤醒：只有队列被取空后的第一次入队才写 eventfd
 class Eventor{
 public:
     Eventor();
@@ -16,13 +28,25 @@ public:
     int getEvtfd();
     void handleRead();
     void addEventcb(Functor &&cb);
+    EventorStats stats() const;
 private:
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        Functor cb;
+    };
     void doPenddingFunctors();//执行函数
     int createEventFd();
     void wakeUp();//唤醒操作
     int _evtfd;//用于通信的文件描述符
-    std::vector<Functor> _pendings;//待执行的任务
-    std::mutex _mutex;//互斥锁访问_pendings队列
+    Node _stub;//哨兵节点
+    std::atomic<Node*> _tail;//生产者端
+    Node *_head;//消费者端，只在loop线程访问
+    std::atomic<bool> _wakeupPending;//已写eventfd且尚未取队列
+    std::atomic<uint64_t> _enqueued;
+    std::atomic<uint64_t> _wakeups;
+    std::atomic<uint64_t> _drains;
+    std::atomic<uint64_t> _drained;
+    std::atomic<uint64_t> _maxBatch;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,69 @@
+#include "InputBuffer.h"
+#include <sys/uio.h>
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+
+InputBuffer::InputBuffer(size_t initSize)
+:_buf(initSize)
+,_readIdx(0)
+,_writeIdx(0){
+}
+
+InputBuffer::~InputBuffer(){
+}
+
+ssize_t InputBuffer::readFd(int fd, int *savedErrno){
+    if (_readIdx == _writeIdx) {
+        _readIdx = _writeIdx = 0;//上一批全部处理完，回到开头，不需要搬移
+    }
+    char extra[65536];
+    size_t writable = _buf.size() - _writeIdx;
+    struct iovec vec[2];
+    vec[0].iov_base = _buf.data() + _writeIdx;
+    vec[0].iov_len = writable;
+    vec[1].iov_base = extra;
+    vec[1].iov_len = sizeof(extra);
+    ssize_t n;
+    do {
+        n = ::readv(fd, vec, 2);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+        *savedErrno = errno;
+    } else if ((size_t)n <= writable) {
+        _writeIdx += n;
+    } else {
+        _writeIdx = _buf.size();
+        append(extra, n - writable);
+    }
+    return n;
+}
+
+void InputBuffer::retrieve(size_t n){
+    if (n >= readable()) {
+        _readIdx = _writeIdx;
+    } else {
+        _readIdx += n;
+    }
+}
+
+void InputBuffer::append(const char *data, size_t len){
+    ensureWritable(len);
+    memcpy(_buf.data() + _writeIdx, data, len);
+    _writeIdx += len;
+}
+
+void InputBuffer::ensureWritable(size_t len){
+    if (_buf.size() - _writeIdx >= len) return;
+    size_t remain = readable();
+    if (_readIdx + (_buf.size() - _writeIdx) >= len) {
+        //前面空出来的空间够用：把未处理的部分挪到开头
+        memmove(_buf.data(), _buf.data() + _readIdx, remain);
+    } else {
+        std::vector<char> bigger(std::max(_buf.size() * 2, remain + len));
+        memcpy(bigger.data(), _buf.data() + _readIdx, remain);
+        _buf.swap(bigger);
+    }
+    _readIdx = 0;
+    _writeIdx = remain;
+}
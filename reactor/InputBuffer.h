@@ -0,0 +1,33 @@
+#ifndef __INPUTBUFFER_H__
+#define __INPUTBUFFER_H__
+
+#include <vector>
+#include <stddef.h>
+#include <sys/types.h>
+
+// 连续接收缓冲区：[readIdx, writeIdx) 为未处理数据。
+// 取走数据只移动 readIdx，不搬移内存；只有尾部空间不够时才把剩余的半个报文挪到开头，
+// 所以已取出条目的视图在下一次 readFd 之前一直有效
+class InputBuffer {
+public:
+    explicit InputBuffer(size_t initSize = 64 * 1024);
+    ~InputBuffer();
+
+    // 从 fd 读一次（readv，尾部空间不够时借用栈上 64KB），返回读到的字节数，0 为对端关闭，-1 出错
+    ssize_t readFd(int fd, int *savedErrno);
+
+    const char *peek() const { return _buf.data() + _readIdx; }
+    size_t readable() const { return _writeIdx - _readIdx; }
+    void retrieve(size_t n);
+    void retrieveAll() { _readIdx = _writeIdx = 0; }
+
+private:
+    void append(const char *data, size_t len);
+    void ensureWritable(size_t len);
+
+    std::vector<char> _buf;
+    size_t _readIdx;
+    size_t _writeIdx;
+};
+
+#endif
@@ -12,19 +12,25 @@ using std::endl;
 
 
 
-MultiThreadEventLoop::MultiThreadEventLoop(const std::string& ip, unsigned short port, size_t threadNum)
-: _acceptor(ip, port)
-, _mainLoop(_acceptor, true)
+MultiThreadEventLoop::MultiThreadEventLoop(const std::string& ip, unsigned short port, size_t threadNum, bool reusePort)
+: _reusePort(reusePort)
+, _acceptor(ip, port)
+, _mainLoop(_acceptor, !reusePort)
 , _threadNum(threadNum)
 , _threadPool(_threadNum, 10)
 , _nextLoopIndex(0)
 , _running(false) {
     
-    LOG_INFO("MultiThreadEventLoop created - IP: %s, Port: %d, Threads: %zu", ip.c_str(), port, threadNum);
+    LOG_INFO("MultiThreadEventLoop created - IP: %s, Port: %d, Threads: %zu, ReusePort: %d", ip.c_str(), port, threadNum, reusePort);
     
     // 创建子EventLoop
     for (size_t i = 0; i < _threadNum; ++i) {
-        _subLoops.emplace_back(std::make_unique<EventLoop>(_acceptor, false));
+        if (_reusePort) {
+            _subAcceptors.emplace_back(std::make_unique<Acceptor>(ip, port));
+            _subLoops.emplace_back(std::make_unique<EventLoop>(*_subAcceptors.back(), false));
+        } else {
+            _subLoops.emplace_back(std::make_unique<EventLoop>(_acceptor, false));
+        }
         LOG_DEBUG("Created sub EventLoop %zu", i);
     }
 }
@@ -50,6 +56,14 @@ void MultiThreadEventLoop::start() {
                     std::bind(&MultiThreadEventLoop::onMessage, this, std::placeholders::_1));
                 loop->setCloseCallback(
                     std::bind(&MultiThreadEventLoop::onClose, this, std::placeholders::_1));
+                if (_reusePort) {
+                    // 子loop自己监听并accept，新连接直接在本线程建立
+                    loop->setNewConnectionCallback([this, loop](int connfd) {
+                        setupConnection(loop, connfd);
+                    });
+                    _subAcceptors[loopIndex]->ready();
+                    loop->enableAccept();
+                }
                 loop->loop();
             }
             LOG_INFO("Worker thread EventLoop %zu stopped", loopIndex);
@@ -65,7 +79,9 @@ void MultiThreadEventLoop::start() {
     
     // 启动主EventLoop
     LOG_INFO("Starting main EventLoop...");
-    _acceptor.ready();
+    if (!_reusePort) {
+        _acceptor.ready();
+    }
     _mainLoop.loop();
 }
 
@@ -113,44 +129,53 @@ EventLoop* MultiThreadEventLoop::getNextLoop() {
     return _subLoops[index].get();
 }
 
+std::vector<EventLoop*> MultiThreadEventLoop::getSubLoops() {
+    std::vector<EventLoop*> loops;
+    for (auto &loop : _subLoops) {
+        loops.push_back(loop.get());
+    }
+    return loops;
+}
+
 void MultiThreadEventLoop::onNewConnection(int connfd) {
     EventLoop* loop = getNextLoop();
     loop->runInLoop([connfd, loop, this]() {
-        TcpConnectionPtr connPtr(new TcpConnection(loop, connfd));
-        LOG_DEBUG("Created TcpConnection for fd: %d", connfd);
-        loop->addTcpConnection(connPtr);
-        connPtr->setMessageCallback(
-            std::bind(&MultiThreadEventLoop::onMessage, this, std::placeholders::_1));
-        connPtr->setCloseCallback(
-            std::bind(&MultiThreadEventLoop::onClose, this, std::placeholders::_1));
-        auto rtspConn = std::make_shared<RtspConnect>(connPtr, loop);
-        connPtr->setRtspConnect(rtspConn);
-        LOG_DEBUG("RTSP connection setup completed for fd: %d", connfd);
+        setupConnection(loop, connfd);
     });
 }
 
+void MultiThreadEventLoop::setupConnection(EventLoop* loop, int connfd) {
+    TcpConnectionPtr connPtr(new TcpConnection(loop, connfd));
+    LOG_DEBUG("Created TcpConnection for fd: %d", connfd);
+    loop->addTcpConnection(connPtr);
+    connPtr->setMessageCallback(
+        std::bind(&MultiThreadEventLoop::onMessage, this, std::placeholders::_1));
+    connPtr->setCloseCallback(
+        std::bind(&MultiThreadEventLoop::onClose, this, std::placeholders::_1));
+    auto rtspConn = std::make_shared<RtspConnect>(connPtr, loop);
+    connPtr->setRtspConnect(rtspConn);
+    LOG_DEBUG("RTSP connection setup completed for fd: %d", connfd);
+}
+
 void MultiThreadEventLoop::onMessage(const TcpConnectionPtr& conn) {
     // LOG_DEBUG("Received message from connection: %s", conn->toString().c_str());
     auto rtspConn = conn->getRtspConnect();
+    // 一次可读事件里把已收全的条目全部处理掉，视图在下次 recvItems 前有效
+    const std::vector<RecvItemView> &items = conn->recvItems();
     if (!rtspConn) {
         LOG_WARN("No RTSP connection found for: %s", conn->toString().c_str());
-        // 仍然把数据读掉避免堆积
-        (void)conn->recvOneItem();
-        return;
-    }
-    
-    RecvItem item = conn->recvOneItem();
-    if (item.type == RecvItemType::None) {
-        return;
+        return;//数据已经读掉，避免堆积
     }
-    if (item.type == RecvItemType::RtspRequest) {
-        LOG_DEBUG("Handling RTSP request (%zu bytes)", item.rtsp.size());
-        rtspConn->handleRequest(item.rtsp);
-    } else if (item.type == RecvItemType::InterleavedFrame) {
-        LOG_DEBUG("Handling RTP Over TCP %zu Data",item.frame.payload.size());
-        rtspConn->onInterleavedFrame(item.frame.channel,
-                                    (const uint8_t*)item.frame.payload.data(),
-                                    item.frame.payload.size());
+    for (const RecvItemView &item : items) {
+        if (item.type == RecvItemType::RtspRequest) {
+            LOG_DEBUG("Handling RTSP request (%zu bytes)", item.len);
+            rtspConn->handleRequest(item.data, item.len);
+        } else if (item.type == RecvItemType::InterleavedFrame) {
+            LOG_DEBUG("Handling RTP Over TCP %zu Data", item.len);
+            rtspConn->onInterleavedFrame(item.channel,
+                                        reinterpret_cast<const uint8_t*>(item.data),
+                                        item.len);
+        }
     }
 }
 
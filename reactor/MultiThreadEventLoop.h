@@ -14,7 +14,9 @@
 
 class MultiThreadEventLoop {
 public:
-    MultiThreadEventLoop(const std::string& ip, unsigned short port, size_t threadNum);
+    // reusePort=true 时每个子EventLoop各自持有一个绑定同一端口的监听socket（SO_REUSEPORT），
+    // 由内核把新连接分散到各子loop直接accept，不再经主loop转交
+    MultiThreadEventLoop(const std::string& ip, unsigned short port, size_t threadNum, bool reusePort = false);
     ~MultiThreadEventLoop();
 
     void start();
@@ -25,19 +27,24 @@ public:
     
     // 获取主EventLoop
     EventLoop* getMainLoop() { return &_mainLoop; }
+    // 全部子EventLoop，供其他服务（如监控服务）把连接挂到这些线程上
+    std::vector<EventLoop*> getSubLoops();
 
 private:
     // void threadFunc();  // 工作线程函数
     void onNewConnection(int connfd);
+    void setupConnection(EventLoop* loop, int connfd);//在loop线程中创建TcpConnection和RtspConnect
     void onMessage(const TcpConnectionPtr& connPtr);
     void onClose(const TcpConnectionPtr& connPtr);
     void createRtpUdpConnection(std::shared_ptr<RtspConnect> rtspConn);
     void onRtpData(const UdpConnectionPtr& udpConn);
 
 private:
+    bool _reusePort;
     Acceptor _acceptor;
-    EventLoop _mainLoop;  // 主线程的EventLoop，负责接受连接
+    EventLoop _mainLoop;  // 主线程的EventLoop，负责接受连接（reusePort模式下只用于阻塞start）
     
+    std::vector<std::unique_ptr<Acceptor>> _subAcceptors;  // reusePort模式下每个子loop的监听socket
     std::vector<std::unique_ptr<EventLoop>> _subLoops;  // 子线程的EventLoop
     size_t _threadNum;
 
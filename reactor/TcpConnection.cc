@@ -2,20 +2,49 @@
 #include <iostream>
 #include <sstream>
 #include <string.h>
+#include <strings.h>
 #include "Logger.h"
 
 using std::cout;
 using std::endl;
 using std::ostringstream;
 
-static inline bool iequals_prefix(const std::string& s, const std::string& key) {
-    if (s.size() < key.size()) return false;
-    for (size_t i = 0; i < key.size(); ++i) {
-        char a = (char)std::tolower((unsigned char)s[i]);
-        char b = (char)std::tolower((unsigned char)key[i]);
-        if (a != b) return false;
+static const size_t kMaxInterleavedLen = 15000;//$ 帧长度上限，超过视为错位数据
+static const size_t kMaxRtspHeader = 8192;//RTSP 头部长度上限
+static const size_t kMaxRtspBody = 1024 * 1024;
+
+// 只在头部范围内逐行找 Content-Length（大小写不敏感，冒号前后可以有空白），取该行第一个整数，
+// 和 RtspRequest 解析头部的写法一致，两边对请求边界的判断不会分歧
+static size_t parseContentLength(const char *header, size_t len) {
+    static const char kKey[] = "content-length";
+    const size_t keyLen = sizeof(kKey) - 1;
+    const char *end = header + len;
+    const char *line = header;
+    while (line < end) {
+        const char *eol = static_cast<const char *>(memchr(line, '\n', end - line));
+        if (!eol) eol = end;
+        const char *p = line;
+        while (p < eol && (*p == ' ' || *p == '\t')) ++p;
+        if ((size_t)(eol - p) > keyLen && strncasecmp(p, kKey, keyLen) == 0) {
+            p += keyLen;
+            while (p < eol && (*p == ' ' || *p == '\t')) ++p;
+            if (p == eol || *p != ':') {
+                line = eol + 1;
+                continue;//Content-LengthX 之类的其他头
+            }
+            ++p;
+            while (p < eol && (*p == ' ' || *p == '\t')) ++p;
+            size_t value = 0;
+            while (p < eol && *p >= '0' && *p <= '9') {
+                value = value * 10 + (*p - '0');
+                if (value > kMaxRtspBody) break;
+                ++p;
+            }
+            return value;
+        }
+        line = eol + 1;
     }
-    return true;
+    return 0;
 }
 
 TcpConnection::TcpConnection(EventLoop* loop, int fd)
@@ -24,6 +53,7 @@ TcpConnection::TcpConnection(EventLoop* loop, int fd)
 ,_sock(fd)
 ,_localAddr(getLocalAddr())
 ,_peerAddr(getPeerAddr()){
+    _sock.setNoblock();//写不完的部分交给发送链，不能阻塞loop
 
     LOG_INFO("TcpConnection created - fd: %d, local: %s, peer: %s", 
              fd, _localAddr.toString().c_str(), _peerAddr.toString().c_str());
@@ -34,27 +64,90 @@ TcpConnection::~TcpConnection(){
 }
 
 void TcpConnection::send(const string &msg){
-    if (_sendBuffer.empty() && !_isWriting) {
+    if (_sendChain.empty() && !_isWriting) {
         int written = _sockIO.writen(msg.c_str(), msg.size());
+        if (written < 0) {
+            LOG_ERROR("Write error for fd %d: %s", getFd(), strerror(errno));
+            return;
+        }
         if (written < (int)msg.size()) {
             // 没写完，缓存剩余部分
-            _sendBuffer = msg.substr(written);
-            _isWriting = true;
-            _loop->addEpollWriteFd(getFd());
+            _sendChain.append(msg.substr(written));
+            enableWriting();
             // LOG_DEBUG("Partial write for fd %d: %d/%zu bytes, buffering remaining", 
             //          getFd(), written, msg.size());
-        } else {
-            // LOG_DEBUG("Complete write for fd %d: %zu bytes", getFd(), msg.size());
         }
     } else {
-        // 缓冲区有数据，直接追加
-        _sendBuffer += msg;
-        if (!_isWriting) {
-            _isWriting = true;
-            _loop->addEpollWriteFd(getFd());
+        // 发送链有数据，直接追加
+        _sendChain.append(std::string(msg));
+        enableWriting();
+        LOG_DEBUG("Appended to send chain for fd %d: %zu bytes, total buffered: %zu", 
+                 getFd(), msg.size(), _sendChain.bytes());
+    }
+}
+
+void TcpConnection::send(const BufferPtr &buf, size_t offset, size_t len){
+    if (_sendChain.empty() && !_isWriting) {
+        int written = _sockIO.writen(buf->data() + offset, len);
+        if (written < 0) {
+            LOG_ERROR("Write error for fd %d: %s", getFd(), strerror(errno));
+            return;
+        }
+        if (written < (int)len) {
+            // 没写完，只记录剩余片段的引用
+            _sendChain.append(buf, offset + written, len - written);
+            enableWriting();
         }
-        LOG_DEBUG("Appended to send buffer for fd %d: %zu bytes, total buffered: %zu", 
-                 getFd(), msg.size(), _sendBuffer.size());
+    } else {
+        _sendChain.append(buf, offset, len);
+        enableWriting();
+    }
+}
+
+void TcpConnection::send(const char *head, size_t headLen, const BufferPtr &buf, size_t offset, size_t len){
+    _sendChain.append(std::string(head, headLen));
+    _sendChain.append(buf, offset, len);
+    if (_isWriting) {
+        return;//等 EPOLLOUT 时一起写出
+    }
+    ssize_t written = _sendChain.flush(getFd());
+    if (written < 0) {
+        LOG_ERROR("Write error for fd %d: %s", getFd(), strerror(errno));
+        _sendChain.clear();
+        return;
+    }
+    if (!_sendChain.empty()) {
+        enableWriting();
+    }
+}
+
+void TcpConnection::sendInLoop(const char *head, size_t headLen, const BufferPtr &buf, size_t offset, size_t len){
+    if(_loop){
+        auto self = shared_from_this();
+        std::string h(head, headLen);
+        _loop->runInLoop([self, h, buf, offset, len](){
+            self->send(h.data(), h.size(), buf, offset, len);
+        });
+    } else {
+        LOG_ERROR("No loop available for sendInLoop on fd %d", getFd());
+    }
+}
+
+void TcpConnection::sendInLoop(const BufferPtr &buf, size_t offset, size_t len){
+    if(_loop){
+        auto self = shared_from_this();
+        _loop->runInLoop([self, buf, offset, len](){
+            self->send(buf, offset, len);
+        });
+    } else {
+        LOG_ERROR("No loop available for sendInLoop on fd %d", getFd());
+    }
+}
+
+void TcpConnection::enableWriting(){
+    if (!_isWriting) {
+        _isWriting = true;
+        _loop->addEpollWriteFd(getFd());
     }
 }
 
@@ -78,135 +171,119 @@ string TcpConnection::recive(){
 }
 
 
-// bool TcpConnection::tryExtractInterleaved(InterleavedFrame& out) {
-    
-//     if (_recvBuffer.empty() || _recvBuffer[0] != '$') return false;
-//     if (_recvBuffer.size() < 4) return false; // 还没到 4 字节头
-
-//     const uint8_t* p = reinterpret_cast<const uint8_t*>(_recvBuffer.data());
-//     uint8_t channel = p[1];
-//     uint16_t len = (uint16_t(p[2]) << 8) | uint16_t(p[3]);
-
-//     // 可选：简单风控，防止异常巨长
-//     if (len > 15000) { // 你也可以换成更合理的上限
-//         LOG_WARN("Interleaved frame length too large: %u, dropping", (unsigned)len);
-//         // 丢弃 '$' 以避免死循环
-//         _recvBuffer.erase(0, 1);
-//         return false;
-//     }
-//     if (_recvBuffer.size() < 4u + len) return false; // 体还没收全
-
-//     out.channel = channel;
-//     out.payload.assign(_recvBuffer.data() + 4, len);
-//     _recvBuffer.erase(0, 4u + len);
-//     return true;
-// }
+bool TcpConnection::tryExtractInterleaved(RecvItemView& out) {
+    const size_t avail = _recvBuffer.readable();
+    if (avail < 4) return false; // 还没到 4 字节头
 
-bool TcpConnection::tryExtractInterleaved(InterleavedFrame& out) {
-    
-    if (_recvBuffer.empty() || _recvBuffer[0] != '$') return false;
-    if (_recvBuffer.size() < 4) return false; // 还没到 4 字节头
-
-    const uint8_t* p = reinterpret_cast<const uint8_t*>(_recvBuffer.data());
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(_recvBuffer.peek());
     uint8_t channel = p[1];
     uint16_t len = (uint16_t(p[2]) << 8) | uint16_t(p[3]);
 
-    // 可选：简单风控，防止异常巨长
-    if (len > 15000) { // 你也可以换成更合理的上限
+    // 简单风控，防止异常巨长
+    if (len > kMaxInterleavedLen) {
         LOG_WARN("Interleaved frame length too large: %u, dropping", (unsigned)len);
-        // 丢弃 '$' 以避免死循环
-        _recvBuffer.erase(0, 1);
-        return false;
+        // 丢弃 '$' 以避免死循环，返回空条目让调用方重新找边界
+        _recvBuffer.retrieve(1);
+        out.type = RecvItemType::None;
+        return true;
     }
-    if (_recvBuffer.size() < 4u + len) return false; // 体还没收全
+    if (avail < 4u + len) return false; // 体还没收全
 
+    out.type = RecvItemType::InterleavedFrame;
     out.channel = channel;
-    out.payload.assign(_recvBuffer.data(), len + 4);
-    _recvBuffer.erase(0, 4u + len);
+    out.data = _recvBuffer.peek() + 4;
+    out.len = len;
+    _recvBuffer.retrieve(4u + len);
     return true;
 }
 
-bool TcpConnection::tryExtractRtsp(std::string& out) {
-    // 找 header 结束
-    size_t headerEnd = _recvBuffer.find("\r\n\r\n");
-    if (headerEnd == std::string::npos) return false;
-
-    const std::string header = _recvBuffer.substr(0, headerEnd + 4);
-
-    // 解析 Content-Length（大小写不敏感，只取该行第一个整数）
-    size_t contentLength = 0;
-    {
-        // 粗暴逐行找
-        size_t pos = 0;
-        while (pos < header.size()) {
-            size_t eol = header.find("\r\n", pos);
-            std::string line = header.substr(pos, (eol == std::string::npos ? header.size() : eol) - pos);
-            // 去掉前导空白
-            size_t i = 0; while (i < line.size() && std::isspace((unsigned char)line[i])) ++i;
-            std::string ltrim = line.substr(i);
-
-            if (iequals_prefix(ltrim, "content-length:")) {
-                size_t j = std::string("content-length:").size();
-                // 跳空白
-                while (j < ltrim.size() && std::isspace((unsigned char)ltrim[j])) ++j;
-                // 读取数字
-                size_t k = j;
-                while (k < ltrim.size() && std::isdigit((unsigned char)ltrim[k])) ++k;
-                try {
-                    if (k > j) contentLength = static_cast<size_t>(std::stoul(ltrim.substr(j, k - j)));
-                } catch (...) {
-                    contentLength = 0;
-                }
-                break;
-            }
-            if (eol == std::string::npos) break;
-            pos = eol + 2;
+bool TcpConnection::tryExtractRtsp(RecvItemView& out) {
+    const char *begin = _recvBuffer.peek();
+    const size_t avail = _recvBuffer.readable();
+    // 找 header 结束，上次已经找过的部分不再重复扫描
+    size_t from = _headerScanned > 3 ? _headerScanned - 3 : 0;
+    const char *found = nullptr;
+    if (avail > from) {
+        found = static_cast<const char *>(memmem(begin + from, avail - from, "\r\n\r\n", 4));
+    }
+    if (!found) {
+        if (avail > kMaxRtspHeader) {
+            LOG_WARN("RTSP header exceeds %zu bytes on fd %d, dropping", kMaxRtspHeader, getFd());
+            _recvBuffer.retrieve(1);
+            _headerScanned = 0;
+            out.type = RecvItemType::None;
+            return true;
         }
+        _headerScanned = avail;
+        return false;
     }
-    size_t tpos = _recvBuffer.rfind("TEARDOWN");
-    if(tpos != std::string::npos){//找到了TEARDOWN
-        size_t total =  headerEnd - tpos + 4;
-        out.assign(_recvBuffer.data() + tpos,total);
-        _recvBuffer.erase();
-    }else{
-        size_t total = headerEnd + 4 + contentLength;
-        if (_recvBuffer.size() < total) return false; // body 未收全
-        out.assign(_recvBuffer.data(), total);
-        _recvBuffer.erase(0, total);
-    }       
+    size_t headerLen = found - begin + 4;
+    _headerScanned = headerLen - 4;
+
+    size_t contentLength = parseContentLength(begin, headerLen);
+    if (contentLength > kMaxRtspBody) {
+        LOG_WARN("RTSP Content-Length too large on fd %d, dropping header", getFd());
+        _recvBuffer.retrieve(headerLen);
+        _headerScanned = 0;
+        out.type = RecvItemType::None;
+        return true;
+    }
+    size_t total = headerLen + contentLength;
+    if (avail < total) return false; // body 未收全
+
+    out.type = RecvItemType::RtspRequest;
+    out.data = begin;
+    out.len = total;
+    _recvBuffer.retrieve(total);
+    _headerScanned = 0;
     return true;
 }
 
-RecvItem TcpConnection::recvOneItem() {
-    char temp[8192];
-    int n = ::recv(_sock.fd(), temp, sizeof(temp), 0);
+bool TcpConnection::skipToNextItem() {
+    // 缓冲区开头既不是 $ 帧也不像 RTSP 请求，丢到下一个 '$'
+    const char *begin = _recvBuffer.peek();
+    size_t avail = _recvBuffer.readable();
+    const char *next = static_cast<const char *>(memchr(begin, '$', avail));
+    size_t skip = next ? (size_t)(next - begin) : avail;
+    LOG_DEBUG("Skipping %zu bytes of unknown data on fd %d", skip, getFd());
+    _recvBuffer.retrieve(skip);
+    _headerScanned = 0;
+    return next != nullptr;
+}
+
+const std::vector<RecvItemView> &TcpConnection::recvItems() {
+    _items.clear();
+    int savedErrno = 0;
+    ssize_t n = _recvBuffer.readFd(_sock.fd(), &savedErrno);
     if (n < 0) {
-        if (errno == EAGAIN || errno == EWOULDBLOCK) return {}; // 没有数据
-        LOG_ERROR("Error reading from fd %d: %s", getFd(), strerror(errno));
-        return {};
+        if (savedErrno != EAGAIN && savedErrno != EWOULDBLOCK) {
+            LOG_ERROR("Error reading from fd %d: %s", getFd(), strerror(savedErrno));
+        }
+        return _items;
     } else if (n == 0) {
         LOG_DEBUG("Peer closed fd %d", getFd());
-        return {};//连接关闭
+        return _items;//连接关闭
     }
-    _recvBuffer.append(temp, n);
-    std::string req;
-    InterleavedFrame fr;
-    if(tryExtractRtsp(req)){
-        RecvItem item;
-        item.type = RecvItemType::RtspRequest;
-        item.rtsp = std::move(req);
-        return item;
-    }else if (tryExtractInterleaved(fr)) {
-        RecvItem item;
-        item.type = RecvItemType::InterleavedFrame;
-        item.frame = std::move(fr);
-        return item;
-    }else{
-        std::string prefix = _recvBuffer.substr(0, std::min(_recvBuffer.size(), (size_t)50));
-        for(char& c : prefix) if (!std::isprint((unsigned char)c)) c = '.';
-        LOG_DEBUG("Buffer contains incomplete data or unknown format. Size: %zu. Prefix: %s", _recvBuffer.size(), prefix.c_str());
-        return {};
+    // 按缓冲区开头的第一个字节判断类型，依次取出所有完整条目，只移动读下标不拷贝
+    while (_recvBuffer.readable() > 0) {
+        char c = *_recvBuffer.peek();
+        RecvItemView item;
+        bool complete;
+        if (c == '$') {
+            complete = tryExtractInterleaved(item);
+        } else if ((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')) {
+            // 方法名开头的请求；监控端协议的应答行以状态码开头（"200 OK"），同样按头部+body取出
+            complete = tryExtractRtsp(item);
+        } else {
+            if (!skipToNextItem()) break;
+            continue;
+        }
+        if (!complete) break;
+        if (item.type != RecvItemType::None) {
+            _items.push_back(item);
+        }
     }
+    return _items;
 }
 
 string TcpConnection::toString(){
@@ -297,13 +374,13 @@ void TcpConnection::handleCloseCallback(){
     }
 }
 
-TimerId TcpConnection::addOneTimer(int delaySec, TimerCallback &&cb){
-    LOG_DEBUG("Adding one-shot timer for fd %d: %d seconds", getFd(), delaySec);
-    return _loop->addOneTimer(delaySec, std::move(cb));
+TimerId TcpConnection::addOneTimer(int delayMs, TimerCallback &&cb){
+    LOG_DEBUG("Adding one-shot timer for fd %d: %d ms", getFd(), delayMs);
+    return _loop->addOneTimer(delayMs, std::move(cb));
 }
-TimerId TcpConnection::addPeriodicTimer(int delaySec, int intervalSec, TimerCallback &&cb){
-    LOG_DEBUG("Adding periodic timer for fd %d: delay=%d, interval=%d", getFd(), delaySec, intervalSec);
-    return _loop->addPeriodicTimer(delaySec, intervalSec, std::move(cb));
+TimerId TcpConnection::addPeriodicTimer(int delayMs, int intervalMs, TimerCallback &&cb){
+    LOG_DEBUG("Adding periodic timer for fd %d: delay=%dms, interval=%dms", getFd(), delayMs, intervalMs);
+    return _loop->addPeriodicTimer(delayMs, intervalMs, std::move(cb));
 }
 void TcpConnection::removeTimer(TimerId timerId){
     LOG_DEBUG("Removing timer %lu for fd %d", timerId, getFd());
@@ -311,23 +388,22 @@ void TcpConnection::removeTimer(TimerId timerId){
 }
 
 void TcpConnection::handleWriteCallback() {
-    if (_sendBuffer.empty()) {
+    if (_sendChain.empty()) {
         _isWriting = false;
         _loop->delEpollWriteFd(getFd());
         LOG_DEBUG("Write buffer empty for fd %d, removed write event", getFd());
         return;
     }
-    int written = _sockIO.writen(_sendBuffer.c_str(), _sendBuffer.size());
+    ssize_t written = _sendChain.flush(getFd());
     if (written < 0) {
         // 错误，关闭连接
         LOG_ERROR("Write error for fd %d: %s", getFd(), strerror(errno));
         handleCloseCallback();
         return;
     }
-    _sendBuffer.erase(0, written);
-    LOG_DEBUG("Wrote %d bytes from buffer for fd %d, remaining: %zu", 
-             written, getFd(), _sendBuffer.size());
-    if (_sendBuffer.empty()) {
+    LOG_DEBUG("Wrote %zd bytes from chain for fd %d, remaining: %zu", 
+             written, getFd(), _sendChain.bytes());
+    if (_sendChain.empty()) {
         _isWriting = false;
         _loop->delEpollWriteFd(getFd());
         LOG_DEBUG("Write buffer completely sent for fd %d, removed write event", getFd());
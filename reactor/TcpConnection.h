@@ -5,27 +5,27 @@
 #include "SocketIO.h"
 #include "InetAddress.h"
 #include "EventLoop.h"
+#include "BufferChain.h"
+#include "InputBuffer.h"
 #include <memory>
 #include <functional>
 #include <string>
+#include <vector>
 using std::shared_ptr;
 using std::function;
 
-struct InterleavedFrame {
-    uint8_t  channel = 0;          // 0,1,2,3...
-    std::string payload;           // RTP/RTCP 原始字节
-};
-
 enum class RecvItemType {
     None,
-    RtspRequest,       // one complete RTSP request (string)
+    RtspRequest,       // one complete RTSP request (header + body)
     InterleavedFrame   // one complete $-frame
 };
 
-struct RecvItem {
+// 接收缓冲区中一个完整条目的视图，不拷贝数据；下一次 recvItems 之前有效
+struct RecvItemView {
     RecvItemType type = RecvItemType::None;
-    std::string  rtsp;             // 当 type==RtspRequest
-    InterleavedFrame frame;        // 当 type==InterleavedFrame
+    uint8_t channel = 0;           // 当 type==InterleavedFrame，0,1,2,3...
+    const char *data = nullptr;    // RTSP 请求原文，或去掉 4 字节 $ 头的 RTP/RTCP 包
+    size_t len = 0;
 };
 
 class RtspConnect;
@@ -39,6 +39,13 @@ public:
     ~TcpConnection();
     void send(const string &msg);
     void sendInLoop(const string &msg);
+    // 发送共享数据块的一段，排队时只持有引用不拷贝，多个连接可共享同一帧
+    void send(const BufferPtr &buf, size_t offset, size_t len);
+    void sendInLoop(const BufferPtr &buf, size_t offset, size_t len);
+    // 先发一小段私有头部再发共享数据块的一段（如 $ 帧头 + RTP 包），合并为一次 writev
+    void send(const char *head, size_t headLen, const BufferPtr &buf, size_t offset, size_t len);
+    void sendInLoop(const char *head, size_t headLen, const BufferPtr &buf, size_t offset, size_t len);
+    size_t pendingBytes() const { return _sendChain.bytes(); }//发送链中积压的字节数
     string recive();
     string reciveRtspRequest();//接收Rtsp请求
     string toString();
@@ -62,12 +69,13 @@ public:
     void setRtspConnect(const std::shared_ptr<RtspConnect>& conn);
     std::shared_ptr<RtspConnect> getRtspConnect();
 
-    TimerId addOneTimer(int delaySec, TimerCallback &&cb);
-    TimerId addPeriodicTimer(int delaySec, int intervalSec, TimerCallback &&cb);
+    TimerId addOneTimer(int delayMs, TimerCallback &&cb);
+    TimerId addPeriodicTimer(int delayMs, int intervalMs, TimerCallback &&cb);
     void removeTimer(TimerId timerId);
 
     void handleWriteCallback(); // 写事件回调
-    RecvItem recvOneItem();
+    // 读一次 socket，取出缓冲区里所有完整的 RTSP 请求和 $ 帧
+    const std::vector<RecvItemView> &recvItems();
     
 private:
     EventLoop *_loop;
@@ -79,18 +87,22 @@ private:
     为什么要有持久化 buffer？
     你每次 recv 到的数据，可能只是"消息的一部分"，也可能是"多条消息"。
     如果你只处理本次 recv 的内容，就会丢失消息边界，导致解析出错。
-    持久化 buffer就是把每次 recv 到的数据都 append 到一个成员变量（如 _recvBuffer）里，只要没处理完的数据都留着，直到拼出完整的消息。
+    持久化 buffer就是把每次 recv 到的数据都留在接收缓冲区里，只要没处理完的数据都留着，直到拼出完整的消息。
     */
-    std::string _recvBuffer;//持久化buffer
-    std::string _sendBuffer; // 发送缓冲区
+    InputBuffer _recvBuffer;//持久化buffer
+    std::vector<RecvItemView> _items;//本次取出的条目
+    size_t _headerScanned = 0;//RTSP 头部已经找过 \r\n\r\n 的长度，下次从这里继续找
+    BufferChain _sendChain; // 发送链，EPOLLOUT 时用 writev 写出
     bool _isWriting = false; // 是否正在监听写事件
 
     std::shared_ptr<RtspConnect> _rtspConn;
     // TcpConnectionCallback _onNewConnectionCb;
     TcpConnectionCallback _onMessageCb;
     TcpConnectionCallback _onCloseCb;
-    bool tryExtractInterleaved(InterleavedFrame& out);
-    bool tryExtractRtsp(std::string& out);
+    void enableWriting();
+    bool tryExtractInterleaved(RecvItemView& out);
+    bool tryExtractRtsp(RecvItemView& out);
+    bool skipToNextItem();
 };
 
 
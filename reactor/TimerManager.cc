@@ -2,11 +2,19 @@
 #include <sys/time.h>
 #include <string.h>
 #include <iostream>
-#include <atomic>
 #include "Logger.h"
 
 TimerManager::TimerManager()
-:_timerfd(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)){
+:_timerfd(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC))
+,_rootCount(0)
+,_count(0)
+,_current(getNowMs())
+,_armedAt(0)
+,_running(kNil)
+,_runningRemoved(false){
+    for (int i = 0; i <= kSlotNum; ++i) _heads[i] = kNil;
+    memset(_rootBits, 0, sizeof(_rootBits));
+    memset(_levelCount, 0, sizeof(_levelCount));
     LOG_DEBUG("TimeManager created with fd: %d", _timerfd);
 }
 
@@ -28,74 +36,229 @@ uint64_t TimerManager::getNowMs() const {
     return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;//返回毫秒
 }
 
-TimerManager::TimerId TimerManager::addTimer(int delaySec, TimerCallback &&cb) {
+TimerManager::TimerId TimerManager::addTimer(int delayMs, TimerCallback &&cb) {
     LOG_DEBUG("Add once timer event");
-    uint64_t expireTime = getNowMs() + delaySec;//计算到期执行时间单位毫秒
-    TimerId timerId = _nextId++;
-    _timers.emplace(timerId, std::make_pair(expireTime, Timer{0, std::move(cb)}));//添加到执行表，执行时间和回调函数
-    resetTimerfd();
-    return timerId;
+    return addPeriodicTimer(delayMs, 0, std::move(cb));
 }
 
-TimerManager::TimerId TimerManager::addPeriodicTimer(int delaySec, int intervalSec, TimerCallback &&cb) {
-    uint64_t expireTime = getNowMs() + delaySec;
-    TimerId timerId = _nextId++;
-    _timers.emplace(timerId, std::make_pair(expireTime, Timer{intervalSec, std::move(cb)}));
-    LOG_DEBUG("Add periodic timer event timerId: %d",timerId);
+TimerManager::TimerId TimerManager::addPeriodicTimer(int delayMs, int intervalMs, TimerCallback &&cb) {
+    uint64_t now = getNowMs();
+    if (_count == 0 && _running == kNil) {
+        _current = now;//时间轮空闲时直接拨到当前时间，避免追赶空转
+    }
+    uint32_t idx = allocTimer();
+    Timer &timer = _nodes[idx];
+    timer.expire = now + (delayMs > 0 ? delayMs : 0);//计算到期执行时间单位毫秒
+    timer.interval = intervalMs > 0 ? intervalMs : 0;
+    timer.callback = std::move(cb);
+    place(idx);
     resetTimerfd();
-    return timerId;
+    return (static_cast<TimerId>(timer.gen) << 32) | idx;
 }
 
 void TimerManager::removeTimer(TimerId timerId) {
-    LOG_DEBUG("Remove timer");
-    auto it = _timers.find(timerId);
-    if (it != _timers.end()) {
-        _timers.erase(it);
-        resetTimerfd();  // 删除后重置 timerfd
+    uint32_t idx = static_cast<uint32_t>(timerId);
+    uint32_t gen = static_cast<uint32_t>(timerId >> 32);
+    if (idx >= _nodes.size() || _nodes[idx].gen != gen) {
+        return;//已经执行完或已删除
+    }
+    if (idx == _running) {
+        _runningRemoved = true;//回调里删除自己，执行完后再回收
+        return;
     }
+    if (_nodes[idx].slot < 0) {
+        return;
+    }
+    unlink(idx);
+    freeTimer(idx);
+    // 不重设 timerfd：提前醒来一次无害，省掉一次系统调用
 }
 
 void TimerManager::handleRead() {
     uint64_t expirations;
     ssize_t ret = ::read(_timerfd, &expirations, sizeof(expirations));  // 清除触发状态
     (void)ret; // 忽略返回值
+    _armedAt = 0;
 
     uint64_t now = getNowMs();
+    while (_current <= now) {
+        int idx = _current & (kRootSize - 1);
+        if (idx == 0) {
+            //第0层转完一圈，依次把上层对应槽下放
+            if (cascade(1) == 0 && cascade(2) == 0) {
+                cascade(3);
+            }
+        }
+        while (_heads[idx] != kNil) {
+            uint32_t t = _heads[idx];
+            unlink(t);
+            link(t, kExpiringSlot);
+        }
+        // 先拨到下一刻度再执行回调：回调里新加的 0ms 定时器落在下一刻度，
+        // 而不是刚取空的槽（那样要等第0层转完一圈）
+        ++_current;
+        runExpiring(now);
+        if (_rootCount == 0 && (_current & (kRootSize - 1)) != 0) {
+            //第0层为空，直接跳到下一次下放的刻度
+            uint64_t boundary = (_current | (kRootSize - 1)) + 1;
+            _current = boundary < now + 1 ? boundary : now + 1;
+        }
+    }
 
-    std::vector<std::pair<TimerId, Timer>> expired;
+    resetTimerfd();
+}
+
+void TimerManager::runExpiring(uint64_t now) {
+    while (_heads[kExpiringSlot] != kNil) {
+        uint32_t idx = _heads[kExpiringSlot];
+        unlink(idx);
+        //回调可能新增定时器导致 _nodes 扩容，先把回调移出来再执行
+        TimerCallback cb = std::move(_nodes[idx].callback);
+        _running = idx;
+        _runningRemoved = false;
+        if (cb) cb();
+        _running = kNil;
+        Timer &timer = _nodes[idx];
+        if (timer.interval > 0 && !_runningRemoved) {
+            timer.callback = std::move(cb);
+            timer.expire = now + timer.interval;
+            place(idx);
+        } else {
+            freeTimer(idx);
+        }
+    }
+}
 
-    for (auto it = _timers.begin(); it != _timers.end() && it->second.first <= now;) {
-        expired.push_back({it->first, it->second.second});
-        it = _timers.erase(it);
+uint32_t TimerManager::allocTimer() {
+    uint32_t idx;
+    if (!_freeList.empty()) {
+        idx = _freeList.back();
+        _freeList.pop_back();
+    } else {
+        idx = static_cast<uint32_t>(_nodes.size());
+        _nodes.emplace_back();
+        _nodes[idx].gen = 1;
     }
+    Timer &timer = _nodes[idx];
+    timer.prev = timer.next = kNil;
+    timer.slot = -1;
+    ++_count;
+    return idx;
+}
 
-    for (auto& pair : expired) {
-        auto& timerId = pair.first;
-        auto& timer = pair.second;
+void TimerManager::freeTimer(uint32_t idx) {
+    Timer &timer = _nodes[idx];
+    timer.callback = nullptr;
+    timer.slot = -1;
+    if (++timer.gen == 0) timer.gen = 1;//让旧的 TimerId 失效
+    _freeList.push_back(idx);
+    --_count;
+}
 
-        if (timer.callback) timer.callback();
-        if (timer.interval > 0) {
-            _timers.emplace(timerId, std::make_pair(now + timer.interval, timer));
-        }
+void TimerManager::link(uint32_t idx, int slot) {
+    Timer &timer = _nodes[idx];
+    timer.slot = slot;
+    timer.prev = kNil;
+    timer.next = _heads[slot];
+    if (timer.next != kNil) _nodes[timer.next].prev = idx;
+    _heads[slot] = idx;
+    if (slot < kRootSize) {
+        ++_rootCount;
+        _rootBits[slot >> 6] |= 1ULL << (slot & 63);
+    } else if (slot < kSlotNum) {
+        ++_levelCount[(slot - kRootSize) / kLevelSize];
     }
+}
 
-    resetTimerfd();
+void TimerManager::unlink(uint32_t idx) {
+    Timer &timer = _nodes[idx];
+    int slot = timer.slot;
+    if (timer.prev != kNil) _nodes[timer.prev].next = timer.next;
+    else _heads[slot] = timer.next;
+    if (timer.next != kNil) _nodes[timer.next].prev = timer.prev;
+    timer.prev = timer.next = kNil;
+    timer.slot = -1;
+    if (slot < kRootSize) {
+        --_rootCount;
+        if (_heads[slot] == kNil) _rootBits[slot >> 6] &= ~(1ULL << (slot & 63));
+    } else if (slot < kSlotNum) {
+        --_levelCount[(slot - kRootSize) / kLevelSize];
+    }
 }
 
+void TimerManager::place(uint32_t idx) {
+    uint64_t expire = _nodes[idx].expire;
+    if (expire < _current) expire = _current;//已过期的放到当前刻度
+    uint64_t delta = expire - _current;
+    int slot;
+    if (delta < (1ULL << kRootBits)) {
+        slot = expire & (kRootSize - 1);
+    } else if (delta < (1ULL << (kRootBits + kLevelBits))) {
+        slot = kRootSize + ((expire >> kRootBits) & (kLevelSize - 1));
+    } else if (delta < (1ULL << (kRootBits + 2 * kLevelBits))) {
+        slot = kRootSize + kLevelSize + ((expire >> (kRootBits + kLevelBits)) & (kLevelSize - 1));
+    } else {
+        //超出覆盖范围的先挂在最高层最远的槽，下放时会再次放置
+        uint64_t maxDelta = (1ULL << (kRootBits + 3 * kLevelBits)) - 1;
+        if (delta > maxDelta) expire = _current + maxDelta;
+        slot = kRootSize + 2 * kLevelSize + ((expire >> (kRootBits + 2 * kLevelBits)) & (kLevelSize - 1));
+    }
+    link(idx, slot);
+}
 
-void TimerManager::resetTimerfd() {
-    if (_timers.empty()) {
-        itimerspec spec{};
-        timerfd_settime(_timerfd, 0, &spec, nullptr);  // 停用定时器
-        return;
+int TimerManager::cascade(int level) {
+    int shift = kRootBits + (level - 1) * kLevelBits;
+    int index = (_current >> shift) & (kLevelSize - 1);
+    int slot = kRootSize + (level - 1) * kLevelSize + index;
+    while (_heads[slot] != kNil) {
+        uint32_t idx = _heads[slot];
+        unlink(idx);
+        place(idx);
     }
+    return index;
+}
 
-    uint64_t nextExpire = _timers.begin()->second.first;
-    uint64_t now = getNowMs();
-    uint64_t diffMs = (nextExpire > now) ? (nextExpire - now) : 1;
+uint64_t TimerManager::nextExpireHint() const {
+    uint64_t next = 0;
+    if (_rootCount > 0) {
+        //第0层：从当前刻度起找下一个非空槽
+        int pos = _current & (kRootSize - 1);
+        for (int i = 0; i <= kRootSize / 64; ++i) {
+            int word = ((pos >> 6) + i) % (kRootSize / 64);
+            uint64_t bits = _rootBits[word];
+            if (i == 0) bits &= ~0ULL << (pos & 63);
+            else if (i == kRootSize / 64) bits &= ~(~0ULL << (pos & 63));
+            if (bits) {
+                int slot = word * 64 + __builtin_ctzll(bits);
+                next = _current + ((slot - pos) & (kRootSize - 1));
+                break;
+            }
+        }
+    }
+    //上层：最早在最低非空层的下一个刻度边界下放，下放进来的可能比第0层现有的更早到期
+    for (int level = 1; level <= kLevels; ++level) {
+        if (_levelCount[level - 1] > 0) {
+            uint64_t span = 1ULL << (kRootBits + (level - 1) * kLevelBits);
+            uint64_t boundary = (_current + span - 1) & ~(span - 1);
+            if (next == 0 || boundary < next) next = boundary;
+            break;
+        }
+    }
+    return next;
+}
 
+void TimerManager::resetTimerfd() {
+    uint64_t nextExpire = nextExpireHint();
+    if (nextExpire == _armedAt) {
+        return;//已按该时间设定，省掉系统调用
+    }
     itimerspec spec{};
-    spec.it_value.tv_sec = diffMs / 1000;
-    spec.it_value.tv_nsec = (diffMs % 1000) * 1000000;
-    timerfd_settime(_timerfd, 0, &spec, nullptr);
+    _armedAt = nextExpire;
+    if (nextExpire == 0) {
+        timerfd_settime(_timerfd, 0, &spec, nullptr);  // 停用定时器
+        return;
+    }
+    spec.it_value.tv_sec = nextExpire / 1000;
+    spec.it_value.tv_nsec = (nextExpire % 1000) * 1000000;
+    timerfd_settime(_timerfd, TFD_TIMER_ABSTIME, &spec, nullptr);
 }
@@ -2,25 +2,27 @@
 #define __TIMER_MANAGER_H__
 
 #include <functional>
-#include <map>
 #include <vector>
 #include <sys/timerfd.h>
 #include <unistd.h>
 #include <stdint.h>
 
+// 分层时间轮定时器，精度 1ms，插入和取消 O(1)
+// 第0层 256 个槽，每槽 1ms；第1~3层各 64 个槽，每槽跨度是上一层一整圈，
+// 总覆盖约 18.6 小时，更远的定时器先挂在最高层，到期前会被逐层下放
 class TimerManager {
 public:
     using TimerCallback = std::function<void()>;
-    using TimerId = uint64_t; 
+    using TimerId = uint64_t;
 
     TimerManager();
     ~TimerManager();
 
-    // 添加一次性定时器（延时秒数）
-    TimerId addTimer(int delaySec, TimerCallback &&cb);
+    // 添加一次性定时器（延时毫秒数）
+    TimerId addTimer(int delayMs, TimerCallback &&cb);
 
-    // 添加周期性定时器（延时、周期秒数）
-    TimerId addPeriodicTimer(int delaySec, int intervalSec, TimerCallback &&cb);
+    // 添加周期性定时器（首次延时、周期毫秒数）
+    TimerId addPeriodicTimer(int delayMs, int intervalMs, TimerCallback &&cb);
 
     // 获取底层timerfd
     int getTimerFd() const { return _timerfd; }
@@ -30,16 +32,50 @@ public:
 
     void removeTimer(TimerId timerId);  // 删除定时器
 
+    size_t size() const { return _count; }
+
 private:
+    static const int kRootBits = 8;
+    static const int kLevelBits = 6;
+    static const int kRootSize = 1 << kRootBits;    // 256
+    static const int kLevelSize = 1 << kLevelBits;  // 64
+    static const int kLevels = 3;                   // 第0层之外的层数
+    static const int kSlotNum = kRootSize + kLevels * kLevelSize;
+    static const int kExpiringSlot = kSlotNum;      // 正在执行的到期链表
+    static const uint32_t kNil = 0xffffffff;
+
     struct Timer {
-        int interval;  // 0 表示一次性，>0 表示周期
+        uint64_t expire;        // 到期时间（毫秒）
+        int interval;           // 0 表示一次性，>0 表示周期
         TimerCallback callback;
+        uint32_t prev;          // 槽内双向链表（下标）
+        uint32_t next;
+        int slot;               // 所在槽，-1 表示不在时间轮上
+        uint32_t gen;           // 复用计数，用于校验 TimerId
     };
 
-    int _timerfd;
-    std::map<TimerId, std::pair<uint64_t, Timer>> _timers;  // key: expiration time
+    uint32_t allocTimer();
+    void freeTimer(uint32_t idx);
+    void link(uint32_t idx, int slot);
+    void unlink(uint32_t idx);
+    void place(uint32_t idx);           // 按到期时间放入合适的槽
+    int cascade(int level);             // 把上层一个槽的定时器重新下放
+    void runExpiring(uint64_t now);
     void resetTimerfd();  // 设置下一个 timerfd 到期时间
-    TimerId _nextId = 1;  // 用于生成唯一的 TimerId
+    uint64_t nextExpireHint() const;    // 下一次需要唤醒的时间
+
+    int _timerfd;
+    std::vector<Timer> _nodes;          // 定时器节点池
+    std::vector<uint32_t> _freeList;
+    uint32_t _heads[kSlotNum + 1];      // 各槽链表头
+    uint64_t _rootBits[kRootSize / 64]; // 第0层非空槽位图
+    size_t _rootCount;                  // 第0层定时器个数
+    size_t _levelCount[kLevels];        // 第1~3层各层定时器个数
+    size_t _count;                      // 定时器总数
+    uint64_t _current;                  // 时间轮当前刻度（毫秒）
+    uint64_t _armedAt;                  // timerfd 当前设定的到期时间，0 表示未设定
+    uint32_t _running;                  // 正在执行回调的定时器
+    bool _runningRemoved;               // 回调里删除了自己
 
     uint64_t getNowMs() const;
 };
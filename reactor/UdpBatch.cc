@@ -0,0 +1,86 @@
+#include "UdpBatch.h"
+#include "Logger.h"
+#include <string.h>
+#include <errno.h>
+
+UdpRecvBatch::UdpRecvBatch()
+:_count(0){
+    memset(_msgs, 0, sizeof(_msgs));
+    for (int i = 0; i < kMaxMsgs; ++i) {
+        _iov[i].iov_base = _bufs[i];
+        _iov[i].iov_len = kMaxDatagram;
+        _msgs[i].msg_hdr.msg_iov = &_iov[i];
+        _msgs[i].msg_hdr.msg_iovlen = 1;
+        _msgs[i].msg_hdr.msg_name = &_addrs[i];
+    }
+}
+
+int UdpRecvBatch::recv(int fd){
+    for (int i = 0; i < kMaxMsgs; ++i) {
+        _msgs[i].msg_hdr.msg_namelen = sizeof(_addrs[i]);//每次收包前要恢复成缓冲区大小
+    }
+    int n;
+    do {
+        n = ::recvmmsg(fd, _msgs, kMaxMsgs, MSG_DONTWAIT, nullptr);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+        _count = 0;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+        LOG_ERROR("recvmmsg error on fd %d: %s", fd, strerror(errno));
+        return -1;
+    }
+    _count = n;
+    return n;
+}
+
+UdpSendBatch::UdpSendBatch(int fd)
+:_fd(fd)
+,_count(0)
+,_used(0){
+    memset(_msgs, 0, sizeof(_msgs));
+}
+
+void UdpSendBatch::append(const void *data, size_t len, const struct sockaddr_in &peer){
+    if (_count == kMaxMsgs) {
+        flush();
+    }
+    if (_storage.size() < _used + len) {
+        _storage.resize(_used + len);
+    }
+    memcpy(_storage.data() + _used, data, len);
+    _offsets[_count] = _used;
+    _iov[_count].iov_len = len;
+    _addrs[_count] = peer;
+    _used += len;
+    ++_count;
+}
+
+int UdpSendBatch::flush(){
+    if (_count == 0) return 0;
+    //缓冲区可能扩容过，发送前再设置各报文地址
+    for (int i = 0; i < _count; ++i) {
+        _iov[i].iov_base = _storage.data() + _offsets[i];
+        _msgs[i].msg_hdr.msg_iov = &_iov[i];
+        _msgs[i].msg_hdr.msg_iovlen = 1;
+        _msgs[i].msg_hdr.msg_name = &_addrs[i];
+        _msgs[i].msg_hdr.msg_namelen = sizeof(_addrs[i]);
+    }
+    int sent = 0;
+    int done = 0;
+    while (sent < _count) {
+        int n = ::sendmmsg(_fd, _msgs + sent, _count - sent, MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            //某个目的地出错（如 ICMP 不可达）只跳过这一个报文，其余照常发送
+            LOG_ERROR("sendmmsg error on fd %d: %s", _fd, strerror(errno));
+            ++sent;
+            continue;
+        }
+        sent += n;
+        done += n;
+    }
+    _count = 0;
+    _used = 0;
+    return done;
+}
@@ -0,0 +1,60 @@
+#ifndef __UDPBATCH_H__
+#define __UDPBATCH_H__
+
+#include "InetAddress.h"
+#include <vector>
+#include <stddef.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+// 批量收包：预先分配好 mmsghdr/iovec/地址/缓冲区，一次 recvmmsg 收多个报文。
+// 收到的数据在下一次 recv 之前有效；同一线程的多个 UDP fd 可以共用一个
+class UdpRecvBatch {
+public:
+    static const int kMaxMsgs = 32;
+    static const int kMaxDatagram = 2048;
+
+    UdpRecvBatch();
+
+    // 非阻塞收一批，返回报文个数，没有数据返回 0，出错返回 -1
+    int recv(int fd);
+
+    int size() const { return _count; }
+    const char *data(int i) const { return _bufs[i]; }
+    size_t len(int i) const { return _msgs[i].msg_len; }
+    const struct sockaddr_in &addr(int i) const { return _addrs[i]; }
+
+private:
+    int _count;
+    struct mmsghdr _msgs[kMaxMsgs];
+    struct iovec _iov[kMaxMsgs];
+    struct sockaddr_in _addrs[kMaxMsgs];
+    char _bufs[kMaxMsgs][kMaxDatagram];
+};
+
+// 批量发包：append 时拷贝报文（KCP 的 output 缓冲会被复用），flush 时一次 sendmmsg 发出。
+// 报文缓冲按实际用量增长后复用，攒满 kMaxMsgs 个自动 flush
+class UdpSendBatch {
+public:
+    static const int kMaxMsgs = 64;
+
+    explicit UdpSendBatch(int fd = -1);
+
+    void setFd(int fd) { _fd = fd; }
+    void append(const void *data, size_t len, const struct sockaddr_in &peer);
+    // 返回发出的报文个数；发送缓冲满（EAGAIN）时丢弃剩余报文，UDP 上由 KCP 负责重传
+    int flush();
+    int size() const { return _count; }
+
+private:
+    int _fd;
+    int _count;
+    size_t _used;
+    std::vector<char> _storage;
+    size_t _offsets[kMaxMsgs];
+    struct mmsghdr _msgs[kMaxMsgs];
+    struct iovec _iov[kMaxMsgs];
+    struct sockaddr_in _addrs[kMaxMsgs];
+};
+
+#endif
@@ -7,8 +7,8 @@ using std::cout;
 using std::endl;
 using std::ostringstream;
 
-UdpConnection::UdpConnection(const string &ip,unsigned short port,InetAddress peerAddr,EventLoop* loopPtr)
-    : _loopPtr(loopPtr), _sock(ip,port,peerAddr), _localAddr(getLocalAddr()), _peerAddr(peerAddr) {
+UdpConnection::UdpConnection(const string &ip,unsigned short port,InetAddress peerAddr,EventLoop* loopPtr,bool reusePort)
+    : _loopPtr(loopPtr), _sock(ip,port,peerAddr,reusePort), _localAddr(getLocalAddr()), _peerAddr(peerAddr), _sendBatch(_sock.fd()) {
     _sock.setReuseAddr();
     _sock.setReusePort();
 }
@@ -36,6 +36,21 @@ int UdpConnection::recv(void* buff, size_t len) {
     return n;
 }
 
+int UdpConnection::recvBatch(UdpRecvBatch &batch) {
+    int n = batch.recv(_sock.fd());
+    if (n > 0)
+        _peerAddr = InetAddress(batch.addr(n - 1));
+    return n;
+}
+
+void UdpConnection::queueSend(const void *data, int len) {
+    _sendBatch.append(data, len, *_peerAddr.getInetAddrPtr());
+}
+
+int UdpConnection::flushSend() {
+    return _sendBatch.flush();
+}
+
 void UdpConnection::setMessageCallback(const UdpConnectionCallback& cb) {
     _onMessageCb = std::move(cb);
 }
@@ -64,12 +79,12 @@ int UdpConnection::getUdpFd() const {
     return _sock.fd();
 }
 
-TimerId UdpConnection::addOneTimer(int delaySec, TimerCallback&& cb) {
-    return _loopPtr ? _loopPtr->addOneTimer(delaySec, std::move(cb)) : 0;
+TimerId UdpConnection::addOneTimer(int delayMs, TimerCallback&& cb) {
+    return _loopPtr ? _loopPtr->addOneTimer(delayMs, std::move(cb)) : 0;
 }
 
-TimerId UdpConnection::addPeriodicTimer(int delaySec, int intervalSec, TimerCallback&& cb) {
-    return _loopPtr ? _loopPtr->addPeriodicTimer(delaySec, intervalSec, std::move(cb)) : 0;
+TimerId UdpConnection::addPeriodicTimer(int delayMs, int intervalMs, TimerCallback&& cb) {
+    return _loopPtr ? _loopPtr->addPeriodicTimer(delayMs, intervalMs, std::move(cb)) : 0;
 }
 
 void UdpConnection::removeTimer(TimerId timerId) {
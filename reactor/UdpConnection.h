@@ -4,6 +4,7 @@
 #include "UdpSocket.h"
 #include "InetAddress.h"
 #include "EventLoop.h"
+#include "UdpBatch.h"
 #include <memory>
 #include <functional>
 #include <string>
@@ -19,12 +20,18 @@ class UdpConnection : public std::enable_shared_from_this<UdpConnection> {
     using UdpConnectionCallback = function<void(const UdpConnectionPtr&)>;
     
 public:
-    explicit UdpConnection(const string &ip,unsigned short port,InetAddress peerAddr, EventLoop* loopPtr);
+    // reusePort=true 时多个loop可各自绑定同一端口（如监控端KCP端口），由内核按来源分散
+    explicit UdpConnection(const string &ip,unsigned short port,InetAddress peerAddr, EventLoop* loopPtr, bool reusePort = false);
     ~UdpConnection();
     
     int send(const std::string& msg,int len);
     void sendInLoop(const std::string& msg,int len);
     int recv(void *buff,size_t len);
+    // 一次 recvmmsg 收一批，返回报文个数（0 没有数据，-1 出错），对端地址取最后一个报文的来源
+    int recvBatch(UdpRecvBatch &batch);
+    // 报文先放进发送批，flushSend 时一次 sendmmsg 发给对端
+    void queueSend(const void *data, int len);
+    int flushSend();
     
     // 回调函数注册
     void setMessageCallback(const UdpConnectionCallback& cb);
@@ -37,8 +44,8 @@ public:
     
     int getUdpFd() const;
     
-    TimerId addOneTimer(int delaySec, TimerCallback&& cb);
-    TimerId addPeriodicTimer(int delaySec, int intervalSec, TimerCallback&& cb);
+    TimerId addOneTimer(int delayMs, TimerCallback&& cb);
+    TimerId addPeriodicTimer(int delayMs, int intervalMs, TimerCallback&& cb);
     void removeTimer(TimerId timerId);
     
 private:
@@ -46,6 +53,7 @@ private:
     UdpSocket _sock;
     InetAddress _localAddr;
     InetAddress _peerAddr;
+    UdpSendBatch _sendBatch;
     
     UdpConnectionCallback _onMessageCb;
 };
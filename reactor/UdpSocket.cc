@@ -7,7 +7,7 @@
 #include <errno.h>
 #include <string.h>
 
-UdpSocket::UdpSocket(const string &ip,unsigned short port,InetAddress clientAddr)
+UdpSocket::UdpSocket(const string &ip,unsigned short port,InetAddress clientAddr,bool reusePort)
 :_serverAddr(ip,port)
 ,_clientAddr(clientAddr){
     _fd = ::socket(AF_INET, SOCK_DGRAM, 0);
@@ -15,6 +15,9 @@ UdpSocket::UdpSocket(const string &ip,unsigned short port,InetAddress clientAddr
         perror("socket");
         return;
     }
+    if (reusePort) {
+        setReusePort();
+    }
     bind();
     setNoblock();
     setReuseAddr();
@@ -8,7 +8,8 @@
 
 class UdpSocket : NonCopyable {
 public:
-    UdpSocket(const string &ip,unsigned short port,InetAddress clientAddr);
+    // reusePort=true 时绑定前设置 SO_REUSEPORT，多个loop可各自绑定同一端口
+    UdpSocket(const string &ip,unsigned short port,InetAddress clientAddr,bool reusePort = false);
     explicit UdpSocket(int fd);
     ~UdpSocket();
     
@@ -0,0 +1,52 @@
+// DetectionIndex::parse：正常的检测扩展头、被截短或长度不对的扩展头（不能读出包外）
+#include "DetectionIndex.h"
+#include <stdio.h>
+#include <string>
+
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+    printf("%s %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok) ++failures;
+}
+
+// RTP 头（X 位）+ 'DT' 扩展头，extWords 是扩展头长度字段（32 位字数），body 是扩展头内容
+static std::string packet(uint16_t extWords, const std::string &body) {
+    std::string pkt = {char(0x90), 96, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1};
+    pkt += {'D', 'T', char(extWords >> 8), char(extWords)};
+    pkt += body;
+    return pkt;
+}
+
+int main() {
+    DetectionFrame frame;
+    size_t b = 0, e = 0;
+
+    // 一个框：class 2、score 200、坐标 (1,2)-(4095,4094)
+    std::string block = {1, 1, 0, 0, 0x12, 0x34, 0x56, 0x78};
+    std::string box = {2, char(200), 0x00, 0x10, 0x02, char(0xFF), char(0xFF), char(0xFE)};
+    std::string ok = packet(4, block + box) + "\x65payload";
+    check(DetectionIndex::parse(ok.data(), ok.size(), frame, b, e) && frame.timestamp == 0x12345678 &&
+          frame.boxes.size() == 1 && frame.boxes[0].classId == 2 && frame.boxes[0].score == 200 &&
+          frame.boxes[0].x0 == 1 && frame.boxes[0].y0 == 2 && frame.boxes[0].x1 == 4095 &&
+          frame.boxes[0].y1 == 4094 && b == 12 && e == 32, "well-formed extension");
+
+    // 长度为 0 的扩展头正好在包尾，块头不在包里
+    std::string empty = packet(0, "");
+    check(!DetectionIndex::parse(empty.data(), empty.size(), frame, b, e), "zero-length extension at packet end");
+
+    // 扩展头只有 4 字节，不够块头
+    std::string shortExt = packet(1, std::string("\x01\x05\x00\x00", 4));
+    check(!DetectionIndex::parse(shortExt.data(), shortExt.size(), frame, b, e), "extension shorter than block header");
+
+    // 块头声明 5 个框，扩展头里只有 1 个
+    std::string tooMany = block;
+    tooMany[1] = 5;
+    std::string lying = packet(4, tooMany + box);
+    check(!DetectionIndex::parse(lying.data(), lying.size(), frame, b, e), "box count beyond extension");
+
+    // 扩展头长度字段超出包长
+    std::string cut = packet(4, block);
+    check(!DetectionIndex::parse(cut.data(), cut.size(), frame, b, e), "extension length beyond packet");
+    return failures ? 1 : 0;
+}
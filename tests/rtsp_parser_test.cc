@@ -0,0 +1,45 @@
+// RtspRequest 的 Content-Length 处理：溢出、超过上限、body 未收全都不能让 body 越过输入缓冲区
+#include "RtspParser.h"
+#include <stdio.h>
+#include <string>
+
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+    printf("%s %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok) ++failures;
+}
+
+static RtspRequest::Result parse(const std::string &msg, RtspRequest &req) {
+    req.reset();
+    return req.parse(msg.data(), msg.size());
+}
+
+int main() {
+    RtspRequest req;
+    const std::string head = "SET_PARAMETER rtsp://127.0.0.1/cam RTSP/1.0\r\nCSeq: 3\r\n";
+
+    check(parse(head + "Content-Length: 11\r\n\r\nevent: door", req) == RtspRequest::Complete &&
+          req.body().len == 11, "body framed by Content-Length");
+    check(parse(head + "Content-Length : 11\r\n\r\nevent: door", req) == RtspRequest::Complete &&
+          req.body().len == 11, "blank before the colon is tolerated");
+    check(parse(head + "Content-Length : 18446744073709551615\r\n\r\nx", req) == RtspRequest::Error,
+          "SIZE_MAX Content-Length is rejected");
+    check(parse(head + "Content-Length: 99999999999999999999999\r\n\r\nx", req) == RtspRequest::Error,
+          "overflowing Content-Length is rejected");
+    check(parse(head + "Content-Length: 2000000\r\n\r\nx", req) == RtspRequest::Error,
+          "Content-Length over the body cap is rejected");
+    check(parse(head + "Content-Length: abc\r\n\r\n", req) == RtspRequest::Error,
+          "non-numeric Content-Length is rejected");
+    check(parse(head + "Content-Length: 20\r\n\r\nevent: door", req) == RtspRequest::Incomplete,
+          "short body waits for more data");
+    check(parse(head + "\r\n", req) == RtspRequest::Complete && req.body().len == 0,
+          "no Content-Length means no body");
+
+    unsigned long v;
+    check(StringPiece("18446744073709551615").toULong(v) && v == 18446744073709551615UL,
+          "toULong accepts ULONG_MAX");
+    check(!StringPiece("18446744073709551616").toULong(v) && StringPiece("18446744073709551616").toULong() == 0,
+          "toULong rejects overflow");
+    return failures ? 1 : 0;
+}
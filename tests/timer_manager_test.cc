@@ -0,0 +1,96 @@
+// TimerManager 回归测试：回调里重新挂的 0ms 定时器要在下一个刻度执行，不能等第0层转一圈（256ms）
+// KcpScheduler 按 ikcp_check 算出的延时重挂定时器，延时常常是 0
+#include "TimerManager.h"
+#include <poll.h>
+#include <stdio.h>
+#include <time.h>
+
+static uint64_t nowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// 像 EventLoop 一样等 timerfd 可读再调 handleRead，直到 done 或超时
+static void drive(TimerManager &tm, const bool &done, int timeoutMs) {
+    uint64_t deadline = nowMs() + timeoutMs;
+    while (!done && nowMs() < deadline) {
+        struct pollfd pfd = {tm.getTimerFd(), POLLIN, 0};
+        if (poll(&pfd, 1, 10) > 0) tm.handleRead();
+    }
+}
+
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+    printf("%s %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok) ++failures;
+}
+
+// 回调里挂 0ms 定时器，链式重挂若干次，每次都应在 1~2 个刻度内执行
+static void testRearmZeroDelay() {
+    TimerManager tm;
+    const int kRounds = 20;
+    int fired = 0;
+    bool done = false;
+    uint64_t last = 0, worst = 0;
+    std::function<void()> cb;
+    cb = [&]() {
+        uint64_t t = nowMs();
+        if (fired > 0 && t - last > worst) worst = t - last;
+        last = t;
+        if (++fired == kRounds) {
+            done = true;
+            return;
+        }
+        tm.addTimer(0, [&]() { cb(); });
+    };
+    tm.addTimer(0, [&]() { cb(); });
+    drive(tm, done, 2000);
+    check(fired == kRounds, "re-armed 0ms timer keeps firing");
+    // 留余量给调度抖动，修复前每次间隔约 256ms
+    check(worst < 20, "re-armed 0ms timer fires on the next tick");
+    check(tm.size() == 0, "one-shot timers are freed");
+}
+
+// 周期定时器在回调里删除自己后不再执行
+static void testPeriodicRemoveSelf() {
+    TimerManager tm;
+    int fired = 0;
+    bool done = false;
+    TimerManager::TimerId id = 0;
+    id = tm.addPeriodicTimer(1, 1, [&]() {
+        if (++fired == 3) tm.removeTimer(id);
+    });
+    tm.addTimer(50, [&]() { done = true; });
+    drive(tm, done, 1000);
+    check(fired == 3, "periodic timer removed from its own callback stops");
+    check(tm.size() == 0, "all timers freed");
+}
+
+// 上层的定时器要按时下放：第0层已有一个更晚到期的定时器时，不能等到它才醒来
+static void testCascadeBeforeRootTimer() {
+    TimerManager tm;
+    uint64_t start = nowMs();
+    uint64_t firedLong = 0, firedShort = 0;
+    bool done = false;
+    tm.addTimer(300, [&]() { firedLong = nowMs() - start; });  // 超过第0层一圈，挂在第1层
+    tm.addTimer(100, [&]() {
+        tm.addTimer(250, [&]() {
+            firedShort = nowMs() - start;
+            done = true;
+        });
+    });
+    drive(tm, done, 2000);
+    printf("     300ms timer fired at %lums, 100+250ms timer at %lums\n",
+           (unsigned long)firedLong, (unsigned long)firedShort);
+    check(firedLong >= 300 && firedLong < 320, "upper-level timer cascades in on time");
+    check(firedShort >= 350, "root timer still fires on time");
+}
+
+int main() {
+    testRearmZeroDelay();
+    testCascadeBeforeRootTimer();
+    testPeriodicRemoveSelf();
+    return failures ? 1 : 0;
+}